@@ -100,6 +100,9 @@ bool AABBTest(const AABB& boxA, const AABB& boxB, Vector2f& offsetOut)
 
 bool AABBSweepTest(const AABB& boxA, const AABB& boxB, const Vector2f& delta, Vector2f& outPos)
 {
+	static const int sweepCounter = PlayProfiler::Instance().RegisterCounter("AABB sweep tests");
+	PlayProfiler::Count(sweepCounter);
+
 	if (delta.null == 0.f && delta.y == 0.f) {
 		Vector2f offset;
 		if (AABBTest(boxA, boxB, offset))
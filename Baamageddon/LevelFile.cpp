@@ -0,0 +1,429 @@
+///////////////////////////////////////////////////////////////////////////
+//	File		: LevelFile.cpp
+//  Reading and writing Baamageddon levels (shared with the Level Editor).
+//  Levels are edited as text (.lev) and cooked into a binary format (.blev)
+//  which is memory-mapped and used in place without any parsing.
+//  Binary levels are partitioned into square sectors so they can be streamed.
+//  Objects can have named properties, which override their type's defaults.
+///////////////////////////////////////////////////////////////////////////
+
+#include "Play.h"
+#include "LevelFile.h"
+
+//-------------------------------------------------------------------------
+
+bool LevelFile::Open( const char* filename )
+{
+	Close();
+
+	m_pData = static_cast<const uint8_t*>( PlayWindow::MapFile( filename, m_size, m_hMapping ) );
+	if( !m_pData )
+		return false;
+
+	// Check everything the accessors rely on, so they don't need to check it again
+	m_pHeader = reinterpret_cast<const Header*>( m_pData );
+	bool valid = m_size >= sizeof( Header ) && memcmp( m_pHeader->magic, "BLEV", 4 ) == 0 && m_pHeader->version == LEVEL_FILE_VERSION;
+
+	valid = valid && sizeof( Header ) + ( static_cast<uint64_t>( m_pHeader->blockCount ) * sizeof( Block ) ) <= m_size;
+	valid = valid && m_pHeader->sectorSize > 0 && m_pHeader->sectorOffset % alignof( LevelSector ) == 0 && m_pHeader->sectorOffset + ( static_cast<uint64_t>( m_pHeader->sectorCount ) * sizeof( LevelSector ) ) <= m_size;
+	valid = valid && m_pHeader->stringOffsetsOffset % alignof( uint32_t ) == 0 && m_pHeader->stringOffsetsOffset + ( static_cast<uint64_t>( m_pHeader->stringCount ) * sizeof( uint32_t ) ) <= m_size;
+	valid = valid && static_cast<uint64_t>( m_pHeader->stringDataOffset ) + m_pHeader->stringDataSize <= m_size;
+	valid = valid && m_pHeader->stringDataSize > 0 && m_pData[m_pHeader->stringDataOffset + m_pHeader->stringDataSize - 1] == '\0';
+
+	if( valid )
+	{
+		m_pBlocks = reinterpret_cast<const Block*>( m_pData + sizeof( Header ) );
+		m_pSectors = reinterpret_cast<const LevelSector*>( m_pData + m_pHeader->sectorOffset );
+		m_pStringOffsets = reinterpret_cast<const uint32_t*>( m_pData + m_pHeader->stringOffsetsOffset );
+		m_pStrings = reinterpret_cast<const char*>( m_pData + m_pHeader->stringDataOffset );
+
+		for( uint32_t b = 0; b < m_pHeader->blockCount && valid; b++ )
+		{
+			const Block& block = m_pBlocks[b];
+			valid = block.name < m_pHeader->stringCount && block.sector < m_pHeader->sectorCount;
+			valid = valid && block.recordOffset % alignof( LevelRecord ) == 0 && block.recordOffset + ( static_cast<uint64_t>( block.recordCount ) * sizeof( LevelRecord ) ) <= m_size;
+
+			// The sprite names are checked too, so they can be used to index tables sized by GetStringCount()
+			const LevelRecord* pRecords = reinterpret_cast<const LevelRecord*>( m_pData + block.recordOffset );
+			for( uint32_t r = 0; r < block.recordCount && valid; r++ )
+				valid = pRecords[r].sprite < m_pHeader->stringCount;
+
+			// Properties must belong to the block's objects, in order, so they can be walked alongside them
+			valid = valid && block.propertyOffset % alignof( LevelPropertyRecord ) == 0 && block.propertyOffset + ( static_cast<uint64_t>( block.propertyCount ) * sizeof( LevelPropertyRecord ) ) <= m_size;
+
+			const LevelPropertyRecord* pProperties = reinterpret_cast<const LevelPropertyRecord*>( m_pData + block.propertyOffset );
+			for( uint32_t p = 0; p < block.propertyCount && valid; p++ )
+				valid = pProperties[p].name < m_pHeader->stringCount && pProperties[p].record < block.recordCount && ( p == 0 || pProperties[p - 1].record <= pProperties[p].record );
+		}
+
+		// Each sector's blocks must belong to it and its record numbering must add up
+		for( uint32_t i = 0; i < m_pHeader->sectorCount && valid; i++ )
+		{
+			const LevelSector& sector = m_pSectors[i];
+			valid = static_cast<uint64_t>( sector.firstBlock ) + sector.blockCount <= m_pHeader->blockCount;
+			valid = valid && static_cast<uint64_t>( sector.firstRecord ) + sector.recordCount <= m_pHeader->recordCount;
+
+			uint64_t records = 0;
+			for( uint32_t b = sector.firstBlock; b < sector.firstBlock + sector.blockCount && valid; b++ )
+			{
+				valid = m_pBlocks[b].sector == i;
+				records += m_pBlocks[b].recordCount;
+			}
+
+			valid = valid && records == sector.recordCount;
+			valid = valid && ( i == 0 || m_pSectors[i - 1].x < sector.x || ( m_pSectors[i - 1].x == sector.x && m_pSectors[i - 1].y < sector.y ) );
+		}
+	}
+
+	if( !valid )
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+//-------------------------------------------------------------------------
+
+void LevelFile::Close()
+{
+	PlayWindow::UnmapFile( m_pData, m_hMapping );
+	m_pData = nullptr;
+	m_hMapping = nullptr;
+	m_size = 0;
+	m_pHeader = nullptr;
+	m_pBlocks = nullptr;
+	m_pSectors = nullptr;
+	m_pStringOffsets = nullptr;
+	m_pStrings = nullptr;
+}
+
+//-------------------------------------------------------------------------
+
+int LevelFile::GetBlockCount() const
+{
+	return m_pHeader ? static_cast<int>( m_pHeader->blockCount ) : 0;
+}
+
+const char* LevelFile::GetBlockTypeName( int blockIndex ) const
+{
+	return GetString( m_pBlocks[blockIndex].name );
+}
+
+int LevelFile::GetBlockRecordCount( int blockIndex ) const
+{
+	return static_cast<int>( m_pBlocks[blockIndex].recordCount );
+}
+
+const LevelRecord* LevelFile::GetBlockRecords( int blockIndex ) const
+{
+	return reinterpret_cast<const LevelRecord*>( m_pData + m_pBlocks[blockIndex].recordOffset );
+}
+
+int LevelFile::GetBlockPropertyCount( int blockIndex ) const
+{
+	return static_cast<int>( m_pBlocks[blockIndex].propertyCount );
+}
+
+const LevelPropertyRecord* LevelFile::GetBlockProperties( int blockIndex ) const
+{
+	return reinterpret_cast<const LevelPropertyRecord*>( m_pData + m_pBlocks[blockIndex].propertyOffset );
+}
+
+int LevelFile::GetTotalRecords() const
+{
+	return m_pHeader ? static_cast<int>( m_pHeader->recordCount ) : 0;
+}
+
+int LevelFile::GetSectorSize() const
+{
+	return m_pHeader ? static_cast<int>( m_pHeader->sectorSize ) : LEVEL_SECTOR_SIZE;
+}
+
+int LevelFile::GetSectorCount() const
+{
+	return m_pHeader ? static_cast<int>( m_pHeader->sectorCount ) : 0;
+}
+
+const LevelSector& LevelFile::GetSector( int sectorIndex ) const
+{
+	return m_pSectors[sectorIndex];
+}
+
+int LevelFile::GetStringCount() const
+{
+	return m_pHeader ? static_cast<int>( m_pHeader->stringCount ) : 0;
+}
+
+const char* LevelFile::GetString( uint32_t index ) const
+{
+	if( !m_pHeader || index >= m_pHeader->stringCount || m_pStringOffsets[index] >= m_pHeader->stringDataSize )
+		return "";
+
+	return m_pStrings + m_pStringOffsets[index];
+}
+
+//-------------------------------------------------------------------------
+
+uint32_t LevelFile::GetJournalSequence() const
+{
+	return m_pHeader ? m_pHeader->journalSequence : 0;
+}
+
+//-------------------------------------------------------------------------
+
+int FindLevelObjectType( const char* name )
+{
+	for( int t = 0; t < LEVEL_OBJECT_TYPE_COUNT; t++ )
+	{
+		if( strcmp( LEVEL_OBJECT_TYPES[t].name, name ) == 0 )
+			return t;
+	}
+
+	return -1;
+}
+
+//-------------------------------------------------------------------------
+
+bool ReadTextLevel( const char* filename, std::vector< LevelEntry >& vEntries, uint32_t* pJournalSequence )
+{
+	std::ifstream levelfile( filename );
+	if( !levelfile )
+		return false;
+
+	std::string sLine, sX, sY, sSprite;
+
+	// Skip the comment at the top of the file (apart from the journal sequence)
+	std::getline( levelfile, sLine );
+
+	if( pJournalSequence )
+	{
+		size_t journal = sLine.find( "[journal " );
+		*pJournalSequence = journal == std::string::npos ? 0 : static_cast<uint32_t>( std::strtoul( sLine.c_str() + journal + 9, nullptr, 10 ) );
+	}
+
+	// Stops as soon as there isn't a whole object left, so the last one isn't read twice
+	bool haveLine = static_cast<bool>( std::getline( levelfile, sLine ) );
+	while( haveLine && std::getline( levelfile, sX ) && std::getline( levelfile, sY ) && std::getline( levelfile, sSprite ) )
+	{
+		LevelEntry entry;
+		entry.type = sLine;
+		entry.pos = { std::strtof( sX.c_str(), nullptr ), std::strtof( sY.c_str(), nullptr ) };
+		entry.sprite = sSprite;
+
+		// Any line after the object which isn't a property is the next object's type
+		while( ( haveLine = static_cast<bool>( std::getline( levelfile, sLine ) ) ) && sLine.compare( 0, 5, "PROP " ) == 0 )
+		{
+			size_t nameEnd = sLine.find( ' ', 5 );
+			if( nameEnd != std::string::npos )
+				entry.vProperties.push_back( { sLine.substr( 5, nameEnd - 5 ), std::strtof( sLine.c_str() + nameEnd + 1, nullptr ) } );
+		}
+
+		vEntries.push_back( std::move( entry ) );
+	}
+
+	return true;
+}
+
+//-------------------------------------------------------------------------
+
+bool WriteTextLevel( const char* filename, const std::vector< LevelEntry >& vEntries, uint32_t journalSequence )
+{
+	// Written to a temporary file first, like the binary level, so a failed write never leaves a broken level behind
+	std::string tempFile = std::string( filename ) + ".tmp";
+	{
+		std::ofstream levelfile( tempFile );
+		if( !levelfile )
+			return false;
+
+		levelfile << "// This file is auto-generated by the Level Editor - it's not advisable to edit it directly as changes may be overwritten! [journal " << journalSequence << "]\n";
+
+		for( const LevelEntry& entry : vEntries )
+		{
+			levelfile << entry.type << "\n";
+			levelfile << std::to_string( entry.pos.null ) + "f\n" << std::to_string( entry.pos.y ) + "f\n";
+			levelfile << entry.sprite << "\n";
+
+			for( const LevelProperty& property : entry.vProperties )
+				levelfile << "PROP " << property.name << " " << std::to_string( property.value ) << "f\n";
+		}
+
+		if( !levelfile )
+			return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename( tempFile, filename, error );
+	return !error;
+}
+
+//-------------------------------------------------------------------------
+
+bool WriteBinaryLevel( const char* filename, const std::vector< LevelEntry >& vEntries, uint32_t sectorSize, uint32_t journalSequence )
+{
+	std::vector< std::string > vStrings;
+	std::map< std::string, uint32_t > stringIndex;
+
+	auto addString = [&]( const std::string& s )
+	{
+		auto it = stringIndex.find( s );
+		if( it != stringIndex.end() )
+			return it->second;
+
+		uint32_t index = static_cast<uint32_t>( vStrings.size() );
+		vStrings.push_back( s );
+		stringIndex[s] = index;
+		return index;
+	};
+
+	// Type names go first so the blocks in every sector are in order of the types' first appearance
+	for( const LevelEntry& entry : vEntries )
+		addString( entry.type );
+
+	// Group the objects by sector and then by type, keeping their order within each type
+	struct BlockData
+	{
+		std::vector< LevelRecord > vRecords;
+		std::vector< LevelPropertyRecord > vProperties;
+	};
+
+	std::map< std::pair< int32_t, int32_t >, std::map< uint32_t, BlockData > > sectorMap;
+
+	for( const LevelEntry& entry : vEntries )
+	{
+		int32_t sectorX = static_cast<int32_t>( std::floor( entry.pos.null / sectorSize ) );
+		int32_t sectorY = static_cast<int32_t>( std::floor( entry.pos.y / sectorSize ) );
+		uint32_t typeName = addString( entry.type );
+		BlockData& block = sectorMap[{ sectorX, sectorY }][typeName];
+
+		for( const LevelProperty& property : entry.vProperties )
+			block.vProperties.push_back( { static_cast<uint32_t>( block.vRecords.size() ), addString( property.name ), property.value } );
+
+		block.vRecords.push_back( { entry.pos.null, entry.pos.y, addString( entry.sprite ) } );
+	}
+
+	// The layout is: header, blocks, sectors, records for each block, properties for each block, string offsets and then the strings themselves
+	std::vector< LevelFile::Block > vBlocks;
+	std::vector< LevelSector > vSectors;
+	std::vector< const BlockData* > vBlockData;
+
+	for( const auto& sectorPair : sectorMap )
+	{
+		LevelSector sector;
+		sector.x = sectorPair.first.first;
+		sector.y = sectorPair.first.second;
+		sector.firstBlock = static_cast<uint32_t>( vBlocks.size() );
+		sector.blockCount = static_cast<uint32_t>( sectorPair.second.size() );
+		sector.firstRecord = vSectors.empty() ? 0 : vSectors.back().firstRecord + vSectors.back().recordCount;
+		sector.recordCount = 0;
+
+		for( const auto& typePair : sectorPair.second )
+		{
+			LevelFile::Block block;
+			block.name = typePair.first;
+			block.recordCount = static_cast<uint32_t>( typePair.second.vRecords.size() );
+			block.propertyCount = static_cast<uint32_t>( typePair.second.vProperties.size() );
+			block.sector = static_cast<uint32_t>( vSectors.size() );
+			vBlocks.push_back( block );
+			vBlockData.push_back( &typePair.second );
+			sector.recordCount += block.recordCount;
+		}
+
+		vSectors.push_back( sector );
+	}
+
+	LevelFile::Header header;
+	header.blockCount = static_cast<uint32_t>( vBlocks.size() );
+	header.stringCount = static_cast<uint32_t>( vStrings.size() );
+	header.recordCount = static_cast<uint32_t>( vEntries.size() );
+	header.sectorSize = sectorSize;
+	header.sectorCount = static_cast<uint32_t>( vSectors.size() );
+	header.sectorOffset = static_cast<uint32_t>( sizeof( LevelFile::Header ) + ( sizeof( LevelFile::Block ) * vBlocks.size() ) );
+	header.journalSequence = journalSequence;
+
+	uint32_t offset = header.sectorOffset + static_cast<uint32_t>( sizeof( LevelSector ) * vSectors.size() );
+	for( size_t b = 0; b < vBlocks.size(); b++ )
+	{
+		vBlocks[b].recordOffset = offset;
+		offset += static_cast<uint32_t>( sizeof( LevelRecord ) * vBlockData[b]->vRecords.size() );
+	}
+
+	for( size_t b = 0; b < vBlocks.size(); b++ )
+	{
+		vBlocks[b].propertyOffset = offset;
+		offset += static_cast<uint32_t>( sizeof( LevelPropertyRecord ) * vBlockData[b]->vProperties.size() );
+	}
+
+	std::vector< uint32_t > vStringOffsets;
+	std::string stringData;
+	for( const std::string& s : vStrings )
+	{
+		vStringOffsets.push_back( static_cast<uint32_t>( stringData.size() ) );
+		stringData += s;
+		stringData += '\0';
+	}
+
+	header.stringOffsetsOffset = offset;
+	header.stringDataOffset = offset + static_cast<uint32_t>( sizeof( uint32_t ) * vStringOffsets.size() );
+	header.stringDataSize = static_cast<uint32_t>( stringData.size() );
+
+	if( stringData.empty() )
+	{
+		// Open() expects at least one terminated string
+		stringData += '\0';
+		header.stringDataSize = 1;
+	}
+
+	// Written to a temporary file first so a failed write never leaves a broken level behind
+	std::string tempFile = std::string( filename ) + ".tmp";
+	{
+		std::ofstream levelfile( tempFile, std::ios::binary );
+		if( !levelfile )
+			return false;
+
+		levelfile.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+		levelfile.write( reinterpret_cast<const char*>( vBlocks.data() ), sizeof( LevelFile::Block ) * vBlocks.size() );
+		levelfile.write( reinterpret_cast<const char*>( vSectors.data() ), sizeof( LevelSector ) * vSectors.size() );
+		for( const BlockData* pBlock : vBlockData )
+			levelfile.write( reinterpret_cast<const char*>( pBlock->vRecords.data() ), sizeof( LevelRecord ) * pBlock->vRecords.size() );
+		for( const BlockData* pBlock : vBlockData )
+			levelfile.write( reinterpret_cast<const char*>( pBlock->vProperties.data() ), sizeof( LevelPropertyRecord ) * pBlock->vProperties.size() );
+		levelfile.write( reinterpret_cast<const char*>( vStringOffsets.data() ), sizeof( uint32_t ) * vStringOffsets.size() );
+		levelfile.write( stringData.data(), stringData.size() );
+
+		if( !levelfile )
+			return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename( tempFile, filename, error );
+	return !error;
+}
+
+//-------------------------------------------------------------------------
+
+bool ConvertTextLevel( const char* textFile, const char* binaryFile )
+{
+	std::vector< LevelEntry > vEntries;
+	uint32_t journalSequence = 0;
+	return ReadTextLevel( textFile, vEntries, &journalSequence ) && WriteBinaryLevel( binaryFile, vEntries, LEVEL_SECTOR_SIZE, journalSequence );
+}
+
+//-------------------------------------------------------------------------
+
+bool OpenLevel( LevelFile& level, const char* textFile, const char* binaryFile )
+{
+	std::error_code textError, binaryError;
+	std::filesystem::file_time_type textTime = std::filesystem::last_write_time( textFile, textError );
+	std::filesystem::file_time_type binaryTime = std::filesystem::last_write_time( binaryFile, binaryError );
+
+	if( !textError && ( binaryError || binaryTime < textTime ) )
+		ConvertTextLevel( textFile, binaryFile );
+
+	if( level.Open( binaryFile ) )
+		return true;
+
+	// The binary level may be from an older version, so try converting it again
+	return !textError && ConvertTextLevel( textFile, binaryFile ) && level.Open( binaryFile );
+}
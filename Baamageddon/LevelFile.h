@@ -0,0 +1,197 @@
+#pragma once
+///////////////////////////////////////////////////////////////////////////
+//	File		: LevelFile.h
+//  Reading and writing Baamageddon levels (shared with the Level Editor).
+//  Levels are edited as text (.lev) and cooked into a binary format (.blev)
+//  which is memory-mapped and used in place without any parsing.
+//  Binary levels are partitioned into square sectors so they can be streamed.
+//  Objects can have named properties, which override their type's defaults.
+///////////////////////////////////////////////////////////////////////////
+
+constexpr uint32_t LEVEL_FILE_VERSION = 3;
+constexpr uint32_t LEVEL_SECTOR_SIZE = 1024;
+
+//-------------------------------------------------------------------------
+
+// A property set on an object in a text level, e.g. a blade's radius
+struct LevelProperty
+{
+	std::string name;
+	float value;
+};
+
+//-------------------------------------------------------------------------
+
+// An object in a text level, or one which is about to be written to a binary level
+// > The type is stored by name so the game and editor can each use their own enums
+struct LevelEntry
+{
+	std::string type;
+	Point2f pos;
+	std::string sprite;
+	std::vector< LevelProperty > vProperties; // Only the ones which aren't the type's defaults
+};
+
+//-------------------------------------------------------------------------
+
+// The object types which can appear in a level, by the names used in the level files
+// > The game and editor each map these to their own enums with a table in the same order
+struct LevelObjectType
+{
+	const char* name;
+	int radius;
+	bool streamed; // Objects which aren't streamed are created when the level opens and always exist
+};
+
+constexpr LevelObjectType LEVEL_OBJECT_TYPES[] =
+{
+	{ "TYPE_SHEEP", 50, false },
+	{ "TYPE_ISLAND", 0, true },
+	{ "TYPE_DOUGHNUT", 30, true },
+	{ "TYPE_SPIKE", 30, true },
+	{ "TYPE_WOLF", 30, true },
+	{ "TYPE_BUSH", 30, true },
+	{ "TYPE_BLADE", 5, true },
+	{ "TYPE_FINAL", 30, false },
+};
+
+constexpr int LEVEL_OBJECT_TYPE_COUNT = sizeof( LEVEL_OBJECT_TYPES ) / sizeof( LEVEL_OBJECT_TYPES[0] );
+
+//-------------------------------------------------------------------------
+
+// The packed record for each object in a binary level
+struct LevelRecord
+{
+	float x;
+	float y;
+	uint32_t sprite; // Index into the string table
+};
+
+//-------------------------------------------------------------------------
+
+// The packed record for each property set on an object in a binary level
+struct LevelPropertyRecord
+{
+	uint32_t record; // Index of the object within its block
+	uint32_t name; // Index into the string table
+	float value;
+};
+
+//-------------------------------------------------------------------------
+
+// A square area of a binary level, which owns a consecutive run of blocks
+struct LevelSector
+{
+	int32_t x; // In units of the sector size
+	int32_t y;
+	uint32_t firstBlock;
+	uint32_t blockCount;
+	uint32_t firstRecord; // Index of the sector's first object counting through all the blocks
+	uint32_t recordCount;
+};
+
+//-------------------------------------------------------------------------
+
+// A binary level mapped into memory: the objects are grouped by sector, then by type, into packed arrays (blocks)
+class LevelFile
+{
+public:
+	LevelFile() = default;
+	~LevelFile() { Close(); }
+	LevelFile( const LevelFile& ) = delete;
+	LevelFile& operator=( const LevelFile& ) = delete;
+
+	// Maps a binary level into memory
+	// > Returns false if the file is missing or isn't a valid level
+	bool Open( const char* filename );
+	// Unmaps the level (any pointers from it are no longer valid)
+	void Close();
+
+	// Gets the number of blocks in the level
+	int GetBlockCount() const;
+	// Gets the name of the type of the objects in a block e.g. "TYPE_ISLAND"
+	const char* GetBlockTypeName( int blockIndex ) const;
+	// Gets the number of objects in a block
+	int GetBlockRecordCount( int blockIndex ) const;
+	// Gets the packed array of objects in a block
+	const LevelRecord* GetBlockRecords( int blockIndex ) const;
+	// Gets the number of properties set on the objects in a block
+	int GetBlockPropertyCount( int blockIndex ) const;
+	// Gets the packed array of properties set on the objects in a block, in order of their objects
+	const LevelPropertyRecord* GetBlockProperties( int blockIndex ) const;
+	// Gets the total number of objects in the level
+	int GetTotalRecords() const;
+	// Gets the width and height of the sectors
+	int GetSectorSize() const;
+	// Gets the number of sectors (only sectors containing objects are stored)
+	int GetSectorCount() const;
+	// Gets a sector: they're sorted by their x and then y coordinates
+	const LevelSector& GetSector( int sectorIndex ) const;
+	// Gets the number of strings in the string table
+	int GetStringCount() const;
+	// Gets a string from the string table (empty if the index is out of range)
+	const char* GetString( uint32_t index ) const;
+	// Gets the last of the Level Editor's journal records which the level includes (zero if it wasn't saved from a journal)
+	uint32_t GetJournalSequence() const;
+
+	// The header at the start of a binary level
+	struct Header
+	{
+		char magic[4]{ 'B','L','E','V' };
+		uint32_t version{ LEVEL_FILE_VERSION };
+		uint32_t blockCount{ 0 };
+		uint32_t stringCount{ 0 };
+		uint32_t stringOffsetsOffset{ 0 }; // Offsets are from the start of the file
+		uint32_t stringDataOffset{ 0 };
+		uint32_t stringDataSize{ 0 };
+		uint32_t recordCount{ 0 };
+		uint32_t sectorSize{ LEVEL_SECTOR_SIZE };
+		uint32_t sectorCount{ 0 };
+		uint32_t sectorOffset{ 0 };
+		uint32_t journalSequence{ 0 }; // Used to be reserved (always zero), so older levels simply don't have one
+	};
+
+	// Describes the packed array of objects for one type in one sector (these follow the header)
+	struct Block
+	{
+		uint32_t name{ 0 }; // Index into the string table
+		uint32_t recordCount{ 0 };
+		uint32_t recordOffset{ 0 };
+		uint32_t sector{ 0 };
+		uint32_t propertyCount{ 0 };
+		uint32_t propertyOffset{ 0 };
+	};
+
+private:
+	const uint8_t* m_pData{ nullptr };
+	void* m_hMapping{ nullptr };
+	size_t m_size{ 0 };
+	const Header* m_pHeader{ nullptr };
+	const Block* m_pBlocks{ nullptr };
+	const LevelSector* m_pSectors{ nullptr };
+	const uint32_t* m_pStringOffsets{ nullptr };
+	const char* m_pStrings{ nullptr };
+};
+
+//-------------------------------------------------------------------------
+
+// Finds an object type by its name
+// > Returns its index in LEVEL_OBJECT_TYPES, or -1 if there's no such type
+int FindLevelObjectType( const char* name );
+
+// Reads a text level: a comment line followed by four lines for each object (type, x, y and sprite)
+// > Each object's lines are followed by a "PROP name value" line for each of its properties
+// > The journal sequence is read from the comment line, if there's one there
+bool ReadTextLevel( const char* filename, std::vector< LevelEntry >& vEntries, uint32_t* pJournalSequence = nullptr );
+
+// Writes a text level, recording the last journal record it includes in the comment line
+bool WriteTextLevel( const char* filename, const std::vector< LevelEntry >& vEntries, uint32_t journalSequence = 0 );
+
+// Writes a binary level, grouping the objects by sector and then type (in order of first appearance) and sharing the names
+bool WriteBinaryLevel( const char* filename, const std::vector< LevelEntry >& vEntries, uint32_t sectorSize = LEVEL_SECTOR_SIZE, uint32_t journalSequence = 0 );
+
+// Converts a text level to a binary level
+bool ConvertTextLevel( const char* textFile, const char* binaryFile );
+
+// Opens the binary version of a text level, converting it first if it's missing or older than the text
+bool OpenLevel( LevelFile& level, const char* textFile, const char* binaryFile );
@@ -0,0 +1,211 @@
+///////////////////////////////////////////////////////////////////////////
+//	File		: LevelGenerator.cpp
+//  Generates levels procedurally, for stress testing the loading, streaming
+//  and game loop with far more objects than a hand-made level has.
+///////////////////////////////////////////////////////////////////////////
+
+#include "Play.h"
+#include "LevelFile.h"
+#include "LevelProperties.h"
+#include "LevelGenerator.h"
+
+//-------------------------------------------------------------------------
+
+// The islands' sprites, by the names used in the level files
+constexpr const char* GENERATOR_ISLAND_SPRITES[] = { "SPR_ISLAND_A", "SPR_ISLAND_B", "SPR_ISLAND_C", "SPR_ISLAND_D" };
+// Hazards and the ends of the chain only go on islands at least this wide, so there's room to get past
+constexpr float GENERATOR_WIDE_ISLAND_HALF_WIDTH = 200.0f;
+
+// Islands at the start of the chain which are kept clear of hazards, so the sheep is out of the wolves' reach until it moves
+constexpr int GENERATOR_CLEAR_ISLANDS = 3;
+
+// The space between one island's collision box and the next, which is always less than a jump
+constexpr int GENERATOR_MIN_GAP = 40;
+constexpr int GENERATOR_MAX_GAP = 90;
+// How much higher or lower each island's surface can be than the last
+constexpr int GENERATOR_MAX_STEP_UP = 32;
+constexpr int GENERATOR_MAX_STEP_DOWN = 96;
+// The surfaces stay well above the floor which kills the sheep
+constexpr float GENERATOR_START_SURFACE = 600.0f;
+constexpr float GENERATOR_HIGHEST_SURFACE = 300.0f;
+constexpr float GENERATOR_LOWEST_SURFACE = 1100.0f;
+
+// Heights above the surface of an island, as they are in the hand-made level
+constexpr float GENERATOR_SHEEP_OFFSET = -76.0f;
+constexpr float GENERATOR_FINAL_OFFSET = -109.0f;
+constexpr float GENERATOR_DOUGHNUT_OFFSET = -61.0f;
+// Between the doughnuts in a row, and between the rows when an island has more than fit in one
+constexpr float GENERATOR_DOUGHNUT_SPACING = 96.0f;
+
+//-------------------------------------------------------------------------
+
+// Where each kind of hazard goes, relative to the middle of its island's surface
+struct HazardPlacement
+{
+	const char* type;
+	const char* sprite;
+	float offsetY;
+};
+
+const HazardPlacement GENERATOR_HAZARDS[] =
+{
+	{ "TYPE_SPIKE", "SPR_SPIKES", -27.0f },
+	{ "TYPE_WOLF", "SPR_WOLF_LEFT_3", -91.0f },
+	{ "TYPE_BUSH", "SPR_BOUNCY_BUSH_4", -29.0f },
+	// Blades are positioned by their pivot, which is just high enough for the bottom of the swing to reach the sheep
+	{ "TYPE_BLADE", "SPR_SWINGING_BLADE", -310.0f },
+};
+
+//-------------------------------------------------------------------------
+
+// An island sprite and its collision box, which decides where everything on it goes
+struct IslandShape
+{
+	const char* sprite;
+	LevelPropertyValues box;
+};
+
+//-------------------------------------------------------------------------
+
+// A small random number generator which gives the same numbers on every platform (unlike rand() and the standard distributions)
+class LevelRandom
+{
+public:
+	explicit LevelRandom( uint32_t seed ) : m_state( seed ? seed : 1 ) {}
+
+	// Gets a random number from min to max inclusive
+	int Range( int min, int max ) { return min + static_cast<int>( Next() % static_cast<uint32_t>( max - min + 1 ) ); }
+
+private:
+	// Xorshift, which never reaches zero from a non-zero state
+	uint32_t Next()
+	{
+		m_state ^= m_state << 13;
+		m_state ^= m_state >> 17;
+		m_state ^= m_state << 5;
+		return m_state;
+	}
+
+	uint32_t m_state;
+};
+
+//-------------------------------------------------------------------------
+
+// Reads an island sprite's collision box from the property templates, so generated islands match the ones placed in the editor
+static IslandShape GetIslandShape( const char* sprite )
+{
+	IslandShape shape{ sprite, {} };
+	std::string levelSprite( sprite );
+
+	for( int t = 0; t < LEVEL_PROPERTY_TEMPLATE_COUNT; t++ )
+	{
+		const LevelPropertyTemplate& propertyTemplate = LEVEL_PROPERTY_TEMPLATES[t];
+
+		// The level files use upper case names for the sprites
+		if( strcmp( propertyTemplate.type, "TYPE_ISLAND" ) == 0 && propertyTemplate.sprite && strlen( propertyTemplate.sprite ) == levelSprite.size() && ContainsUpperCase( levelSprite, propertyTemplate.sprite ) )
+			shape.box.values[propertyTemplate.index] = propertyTemplate.value;
+	}
+
+	return shape;
+}
+
+//-------------------------------------------------------------------------
+
+// Puts doughnuts in rows above an island, starting with the row the sheep walks through
+static void AddDoughnuts( int count, float centre, float halfWidth, float surface, std::vector< LevelEntry >& vEntries )
+{
+	int perRow = std::max( 1, static_cast<int>( halfWidth * 2.0f / GENERATOR_DOUGHNUT_SPACING ) );
+
+	for( int d = 0; d < count; d++ )
+	{
+		int row = d / perRow;
+		int inRow = std::min( perRow, count - row * perRow );
+		float spacing = halfWidth * 2.0f / inRow;
+		Point2f pos( centre - halfWidth + ( ( d % perRow ) + 0.5f ) * spacing, surface + GENERATOR_DOUGHNUT_OFFSET - row * GENERATOR_DOUGHNUT_SPACING );
+		vEntries.push_back( { "TYPE_DOUGHNUT", pos, "SPR_DOUGHNUT_12", {} } );
+	}
+}
+
+//-------------------------------------------------------------------------
+
+LevelGeneratorSettings GetStressLevelSettings( int objectCount, uint32_t seed )
+{
+	LevelGeneratorSettings settings;
+	settings.islands = objectCount / 4;
+	settings.spikes = objectCount / 20;
+	settings.wolves = objectCount / 20;
+	settings.bushes = objectCount / 20;
+	settings.blades = objectCount / 20;
+	// The doughnuts make up the rest, after the sheep and the exit
+	settings.doughnuts = std::max( 0, objectCount - 2 - settings.islands - settings.spikes - settings.wolves - settings.bushes - settings.blades );
+	settings.seed = seed;
+	return settings;
+}
+
+//-------------------------------------------------------------------------
+
+void GenerateLevel( const LevelGeneratorSettings& settings, std::vector< LevelEntry >& vEntries )
+{
+	LevelRandom random( settings.seed );
+
+	std::vector< IslandShape > vShapes;
+	for( const char* sprite : GENERATOR_ISLAND_SPRITES )
+		vShapes.push_back( GetIslandShape( sprite ) );
+
+	// The hazards are shuffled so the different kinds are mixed up along the chain
+	std::vector< int > vHazards;
+	vHazards.insert( vHazards.end(), settings.spikes, 0 );
+	vHazards.insert( vHazards.end(), settings.wolves, 1 );
+	vHazards.insert( vHazards.end(), settings.bushes, 2 );
+	vHazards.insert( vHazards.end(), settings.blades, 3 );
+	for( int h = static_cast<int>( vHazards.size() ) - 1; h > 0; h-- )
+		std::swap( vHazards[h], vHazards[random.Range( 0, h )] );
+
+	// The islands around the sheep and the last one with the exit are kept clear, and the hazards are spread evenly between them
+	int islandCount = std::max( settings.islands, static_cast<int>( vHazards.size() ) + GENERATOR_CLEAR_ISLANDS + 1 );
+	int hazardIslands = islandCount - GENERATOR_CLEAR_ISLANDS - 1;
+	std::vector< int > vIslandHazards( islandCount, -1 );
+	for( size_t h = 0; h < vHazards.size(); h++ )
+		vIslandHazards[GENERATOR_CLEAR_ISLANDS + static_cast<int64_t>( h ) * hazardIslands / vHazards.size()] = vHazards[h];
+
+	vEntries.clear();
+	vEntries.reserve( static_cast<size_t>( islandCount ) + settings.doughnuts + vHazards.size() + 2 );
+
+	float left = 0.0f;
+	float surface = GENERATOR_START_SURFACE;
+
+	for( int i = 0; i < islandCount; i++ )
+	{
+		bool needsRoom = vIslandHazards[i] >= 0 || i == 0 || i == islandCount - 1;
+
+		const IslandShape* pShape = nullptr;
+		do
+			pShape = &vShapes[random.Range( 0, static_cast<int>( vShapes.size() ) - 1 )];
+		while( needsRoom && pShape->box[ISLAND_BOX_HALF_WIDTH] < GENERATOR_WIDE_ISLAND_HALF_WIDTH );
+
+		// Islands are positioned by their sprites, so the collision box's offset is taken back off
+		float halfWidth = pShape->box[ISLAND_BOX_HALF_WIDTH];
+		float centre = left + halfWidth;
+		Point2f islandPos( centre - pShape->box[ISLAND_BOX_X], surface - pShape->box[ISLAND_BOX_Y] + pShape->box[ISLAND_BOX_HALF_HEIGHT] );
+		vEntries.push_back( { "TYPE_ISLAND", islandPos, pShape->sprite, {} } );
+
+		if( i == 0 )
+			vEntries.push_back( { "TYPE_SHEEP", { centre, surface + GENERATOR_SHEEP_OFFSET }, "SPR_SHEEP1_IDLE_RIGHT_25", {} } );
+		if( i == islandCount - 1 )
+			vEntries.push_back( { "TYPE_FINAL", { centre, surface + GENERATOR_FINAL_OFFSET }, "SPR_INVISIBLE_MARKER", {} } );
+
+		if( vIslandHazards[i] >= 0 )
+		{
+			const HazardPlacement& hazard = GENERATOR_HAZARDS[vIslandHazards[i]];
+			vEntries.push_back( { hazard.type, { centre, surface + hazard.offsetY }, hazard.sprite, {} } );
+		}
+
+		int firstDoughnut = static_cast<int>( static_cast<int64_t>( settings.doughnuts ) * i / islandCount );
+		int lastDoughnut = static_cast<int>( static_cast<int64_t>( settings.doughnuts ) * ( i + 1 ) / islandCount );
+		AddDoughnuts( lastDoughnut - firstDoughnut, centre, halfWidth, surface, vEntries );
+
+		// The next island is always close enough to jump to, and never much higher
+		left = centre + halfWidth + random.Range( GENERATOR_MIN_GAP, GENERATOR_MAX_GAP );
+		surface = std::clamp( surface + random.Range( -GENERATOR_MAX_STEP_UP, GENERATOR_MAX_STEP_DOWN ), GENERATOR_HIGHEST_SURFACE, GENERATOR_LOWEST_SURFACE );
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+///////////////////////////////////////////////////////////////////////////
+//	File		: LevelGenerator.h
+//  Generates levels procedurally, for stress testing the loading, streaming
+//  and game loop with far more objects than a hand-made level has.
+//  The islands form a chain the sheep can walk and jump along from start
+//  to finish, with the hazards and doughnuts spread out along it.
+///////////////////////////////////////////////////////////////////////////
+
+// How many of each object a generated level has (it always has a sheep and an exit as well)
+struct LevelGeneratorSettings
+{
+	int islands{ 0 };
+	int doughnuts{ 0 };
+	int spikes{ 0 };
+	int wolves{ 0 };
+	int bushes{ 0 };
+	int blades{ 0 };
+	uint32_t seed{ 1 }; // The same settings and seed always generate the same level, on any platform
+};
+
+//-------------------------------------------------------------------------
+
+// Shares out a total number of objects (including the sheep and the exit) in roughly the proportions of the hand-made level
+LevelGeneratorSettings GetStressLevelSettings( int objectCount, uint32_t seed = 1 );
+
+// Generates a level as the entries which are written to the level files, so it can be saved in any of their formats
+// > Each hazard gets an island to itself away from the ends of the chain, so there are extra islands if there are too few
+// > The chain runs to the right from the origin, so very long levels lose some float precision towards the end
+void GenerateLevel( const LevelGeneratorSettings& settings, std::vector< LevelEntry >& vEntries );
@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////
+//	File		: LevelProperties.cpp
+//  The properties each type of object in a level can have (e.g. how close
+//  the sheep has to be before a wolf pounces) and their default values.
+///////////////////////////////////////////////////////////////////////////
+
+#include "Play.h"
+#include "LevelProperties.h"
+
+//-------------------------------------------------------------------------
+
+// Templates for a specific sprite come after the ones for any sprite, so they take precedence
+const LevelPropertyTemplate LEVEL_PROPERTY_TEMPLATES[] =
+{
+	{ "TYPE_ISLAND", "spr_island_A", "boxX", ISLAND_BOX_X, 24.0f },
+	{ "TYPE_ISLAND", "spr_island_A", "boxY", ISLAND_BOX_Y, 12.0f },
+	{ "TYPE_ISLAND", "spr_island_A", "boxHalfWidth", ISLAND_BOX_HALF_WIDTH, 116.0f },
+	{ "TYPE_ISLAND", "spr_island_A", "boxHalfHeight", ISLAND_BOX_HALF_HEIGHT, 15.0f },
+	{ "TYPE_ISLAND", "spr_island_B", "boxX", ISLAND_BOX_X, 0.0f },
+	{ "TYPE_ISLAND", "spr_island_B", "boxY", ISLAND_BOX_Y, 10.0f },
+	{ "TYPE_ISLAND", "spr_island_B", "boxHalfWidth", ISLAND_BOX_HALF_WIDTH, 250.0f },
+	{ "TYPE_ISLAND", "spr_island_B", "boxHalfHeight", ISLAND_BOX_HALF_HEIGHT, 15.0f },
+	{ "TYPE_ISLAND", "spr_island_C", "boxX", ISLAND_BOX_X, 0.0f },
+	{ "TYPE_ISLAND", "spr_island_C", "boxY", ISLAND_BOX_Y, 70.0f },
+	{ "TYPE_ISLAND", "spr_island_C", "boxHalfWidth", ISLAND_BOX_HALF_WIDTH, 250.0f },
+	{ "TYPE_ISLAND", "spr_island_C", "boxHalfHeight", ISLAND_BOX_HALF_HEIGHT, 15.0f },
+	{ "TYPE_ISLAND", "spr_island_D", "boxX", ISLAND_BOX_X, 10.0f },
+	{ "TYPE_ISLAND", "spr_island_D", "boxY", ISLAND_BOX_Y, 50.0f },
+	{ "TYPE_ISLAND", "spr_island_D", "boxHalfWidth", ISLAND_BOX_HALF_WIDTH, 200.0f },
+	{ "TYPE_ISLAND", "spr_island_D", "boxHalfHeight", ISLAND_BOX_HALF_HEIGHT, 15.0f },
+	{ "TYPE_BLADE", nullptr, "radius", BLADE_RADIUS, 270.0f },
+	{ "TYPE_BLADE", nullptr, "swingSpeed", BLADE_SWING_SPEED, 0.04f },
+	{ "TYPE_WOLF", nullptr, "alertRange", WOLF_ALERT_RANGE, 500.0f },
+	{ "TYPE_WOLF", nullptr, "pounceRange", WOLF_POUNCE_RANGE, 200.0f },
+	{ "TYPE_BUSH", nullptr, "launchSpeed", BUSH_LAUNCH_SPEED, 20.0f },
+	{ "TYPE_BUSH", nullptr, "boostedLaunchSpeed", BUSH_BOOSTED_LAUNCH_SPEED, 32.0f },
+};
+
+const int LEVEL_PROPERTY_TEMPLATE_COUNT = sizeof( LEVEL_PROPERTY_TEMPLATES ) / sizeof( LEVEL_PROPERTY_TEMPLATES[0] );
+
+//-------------------------------------------------------------------------
+
+LevelPropertyValues GetDefaultLevelProperties( const char* typeName, int spriteId )
+{
+	// The templates' sprites are only looked up once (initialising a static is thread-safe)
+	static const std::vector< int > vTemplateSpriteIds = []()
+	{
+		std::vector< int > vSpriteIds( LEVEL_PROPERTY_TEMPLATE_COUNT, -1 );
+		for( int t = 0; t < LEVEL_PROPERTY_TEMPLATE_COUNT; t++ )
+		{
+			if( LEVEL_PROPERTY_TEMPLATES[t].sprite )
+				vSpriteIds[t] = Play::GetSpriteId( LEVEL_PROPERTY_TEMPLATES[t].sprite );
+		}
+		return vSpriteIds;
+	}();
+
+	LevelPropertyValues properties;
+
+	for( int t = 0; t < LEVEL_PROPERTY_TEMPLATE_COUNT; t++ )
+	{
+		const LevelPropertyTemplate& propertyTemplate = LEVEL_PROPERTY_TEMPLATES[t];
+
+		if( strcmp( propertyTemplate.type, typeName ) == 0 && ( !propertyTemplate.sprite || ( vTemplateSpriteIds[t] >= 0 && vTemplateSpriteIds[t] == spriteId ) ) )
+			properties.values[propertyTemplate.index] = propertyTemplate.value;
+	}
+
+	return properties;
+}
+
+//-------------------------------------------------------------------------
+
+bool SetLevelProperty( const char* typeName, const char* name, float value, LevelPropertyValues& properties )
+{
+	for( int t = 0; t < LEVEL_PROPERTY_TEMPLATE_COUNT; t++ )
+	{
+		const LevelPropertyTemplate& propertyTemplate = LEVEL_PROPERTY_TEMPLATES[t];
+
+		if( strcmp( propertyTemplate.type, typeName ) == 0 && strcmp( propertyTemplate.name, name ) == 0 )
+		{
+			properties.values[propertyTemplate.index] = value;
+			return true;
+		}
+	}
+
+	return false;
+}
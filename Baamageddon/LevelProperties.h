@@ -0,0 +1,63 @@
+#pragma once
+///////////////////////////////////////////////////////////////////////////
+//	File		: LevelProperties.h
+//  The properties each type of object in a level can have (e.g. how close
+//  the sheep has to be before a wolf pounces) and their default values.
+//  Levels only store the properties which differ from the defaults, and
+//  they're resolved into plain values as the objects are loaded, so
+//  nothing is looked up by name while the game is running.
+///////////////////////////////////////////////////////////////////////////
+
+constexpr int LEVEL_MAX_PROPERTIES = 4;
+
+// Where each type's properties are kept in its values
+enum LevelPropertyIndex
+{
+	ISLAND_BOX_X = 0, // The collision box, relative to the island's position
+	ISLAND_BOX_Y,
+	ISLAND_BOX_HALF_WIDTH, // Islands with no width don't have a collision box
+	ISLAND_BOX_HALF_HEIGHT,
+
+	BLADE_RADIUS = 0, // From the pivot to the collision object at the end of the blade
+	BLADE_SWING_SPEED, // In radians per frame
+
+	WOLF_ALERT_RANGE = 0, // Horizontal distances to the sheep
+	WOLF_POUNCE_RANGE,
+
+	BUSH_LAUNCH_SPEED = 0,
+	BUSH_BOOSTED_LAUNCH_SPEED, // When the sheep is holding jump
+};
+
+//-------------------------------------------------------------------------
+
+// An object's properties, resolved from its type's defaults and any which the level sets
+struct LevelPropertyValues
+{
+	float values[LEVEL_MAX_PROPERTIES]{};
+
+	float operator[]( LevelPropertyIndex index ) const { return values[index]; }
+};
+
+//-------------------------------------------------------------------------
+
+// The default value of one of a type's properties
+struct LevelPropertyTemplate
+{
+	const char* type; // By the names used in the level files
+	const char* sprite; // Only for objects with this sprite (or nullptr for any sprite)
+	const char* name; // As used in the level files
+	LevelPropertyIndex index;
+	float value;
+};
+
+//-------------------------------------------------------------------------
+
+// Gets an object's default properties, some of which depend on its sprite
+// > Safe to call from the level's worker threads
+LevelPropertyValues GetDefaultLevelProperties( const char* typeName, int spriteId );
+// Sets one of an object's properties by name
+// > Returns false if the object's type doesn't have a property with that name
+bool SetLevelProperty( const char* typeName, const char* name, float value, LevelPropertyValues& properties );
+
+extern const LevelPropertyTemplate LEVEL_PROPERTY_TEMPLATES[];
+extern const int LEVEL_PROPERTY_TEMPLATE_COUNT;
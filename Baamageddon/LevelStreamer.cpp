@@ -0,0 +1,630 @@
+///////////////////////////////////////////////////////////////////////////
+//	File		: LevelStreamer.cpp
+//  Creates and destroys the objects in a binary level's sectors as the
+//  camera moves, so only the part of the level near the player exists.
+//  Each object's properties are resolved as its sector is read, and kept
+//  for as long as the object exists.
+///////////////////////////////////////////////////////////////////////////
+
+#define PLAY_USING_GAMEOBJECT_MANAGER
+
+#include "Play.h"
+#include "AABB.h"
+#include "LevelFile.h"
+#include "LevelProperties.h"
+#include "MainGame.h"
+#include "LevelStreamer.h"
+
+//-------------------------------------------------------------------------
+
+const GameObjectType LEVEL_GAME_TYPES[LEVEL_OBJECT_TYPE_COUNT] =
+{
+	TYPE_SHEEP,
+	TYPE_ISLAND,
+	TYPE_DOUGHNUT,
+	TYPE_SPIKE,
+	TYPE_WOLF,
+	TYPE_BUSH,
+	TYPE_BLADE,
+	TYPE_FINAL,
+};
+
+//-------------------------------------------------------------------------
+
+void LevelStreamer::BeginOpen( const char* textFile, const char* binaryFile, Vector2f viewSize )
+{
+	Close();
+
+	m_viewSize = viewSize;
+	m_openProgress = 0.0f;
+	// The worker mustn't look at the sprites' pixel data while the main thread is drawing, so it's told which ones need decoding
+	m_vEvictedSprites = Play::GetEvictedSprites();
+	m_openResult = std::async( std::launch::async, &LevelStreamer::OpenInBackground, this, std::string( textFile ), std::string( binaryFile ) );
+}
+
+//-------------------------------------------------------------------------
+
+bool LevelStreamer::IsOpenReady() const
+{
+	if( m_openResult.valid() && m_waitForLoads )
+		m_openResult.wait();
+
+	return m_openResult.valid() && m_openResult.wait_for( std::chrono::seconds( 0 ) ) == std::future_status::ready;
+}
+
+//-------------------------------------------------------------------------
+
+bool LevelStreamer::FinishOpen()
+{
+	PLAY_PROFILE_FUNCTION();
+
+	if( !m_openResult.valid() || !m_openResult.get() )
+		return false;
+
+	// Everything was looked up and decoded on the worker thread, so this only creates the objects
+	CreateObjects( -1, m_vStagedGlobals );
+
+	for( const std::pair< int, std::vector< StagedObject > >& sector : m_vStagedSectors )
+		CommitSector( sector.first, sector.second );
+
+	// The sprites were decoded by the worker thread too, so they just need pre-multiplying and making resident
+	Play::AttachSprites( m_vDecodedSprites );
+
+	// Any which were evicted by the loading screen while the level was opening are decoded now
+	std::vector< int > vSpriteIds;
+	for( int spriteId : m_vStringSpriteIds )
+	{
+		if( spriteId >= 0 )
+			vSpriteIds.push_back( spriteId );
+	}
+
+	Play::PreloadSprites( vSpriteIds );
+
+	m_vStagedGlobals.clear();
+	m_vStagedSectors.clear();
+	m_vEvictedSprites.clear();
+	return true;
+}
+
+//-------------------------------------------------------------------------
+// Runs on a worker thread: nothing is created here as the object manager can only be used from the main thread
+bool LevelStreamer::OpenInBackground( std::string textFile, std::string binaryFile )
+{
+	PLAY_PROFILE_FUNCTION();
+	PLAY_ALLOCATION_TAG( "Level" );
+
+	// Converting the text level (if it's changed) is the slowest part
+	if( !OpenLevel( m_level, textFile.c_str(), binaryFile.c_str() ) )
+		return false;
+
+	m_openProgress = 0.25f;
+
+	m_vStringSpriteIds.assign( m_level.GetStringCount(), -2 );
+	m_vSectors = std::vector< Sector >( m_level.GetSectorCount() );
+
+	uint32_t recordCount = 0;
+	for( int s = 0; s < m_level.GetSectorCount(); s++ )
+		recordCount = std::max( recordCount, m_level.GetSector( s ).firstRecord + m_level.GetSector( s ).recordCount );
+
+	m_vRecordIds.assign( recordCount, -1 );
+	m_vConsumed.assign( recordCount, false );
+	m_vInactiveCounts.assign( LEVEL_OBJECT_TYPE_COUNT, 0 );
+	m_vBlockTypes.assign( m_level.GetBlockCount(), -1 );
+
+	Point2f start{ 0.0f, 0.0f };
+
+	size_t largestBlock = 0;
+
+	for( int b = 0; b < m_level.GetBlockCount(); b++ )
+	{
+		int typeIndex = FindLevelObjectType( m_level.GetBlockTypeName( b ) );
+		m_vBlockTypes[b] = typeIndex;
+		if( typeIndex < 0 )
+			continue;
+
+		largestBlock = std::max( largestBlock, static_cast<size_t>( m_level.GetBlockRecordCount( b ) ) );
+
+		// Every sprite is looked up now so the main thread never has to
+		const LevelRecord* pRecords = m_level.GetBlockRecords( b );
+		for( int i = 0; i < m_level.GetBlockRecordCount( b ); i++ )
+		{
+			int& spriteId = m_vStringSpriteIds[pRecords[i].sprite];
+			if( spriteId == -2 )
+				spriteId = Play::GetSpriteId( m_level.GetString( pRecords[i].sprite ) );
+		}
+
+		if( LEVEL_OBJECT_TYPES[typeIndex].streamed )
+		{
+			m_vInactiveCounts[typeIndex] += m_level.GetBlockRecordCount( b );
+			continue;
+		}
+
+		const LevelPropertyRecord* pProperty = m_level.GetBlockProperties( b );
+		const LevelPropertyRecord* pPropertyEnd = pProperty + m_level.GetBlockPropertyCount( b );
+
+		for( int i = 0; i < m_level.GetBlockRecordCount( b ); i++ )
+		{
+			m_vStagedGlobals.push_back( { typeIndex, 0, pRecords[i], ReadProperties( typeIndex, pRecords[i], i, pProperty, pPropertyEnd ) } );
+
+			if( LEVEL_GAME_TYPES[typeIndex] == TYPE_SHEEP )
+				start = { pRecords[i].x, pRecords[i].y };
+		}
+	}
+
+	// Objects are created a block at a time, so this is as much as CreateObjects() ever needs
+	m_vCreateStaged.reserve( largestBlock );
+	m_vCreatePositions.reserve( largestBlock );
+	m_vCreateSpriteIds.reserve( largestBlock );
+
+	m_openProgress = 0.5f;
+
+	// Stage the sectors around the sheep so the level can start without waiting for them to stream in
+	m_lastFocus = start;
+	float left = start.null - ( m_viewSize.width / 2.0f ) - STREAM_ACTIVATE_MARGIN;
+	float right = start.null + ( m_viewSize.width / 2.0f ) + STREAM_ACTIVATE_MARGIN;
+	float top = start.y - ( m_viewSize.height / 2.0f ) - STREAM_ACTIVATE_MARGIN;
+	float bottom = start.y + ( m_viewSize.height / 2.0f ) + STREAM_ACTIVATE_MARGIN;
+
+	ForEachSectorIn( left, top, right, bottom, [&]( int sectorIndex )
+	{
+		m_vStagedSectors.push_back( { sectorIndex, ReadSector( sectorIndex ) } );
+	} );
+
+	// Decode the level's evicted sprites a few at a time so the progress keeps moving
+	// > They're decoded into separate buffers as the main thread can still be drawing, evicting and reloading sprites
+	std::vector< int > vLevelSpriteIds;
+	for( int spriteId : m_vStringSpriteIds )
+	{
+		if( spriteId >= 0 )
+			vLevelSpriteIds.push_back( spriteId );
+	}
+
+	std::sort( vLevelSpriteIds.begin(), vLevelSpriteIds.end() );
+	std::vector< int > vSpriteIds;
+	std::set_intersection( vLevelSpriteIds.begin(), vLevelSpriteIds.end(), m_vEvictedSprites.begin(), m_vEvictedSprites.end(), std::back_inserter( vSpriteIds ) );
+
+	constexpr size_t DECODE_BATCH_SIZE = 4;
+	for( size_t i = 0; i < vSpriteIds.size(); i += DECODE_BATCH_SIZE )
+	{
+		size_t end = std::min( i + DECODE_BATCH_SIZE, vSpriteIds.size() );
+		std::vector< PlayGraphics::DecodedSprite > vDecoded = Play::DecodeSprites( std::vector< int >( vSpriteIds.begin() + i, vSpriteIds.begin() + end ) );
+		m_vDecodedSprites.insert( m_vDecodedSprites.end(), vDecoded.begin(), vDecoded.end() );
+		m_openProgress = 0.5f + ( 0.5f * end / vSpriteIds.size() );
+	}
+
+	m_openProgress = 1.0f;
+	return true;
+}
+
+//-------------------------------------------------------------------------
+
+void LevelStreamer::Close()
+{
+	if( m_openResult.valid() )
+		m_openResult.wait();
+	m_openResult = {};
+	m_vStagedGlobals.clear();
+	m_vStagedSectors.clear();
+	m_vEvictedSprites.clear();
+	Play::DiscardSprites( m_vDecodedSprites );
+
+	// The loads read the level, so they have to finish before it's closed
+	AbandonLoads();
+	WaitForLoads();
+	m_level.Close();
+	m_vBlockTypes.clear();
+	m_vStringSpriteIds.clear();
+	m_vSectors.clear();
+	m_vRecordIds.clear();
+	m_vConsumed.clear();
+	m_vActiveSectors.clear();
+	m_vInactiveCounts.clear();
+	m_vSnapshotSectors.clear();
+	m_vSnapshotRecordIds.clear();
+	m_vSnapshotConsumed.clear();
+	m_vSnapshotActiveSectors.clear();
+	m_vSnapshotInactiveCounts.clear();
+	m_vObjectProperties.clear();
+	m_vSnapshotObjectProperties.clear();
+}
+
+//-------------------------------------------------------------------------
+
+bool LevelStreamer::Update( Point2f focus )
+{
+	PLAY_PROFILE_FUNCTION();
+	// Streaming sectors in and out creates and destroys objects, so it's expected to allocate
+	PLAY_ALLOW_ALLOCATIONS();
+
+	// Nothing is streamed until the level has finished opening
+	if( m_openResult.valid() || m_vSectors.empty() )
+		return false;
+
+	bool bChanged = false;
+
+	// Remember which way the camera was last moving on each axis, so sectors ahead of it can be prefetched
+	Vector2f delta = focus - m_lastFocus;
+	if( abs( delta.null ) > 0.5f )
+		m_direction.null = delta.null > 0.0f ? 1.0f : -1.0f;
+	if( abs( delta.y ) > 0.5f )
+		m_direction.y = delta.y > 0.0f ? 1.0f : -1.0f;
+	m_lastFocus = focus;
+
+	float left = focus.null - ( m_viewSize.width / 2.0f ) - STREAM_ACTIVATE_MARGIN;
+	float right = focus.null + ( m_viewSize.width / 2.0f ) + STREAM_ACTIVATE_MARGIN;
+	float top = focus.y - ( m_viewSize.height / 2.0f ) - STREAM_ACTIVATE_MARGIN;
+	float bottom = focus.y + ( m_viewSize.height / 2.0f ) + STREAM_ACTIVATE_MARGIN;
+
+	if( m_direction.null > 0.0f )
+		right += STREAM_PREFETCH_DISTANCE;
+	else if( m_direction.null < 0.0f )
+		left -= STREAM_PREFETCH_DISTANCE;
+
+	if( m_direction.y > 0.0f )
+		bottom += STREAM_PREFETCH_DISTANCE;
+	else if( m_direction.y < 0.0f )
+		top -= STREAM_PREFETCH_DISTANCE;
+
+	float sectorSize = static_cast<float>( m_level.GetSectorSize() );
+	auto isSectorNear = [&]( int sectorIndex )
+	{
+		const LevelSector& sector = m_level.GetSector( sectorIndex );
+		return sector.x * sectorSize < right + STREAM_DEACTIVATE_MARGIN && ( sector.x + 1 ) * sectorSize > left - STREAM_DEACTIVATE_MARGIN &&
+			sector.y * sectorSize < bottom + STREAM_DEACTIVATE_MARGIN && ( sector.y + 1 ) * sectorSize > top - STREAM_DEACTIVATE_MARGIN;
+	};
+
+	// Loads which were abandoned by RestoreSnapshot() are only thrown away once they've finished
+	m_vAbandonedLoads.erase( std::remove_if( m_vAbandonedLoads.begin(), m_vAbandonedLoads.end(), []( const std::future< std::vector< StagedObject > >& load )
+	{
+		return load.wait_for( std::chrono::seconds( 0 ) ) == std::future_status::ready;
+	} ), m_vAbandonedLoads.end() );
+
+	// Create the objects for sectors which have finished loading, unless the camera has moved away again in the meantime
+	for( auto i = m_pendingLoads.begin(); i != m_pendingLoads.end(); )
+	{
+		if( m_waitForLoads )
+			i->second.wait();
+
+		if( i->second.wait_for( std::chrono::seconds( 0 ) ) != std::future_status::ready )
+		{
+			++i;
+			continue;
+		}
+
+		std::vector< StagedObject > vStaged = i->second.get();
+		if( isSectorNear( i->first ) )
+		{
+			CommitSector( i->first, vStaged );
+			bChanged = true;
+		}
+		else
+		{
+			m_vSectors[i->first].state = SECTOR_INACTIVE;
+		}
+
+		i = m_pendingLoads.erase( i );
+	}
+
+	// Sectors are only deactivated once they're well outside the area which activates them
+	// > Objects belong to the sector they started in, so it's kept while any of them have moved near (e.g. a wolf chasing the sheep)
+	for( size_t i = 0; i < m_vActiveSectors.size(); )
+	{
+		if( isSectorNear( m_vActiveSectors[i] ) || HasObjectIn( m_vActiveSectors[i], left - STREAM_DEACTIVATE_MARGIN, top - STREAM_DEACTIVATE_MARGIN, right + STREAM_DEACTIVATE_MARGIN, bottom + STREAM_DEACTIVATE_MARGIN ) )
+		{
+			i++;
+		}
+		else
+		{
+			DeactivateSector( m_vActiveSectors[i] );
+			bChanged = true;
+		}
+	}
+
+	ForEachSectorIn( left, top, right, bottom, [&]( int sectorIndex )
+	{
+		if( m_vSectors[sectorIndex].state == SECTOR_INACTIVE )
+		{
+			m_vSectors[sectorIndex].state = SECTOR_LOADING;
+			m_pendingLoads[sectorIndex] = std::async( std::launch::async, &LevelStreamer::ReadSector, this, sectorIndex );
+		}
+	} );
+
+	return bChanged;
+}
+
+//-------------------------------------------------------------------------
+
+int LevelStreamer::CountInactiveObjects( GameObjectType type ) const
+{
+	for( int t = 0; t < LEVEL_OBJECT_TYPE_COUNT; t++ )
+	{
+		if( LEVEL_GAME_TYPES[t] == type )
+			return m_vInactiveCounts.empty() ? 0 : m_vInactiveCounts[t];
+	}
+
+	return 0;
+}
+
+//-------------------------------------------------------------------------
+
+const LevelPropertyValues* LevelStreamer::GetProperties( int id ) const
+{
+	bool exists = id >= 0 && id < static_cast<int>( m_vObjectProperties.size() ) && m_vObjectProperties[id].exists;
+	return exists ? &m_vObjectProperties[id].properties : nullptr;
+}
+
+//-------------------------------------------------------------------------
+
+int LevelStreamer::GetLinkedObject( int id ) const
+{
+	bool exists = id >= 0 && id < static_cast<int>( m_vObjectProperties.size() ) && m_vObjectProperties[id].exists;
+	return exists ? m_vObjectProperties[id].linkedId : -1;
+}
+
+//-------------------------------------------------------------------------
+
+void LevelStreamer::AddObject( int id, const LevelPropertyValues& properties, int linkedId )
+{
+	// Object ids only ever increase, so this grows along with the object manager
+	if( id >= static_cast<int>( m_vObjectProperties.size() ) )
+		m_vObjectProperties.resize( static_cast<size_t>( id ) + 1 );
+
+	m_vObjectProperties[id] = { properties, linkedId, true };
+}
+
+//-------------------------------------------------------------------------
+
+// The snapshot is only allocated here, so restoring it (every time the sheep respawns) just copies it back
+void LevelStreamer::SaveSnapshot()
+{
+	AbandonLoads();
+	m_vSnapshotSectors = m_vSectors;
+	m_vSnapshotRecordIds = m_vRecordIds;
+	m_vSnapshotConsumed = m_vConsumed;
+	m_vSnapshotActiveSectors = m_vActiveSectors;
+	m_vSnapshotInactiveCounts = m_vInactiveCounts;
+	m_vSnapshotObjectProperties = m_vObjectProperties;
+
+	// Enough room is kept for the snapshot however the level changes before it's restored
+	m_vActiveSectors.reserve( m_vSectors.size() );
+}
+
+//-------------------------------------------------------------------------
+// The sectors, records and counts are fixed sizes, and the active sectors and objects only ever shrink back to the snapshot
+void LevelStreamer::RestoreSnapshot()
+{
+	AbandonLoads();
+	std::copy( m_vSnapshotSectors.begin(), m_vSnapshotSectors.end(), m_vSectors.begin() );
+	std::copy( m_vSnapshotRecordIds.begin(), m_vSnapshotRecordIds.end(), m_vRecordIds.begin() );
+	std::copy( m_vSnapshotConsumed.begin(), m_vSnapshotConsumed.end(), m_vConsumed.begin() );
+	std::copy( m_vSnapshotInactiveCounts.begin(), m_vSnapshotInactiveCounts.end(), m_vInactiveCounts.begin() );
+
+	m_vActiveSectors.resize( m_vSnapshotActiveSectors.size() );
+	std::copy( m_vSnapshotActiveSectors.begin(), m_vSnapshotActiveSectors.end(), m_vActiveSectors.begin() );
+
+	m_vObjectProperties.resize( m_vSnapshotObjectProperties.size() );
+	std::copy( m_vSnapshotObjectProperties.begin(), m_vSnapshotObjectProperties.end(), m_vObjectProperties.begin() );
+}
+
+//-------------------------------------------------------------------------
+// Resolves an object's properties from its type's defaults and any the level sets, moving past the ones the level sets
+LevelPropertyValues LevelStreamer::ReadProperties( int typeIndex, const LevelRecord& record, uint32_t blockRecordIndex, const LevelPropertyRecord*& pProperty, const LevelPropertyRecord* pPropertyEnd ) const
+{
+	const char* typeName = LEVEL_OBJECT_TYPES[typeIndex].name;
+	LevelPropertyValues properties = GetDefaultLevelProperties( typeName, m_vStringSpriteIds[record.sprite] );
+
+	// A block's properties are in the same order as its objects, so they're read alongside them
+	for( ; pProperty != pPropertyEnd && pProperty->record == blockRecordIndex; pProperty++ )
+		SetLevelProperty( typeName, m_level.GetString( pProperty->name ), pProperty->value, properties );
+
+	return properties;
+}
+
+//-------------------------------------------------------------------------
+// Copies the records out of a sector: this runs in the background so any disk access happens there
+std::vector< LevelStreamer::StagedObject > LevelStreamer::ReadSector( int sectorIndex ) const
+{
+	PLAY_PROFILE_FUNCTION();
+	PLAY_ALLOCATION_TAG( "Level" );
+
+	const LevelSector& sector = m_level.GetSector( sectorIndex );
+
+	std::vector< StagedObject > vStaged;
+	vStaged.reserve( sector.recordCount );
+
+	int recordIndex = 0;
+	for( uint32_t b = sector.firstBlock; b < sector.firstBlock + sector.blockCount; b++ )
+	{
+		int typeIndex = m_vBlockTypes[b];
+		const LevelRecord* pRecords = m_level.GetBlockRecords( b );
+		const LevelPropertyRecord* pProperty = m_level.GetBlockProperties( b );
+		const LevelPropertyRecord* pPropertyEnd = pProperty + m_level.GetBlockPropertyCount( b );
+
+		for( int i = 0; i < m_level.GetBlockRecordCount( b ); i++, recordIndex++ )
+		{
+			if( typeIndex >= 0 && LEVEL_OBJECT_TYPES[typeIndex].streamed )
+				vStaged.push_back( { typeIndex, recordIndex, pRecords[i], ReadProperties( typeIndex, pRecords[i], i, pProperty, pPropertyEnd ) } );
+		}
+	}
+
+	return vStaged;
+}
+
+//-------------------------------------------------------------------------
+
+void LevelStreamer::CommitSector( int sectorIndex, const std::vector< StagedObject >& vStaged )
+{
+	PLAY_PROFILE_FUNCTION();
+	PLAY_ALLOCATION_TAG( "Level" );
+
+	CreateObjects( sectorIndex, vStaged );
+
+	m_vSectors[sectorIndex].state = SECTOR_ACTIVE;
+	m_vActiveSectors.push_back( sectorIndex );
+}
+
+//-------------------------------------------------------------------------
+// Destroys a sector's objects: any which the game has already destroyed are marked as consumed so they don't come back
+void LevelStreamer::DeactivateSector( int sectorIndex )
+{
+	Sector& sector = m_vSectors[sectorIndex];
+	const LevelSector& levelSector = m_level.GetSector( sectorIndex );
+
+	int recordIndex = 0;
+	for( uint32_t b = levelSector.firstBlock; b < levelSector.firstBlock + levelSector.blockCount; b++ )
+	{
+		int typeIndex = m_vBlockTypes[b];
+
+		for( int i = 0; i < m_level.GetBlockRecordCount( b ); i++, recordIndex++ )
+		{
+			uint32_t record = levelSector.firstRecord + recordIndex;
+			int id = m_vRecordIds[record];
+			if( id == -1 )
+				continue;
+
+			// Objects created alongside the records (e.g. the blades' collision objects) go with them
+			int linkedId = GetLinkedObject( id );
+			if( linkedId != -1 && Play::GetGameObject( linkedId ).type != -1 )
+				Play::DestroyGameObject( linkedId );
+
+			m_vObjectProperties[id].exists = false;
+			m_vRecordIds[record] = -1;
+
+			if( Play::GetGameObject( id ).type == -1 )
+			{
+				m_vConsumed[record] = true;
+				continue;
+			}
+
+			Play::DestroyGameObject( id );
+			m_vInactiveCounts[typeIndex]++;
+		}
+	}
+
+	sector.state = SECTOR_INACTIVE;
+
+	m_vActiveSectors.erase( std::find( m_vActiveSectors.begin(), m_vActiveSectors.end(), sectorIndex ) );
+}
+
+//-------------------------------------------------------------------------
+// Checks whether any of the objects created for a sector are in the area now, wherever they started
+bool LevelStreamer::HasObjectIn( int sectorIndex, float left, float top, float right, float bottom ) const
+{
+	const LevelSector& levelSector = m_level.GetSector( sectorIndex );
+
+	for( uint32_t record = levelSector.firstRecord; record < levelSector.firstRecord + levelSector.recordCount; record++ )
+	{
+		int id = m_vRecordIds[record];
+		if( id == -1 )
+			continue;
+
+		const GameObject& obj = Play::GetGameObject( id );
+		if( obj.type != -1 && obj.pos.null >= left && obj.pos.null <= right && obj.pos.y >= top && obj.pos.y <= bottom )
+			return true;
+	}
+
+	return false;
+}
+
+//-------------------------------------------------------------------------
+// Throws away any background loads without waiting for them: Update() only lets them go once they've finished
+void LevelStreamer::AbandonLoads()
+{
+	for( std::pair< const int, std::future< std::vector< StagedObject > > >& load : m_pendingLoads )
+	{
+		m_vAbandonedLoads.push_back( std::move( load.second ) );
+		m_vSectors[load.first].state = SECTOR_INACTIVE;
+	}
+
+	m_pendingLoads.clear();
+}
+
+//-------------------------------------------------------------------------
+// Waits for the loads which have been abandoned to finish
+void LevelStreamer::WaitForLoads()
+{
+	for( std::future< std::vector< StagedObject > >& load : m_vAbandonedLoads )
+		load.wait();
+
+	m_vAbandonedLoads.clear();
+}
+
+//-------------------------------------------------------------------------
+
+// Creates a sector's objects (or the ones which aren't streamed, for a sector index of -1), skipping any which have been consumed
+// > The staged objects are grouped by type, so each group is created in one go
+void LevelStreamer::CreateObjects( int sectorIndex, const std::vector< StagedObject >& vStaged )
+{
+	uint32_t firstRecord = sectorIndex < 0 ? 0 : m_level.GetSector( sectorIndex ).firstRecord;
+
+	for( size_t first = 0, last = 0; first < vStaged.size(); first = last )
+	{
+		int typeIndex = vStaged[first].typeIndex;
+		m_vCreateStaged.clear();
+		m_vCreatePositions.clear();
+		m_vCreateSpriteIds.clear();
+
+		for( last = first; last < vStaged.size() && vStaged[last].typeIndex == typeIndex; last++ )
+		{
+			const StagedObject& staged = vStaged[last];
+			if( sectorIndex >= 0 && m_vConsumed[firstRecord + staged.recordIndex] )
+				continue;
+
+			int& spriteId = m_vStringSpriteIds[staged.record.sprite];
+			if( spriteId == -2 )
+				spriteId = Play::GetSpriteId( m_level.GetString( staged.record.sprite ) );
+
+			m_vCreateStaged.push_back( &staged );
+			m_vCreatePositions.push_back( { staged.record.x, staged.record.y } );
+			m_vCreateSpriteIds.push_back( spriteId );
+		}
+
+		int count = static_cast<int>( m_vCreateStaged.size() );
+		if( count == 0 )
+			continue;
+
+		GameObjectType type = LEVEL_GAME_TYPES[typeIndex];
+		int firstId = Play::CreateGameObjects( type, count, m_vCreatePositions.data(), m_vCreateSpriteIds.data(), LEVEL_OBJECT_TYPES[typeIndex].radius );
+
+		for( int i = 0; i < count; i++ )
+		{
+			const StagedObject& staged = *m_vCreateStaged[i];
+			int id = firstId + i;
+			int linkedId = -1;
+
+			if( type == TYPE_BLADE )
+			{
+				linkedId = Play::CreateGameObject( TYPE_NULL_BLADE, { staged.record.x, staged.record.y + staged.properties[BLADE_RADIUS] }, 70, "" );
+			}
+
+			AddObject( id, staged.properties, linkedId );
+
+			if( sectorIndex >= 0 )
+			{
+				m_vRecordIds[firstRecord + staged.recordIndex] = id;
+				m_vInactiveCounts[typeIndex]--;
+			}
+		}
+	}
+}
+
+//-------------------------------------------------------------------------
+// Finds the first sector at or after the given coordinates (the sectors are sorted by x and then y)
+int LevelStreamer::FindSector( int32_t sectorX, int32_t sectorY ) const
+{
+	int first = 0;
+	int last = m_level.GetSectorCount();
+
+	while( first < last )
+	{
+		int middle = ( first + last ) / 2;
+		const LevelSector& sector = m_level.GetSector( middle );
+
+		if( sector.x < sectorX || ( sector.x == sectorX && sector.y < sectorY ) )
+			first = middle + 1;
+		else
+			last = middle;
+	}
+
+	return first;
+}
@@ -0,0 +1,160 @@
+#pragma once
+///////////////////////////////////////////////////////////////////////////
+//	File		: LevelStreamer.h
+//  Creates and destroys the objects in a binary level's sectors as the
+//  camera moves, so only the part of the level near the player exists.
+//  Each object's properties are resolved as its sector is read, and kept
+//  for as long as the object exists.
+///////////////////////////////////////////////////////////////////////////
+
+// How far beyond the view sectors are activated
+constexpr float STREAM_ACTIVATE_MARGIN = 256.0f;
+// How much further away a sector has to be before it's deactivated again (so it doesn't flip back and forth)
+constexpr float STREAM_DEACTIVATE_MARGIN = 768.0f;
+// How far ahead sectors are activated in the direction the camera is moving
+constexpr float STREAM_PREFETCH_DISTANCE = 1024.0f;
+
+//-------------------------------------------------------------------------
+
+class LevelStreamer
+{
+public:
+	LevelStreamer() = default;
+	~LevelStreamer() { Close(); }
+	LevelStreamer( const LevelStreamer& ) = delete;
+	LevelStreamer& operator=( const LevelStreamer& ) = delete;
+
+	// Starts opening a level on a worker thread, which also decodes the sprites and stages the objects around the sheep
+	// > The view size is the area around the focus point which must always be active
+	void BeginOpen( const char* textFile, const char* binaryFile, Vector2f viewSize );
+	// Checks whether the worker thread has finished opening the level
+	bool IsOpenReady() const;
+	// Gets how far the worker thread has got with opening the level (0 to 1)
+	float GetOpenProgress() const { return m_openProgress; }
+	// Creates the objects which aren't streamed and the ones around the sheep, all in one go
+	// > Waits for the worker thread if it hasn't finished. Returns false if the level couldn't be opened
+	bool FinishOpen();
+	// Closes the level (its objects aren't destroyed)
+	void Close();
+	// Makes the streamer wait for its worker threads instead of picking up their work on a later frame
+	// > Every run then creates the same objects on the same frames, which replays depend on
+	void SetWaitForLoads( bool wait ) { m_waitForLoads = wait; }
+
+	// Activates and deactivates sectors around the focus point, loading new ones in the background
+	// > Returns true if any objects were created or destroyed
+	bool Update( Point2f focus );
+	// Counts the objects of a type which exist in the level but not in the object manager (because their sector isn't active)
+	int CountInactiveObjects( GameObjectType type ) const;
+	// Gets the number of active sectors
+	int GetActiveSectorCount() const { return static_cast<int>( m_vActiveSectors.size() ); }
+	// Gets the total number of sectors
+	int GetSectorCount() const { return static_cast<int>( m_vSectors.size() ); }
+
+	// Gets the properties of an object the streamer created (or was given), or nullptr for any other object
+	const LevelPropertyValues* GetProperties( int id ) const;
+	// Gets the object which was created alongside another (e.g. a blade's collision object), or -1
+	int GetLinkedObject( int id ) const;
+	// Adds an object which was created elsewhere (e.g. by the Level Editor), so the game can find its properties
+	void AddObject( int id, const LevelPropertyValues& properties, int linkedId = -1 );
+
+	// Remembers which sectors are active and which objects have been consumed, to go with Play::SaveGameObjectSnapshot()
+	void SaveSnapshot();
+	// Goes back to the state in the snapshot, to go with Play::RestoreGameObjectSnapshot()
+	void RestoreSnapshot();
+
+private:
+	enum SectorState
+	{
+		SECTOR_INACTIVE = 0,
+		SECTOR_LOADING,
+		SECTOR_ACTIVE,
+	};
+
+	// A sector's records are the range of m_vRecordIds and m_vConsumed given by its LevelSector, so the sectors can be saved and restored without allocating
+	struct Sector
+	{
+		SectorState state{ SECTOR_INACTIVE };
+	};
+
+	// An object read from the level by the background loader, ready to be created
+	struct StagedObject
+	{
+		int typeIndex;
+		int recordIndex; // Within the sector
+		LevelRecord record;
+		LevelPropertyValues properties;
+	};
+
+	// What the game needs to know about an object which exists
+	struct ObjectProperties
+	{
+		LevelPropertyValues properties;
+		int linkedId{ -1 };
+		bool exists{ false };
+	};
+
+	bool OpenInBackground( std::string textFile, std::string binaryFile );
+	LevelPropertyValues ReadProperties( int typeIndex, const LevelRecord& record, uint32_t blockRecordIndex, const LevelPropertyRecord*& pProperty, const LevelPropertyRecord* pPropertyEnd ) const;
+	std::vector< StagedObject > ReadSector( int sectorIndex ) const;
+	void CommitSector( int sectorIndex, const std::vector< StagedObject >& vStaged );
+	void DeactivateSector( int sectorIndex );
+	bool HasObjectIn( int sectorIndex, float left, float top, float right, float bottom ) const;
+	void AbandonLoads();
+	void WaitForLoads();
+	void CreateObjects( int sectorIndex, const std::vector< StagedObject >& vStaged );
+	int FindSector( int32_t sectorX, int32_t sectorY ) const;
+
+	// Calls the function with the index of each sector which overlaps the area
+	template< typename Function > void ForEachSectorIn( float left, float top, float right, float bottom, Function function ) const
+	{
+		float sectorSize = static_cast<float>( m_level.GetSectorSize() );
+		int32_t minY = static_cast<int32_t>( std::floor( top / sectorSize ) );
+		int32_t maxY = static_cast<int32_t>( std::floor( bottom / sectorSize ) );
+
+		for( int32_t sectorX = static_cast<int32_t>( std::floor( left / sectorSize ) ); sectorX <= static_cast<int32_t>( std::floor( right / sectorSize ) ); sectorX++ )
+		{
+			for( int s = FindSector( sectorX, minY ); s < m_level.GetSectorCount() && m_level.GetSector( s ).x == sectorX && m_level.GetSector( s ).y <= maxY; s++ )
+				function( s );
+		}
+	}
+
+	LevelFile m_level;
+	Vector2f m_viewSize{ 0.0f, 0.0f };
+	Point2f m_lastFocus{ 0.0f, 0.0f };
+	Vector2f m_direction{ 0.0f, 0.0f };
+	bool m_waitForLoads{ false };
+
+	std::vector< int > m_vBlockTypes; // Index into LEVEL_OBJECT_TYPES for each block (or -1)
+	std::vector< int > m_vStringSpriteIds; // Looked up for each sprite name while the level opens
+	std::vector< Sector > m_vSectors;
+	std::vector< int > m_vRecordIds; // The object created for each of the level's records (or -1)
+	std::vector< bool > m_vConsumed; // Records whose objects were destroyed by the game, which aren't created again
+	std::vector< int > m_vActiveSectors;
+	std::vector< int > m_vInactiveCounts; // Indexed like LEVEL_OBJECT_TYPES
+	std::map< int, std::future< std::vector< StagedObject > > > m_pendingLoads;
+	std::vector< std::future< std::vector< StagedObject > > > m_vAbandonedLoads; // Loads which are no longer wanted but haven't finished
+	std::vector< ObjectProperties > m_vObjectProperties; // Indexed by object id
+	std::vector< const StagedObject* > m_vCreateStaged; // The run of objects CreateObjects() is creating (kept to save allocating)
+	std::vector< Point2f > m_vCreatePositions;
+	std::vector< int > m_vCreateSpriteIds;
+
+	// Prepared by the worker thread which opens the level
+	std::future< bool > m_openResult;
+	std::atomic< float > m_openProgress{ 0.0f };
+	std::vector< StagedObject > m_vStagedGlobals;
+	std::vector< std::pair< int, std::vector< StagedObject > > > m_vStagedSectors;
+	std::vector< int > m_vEvictedSprites; // Which sprites needed decoding when the level started opening
+	std::vector< PlayGraphics::DecodedSprite > m_vDecodedSprites;
+
+	std::vector< Sector > m_vSnapshotSectors;
+	std::vector< int > m_vSnapshotRecordIds;
+	std::vector< bool > m_vSnapshotConsumed;
+	std::vector< int > m_vSnapshotActiveSectors;
+	std::vector< int > m_vSnapshotInactiveCounts;
+	std::vector< ObjectProperties > m_vSnapshotObjectProperties;
+};
+
+//-------------------------------------------------------------------------
+
+// The game's type for each of LEVEL_OBJECT_TYPES
+extern const GameObjectType LEVEL_GAME_TYPES[LEVEL_OBJECT_TYPE_COUNT];
@@ -13,14 +13,22 @@
 // 6. Exit Doughnut
 ///////////////////////////////////////////////////////////////////////////
 
+// The level editor compiles this file too, to play the level it has loaded (and has its own Play implementation)
+#ifndef BAAMAGEDDON_IN_EDITOR
 #define PLAY_IMPLEMENTATION
+#endif
 #define PLAY_USING_GAMEOBJECT_MANAGER
 
 //-------------------------------------------------------------------------
 
 #include "Play.h"
 #include "AABB.h"
+#include "LevelFile.h"
+#include "LevelProperties.h"
 #include "MainGame.h"
+#include "LevelStreamer.h"
+#include "LevelGenerator.h"
+#include "PlayInEditor.h"
 
 //-------------------------------------------------------------------------
 
@@ -38,11 +46,6 @@ constexpr const char* SHEEP_WALK_RIGHT_SPRITE_NAME = "spr_sheep1_walk_right";
 constexpr const char* SHEEP_JUMP_LEFT_SPRITE_NAME = "spr_sheep1_jump_left";
 constexpr const char* SHEEP_JUMP_RIGHT_SPRITE_NAME = "spr_sheep1_jump_right";
 
-constexpr const char* ISLAND_A_SPRITE_NAME = "spr_island_A";
-constexpr const char* ISLAND_B_SPRITE_NAME = "spr_island_B";
-constexpr const char* ISLAND_C_SPRITE_NAME = "spr_island_C";
-constexpr const char* ISLAND_D_SPRITE_NAME = "spr_island_D";
-
 const Point2f SHEEP_COLLISION_HALFSIZE = { 40,40 };
 
 constexpr const char* DOUGHNUT_SPRITE_NAME = "spr_doughnut_12";
@@ -55,6 +58,8 @@ constexpr const char* WOLF_SPRITE_NAME_RIGHT = "spr_wolf_right";
 constexpr const char* BUSH_SPRITE_NAME = "spr_bouncy_bush";
 
 constexpr const char* BLADE_SPRITE_NAME = "spr_swinging_blade";
+// The blades swing from above their centre
+constexpr int BLADE_PIVOT_OFFSET = 150;
 
 constexpr const char* FINAL_SPRITE_NAME = "level_exit";
 
@@ -63,27 +68,115 @@ constexpr int RIGHT_SCREEN_BOUND = DISPLAY_WIDTH - LEFT_SCREEN_BOUND;
 
 constexpr int FLOOR_BOUND = DISPLAY_HEIGHT * 2;
 
+constexpr int BACKGROUND_LAYER = 0;
+constexpr int ISLAND_LAYER = 1;
+
+constexpr size_t SPRITE_MEMORY_BUDGET = 32 * 1024 * 1024;
+
+// Frames which take longer than this are dumped to a file (release builds only, unless "--hitch=<ms>" is used)
+constexpr float HITCH_THRESHOLD_MS = 20.0f;
+
+constexpr const char* LEVEL_TEXT_FILENAME = "Level.lev";
+constexpr const char* LEVEL_BINARY_FILENAME = "Level.blev";
+
+// "--stress-benchmark=<file>" generates levels with this many objects and times loading and playing them, instead of running the game
+// > "--stress-objects=<count>" measures a single size instead
+constexpr int STRESS_LEVEL_SIZES[] = { 1000, 10000, 100000 };
+// Frames which aren't timed, while the level starts and the sheep lands on the first island
+constexpr int STRESS_WARMUP_FRAMES = 30;
+// The times are read back from the profiler's history, so this can't be more than it keeps
+constexpr int STRESS_MEASURED_FRAMES = 120;
+static_assert( STRESS_MEASURED_FRAMES <= PROFILER_STATS_FRAMES, "The profiler doesn't keep enough frames" );
+// The generated levels are deleted again once they've been measured
+constexpr const char* STRESS_TEXT_FILENAME = "Stress.lev";
+constexpr const char* STRESS_BINARY_FILENAME = "Stress.blev";
+
 
 //-------------------------------------------------------------------------
 
 static GameState gameState;
+// The state just after the level was loaded, whose object tables are restored whenever the sheep respawns
+static GameState pristineGameState;
+// Only the sectors of the level near the camera have their objects created
+static LevelStreamer levelStreamer;
+
+#ifndef BAAMAGEDDON_IN_EDITOR
 
+//-------------------------------------------------------------------------
+
+// One size of generated level in one streaming mode, as measured by the stress benchmark
+struct StressRun
+{
+	int objects{ 0 };
+	bool allActive{ false }; // The view covers the whole level, so every object exists at once
+	int activeObjects{ 0 };
+	int sectors{ 0 };
+	int activeSectors{ 0 };
+	float generateMs{ 0 }; // Generating the level and writing both of its files
+	float loadMs{ 0 }; // Opening the binary level and creating its objects
+	size_t processBytes{ 0 }; // Once the level has loaded
+	long long processBytesAdded{ 0 }; // By loading, which can be less than it needed when memory freed by an earlier run is reused
+	long long heapBytesAdded{ 0 }; // Debug builds only
+	// The means per frame of the timing bar segments for each of the game's systems
+	float streamingMs{ 0 };
+	float updateMs{ 0 };
+	float collisionMs{ 0 };
+	float drawMs{ 0 };
+	float frameMs{ 0 };
+	float maxFrameMs{ 0 };
+	// The profiler's counters for the last frame
+	uint32_t circleTests{ 0 };
+	uint32_t sweepTests{ 0 };
+	uint32_t spriteDraws{ 0 };
+};
+
+//-------------------------------------------------------------------------
+
+// What the stress benchmark has measured, and which frame of which run it's on
+struct StressBenchmark
+{
+	std::string resultsFile; // Empty unless the benchmark is running instead of the game
+	std::vector< StressRun > vRuns;
+	int run{ -1 };
+	int frame{ 0 };
+};
+
+static StressBenchmark stressBenchmark;
 
 //-------------------------------------------------------------------------
 // The entry point for a Play program
-void MainGameEntry( PLAY_IGNORE_COMMAND_LINE )
+void MainGameEntry( int argc, char* argv[] )
 {
 	Play::CreateManager( DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_SCALE );
+	Play::EnableCoverageCulling( true );
+	Play::SetSpriteMemoryBudget( SPRITE_MEMORY_BUDGET );
+#ifndef _DEBUG
+	if( Play::GetHitchThreshold() == 0.0f )
+		Play::SetHitchThreshold( HITCH_THRESHOLD_MS );
+#endif
+	Play::MakeSpriteMutable( "64px" );
+	Play::EnableCompactSprites( true );
 	Play::CentreAllSpriteOrigins();
 	Play::LoadBackground( "Data\\Backgrounds\\spr_background.png" );
 	Play::StartAudioLoop( "soundscape" );
 	Play::ColourSprite( "64px", Play::cBlack );
-	LoadLevel();
-	CreatePlatforms();
-	CreateSpikes();
-	CreateBlades();
 	gameState.cameraTarget = Point2f( DISPLAY_WIDTH, DISPLAY_HEIGHT ) - Point2f( DISPLAY_WIDTH / 2.0f, DISPLAY_HEIGHT / 2.0f);
 	Play::SetCameraPosition( gameState.cameraTarget );
+	levelStreamer.SetWaitForLoads( Play::IsRecordingOrReplaying() );
+
+	int stressObjects = 0;
+	for( int i = 1; i < argc; i++ )
+	{
+		if( strncmp( argv[i], "--stress-benchmark=", 19 ) == 0 )
+			stressBenchmark.resultsFile = argv[i] + 19;
+		else if( strncmp( argv[i], "--stress-objects=", 17 ) == 0 )
+			stressObjects = atoi( argv[i] + 17 );
+	}
+
+	if( !stressBenchmark.resultsFile.empty() )
+		BeginStressBenchmark( stressObjects );
+	else
+		LoadLevel();
 }
 
 //-------------------------------------------------------------------------
@@ -96,77 +189,107 @@ bool MainGameUpdate(float elapsedTime)
 	Point2f cameraDiff = gameState.cameraTarget - Point2f( DISPLAY_WIDTH / 2.0f, DISPLAY_HEIGHT / 2.0f ) - Play::GetCameraPosition();
 	Play::SetCameraPosition( Play::GetCameraPosition() + cameraDiff/8.0f );
 
-	Play::BeginTimingBar( Play::cBlue );
+	Play::BeginTimingBar( Play::cBlue, "Streaming" );
+
+	if( !stressBenchmark.resultsFile.empty() )
+		return UpdateStressBenchmark();
+
+	// The level loads on a worker thread, so frames keep being presented (and the music keeps playing) until it's ready
+	if( gameState.playState == STATE_LOADING )
+	{
+		UpdateLoading();
+		Play::PresentDrawingBuffer();
+		return Play::KeyDown( VK_ESCAPE );
+	}
+
+	// Once the level's being played nothing should need allocating, which "--strict-allocations" checks in debug builds
+	SetStrictAllocations( gameState.playState == STATE_PLAY );
+	UpdateGame();
+	Play::PresentDrawingBuffer();
+	SetStrictAllocations( false );
+	return Play::KeyDown(VK_ESCAPE);
+}
+
+//-------------------------------------------------------------------------
+// Gets called once when the player quits the game 
+int MainGameExit(void)
+{
+	levelStreamer.Close();
+	Play::DestroyManager();
+	return PLAY_OK;
+}
+#endif
+
+//-------------------------------------------------------------------------
+// Updates and draws one frame of the game once the level has loaded
+void UpdateGame( void )
+{
+	PLAY_PROFILE_FUNCTION();
+
+	// The collision and hazard tables only need rebuilding when sectors come and go
+	// > Those frames are allowed to allocate, as the lists of objects can grow too
+	if( levelStreamer.Update( gameState.cameraTarget ) )
+	{
+		SetStrictAllocations( false );
+		CreatePlatforms();
+		CreateSpikes();
+		CreateHazards();
+	}
+
+	Play::ColourTimingBar( Play::cCyan, "Background" );
 	DrawScene();
 
-	Play::ColourTimingBar( Play::cRed );
+	Play::ColourTimingBar( Play::cRed, "Sheep" );
 	UpdateGamePlayState();
-	Play::ColourTimingBar( Play::cGreen );
+	Play::ColourTimingBar( Play::cGreen, "Objects" );
 	UpdateDoughnuts();
 	UpdateSprinkles();
 	UpdateWolves();
 	UpdateBushes();
 	UpdateBlades();
+	Play::ColourTimingBar( Play::cMagenta, "Collision" );
 	HandleSpikeCollision();
 
+	Play::ColourTimingBar( Play::cWhite, "Score and present" );
 	Play::SetDrawingSpace( Play::SCREEN );
 	Play::DrawSprite( Play::GetSpriteId( SCORE_TAB_SPRITE_NAME ), { DISPLAY_WIDTH / 2, 35 }, 0 );
-	Play::DrawFontText("64px", "SCORE: " + std::to_string(gameState.score), { DISPLAY_WIDTH / 2, 28 }, Play::CENTRE);
+	char scoreText[32];
+	snprintf( scoreText, sizeof( scoreText ), "SCORE: %d", gameState.score );
+	Play::DrawFontText( "64px", scoreText, { DISPLAY_WIDTH / 2, 28 }, Play::CENTRE );
 	Play::SetDrawingSpace( Play::WORLD );
 
-	Play::ColourTimingBar( Play::cWhite );
 	Play::DrawTimingBar( { 5, DISPLAY_HEIGHT - 15 }, { 250, 10 } );
-	Play::PresentDrawingBuffer();
-	return Play::KeyDown(VK_ESCAPE);
-}
-
-//-------------------------------------------------------------------------
-// Gets called once when the player quits the game 
-int MainGameExit(void)
-{
-	Play::DestroyManager();
-	return PLAY_OK;
 }
 
 //-------------------------------------------------------------------------
 void CreatePlatforms( void )
 {
+	PLAY_PROFILE_FUNCTION();
+
 	std::vector<int> vPlatforms = Play::CollectGameObjectIDsByType( TYPE_ISLAND );
+	gameState.vPlatforms.clear();
 
 	for( int id_platform : vPlatforms )
 	{
-		GameObject& obj_platform = Play::GetGameObject( id_platform );
-
-		if( obj_platform.spriteId == Play::GetSpriteId( ISLAND_A_SPRITE_NAME ) )
-		{
-			Platform p = { { obj_platform.pos + Point2f( 24, 12 ), { 116, 15 } }, id_platform };
-			gameState.vPlatforms.push_back( p );
-		}
-
-		if( obj_platform.spriteId == Play::GetSpriteId( ISLAND_B_SPRITE_NAME ) )
-		{
-			Platform p = { { obj_platform.pos + Point2f( 0, 10 ), { 250, 15 } }, id_platform };
-			gameState.vPlatforms.push_back( p );
-		}
-
-		if( obj_platform.spriteId == Play::GetSpriteId( ISLAND_C_SPRITE_NAME ) )
-		{
-			Platform p = { { obj_platform.pos + Point2f( 0, 70 ), { 250, 15 } }, id_platform };
-			gameState.vPlatforms.push_back( p );
-		}
+		// The collision box for each island sprite is one of its properties in the level
+		const LevelPropertyValues* pProperties = levelStreamer.GetProperties( id_platform );
+		if( !pProperties || ( *pProperties )[ISLAND_BOX_HALF_WIDTH] <= 0.0f )
+			continue;
 
-		if( obj_platform.spriteId == Play::GetSpriteId( ISLAND_D_SPRITE_NAME ) )
-		{
-			Platform p = { { obj_platform.pos + Point2f( 10, 50 ), { 200, 15 } }, id_platform };
-			gameState.vPlatforms.push_back( p );
-		}
+		GameObject& obj_platform = Play::GetGameObject( id_platform );
+		const LevelPropertyValues& p = *pProperties;
+		Platform platform = { { obj_platform.pos + Point2f( p[ISLAND_BOX_X], p[ISLAND_BOX_Y] ), { p[ISLAND_BOX_HALF_WIDTH], p[ISLAND_BOX_HALF_HEIGHT] } }, id_platform };
+		gameState.vPlatforms.push_back( platform );
 	}
 }
 
 //-------------------------------------------------------------------------
 void CreateSpikes(void)
 {
+	PLAY_PROFILE_FUNCTION();
+
 	std::vector<int> vSpikes = Play::CollectGameObjectIDsByType(TYPE_SPIKE);
+	gameState.vSpikes.clear();
 
 	for (int id_spike : vSpikes)
 	{
@@ -179,19 +302,47 @@ void CreateSpikes(void)
 //-------------------------------------------------------------------------
 void CreateBlades(void)
 {
-	std::vector<int> vBlades = Play::CollectGameObjectIDsByType(TYPE_BLADE);
+	// The blades are streamed in later, so their shared sprite origin is moved once whether or not any exist yet
+	Play::MoveMatchingSpriteOrigins(BLADE_SPRITE_NAME, 0, -BLADE_PIVOT_OFFSET);
+}
+
+//-------------------------------------------------------------------------
+// Packs the hazards' properties next to their ids, so their updates don't have to look anything up
+void CreateHazards( void )
+{
+	PLAY_PROFILE_FUNCTION();
+
+	gameState.vWolves.clear();
+	gameState.vBlades.clear();
+	gameState.vBushes.clear();
+
+	for( int id_wolf : Play::CollectGameObjectIDsByType( TYPE_WOLF ) )
+	{
+		if( const LevelPropertyValues* p = levelStreamer.GetProperties( id_wolf ) )
+			gameState.vWolves.push_back( { id_wolf, ( *p )[WOLF_ALERT_RANGE], ( *p )[WOLF_POUNCE_RANGE] } );
+	}
+
+	for( int id_blade : Play::CollectGameObjectIDsByType( TYPE_BLADE ) )
+	{
+		const LevelPropertyValues* p = levelStreamer.GetProperties( id_blade );
+		int id_null = levelStreamer.GetLinkedObject( id_blade );
+		if( p && id_null != -1 )
+			gameState.vBlades.push_back( { id_blade, id_null, ( *p )[BLADE_RADIUS], ( *p )[BLADE_SWING_SPEED] } );
+	}
 
-	for (int id_blade : vBlades)
+	for( int id_bush : Play::CollectGameObjectIDsByType( TYPE_BUSH ) )
 	{
-		GameObject& obj_blade = Play::GetGameObject(id_blade);
-		Play::MoveMatchingSpriteOrigins(BLADE_SPRITE_NAME, 0, -150);
+		if( const LevelPropertyValues* p = levelStreamer.GetProperties( id_bush ) )
+			gameState.vBushes.push_back( { id_bush, ( *p )[BUSH_LAUNCH_SPEED], ( *p )[BUSH_BOOSTED_LAUNCH_SPEED] } );
 	}
 }
 
 //-------------------------------------------------------------------------
 void DrawObjectsOfType( GameObjectType type )
 {
-	for( int id : Play::CollectGameObjectIDsByType( type ) )
+	static std::vector<int> vIds;
+	Play::CollectGameObjectIDsByType( type, vIds );
+	for( int id : vIds )
 	{
 		GameObject& obj = Play::GetGameObject( id );
 		Play::DrawSprite( obj.spriteId, obj.pos, obj.frame);
@@ -201,9 +352,23 @@ void DrawObjectsOfType( GameObjectType type )
 //-------------------------------------------------------------------------
 void DrawScene()
 {
+	PLAY_PROFILE_FUNCTION();
+
+	// Front-to-back pass: the islands hide a lot of the background so it doesn't need drawing behind them
+	Play::BeginCoveragePass();
+	static std::vector<int> vIslands;
+	Play::CollectGameObjectIDsByType( TYPE_ISLAND, vIslands );
+	for( int id : vIslands )
+	{
+		GameObject& obj = Play::GetGameObject( id );
+		Play::AddOccluder( obj.spriteId, obj.pos, obj.frame, ISLAND_LAYER );
+	}
+
+	Play::SetDrawLayer( BACKGROUND_LAYER );
 	Play::DrawBackground();
+	Play::SetDrawLayer( ISLAND_LAYER );
 
-	Play::ColourTimingBar( Play::cYellow );
+	Play::ColourTimingBar( Play::cYellow, "Draw objects" );
 
 	DrawObjectsOfType( TYPE_ISLAND );
 	DrawObjectsOfType( TYPE_DOUGHNUT );
@@ -282,6 +447,8 @@ void HandlePlatformCollision(GameObject& obj_sheep)
 //Using the same collision detection as platforms to create a better bounding box for the rectangular spikes
 void HandleSpikeCollision() 
 {
+	PLAY_PROFILE_FUNCTION();
+
 	//commented out code was from previous iteration using the Playbuffer radius collider
 	GameObject& obj_sheep = Play::GetGameObjectByType(TYPE_SHEEP);
 	AABB sheepAABB = { obj_sheep.pos, SHEEP_COLLISION_HALFSIZE };
@@ -326,7 +493,8 @@ void DrawCollisionBounds(GameObject& obj_sheep)
 	{
 		DrawAABB( spike.box, Play::cRed );
 	}
-	std::vector<int> vWolves = Play::CollectGameObjectIDsByType(TYPE_WOLF);
+	static std::vector<int> vWolves;
+	Play::CollectGameObjectIDsByType( TYPE_WOLF, vWolves );
 	for (int id_wolf : vWolves)
 	{
 		GameObject& obj_wolf = Play::GetGameObject(id_wolf);
@@ -340,18 +508,13 @@ void DisplayDebugInfo(GameObject& obj_sheep)
 {
 	Play::SetDrawingSpace( Play::SCREEN );
 
-	std::ostringstream info;
-	info.precision(2);
-	info << std::fixed;
-	info << " Playstate:" << gameState.playState;
-	info << "\nSheepstate:" << gameState.sheepState;
+	char info[512];
+	snprintf( info, sizeof( info ), " Playstate:%d\nSheepstate:%d Sectors:%d/%d p{ %.2f, %.2f }  v{ %.2f, %.2f }  a{ %.2f, %.2f }  a{ %.2f, %.2f } ",
+		gameState.playState, gameState.sheepState, levelStreamer.GetActiveSectorCount(), levelStreamer.GetSectorCount(),
+		obj_sheep.pos.null, obj_sheep.pos.y, obj_sheep.velocity.null, obj_sheep.velocity.y, obj_sheep.acceleration.null, obj_sheep.acceleration.y,
+		abs( obj_sheep.pos.null - Play::GetGameObjectByType( TYPE_WOLF ).pos.null ), obj_sheep.acceleration.y );
 
-	info << " p{ " << obj_sheep.pos.null << ", " << obj_sheep.pos.y << " } ";
-	info << " v{ " << obj_sheep.velocity.null << ", " << obj_sheep.velocity.y << " } ";
-	info << " a{ " << obj_sheep.acceleration.null << ", " << obj_sheep.acceleration.y << " } ";
-	info << " a{ " << abs(obj_sheep.pos.null - Play::GetGameObjectByType(TYPE_WOLF).pos.null) << ", " << obj_sheep.acceleration.y << " } ";
-
-	Play::DrawDebugText({ DISPLAY_WIDTH / 2, DISPLAY_HEIGHT - 50 }, info.str().c_str());
+	Play::DrawDebugText({ DISPLAY_WIDTH / 2, DISPLAY_HEIGHT - 50 }, info);
 
 	Play::SetDrawingSpace( Play::WORLD );
 }
@@ -454,7 +617,11 @@ void UpdateSheep(GameObject& obj_sheep)
 		break;
 	};
 	if(gameState.playState != STATE_DEAD)
+	{
+		Play::ColourTimingBar( Play::cMagenta, "Collision" );
 		HandlePlatformCollision(obj_sheep);
+		Play::ColourTimingBar( Play::cRed, "Sheep" );
+	}
 
 	gameState.cameraTarget = obj_sheep.pos;
 	
@@ -473,18 +640,23 @@ void UpdateSheep(GameObject& obj_sheep)
 */
 void UpdateWolves()
 {
-	GameObject& obj_sheep = Play::GetGameObjectByType(TYPE_SHEEP);
-	std::vector<int> vWolves = Play::CollectGameObjectIDsByType(TYPE_WOLF);
+	PLAY_PROFILE_FUNCTION();
 
+	GameObject& obj_sheep = Play::GetGameObjectByType(TYPE_SHEEP);
 
 	static bool hasCollided = false;
-	for (int id_wolf : vWolves)
+	for (const Wolf& wolf : gameState.vWolves)
 	{
+		// Wolves which have fallen off the level stay in the list until it's next rebuilt
+		int id_wolf = wolf.wolf_id;
 		GameObject& obj_wolf = Play::GetGameObject(id_wolf);
+		if (obj_wolf.type == -1)
+			continue;
+
 		float xDistance = abs(obj_sheep.pos.null - obj_wolf.pos.null);
 		if (obj_wolf.frame != 2) 
 		{
-			if (xDistance > 500 || obj_sheep.pos.null > obj_wolf.pos.null)
+			if (xDistance > wolf.alertRange || obj_sheep.pos.null > obj_wolf.pos.null)
 			{
 				obj_wolf.frame = 1;
 				Play::UpdateGameObject(obj_wolf);
@@ -492,7 +664,7 @@ void UpdateWolves()
 			else
 			{
 				obj_wolf.frame = 0;
-				if (xDistance < 200 && obj_wolf.pos.y + 100 > obj_sheep.pos.y)
+				if (xDistance < wolf.pounceRange && obj_wolf.pos.y + 100 > obj_sheep.pos.y)
 				{
 					obj_wolf.frame = 2;
 				}
@@ -529,24 +701,23 @@ void UpdateWolves()
 //-------------------------------------------------------------------------
 void UpdateBlades()
 {
+	PLAY_PROFILE_FUNCTION();
+
 	GameObject& obj_sheep = Play::GetGameObjectByType(TYPE_SHEEP);
-	std::vector<int> vBlades = Play::CollectGameObjectIDsByType(TYPE_BLADE);
-	std::vector<int> vNull = Play::CollectGameObjectIDsByType(TYPE_NULL_BLADE);
-	for (int i = 0; i < vBlades.size(); i++)
+	for (const Blade& blade : gameState.vBlades)
 	{
-		GameObject& obj_blade = Play::GetGameObject(vBlades.at(0));
-		if (gameState.null <= 2 * (PLAY_PI))
+		// Each blade's rotation is also the angle of its swing
+		GameObject& obj_blade = Play::GetGameObject(blade.blade_id);
+		if (obj_blade.rotation <= 2 * (PLAY_PI))
 		{
-			gameState.null += 0.04f;
-			obj_blade.rotation += 0.04f;
+			obj_blade.rotation += blade.swingSpeed;
 		}
 		else
 		{
-			gameState.null = 0;
 			obj_blade.rotation = 0;
 		}
-		GameObject& obj_null = Play::GetGameObject(vNull.at(0));
-		obj_null.pos = { obj_blade.pos.null + (270 * cos(gameState.null + PLAY_PI/2 )), obj_blade.pos.y + 270 * sin(gameState.null + PLAY_PI/2)};
+		GameObject& obj_null = Play::GetGameObject(blade.null_id);
+		obj_null.pos = { obj_blade.pos.null + (blade.radius * std::cos(obj_blade.rotation + PLAY_PI/2 )), obj_blade.pos.y + blade.radius * std::sin(obj_blade.rotation + PLAY_PI/2)};
 		Play::UpdateGameObject(obj_null);
 		
 		Play::UpdateGameObject(obj_blade);
@@ -562,19 +733,20 @@ void UpdateBlades()
 //-------------------------------------------------------------------------
 void UpdateBushes()
 {
+	PLAY_PROFILE_FUNCTION();
+
 	GameObject& obj_sheep = Play::GetGameObjectByType(TYPE_SHEEP);
-	std::vector<int> vBushes = Play::CollectGameObjectIDsByType(TYPE_BUSH);
 
-	for (int id_bush : vBushes)
+	for (const Bush& bush : gameState.vBushes)
 	{
-		GameObject& obj_bush = Play::GetGameObject(id_bush);
+		GameObject& obj_bush = Play::GetGameObject(bush.bush_id);
 		
 		if (Play::IsColliding(obj_bush, obj_sheep))
 		{
 			Play::SetSprite(obj_bush, BUSH_SPRITE_NAME, 1.0f);
 			if(Play::KeyDown(VK_SPACE))
-				obj_sheep.velocity.y = -32;
-			else obj_sheep.velocity.y = -20;
+				obj_sheep.velocity.y = -bush.boostedLaunchSpeed;
+			else obj_sheep.velocity.y = -bush.launchSpeed;
 		}
 		if(Play::IsAnimationComplete(obj_bush))
 		{
@@ -589,7 +761,14 @@ void UpdateBushes()
 //-- ----------------------------------------------------------------------
 void UpdateSprinkles()
 {
-	std::vector<int> vSprinkles = Play::CollectGameObjectIDsByType(TYPE_SPRINKLE);
+	PLAY_PROFILE_FUNCTION();
+
+	// The list is reused, so it only allocates when collecting doughnuts has made more sprinkles than there have been before
+	static std::vector<int> vSprinkles;
+	{
+		PLAY_ALLOW_ALLOCATIONS();
+		Play::CollectGameObjectIDsByType( TYPE_SPRINKLE, vSprinkles );
+	}
 
 	for (int id_sprinkle : vSprinkles)
 	{
@@ -606,10 +785,14 @@ void UpdateSprinkles()
 //Added Final Doughnut logic here
 void UpdateDoughnuts()
 {
+	PLAY_PROFILE_FUNCTION();
+
 	GameObject& obj_sheep = Play::GetGameObjectByType(TYPE_SHEEP);
-	std::vector<int> vDoughnuts = Play::CollectGameObjectIDsByType(TYPE_DOUGHNUT);
+	static std::vector<int> vDoughnuts;
+	Play::CollectGameObjectIDsByType( TYPE_DOUGHNUT, vDoughnuts );
 
-	gameState.doughnutsLeft = vDoughnuts.size();
+	// Doughnuts in sectors which aren't active still need collecting
+	gameState.doughnutsLeft = vDoughnuts.size() + levelStreamer.CountInactiveObjects( TYPE_DOUGHNUT );
 
 	for (int id_doughnut : vDoughnuts)
 	{
@@ -618,6 +801,8 @@ void UpdateDoughnuts()
 
 		if (Play::IsColliding(obj_doughnut, obj_sheep))
 		{
+			// Creating objects allocates, but only when something's collected
+			PLAY_ALLOW_ALLOCATIONS();
 			for (float rad{ 0.25f }; rad < 2.0f; rad += 0.25f)
 			{
 				int id = Play::CreateGameObject(TYPE_SPRINKLE, obj_sheep.pos, 0, SPRINKLE_SPRITE_NAME);
@@ -647,6 +832,7 @@ void UpdateDoughnuts()
 		Play::UpdateGameObject(obj_final);
 		if (Play::IsColliding(obj_final, obj_sheep))
 		{
+			PLAY_ALLOW_ALLOCATIONS();
 			int sprinkles = 10;
 			while (sprinkles >= 0) 
 			{
@@ -673,16 +859,24 @@ void UpdateDoughnuts()
 //-------------------------------------------------------------------------
 void UpdateGamePlayState()
 {
+	PLAY_PROFILE_FUNCTION();
+
 	GameObject& obj_sheep = Play::GetGameObjectByType(TYPE_SHEEP);
 
 	switch (gameState.playState)
 	{
 	case STATE_START:
 
-		for( int id_obj : Play::CollectAllGameObjectIDs() )
-			Play::DestroyGameObject( id_obj );
+		Play::RestoreGameObjectSnapshot();
+		levelStreamer.RestoreSnapshot();
 
-		LoadLevel();
+		// Only the parts of the state which refer to the objects go back with them, so the rest (e.g. which way the sheep faces) carries on
+		gameState.doughnutsLeft = pristineGameState.doughnutsLeft;
+		gameState.vPlatforms = pristineGameState.vPlatforms;
+		gameState.vSpikes = pristineGameState.vSpikes;
+		gameState.vWolves = pristineGameState.vWolves;
+		gameState.vBlades = pristineGameState.vBlades;
+		gameState.vBushes = pristineGameState.vBushes;
 
 		for( int id_doughnut : Play::CollectGameObjectIDsByType( TYPE_DOUGHNUT ) )
 		{
@@ -737,6 +931,11 @@ void UpdateGamePlayState()
 		}
 		break;
 
+	case STATE_LOADING:
+		// MainGameUpdate() doesn't update the game until the level has finished loading
+		PLAY_ASSERT_MSG( false, "Updating the game while the level is loading" );
+		break;
+
 	} // End of switch
 
 	Play::UpdateGameObject(obj_sheep);
@@ -749,6 +948,7 @@ void UpdateGamePlayState()
 
 	if (s_bEnableDebug)
 	{
+		PLAY_ALLOW_ALLOCATIONS();
 		DisplayDebugInfo(obj_sheep);
 		DrawCollisionBounds(obj_sheep);
 		TestAABBSegmentTest();
@@ -780,9 +980,12 @@ void TestAABBSegmentTest()
 	t += 0.04f;
 	if (t > PLAY_PI) t -= PLAY_PI * 2.f;
 
-	Vector2f b{ sin(t) * 200.f + 250.f, cos(t) * 200.f + 250.f };
+	Vector2f b{ std::sin(t) * 200.f + 250.f, std::cos(t) * 200.f + 250.f };
 	Vector2f a{ 400.f, 800.f };
 
+	if (gameState.vPlatforms.empty())
+		return;
+
 	float t0;
 	if (AABBSegmentTest(gameState.vPlatforms[0].box, a, b, t0))
 	{
@@ -809,56 +1012,247 @@ void TestAABBSegmentTest()
 	DrawAABB(testBox, { 100, 100, 100 });
 }
 
-
+#ifndef BAAMAGEDDON_IN_EDITOR
 //-------------------------------------------------------------------------
-// Loads the objects from the Baamageddon\Level.lev file
+// Loads the objects from the Baamageddon\Level.lev file (using the binary version, which is created if necessary)
 void LoadLevel( void )
 {
-	std::ifstream levelfile;
-	levelfile.open( "Level.lev" );
+	levelStreamer.BeginOpen( LEVEL_TEXT_FILENAME, LEVEL_BINARY_FILENAME, { DISPLAY_WIDTH, DISPLAY_HEIGHT } );
+	gameState.playState = STATE_LOADING;
+}
+
+//-------------------------------------------------------------------------
+// Shows how far the level has loaded, and starts the game once it's ready
+void UpdateLoading( void )
+{
+	float progress = levelStreamer.GetOpenProgress();
+
+	Play::DrawBackground();
+	Play::SetDrawingSpace( Play::SCREEN );
+	Play::DrawFontText( "64px", "LOADING", { DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2 - 40 }, Play::CENTRE );
+	Play::DrawRect( Point2f( DISPLAY_WIDTH / 4, DISPLAY_HEIGHT / 2 ), Point2f( DISPLAY_WIDTH * 3 / 4, DISPLAY_HEIGHT / 2 + 20 ), Play::cBlack );
+	Play::DrawRect( Point2f( DISPLAY_WIDTH / 4, DISPLAY_HEIGHT / 2 ), Point2f( ( DISPLAY_WIDTH / 4 ) + ( progress * DISPLAY_WIDTH / 2 ), DISPLAY_HEIGHT / 2 + 20 ), Play::cWhite, true );
+	Play::SetDrawingSpace( Play::WORLD );
+
+	if( levelStreamer.IsOpenReady() )
+		FinishLoadingLevel();
+}
+
+//-------------------------------------------------------------------------
+// Creates everything the loading thread prepared in one go
+void FinishLoadingLevel( void )
+{
+	PLAY_PROFILE_FUNCTION();
+
+	levelStreamer.FinishOpen();
+	StartLevel();
+}
+
+//-------------------------------------------------------------------------
+// Measures every size of level with only the sectors near the sheep active, as in the game, and then with all of them active
+// > A count of objects measures that size instead of the usual ones
+void BeginStressBenchmark( int objects )
+{
+	// Every run streams the same sectors on the same frames, and the biggest levels' frames are expected to be too slow to dump as hitches
+	levelStreamer.SetWaitForLoads( true );
+	Play::SetHitchThreshold( 0.0f );
+
+	std::vector< int > vSizes( std::begin( STRESS_LEVEL_SIZES ), std::end( STRESS_LEVEL_SIZES ) );
+	if( objects > 0 )
+		vSizes = { objects };
+
+	for( int size : vSizes )
+	{
+		stressBenchmark.vRuns.push_back( { size, false } );
+		stressBenchmark.vRuns.push_back( { size, true } );
+	}
+}
+
+//-------------------------------------------------------------------------
+// Generates a run's level, and times opening it and creating its objects
+static void BeginStressRun( StressRun& run )
+{
+	PLAY_PROFILE_FUNCTION();
+
+	long long begin = PlayProfiler::GetTime();
+	std::vector< LevelEntry > vEntries;
+	GenerateLevel( GetStressLevelSettings( run.objects ), vEntries );
+	bool bWritten = WriteTextLevel( STRESS_TEXT_FILENAME, vEntries ) && WriteBinaryLevel( STRESS_BINARY_FILENAME, vEntries );
+	PLAY_ASSERT_MSG( bWritten, "Couldn't write the stress benchmark's level" );
+	run.generateMs = ( PlayProfiler::GetTime() - begin ) / 1000000.0f;
+
+	// Sectors are activated around the sheep, so seeing the whole level from there takes a view twice as big as it
+	Vector2f viewSize( DISPLAY_WIDTH, DISPLAY_HEIGHT );
+	if( run.allActive )
+	{
+		Point2f sheepPos = std::find_if( vEntries.begin(), vEntries.end(), []( const LevelEntry& entry ) { return entry.type == "TYPE_SHEEP"; } )->pos;
+		for( const LevelEntry& entry : vEntries )
+		{
+			viewSize.width = std::max( viewSize.width, 2.0f * std::abs( entry.pos.null - sheepPos.null ) );
+			viewSize.height = std::max( viewSize.height, 2.0f * std::abs( entry.pos.y - sheepPos.y ) );
+		}
+	}
+
+	size_t processBefore = PlayWindow::GetProcessMemory();
+#ifdef _DEBUG
+	size_t heapBefore = GetAllocationCounters().liveBytes;
+#endif
+
+	begin = PlayProfiler::GetTime();
+	levelStreamer.BeginOpen( STRESS_TEXT_FILENAME, STRESS_BINARY_FILENAME, viewSize );
+	bool bOpened = levelStreamer.FinishOpen();
+	PLAY_ASSERT_MSG( bOpened, "Couldn't open the stress benchmark's level" );
+	gameState = GameState();
+	StartLevel();
+	run.loadMs = ( PlayProfiler::GetTime() - begin ) / 1000000.0f;
+
+	run.processBytes = PlayWindow::GetProcessMemory();
+	run.processBytesAdded = static_cast<long long>( run.processBytes ) - static_cast<long long>( processBefore );
+#ifdef _DEBUG
+	run.heapBytesAdded = static_cast<long long>( GetAllocationCounters().liveBytes ) - static_cast<long long>( heapBefore );
+#endif
+	run.activeObjects = static_cast<int>( Play::CollectAllGameObjectIDs().size() );
+	run.sectors = levelStreamer.GetSectorCount();
+	run.activeSectors = levelStreamer.GetActiveSectorCount();
+
+	gameState.cameraTarget = Play::GetGameObjectByType( TYPE_SHEEP ).pos;
+	Play::SetCameraPosition( gameState.cameraTarget - Point2f( DISPLAY_WIDTH / 2.0f, DISPLAY_HEIGHT / 2.0f ) );
+}
+
+//-------------------------------------------------------------------------
+// Gets the mean time per frame of the timing bar segments with a name, over the frames which were measured
+static float GetStressSegmentMs( const char* segmentName )
+{
+	PlayProfiler& profiler = PlayProfiler::Instance();
+	int segment = profiler.FindStatsSegment( segmentName );
+	if( segment < 0 )
+		return 0.0f;
 
-	std::string sType, sX, sY, sSprite;
+	float total = 0.0f;
+	for( int f = 0; f < STRESS_MEASURED_FRAMES; f++ )
+		total += profiler.GetSegmentTime( segment, f );
 
-	std::getline( levelfile, sType );
+	return total / STRESS_MEASURED_FRAMES;
+}
+
+//-------------------------------------------------------------------------
+// Collects a run's frame times once its frames have been played, and gets rid of its level
+static void EndStressRun( StressRun& run )
+{
+	PlayProfiler& profiler = PlayProfiler::Instance();
 
-	while( !levelfile.eof() )
+	// The game's timing bar segments are grouped by system
+	run.streamingMs = GetStressSegmentMs( "Streaming" );
+	run.updateMs = GetStressSegmentMs( "Sheep" ) + GetStressSegmentMs( "Objects" );
+	run.collisionMs = GetStressSegmentMs( "Collision" );
+	run.drawMs = GetStressSegmentMs( "Background" ) + GetStressSegmentMs( "Draw objects" ) + GetStressSegmentMs( "Score and present" );
+
+	for( int f = 0; f < STRESS_MEASURED_FRAMES; f++ )
 	{
-		std::getline( levelfile, sType );
-		std::getline( levelfile, sX );
-		std::getline( levelfile, sY );
-		std::getline( levelfile, sSprite );
+		run.frameMs += profiler.GetFrameTime( f ) / STRESS_MEASURED_FRAMES;
+		run.maxFrameMs = std::max( run.maxFrameMs, profiler.GetFrameTime( f ) );
+	}
 
-		if( sType == "TYPE_SHEEP" )
-			Play::CreateGameObject( TYPE_SHEEP, { std::stof( sX ), std::stof( sY ) }, 50, sSprite.c_str() );
+	run.circleTests = profiler.GetCounterValue( COUNTER_CIRCLE_TESTS );
+	run.sweepTests = profiler.GetCounterValue( profiler.RegisterCounter( "AABB sweep tests" ) );
+	run.spriteDraws = profiler.GetCounterValue( COUNTER_SPRITE_DRAWS );
+
+	char line[256];
+	snprintf( line, sizeof( line ), "StressBenchmark: %7d objects %-10s load %9.2fms %+8lldKB  update %7.3fms  collision %7.3fms  draw %7.3fms  frame %7.3fms\n",
+		run.objects, run.allActive ? "all active" : "streamed", run.loadMs, run.processBytesAdded / 1024, run.updateMs, run.collisionMs, run.drawMs, run.frameMs );
+	DebugOutput( line );
+
+	// The level's file is mapped until it's closed, so it can only be deleted afterwards
+	levelStreamer.Close();
+	for( int id : Play::CollectAllGameObjectIDs() )
+		Play::DestroyGameObject( id );
+	Play::MoveMatchingSpriteOrigins( BLADE_SPRITE_NAME, 0, BLADE_PIVOT_OFFSET );
+	std::remove( STRESS_TEXT_FILENAME );
+	std::remove( STRESS_BINARY_FILENAME );
+}
 
-		if( sType == "TYPE_ISLAND" )
-			Play::CreateGameObject( TYPE_ISLAND, { std::stof( sX ), std::stof( sY ) }, 0, sSprite.c_str() );
+//-------------------------------------------------------------------------
+// Writes every run's results as JSON, one run to a line
+static bool WriteStressResults( const std::string& fileAndPath )
+{
+	std::ofstream file( PlayWindow::GetPlatformPath( fileAndPath ), std::ios::trunc );
+	if( !file )
+		return false;
+
+	char buffer[768];
+	snprintf( buffer, sizeof( buffer ), "{\"warmupFrames\":%d,\"measuredFrames\":%d,\"runs\":[\n", STRESS_WARMUP_FRAMES, STRESS_MEASURED_FRAMES );
+	file << buffer;
 
-		if( sType == "TYPE_DOUGHNUT" )
-			Play::CreateGameObject( TYPE_DOUGHNUT, { std::stof( sX ), std::stof( sY ) }, 30, sSprite.c_str() );
+	for( size_t i = 0; i < stressBenchmark.vRuns.size(); i++ )
+	{
+		const StressRun& run = stressBenchmark.vRuns[i];
+		snprintf( buffer, sizeof( buffer ), "{\"objects\":%d,\"mode\":\"%s\",\"activeObjects\":%d,\"sectors\":%d,\"activeSectors\":%d,\"generateMs\":%.3f,\"loadMs\":%.3f,"
+			"\"processBytes\":%llu,\"processBytesAdded\":%lld,\"streamingMs\":%.4f,\"updateMs\":%.4f,\"collisionMs\":%.4f,\"drawMs\":%.4f,\"frameMs\":%.4f,\"maxFrameMs\":%.4f,"
+			"\"circleTests\":%u,\"sweepTests\":%u,\"spriteDraws\":%u",
+			run.objects, run.allActive ? "allActive" : "streamed", run.activeObjects, run.sectors, run.activeSectors, run.generateMs, run.loadMs,
+			static_cast<unsigned long long>( run.processBytes ), run.processBytesAdded, run.streamingMs, run.updateMs, run.collisionMs, run.drawMs, run.frameMs, run.maxFrameMs,
+			run.circleTests, run.sweepTests, run.spriteDraws );
+		file << buffer;
+
+#ifdef _DEBUG
+		// Only debug builds track their allocations
+		snprintf( buffer, sizeof( buffer ), ",\"heapBytesAdded\":%lld", run.heapBytesAdded );
+		file << buffer;
+#endif
+
+		file << ( i + 1 < stressBenchmark.vRuns.size() ? "},\n" : "}\n" );
+	}
 
-		if (sType == "TYPE_SPIKE")
-			Play::CreateGameObject(TYPE_SPIKE, { std::stof(sX), std::stof(sY) }, 30, sSprite.c_str());
+	file << "]}\n";
+	return static_cast<bool>( file );
+}
 
-		if (sType == "TYPE_WOLF")
-			Play::CreateGameObject(TYPE_WOLF, { std::stof(sX), std::stof(sY) }, 30, sSprite.c_str());
+//-------------------------------------------------------------------------
+// Plays a frame of the stress benchmark, which gives each run a frame to load its level before playing it without any input
+// > Returns true once every run has been measured and the results have been written
+bool UpdateStressBenchmark( void )
+{
+	StressBenchmark& bench = stressBenchmark;
 
-		if (sType == "TYPE_BUSH")
-			Play::CreateGameObject(TYPE_BUSH, { std::stof(sX), std::stof(sY) }, 30, sSprite.c_str());
+	if( bench.run < 0 || bench.frame == STRESS_WARMUP_FRAMES + STRESS_MEASURED_FRAMES )
+	{
+		if( bench.run >= 0 )
+			EndStressRun( bench.vRuns[bench.run] );
 
-		if (sType == "TYPE_BLADE")
+		if( ++bench.run == static_cast<int>( bench.vRuns.size() ) )
 		{
-			Play::CreateGameObject(TYPE_BLADE, { std::stof(sX), std::stof(sY) }, 5, sSprite.c_str());
-			Play::CreateGameObject(TYPE_NULL_BLADE, { std::stof(sX), std::stof(sY) + 270 }, 70, "");
+			if( !WriteStressResults( bench.resultsFile ) )
+				DebugOutput( "StressBenchmark: Couldn't write the results to " + bench.resultsFile + "\n" );
+			return true;
 		}
 
-		if (sType == "TYPE_FINAL")
-			Play::CreateGameObject(TYPE_FINAL, { std::stof(sX), std::stof(sY) }, 30, sSprite.c_str());
-			
-		
+		BeginStressRun( bench.vRuns[bench.run] );
+		bench.frame = 0;
+		Play::PresentDrawingBuffer();
+		return Play::KeyDown( VK_ESCAPE );
 	}
 
-	levelfile.close();
+	UpdateGame();
+	Play::PresentDrawingBuffer();
+	bench.frame++;
+	return Play::KeyDown( VK_ESCAPE );
+}
+#endif
+
+//-------------------------------------------------------------------------
+// Sets up the objects which have been created for the game, and starts it
+void StartLevel( void )
+{
+	CreatePlatforms();
+	CreateSpikes();
+	CreateHazards();
+	CreateBlades();
+	gameState.playState = STATE_START;
+
+	// Respawning restores the objects and their tables from here rather than loading the level again, so the platform and spike ids stay valid
+	Play::SaveGameObjectSnapshot();
+	levelStreamer.SaveSnapshot();
+	pristineGameState = gameState;
 }
 
 
@@ -872,4 +1266,99 @@ void RandomBaa( void )
 			case 3: Play::PlayAudio( "baa4" ); break;
 			case 4: Play::PlayAudio( "baa5" ); break;
 		}
-}
\ No newline at end of file
+}
+
+#ifdef BAAMAGEDDON_IN_EDITOR
+//-------------------------------------------------------------------------
+// What each of the editor's objects was before it became one of the game's
+struct EditorObject
+{
+	int id;
+	int editorType;
+	int editorRadius;
+};
+
+static std::vector< EditorObject > vEditorObjects;
+// Objects the game needs which the editor doesn't have (e.g. the blades' collision objects)
+static std::vector< int > vPlayOnlyIds;
+
+//-------------------------------------------------------------------------
+// Starts the game on the editor's objects, without loading anything
+void BeginPlayInEditor( const std::vector< std::string >& vTypeNames, std::function< const std::vector< LevelProperty >&( int id ) > getProperties )
+{
+	vEditorObjects.clear();
+	vPlayOnlyIds.clear();
+
+	// The editor's types are converted to the game's by the names they have in the level files
+	std::vector< int > vTypeIndices( vTypeNames.size(), -1 );
+	for( size_t editorType = 0; editorType < vTypeNames.size(); editorType++ )
+		vTypeIndices[editorType] = FindLevelObjectType( vTypeNames[editorType].c_str() );
+
+	for( int id : Play::CollectAllGameObjectIDs() )
+	{
+		GameObject& obj = Play::GetGameObject( id );
+		vEditorObjects.push_back( { id, obj.type, obj.radius } );
+
+		int typeIndex = ( obj.type >= 0 && obj.type < static_cast<int>( vTypeIndices.size() ) ) ? vTypeIndices[obj.type] : -1;
+		PLAY_ASSERT_MSG( typeIndex >= 0, "The editor has an object type which isn't in the game" );
+		const LevelObjectType* pType = &LEVEL_OBJECT_TYPES[typeIndex];
+
+		// Set up the same way as LevelStreamer::CreateObjects()
+		obj.type = LEVEL_GAME_TYPES[typeIndex];
+		obj.radius = pType->radius;
+
+		LevelPropertyValues properties = GetDefaultLevelProperties( pType->name, obj.spriteId );
+		for( const LevelProperty& property : getProperties( id ) )
+			SetLevelProperty( pType->name, property.name.c_str(), property.value, properties );
+
+		int linkedId = -1;
+		if( obj.type == TYPE_BLADE )
+		{
+			linkedId = Play::CreateGameObject( TYPE_NULL_BLADE, obj.pos + Point2f( 0, properties[BLADE_RADIUS] ), 70, "" );
+			vPlayOnlyIds.push_back( linkedId );
+		}
+
+		levelStreamer.AddObject( id, properties, linkedId );
+	}
+
+	gameState = GameState();
+	gameState.cameraTarget = Play::GetGameObjectByType( TYPE_SHEEP ).pos;
+	Play::SetCameraPosition( gameState.cameraTarget - Point2f( DISPLAY_WIDTH / 2.0f, DISPLAY_HEIGHT / 2.0f ) );
+	Play::StartAudioLoop( "soundscape" );
+	StartLevel();
+}
+
+//-------------------------------------------------------------------------
+// The same as MainGameUpdate() once the level has loaded (the editor presents the drawing buffer)
+void UpdatePlayInEditor( void )
+{
+	Point2f cameraDiff = gameState.cameraTarget - Point2f( DISPLAY_WIDTH / 2.0f, DISPLAY_HEIGHT / 2.0f ) - Play::GetCameraPosition();
+	Play::SetCameraPosition( Play::GetCameraPosition() + cameraDiff / 8.0f );
+
+	Play::BeginTimingBar( Play::cBlue, "Streaming" );
+	UpdateGame();
+}
+
+//-------------------------------------------------------------------------
+// The snapshot StartLevel() took is from just after the editor's objects were converted, so it only needs undoing
+void EndPlayInEditor( void )
+{
+	Play::StopAudioLoop( "soundscape" );
+	Play::RestoreGameObjectSnapshot();
+
+	for( int id : vPlayOnlyIds )
+		Play::DestroyGameObject( id );
+
+	for( const EditorObject& editorObj : vEditorObjects )
+	{
+		GameObject& obj = Play::GetGameObject( editorObj.id );
+		obj.type = editorObj.editorType;
+		obj.radius = editorObj.editorRadius;
+	}
+
+	Play::MoveMatchingSpriteOrigins( BLADE_SPRITE_NAME, 0, BLADE_PIVOT_OFFSET );
+	levelStreamer.Close();
+	vEditorObjects.clear();
+	vPlayOnlyIds.clear();
+}
+#endif
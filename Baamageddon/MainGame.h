@@ -13,7 +13,8 @@ enum PlayState
 	STATE_APPEAR,
 	STATE_PLAY,
 	STATE_DEAD,
-	STATE_WAIT
+	STATE_WAIT,
+	STATE_LOADING
 };
 
 //-------------------------------------------------------------------------
@@ -69,11 +70,38 @@ struct Spike
 
 //-------------------------------------------------------------------------
 
+struct Wolf
+{
+	int wolf_id;
+	float alertRange;
+	float pounceRange;
+};
+
+//-------------------------------------------------------------------------
+
+struct Blade
+{
+	int blade_id;
+	int null_id; // The collision object at the end of the blade
+	float radius;
+	float swingSpeed;
+};
+
+//-------------------------------------------------------------------------
+
+struct Bush
+{
+	int bush_id;
+	float launchSpeed;
+	float boostedLaunchSpeed;
+};
+
+//-------------------------------------------------------------------------
+
 struct GameState
 {
 	int doughnutsLeft;
-	float null = 0;
-	const int jumpTimeMax = 30;
+	static constexpr int jumpTimeMax = 30;
 	int score = 0;
 	int jumpTime = jumpTimeMax;
 	bool isJumping = false;
@@ -83,17 +111,26 @@ struct GameState
 	SheepDirection sheepDirection = DIRECTION_RIGHT;
 	std::vector< Platform > vPlatforms;
 	std::vector< Spike > vSpikes;
+	std::vector< Wolf > vWolves;
+	std::vector< Blade > vBlades;
+	std::vector< Bush > vBushes;
 	Point2f cameraTarget{ 0.0f, 0.0f };
 }; 
 
 //-------------------------------------------------------------------------
 
+void UpdateGame();
+
+void StartLevel();
+
 void CreatePlatforms();
 
 void CreateSpikes();
 
 void CreateBlades();
 
+void CreateHazards();
+
 void DrawScene();
 
 void UpdateWolves();
@@ -126,4 +163,12 @@ void RandomBaa();
 
 void LoadLevel();
 
+void UpdateLoading();
+
+void FinishLoadingLevel();
+
+void BeginStressBenchmark( int objects );
+
+bool UpdateStressBenchmark();
+
 //-------------------------------------------------------------------------
@@ -0,0 +1,18 @@
+#pragma once
+///////////////////////////////////////////////////////////////////////////
+//	File		: PlayInEditor.h
+//  Runs the game inside the level editor, on the objects and sprites the
+//  editor already has loaded (MainGame.cpp is compiled into the editor
+//  with BAAMAGEDDON_IN_EDITOR defined).
+//  > Kept apart from MainGame.h, as the editor has its own object types
+//  (EditorObjectType), which only meet the game's through the level files' names.
+///////////////////////////////////////////////////////////////////////////
+
+// Starts the game on the objects which already exist, instead of loading the level
+// > The type names are the level files' name for each of the editor's types (indexed by the type), which are swapped for the game's own
+// > The objects' properties are the ones they'd have in the level files (the defaults are filled in from the game's templates)
+void BeginPlayInEditor( const std::vector< std::string >& vTypeNames, std::function< const std::vector< LevelProperty >&( int id ) > getProperties );
+// Updates and draws one frame of the game
+void UpdatePlayInEditor();
+// Puts every object back exactly as it was when play began, including its type
+void EndPlayInEditor();
@@ -0,0 +1,521 @@
+///////////////////////////////////////////////////////////////////////////
+//	File		: LevelJournal.cpp
+//  Saves the level editor's changes as small records appended to a
+//  journal, and compacts them into the level files on a background
+//  thread, so saving never holds up the editor.
+///////////////////////////////////////////////////////////////////////////
+
+#include "Play.h"
+#include "Baamageddon/LevelFile.h"
+#include "LevelJournal.h"
+
+// The journal starts with this, followed by the version
+constexpr char JOURNAL_MAGIC[4] = { 'B','J','N','L' };
+constexpr uint32_t JOURNAL_VERSION = 1;
+constexpr size_t JOURNAL_HEADER_SIZE = sizeof( JOURNAL_MAGIC ) + sizeof( uint32_t );
+
+//-------------------------------------------------------------------------
+
+LevelJournal::LevelJournal( const char* textFile, const char* binaryFile, const char* journalFile, std::vector< std::string > vTypeNames )
+	: m_textFile( textFile ), m_binaryFile( binaryFile ), m_journalFile( journalFile ), m_vTypeNames( std::move( vTypeNames ) ), m_vPropertySets( 1 )
+{
+}
+
+//-------------------------------------------------------------------------
+
+bool LevelJournal::Load( std::vector< LevelEntry >& vEntries )
+{
+	vEntries.clear();
+
+	LevelFile level;
+	bool levelFound = OpenLevel( level, m_textFile.c_str(), m_binaryFile.c_str() );
+
+	if( levelFound )
+	{
+		for( int b = 0; b < level.GetBlockCount(); b++ )
+		{
+			const LevelRecord* pRecords = level.GetBlockRecords( b );
+			const LevelPropertyRecord* pProperty = level.GetBlockProperties( b );
+			const LevelPropertyRecord* pPropertyEnd = pProperty + level.GetBlockPropertyCount( b );
+
+			for( int i = 0; i < level.GetBlockRecordCount( b ); i++ )
+			{
+				LevelEntry entry{ level.GetBlockTypeName( b ), { pRecords[i].x, pRecords[i].y }, level.GetString( pRecords[i].sprite ), {} };
+				for( ; pProperty != pPropertyEnd && pProperty->record == static_cast<uint32_t>( i ); pProperty++ )
+					entry.vProperties.push_back( { level.GetString( pProperty->name ), pProperty->value } );
+
+				vEntries.push_back( std::move( entry ) );
+			}
+		}
+
+		m_sequence = m_compactedSequence = level.GetJournalSequence();
+	}
+
+	std::ifstream journal( m_journalFile, std::ios::binary );
+	std::vector< uint8_t > vData( ( std::istreambuf_iterator< char >( journal ) ), std::istreambuf_iterator< char >() );
+	journal.close();
+
+	size_t offset = JOURNAL_HEADER_SIZE;
+	bool journalFound = vData.size() >= JOURNAL_HEADER_SIZE && memcmp( vData.data(), JOURNAL_MAGIC, sizeof( JOURNAL_MAGIC ) ) == 0;
+	journalFound = journalFound && *reinterpret_cast<const uint32_t*>( vData.data() + sizeof( JOURNAL_MAGIC ) ) == JOURNAL_VERSION;
+
+	// Records are matched to the objects by value, as the object ids are different every time the level is loaded
+	// > Objects which are identical in every way are interchangeable, so it doesn't matter which one is found
+	using Key = std::tuple< std::string, float, float, std::string >;
+	std::map< Key, std::vector< size_t > > entryIndex;
+	std::vector< std::string > vJournalSprites;
+	std::vector< bool > vDestroyed( vEntries.size(), false );
+	bool indexed = false;
+
+	while( journalFound && offset + sizeof( Record ) <= vData.size() )
+	{
+		Record record;
+		memcpy( &record, vData.data() + offset, sizeof( Record ) );
+
+		// Stop at the first record which wasn't completely written, e.g. because the editor crashed
+		size_t recordSize = sizeof( Record ) + ( record.recordType == RECORD_SPRITE_NAME ? record.nameLength : 0 );
+		if( offset + recordSize > vData.size() )
+			break;
+
+		uint32_t checksum = Checksum( vData.data() + offset, offsetof( Record, checksum ), vData.data() + offset + sizeof( Record ), recordSize - sizeof( Record ) );
+		if( checksum != record.checksum )
+			break;
+
+		offset += recordSize;
+
+		if( record.recordType == RECORD_SPRITE_NAME )
+		{
+			if( vJournalSprites.size() <= record.sprite )
+				vJournalSprites.resize( record.sprite + 1 );
+
+			vJournalSprites[record.sprite].assign( reinterpret_cast<const char*>( vData.data() + offset - record.nameLength ), record.nameLength );
+			continue;
+		}
+
+		// Records which are already in the level files are skipped (but the sprite names are still needed)
+		if( record.sequence <= m_compactedSequence || record.type >= m_vTypeNames.size() || record.sprite >= vJournalSprites.size() || record.newSprite >= vJournalSprites.size() )
+			continue;
+
+		m_sequence = std::max( m_sequence, record.sequence );
+
+		if( !indexed )
+		{
+			for( size_t i = 0; i < vEntries.size(); i++ )
+				entryIndex[{ vEntries[i].type, vEntries[i].pos.null, vEntries[i].pos.y, vEntries[i].sprite }].push_back( i );
+			indexed = true;
+		}
+
+		const std::string& typeName = m_vTypeNames[record.type];
+
+		if( record.recordType == RECORD_CREATE )
+		{
+			entryIndex[{ typeName, record.x, record.y, vJournalSprites[record.sprite] }].push_back( vEntries.size() );
+			vEntries.push_back( { typeName, { record.x, record.y }, vJournalSprites[record.sprite], {} } );
+			vDestroyed.push_back( false );
+			continue;
+		}
+
+		auto it = entryIndex.find( { typeName, record.x, record.y, vJournalSprites[record.sprite] } );
+		if( it == entryIndex.end() || it->second.empty() )
+			continue;
+
+		size_t index = it->second.back();
+		it->second.pop_back();
+
+		if( record.recordType == RECORD_DESTROY )
+		{
+			vDestroyed[index] = true;
+			continue;
+		}
+
+		LevelEntry& entry = vEntries[index];
+		entry.pos = { record.newX, record.newY };
+		entry.sprite = vJournalSprites[record.newSprite];
+		entryIndex[{ entry.type, entry.pos.null, entry.pos.y, entry.sprite }].push_back( index );
+	}
+
+	if( indexed )
+	{
+		size_t kept = 0;
+		for( size_t i = 0; i < vEntries.size(); i++ )
+		{
+			if( vDestroyed[i] )
+				continue;
+
+			if( kept != i )
+				vEntries[kept] = std::move( vEntries[i] );
+
+			kept++;
+		}
+		vEntries.resize( kept );
+	}
+
+	// Anything after the last complete record is cut off, so new records aren't appended after it
+	std::error_code error;
+	if( !journalFound )
+	{
+		std::ofstream newJournal( m_journalFile, std::ios::binary | std::ios::trunc );
+		newJournal.write( JOURNAL_MAGIC, sizeof( JOURNAL_MAGIC ) );
+		newJournal.write( reinterpret_cast<const char*>( &JOURNAL_VERSION ), sizeof( JOURNAL_VERSION ) );
+	}
+	else if( offset < vData.size() )
+	{
+		std::filesystem::resize_file( m_journalFile, offset, error );
+	}
+
+	return levelFound || !vEntries.empty();
+}
+
+//-------------------------------------------------------------------------
+
+void LevelJournal::Close()
+{
+	if( m_closed )
+		return;
+
+	if( m_saveTask.valid() )
+		m_saveTask.get();
+
+	if( !m_vPendingRecords.empty() )
+		WriteRecords( m_vPendingRecords );
+
+	m_vPendingRecords.clear();
+	m_closed = true;
+}
+
+//-------------------------------------------------------------------------
+
+void LevelJournal::Track( int id, int type, Point2f pos, int spriteId, const std::vector< LevelProperty >* pProperties )
+{
+	Entry& entry = GetWritableEntry( id );
+	entry.type = static_cast<int16_t>( type );
+	entry.sprite = UseSprite( spriteId );
+	entry.x = pos.null;
+	entry.y = pos.y;
+	entry.properties = 0;
+
+	if( pProperties && !pProperties->empty() )
+	{
+		entry.properties = static_cast<uint32_t>( m_vPropertySets.size() );
+		m_vPropertySets.push_back( *pProperties );
+	}
+}
+
+//-------------------------------------------------------------------------
+
+void LevelJournal::Create( int id, int type, Point2f pos, int spriteId )
+{
+	Track( id, type, pos, spriteId );
+	AddRecord( RECORD_CREATE, GetEntry( id ), GetEntry( id ) );
+}
+
+//-------------------------------------------------------------------------
+
+void LevelJournal::Move( int id, Point2f pos )
+{
+	Entry before = GetEntry( id );
+	if( before.type < 0 )
+		return;
+
+	Entry& entry = GetWritableEntry( id );
+	entry.x = pos.null;
+	entry.y = pos.y;
+
+	// Dragging an object moves it every frame, so a move straight after another move of the same object just updates it
+	if( m_lastMoveOffset != SIZE_MAX )
+	{
+		Record record;
+		memcpy( &record, m_vPendingRecords.data() + m_lastMoveOffset, sizeof( Record ) );
+
+		if( record.type == before.type && record.newSprite == before.sprite && record.newX == before.x && record.newY == before.y )
+		{
+			record.newX = pos.null;
+			record.newY = pos.y;
+			record.checksum = Checksum( reinterpret_cast<const uint8_t*>( &record ), offsetof( Record, checksum ), nullptr, 0 );
+			memcpy( m_vPendingRecords.data() + m_lastMoveOffset, &record, sizeof( Record ) );
+			return;
+		}
+	}
+
+	AddRecord( RECORD_MOVE, before, entry );
+	m_lastMoveOffset = m_vPendingRecords.size() - sizeof( Record );
+}
+
+//-------------------------------------------------------------------------
+
+void LevelJournal::SetSprite( int id, int spriteId )
+{
+	Entry before = GetEntry( id );
+	if( before.type < 0 )
+		return;
+
+	Entry& entry = GetWritableEntry( id );
+	entry.sprite = UseSprite( spriteId );
+	AddRecord( RECORD_SPRITE, before, entry );
+}
+
+//-------------------------------------------------------------------------
+
+void LevelJournal::Destroy( int id )
+{
+	Entry before = GetEntry( id );
+	if( before.type < 0 )
+		return;
+
+	GetWritableEntry( id ).type = -1;
+	AddRecord( RECORD_DESTROY, before, before );
+}
+
+//-------------------------------------------------------------------------
+
+const std::vector< LevelProperty >& LevelJournal::GetProperties( int id ) const
+{
+	return m_vPropertySets[GetEntry( id ).properties];
+}
+
+//-------------------------------------------------------------------------
+
+void LevelJournal::Update( float elapsedTime )
+{
+	m_timeSinceWrite += elapsedTime;
+
+	if( m_saveTask.valid() )
+	{
+		if( m_saveTask.wait_for( std::chrono::seconds( 0 ) ) != std::future_status::ready )
+			return;
+
+		m_saveFailed = !m_saveTask.get();
+
+		// The level files only include the snapshot's records once they've been written and the journal emptied
+		if( !m_saveFailed && m_compacting )
+			m_compactedSequence = m_compactingSequence;
+
+		m_compacting = false;
+	}
+
+	// A compaction which failed is retried at the autosave interval rather than every frame
+	bool compactDue = m_sequence - m_compactedSequence >= JOURNAL_COMPACT_RECORDS && ( !m_saveFailed || m_timeSinceWrite >= JOURNAL_AUTOSAVE_INTERVAL );
+
+	if( m_saveRequested || compactDue )
+		StartSave( true );
+	else if( !m_vPendingRecords.empty() && m_timeSinceWrite >= JOURNAL_AUTOSAVE_INTERVAL )
+		StartSave( false );
+}
+
+//-------------------------------------------------------------------------
+
+void LevelJournal::Save()
+{
+	// A save which is already running may have started before the latest changes, so another one follows it
+	if( m_saveTask.valid() )
+		m_saveRequested = true;
+	else
+		StartSave( true );
+}
+
+//-------------------------------------------------------------------------
+
+LevelJournal::Entry& LevelJournal::GetWritableEntry( int id )
+{
+	PLAY_ASSERT_MSG( id >= 0, "Invalid object id for the level journal" );
+
+	size_t chunk = static_cast<size_t>( id ) / JOURNAL_CHUNK_SIZE;
+	if( chunk >= m_vChunks.size() )
+		m_vChunks.resize( chunk + 1 );
+
+	std::shared_ptr< Chunk >& pChunk = m_vChunks[chunk];
+	if( !pChunk )
+		pChunk = std::make_shared< Chunk >( JOURNAL_CHUNK_SIZE );
+	else if( pChunk.use_count() > 1 ) // Still shared with a snapshot which is being saved
+		pChunk = std::make_shared< Chunk >( *pChunk );
+
+	return ( *pChunk )[id % JOURNAL_CHUNK_SIZE];
+}
+
+//-------------------------------------------------------------------------
+
+const LevelJournal::Entry& LevelJournal::GetEntry( int id ) const
+{
+	static const Entry noEntry;
+
+	size_t chunk = static_cast<size_t>( id ) / JOURNAL_CHUNK_SIZE;
+	if( id < 0 || chunk >= m_vChunks.size() || !m_vChunks[chunk] )
+		return noEntry;
+
+	return ( *m_vChunks[chunk] )[id % JOURNAL_CHUNK_SIZE];
+}
+
+//-------------------------------------------------------------------------
+// Gets the document's number for a sprite, giving it one (and remembering its name) the first time it's used
+uint16_t LevelJournal::UseSprite( int spriteId )
+{
+	auto it = m_spriteNumbers.find( spriteId );
+	if( it != m_spriteNumbers.end() )
+		return it->second;
+
+	uint16_t number = static_cast<uint16_t>( m_vSpriteNames.size() );
+	m_vSpriteNames.push_back( spriteId < 0 ? "" : Play::GetSpriteName( spriteId ) );
+	m_spriteNumbers[spriteId] = number;
+	return number;
+}
+
+//-------------------------------------------------------------------------
+
+void LevelJournal::AddRecord( RecordType recordType, const Entry& before, const Entry& after )
+{
+	// The journal names each sprite before the first record which uses it
+	for( uint16_t sprite : { before.sprite, after.sprite } )
+	{
+		if( m_vNamedSprites.size() <= sprite )
+			m_vNamedSprites.resize( sprite + 1, false );
+
+		if( m_vNamedSprites[sprite] )
+			continue;
+
+		const std::string& name = m_vSpriteNames[sprite];
+		Record nameRecord{};
+		nameRecord.sequence = m_sequence;
+		nameRecord.recordType = RECORD_SPRITE_NAME;
+		nameRecord.sprite = sprite;
+		nameRecord.nameLength = static_cast<uint16_t>( name.size() );
+		nameRecord.checksum = Checksum( reinterpret_cast<const uint8_t*>( &nameRecord ), offsetof( Record, checksum ), reinterpret_cast<const uint8_t*>( name.data() ), name.size() );
+
+		const uint8_t* pBytes = reinterpret_cast<const uint8_t*>( &nameRecord );
+		m_vPendingRecords.insert( m_vPendingRecords.end(), pBytes, pBytes + sizeof( Record ) );
+		m_vPendingRecords.insert( m_vPendingRecords.end(), name.begin(), name.end() );
+		m_vNamedSprites[sprite] = true;
+	}
+
+	Record record{};
+	record.sequence = ++m_sequence;
+	record.recordType = recordType;
+	record.type = static_cast<uint8_t>( before.type );
+	record.sprite = before.sprite;
+	record.x = before.x;
+	record.y = before.y;
+	record.newSprite = after.sprite;
+	record.newX = after.x;
+	record.newY = after.y;
+	record.checksum = Checksum( reinterpret_cast<const uint8_t*>( &record ), offsetof( Record, checksum ), nullptr, 0 );
+
+	const uint8_t* pBytes = reinterpret_cast<const uint8_t*>( &record );
+	m_vPendingRecords.insert( m_vPendingRecords.end(), pBytes, pBytes + sizeof( Record ) );
+	m_lastMoveOffset = SIZE_MAX;
+}
+
+//-------------------------------------------------------------------------
+
+void LevelJournal::StartSave( bool compact )
+{
+	PLAY_ASSERT_MSG( !m_saveTask.valid(), "The level journal is already saving" );
+
+	std::vector< uint8_t > vRecords;
+	vRecords.swap( m_vPendingRecords );
+	m_lastMoveOffset = SIZE_MAX;
+	m_timeSinceWrite = 0.0f;
+
+	if( !compact )
+	{
+		m_saveTask = std::async( std::launch::async, [this, vRecords = std::move( vRecords )]() { return WriteRecords( vRecords ); } );
+		return;
+	}
+
+	// Only the chunk pointers are copied, and the editor copies any chunk it changes while the snapshot is being saved
+	Snapshot snapshot;
+	snapshot.vChunks.assign( m_vChunks.begin(), m_vChunks.end() );
+	snapshot.vSpriteNames = m_vSpriteNames;
+	snapshot.vPropertySets = m_vPropertySets;
+	snapshot.sequence = m_sequence;
+
+	// The journal is emptied once it's compacted, so the records after this need to name their sprites again
+	m_vNamedSprites.assign( m_vNamedSprites.size(), false );
+	m_compacting = true;
+	m_compactingSequence = m_sequence;
+	m_saveRequested = false;
+
+	m_saveTask = std::async( std::launch::async, [this, vRecords = std::move( vRecords ), snapshot = std::move( snapshot )]()
+	{
+		// The records go into the journal first, so they aren't lost if compacting fails
+		return WriteRecords( vRecords ) && Compact( snapshot );
+	} );
+}
+
+//-------------------------------------------------------------------------
+// Appends records to the journal file (on the background thread)
+bool LevelJournal::WriteRecords( const std::vector< uint8_t >& vRecords ) const
+{
+	if( vRecords.empty() )
+		return true;
+
+	std::error_code error;
+	bool newJournal = std::filesystem::file_size( m_journalFile, error ) < JOURNAL_HEADER_SIZE || error;
+
+	std::ofstream journal( m_journalFile, std::ios::binary | ( newJournal ? std::ios::trunc : std::ios::app ) );
+	if( !journal )
+		return false;
+
+	if( newJournal )
+	{
+		journal.write( JOURNAL_MAGIC, sizeof( JOURNAL_MAGIC ) );
+		journal.write( reinterpret_cast<const char*>( &JOURNAL_VERSION ), sizeof( JOURNAL_VERSION ) );
+	}
+
+	journal.write( reinterpret_cast<const char*>( vRecords.data() ), vRecords.size() );
+	journal.flush();
+	return static_cast<bool>( journal );
+}
+
+//-------------------------------------------------------------------------
+// Writes the level files from a snapshot and empties the journal (on the background thread)
+bool LevelJournal::Compact( const Snapshot& snapshot ) const
+{
+	// Objects are written in order of their ids, like they've always been
+	std::vector< LevelEntry > vEntries;
+	for( const std::shared_ptr< const Chunk >& pChunk : snapshot.vChunks )
+	{
+		if( !pChunk )
+			continue;
+
+		for( const Entry& entry : *pChunk )
+		{
+			if( entry.type >= 0 && static_cast<size_t>( entry.type ) < m_vTypeNames.size() )
+				vEntries.push_back( { m_vTypeNames[entry.type], { entry.x, entry.y }, snapshot.vSpriteNames[entry.sprite], snapshot.vPropertySets[entry.properties] } );
+		}
+	}
+
+	// Each file is replaced in one go, and both say which records they include, so a crash part way through loses nothing
+	if( !WriteTextLevel( m_textFile.c_str(), vEntries, snapshot.sequence ) )
+		return false;
+
+	if( !WriteBinaryLevel( m_binaryFile.c_str(), vEntries, LEVEL_SECTOR_SIZE, snapshot.sequence ) )
+		return false;
+
+	std::string tempFile = m_journalFile + ".tmp";
+	{
+		std::ofstream journal( tempFile, std::ios::binary | std::ios::trunc );
+		journal.write( JOURNAL_MAGIC, sizeof( JOURNAL_MAGIC ) );
+		journal.write( reinterpret_cast<const char*>( &JOURNAL_VERSION ), sizeof( JOURNAL_VERSION ) );
+
+		if( !journal )
+			return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename( tempFile, m_journalFile, error );
+	return !error;
+}
+
+//-------------------------------------------------------------------------
+// A 32-bit FNV-1a hash of the record followed by any data after it
+uint32_t LevelJournal::Checksum( const uint8_t* pRecord, size_t recordSize, const uint8_t* pExtra, size_t extraSize )
+{
+	uint32_t hash = 2166136261u;
+
+	for( size_t i = 0; i < recordSize; i++ )
+		hash = ( hash ^ pRecord[i] ) * 16777619u;
+
+	for( size_t i = 0; i < extraSize; i++ )
+		hash = ( hash ^ pExtra[i] ) * 16777619u;
+
+	return hash;
+}
@@ -0,0 +1,139 @@
+#pragma once
+///////////////////////////////////////////////////////////////////////////
+//	File		: LevelJournal.h
+//  Saves the level editor's changes as small records appended to a
+//  journal, and compacts them into the level files on a background
+//  thread, so saving never holds up the editor.
+///////////////////////////////////////////////////////////////////////////
+
+// How often (in seconds) the journal records are written out
+constexpr float JOURNAL_AUTOSAVE_INTERVAL = 3.0f;
+// How many records the journal can build up before it's compacted into the level files automatically
+constexpr uint32_t JOURNAL_COMPACT_RECORDS = 4096;
+// The number of objects in each copy-on-write chunk of the document
+constexpr int JOURNAL_CHUNK_SIZE = 1024;
+
+//-------------------------------------------------------------------------
+
+class LevelJournal
+{
+public:
+	// The type names are indexed by the editor's object types, and are what's written to the level files
+	LevelJournal( const char* textFile, const char* binaryFile, const char* journalFile, std::vector< std::string > vTypeNames );
+	// Waits for any background save and writes out the last records
+	~LevelJournal() { Close(); }
+	LevelJournal( const LevelJournal& ) = delete;
+	LevelJournal& operator=( const LevelJournal& ) = delete;
+
+	// Reads the level files and applies the journal records which haven't been compacted into them yet
+	// > Returns false if there isn't a level, or it couldn't be read
+	bool Load( std::vector< LevelEntry >& vEntries );
+	// Waits for any background save and writes out the last records (the journal can't be used afterwards)
+	void Close();
+
+	// Adds an object which was loaded from the level, without recording it (as it's already in the files)
+	// > Its properties can't be edited, so they're only kept to be written back out when the journal is compacted
+	void Track( int id, int type, Point2f pos, int spriteId, const std::vector< LevelProperty >* pProperties = nullptr );
+	// Records a new object
+	void Create( int id, int type, Point2f pos, int spriteId );
+	// Records an object being moved
+	void Move( int id, Point2f pos );
+	// Records an object's sprite being changed
+	void SetSprite( int id, int spriteId );
+	// Records an object being destroyed
+	void Destroy( int id );
+	// Gets the properties an object was loaded with
+	const std::vector< LevelProperty >& GetProperties( int id ) const;
+
+	// Writes out the new records every few seconds, and compacts the journal if it has grown too large
+	// > Call once per frame
+	void Update( float elapsedTime );
+	// Compacts the journal into the level files on a background thread
+	// > Changes made while it's running are journalled as normal
+	void Save();
+	// Returns true while a background save is running
+	bool IsSaving() const { return m_saveTask.valid(); }
+	// Returns true if the last background save couldn't write the files
+	bool HasSaveFailed() const { return m_saveFailed; }
+
+private:
+	enum RecordType : uint8_t
+	{
+		RECORD_CREATE = 0,
+		RECORD_MOVE,
+		RECORD_SPRITE,
+		RECORD_DESTROY,
+		RECORD_SPRITE_NAME, // Names a sprite index used by the records which follow (and is followed by the name)
+	};
+
+	// Each edit is identified by the object's previous value, so the records can be applied to the level without any object ids
+	struct Record
+	{
+		uint32_t sequence;
+		uint8_t recordType;
+		uint8_t type;
+		uint16_t sprite;
+		float x;
+		float y;
+		uint16_t newSprite;
+		uint16_t nameLength;
+		float newX;
+		float newY;
+		uint32_t checksum; // Covers the rest of the record and the name after it, so a torn write is ignored
+	};
+
+	// An object in the document (a type of -1 is a free slot)
+	struct Entry
+	{
+		int16_t type{ -1 };
+		uint16_t sprite{ 0 };
+		float x{ 0.0f };
+		float y{ 0.0f };
+		uint32_t properties{ 0 }; // Index into the property sets (the first of which is empty)
+	};
+
+	using Chunk = std::vector< Entry >;
+
+	// The document at the moment a save started, which the editor carries on changing without affecting it
+	struct Snapshot
+	{
+		std::vector< std::shared_ptr< const Chunk > > vChunks;
+		std::vector< std::string > vSpriteNames;
+		std::vector< std::vector< LevelProperty > > vPropertySets;
+		uint32_t sequence{ 0 };
+	};
+
+	Entry& GetWritableEntry( int id );
+	const Entry& GetEntry( int id ) const;
+	uint16_t UseSprite( int spriteId );
+	void AddRecord( RecordType recordType, const Entry& before, const Entry& after );
+	void StartSave( bool compact );
+	bool WriteRecords( const std::vector< uint8_t >& vRecords ) const;
+	bool Compact( const Snapshot& snapshot ) const;
+	static uint32_t Checksum( const uint8_t* pRecord, size_t recordSize, const uint8_t* pExtra, size_t extraSize );
+
+	std::string m_textFile;
+	std::string m_binaryFile;
+	std::string m_journalFile;
+	std::vector< std::string > m_vTypeNames;
+
+	// The document: the objects indexed by id, in chunks which are shared with a snapshot until they're changed
+	std::vector< std::shared_ptr< Chunk > > m_vChunks;
+	std::vector< std::string > m_vSpriteNames; // Indexed by the document's sprite numbers
+	std::map< int, uint16_t > m_spriteNumbers; // The document's number for each sprite id
+	std::vector< std::vector< LevelProperty > > m_vPropertySets; // Only objects with properties have a set of their own
+
+	std::vector< uint8_t > m_vPendingRecords; // Records which haven't been written to the journal yet
+	std::vector< bool > m_vNamedSprites; // The sprites which have been named in the current journal
+	size_t m_lastMoveOffset{ SIZE_MAX }; // Where the last record is in the pending records, if it's a move (so a drag is one record)
+	uint32_t m_sequence{ 0 };
+	uint32_t m_compactedSequence{ 0 }; // The sequence of the last record in the level files
+	uint32_t m_compactingSequence{ 0 }; // The sequence of the snapshot being written to the level files by the running save
+	bool m_compacting{ false }; // Whether the running save is compacting
+	float m_timeSinceWrite{ 0.0f };
+	bool m_saveRequested{ false };
+	bool m_saveFailed{ false };
+	bool m_closed{ false };
+
+	std::future< bool > m_saveTask;
+};
@@ -11,6 +11,11 @@
 #define PLAY_IMPLEMENTATION
 #define PLAY_USING_GAMEOBJECT_MANAGER
 #include "Play.h"
+#include "Baamageddon/LevelFile.h"
+#include "Baamageddon/PlayInEditor.h"
+#include "SpatialIndex.h"
+#include "OverviewCache.h"
+#include "LevelJournal.h"
 
 constexpr int DISPLAY_WIDTH = 1280;
 constexpr int DISPLAY_HEIGHT = 720;
@@ -41,7 +46,9 @@ constexpr const char* FINAL_SPRITE_NAME = "spr_invisible_marker";
 
 constexpr int FLOOR_BOUND = DISPLAY_HEIGHT * 2;
 
-enum GameObjectType
+// The editor's own object types, which are named differently to the game's (MainGame.cpp is compiled into the editor too)
+// > BeginPlayInEditor() swaps them for the game's by the names they have in the level files, and EndPlayInEditor() swaps them back
+enum EditorObjectType
 {
 	TYPE_NOONE = -1,
 	TYPE_SHEEP,
@@ -67,24 +74,69 @@ const char* SPRITE_NAMES[TOTAL_TYPES][4] =
 	{ FINAL_SPRITE_NAME, FINAL_SPRITE_NAME, FINAL_SPRITE_NAME, FINAL_SPRITE_NAME,}
 };
 
+constexpr const char* LEVEL_TEXT_FILENAME = "Level.lev";
+constexpr const char* LEVEL_BINARY_FILENAME = "Level.blev";
+constexpr const char* LEVEL_JOURNAL_FILENAME = "Level.journal";
+
+// The editor's type for each of LEVEL_OBJECT_TYPES
+const EditorObjectType LEVEL_EDITOR_TYPES[LEVEL_OBJECT_TYPE_COUNT] =
+{
+	TYPE_SHEEP,
+	TYPE_ISLAND,
+	TYPE_DOUGHNUT,
+	TYPE_SPIKE,
+	TYPE_WOLF,
+	TYPE_BUSH,
+	TYPE_BLADE,
+	TYPE_FINAL,
+};
+
+static_assert( LEVEL_OBJECT_TYPE_COUNT == TOTAL_TYPES, "Every level object type needs an editor type" );
+
 struct EditorState
 {
 	int score = 0;
-	GameObjectType editMode = TYPE_SHEEP;
+	EditorObjectType editMode = TYPE_SHEEP;
 	Point2f cameraTarget{ 0.0f, 0.0f };
+	int zoomLevel = OVERVIEW_ZOOM_LEVELS - 1; // Counted in whole steps so the zoom never drifts away from the overview cache's levels
 	float zoom = 1.0f;
 	int selectedObj = -1;
 	Point2f selectedOffset{ 0.0f, 0.0f };
 	int saveCooldown = 0;
+	bool boxSelecting = false;
+	Point2f boxStart{ 0.0f, 0.0f };
+	Point2f boxEnd{ 0.0f, 0.0f };
+	bool playing = false;
 };
 
 EditorState editorState;
 
+// The level files' name for each object type, indexed by type
+const std::vector< std::string > LEVEL_TYPE_NAMES = []()
+{
+	std::vector< std::string > vTypeNames( TOTAL_TYPES );
+	for( int t = 0; t < LEVEL_OBJECT_TYPE_COUNT; t++ )
+		vTypeNames[LEVEL_EDITOR_TYPES[t]] = LEVEL_OBJECT_TYPES[t].name;
+	return vTypeNames;
+}();
+
+// Objects are always created, moved and destroyed through the functions below so these stay up to date
+SpatialIndex spatialIndex;
+// The objects are drawn in this order (later types on top) from the overview's tiles
+OverviewCache overviewCache( spatialIndex, { TYPE_ISLAND, TYPE_DOUGHNUT, TYPE_SHEEP, TYPE_SPIKE, TYPE_WOLF, TYPE_BUSH, TYPE_BLADE, TYPE_FINAL } );
+// Every change is journalled as it's made, and the journal is compacted into the level files in the background
+LevelJournal levelJournal( LEVEL_TEXT_FILENAME, LEVEL_BINARY_FILENAME, LEVEL_JOURNAL_FILENAME, LEVEL_TYPE_NAMES );
+
 void HandleControls();
-void DrawScene();
+void DrawEditorScene();
 void DrawUserInterface();
-bool PointInsideSpriteBounds( Point2f testPos, GameObject& obj );
-void DrawObjectsOfType( GameObjectType type );
+void TogglePlayInEditor();
+int CreateEditorObject( EditorObjectType type, Point2f pos, int radius, int spriteId );
+void MoveEditorObject( GameObject& obj, Point2f pos );
+void SetEditorObjectSprite( GameObject& obj, int spriteId );
+void DestroyEditorObject( int id );
+void IndexEditorObject( GameObject& obj );
+void InvalidateEditorObject( GameObject& obj );
 void SaveLevel();
 void LoadLevel();
 
@@ -93,6 +145,8 @@ void LoadLevel();
 void MainGameEntry( PLAY_IGNORE_COMMAND_LINE )
 {
 	Play::CreateManager( DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_SCALE );
+	Play::MakeSpriteMutable( "64px" );
+	Play::EnableCompactSprites( true );
 	Play::CentreAllSpriteOrigins();
 	Play::LoadBackground( "Data\\Backgrounds\\spr_background.png" );
 	editorState.cameraTarget = HALF_DISPLAY;
@@ -107,9 +161,21 @@ bool MainGameUpdate( float elapsedTime )
 	static float fTotalGameTime = 0.f;
 	fTotalGameTime += elapsedTime;
 
-	HandleControls();
-	DrawScene();
-	DrawUserInterface();
+	if( Play::KeyPressed( VK_F5 ) )
+		TogglePlayInEditor();
+
+	if( editorState.playing )
+	{
+		UpdatePlayInEditor();
+	}
+	else
+	{
+		HandleControls();
+		DrawEditorScene();
+		DrawUserInterface();
+	}
+
+	levelJournal.Update( elapsedTime );
 
 	Play::PresentDrawingBuffer();
 	return Play::KeyDown( VK_ESCAPE );
@@ -119,6 +185,11 @@ bool MainGameUpdate( float elapsedTime )
 // Gets called once when the player quits the game 
 int MainGameExit( void )
 {
+	if( editorState.playing )
+		EndPlayInEditor();
+
+	levelJournal.Close();
+	overviewCache.Clear();
 	Play::DestroyManager();
 	return PLAY_OK;
 }
@@ -148,16 +219,13 @@ void HandleControls( void )
 		editorState.cameraTarget.y += CAMERA_SPEED / editorState.zoom;
 
 	if( Play::KeyPressed( VK_OEM_MINUS ) )
-		editorState.zoom -= 0.1f;
+		editorState.zoomLevel--;
 
 	if( Play::KeyPressed( VK_OEM_PLUS ) )
-		editorState.zoom += 0.1f;
-
-	if( editorState.zoom < 0.2f )
-		editorState.zoom = 0.2f;
+		editorState.zoomLevel++;
 
-	if( editorState.zoom > 1.0f )
-		editorState.zoom = 1.0f;
+	editorState.zoomLevel = std::clamp( editorState.zoomLevel, 0, OVERVIEW_ZOOM_LEVELS - 1 );
+	editorState.zoom = OverviewCache::GetZoom( editorState.zoomLevel );
 
 	if( Play::KeyPressed( VK_SPACE ) )
 	{
@@ -184,28 +252,24 @@ void HandleControls( void )
 	{
 		if( editorState.selectedObj == -1 )
 		{
-			for( int id : Play::CollectGameObjectIDsByType( editorState.editMode ) )
+			editorState.selectedObj = spatialIndex.Pick( mouseWorldPos, editorState.editMode );
+
+			if( editorState.selectedObj != -1 )
 			{
-				GameObject& obj = Play::GetGameObject( id );
-				if( PointInsideSpriteBounds( mouseWorldPos, obj ) )
-				{
-					editorState.selectedObj = obj.GetId();
-					editorState.selectedOffset = obj.pos - mouseWorldSnapPos;
-				}
+				editorState.selectedOffset = Play::GetGameObject( editorState.selectedObj ).pos - mouseWorldSnapPos;
 			}
-
-			if( editorState.selectedObj == -1 )
+			else
 			{
 				switch( editorState.editMode )
 				{
 					case TYPE_SHEEP:
-						Play::GetGameObjectByType( TYPE_SHEEP ).pos = mouseWorldPos;
+						MoveEditorObject( Play::GetGameObjectByType( TYPE_SHEEP ), mouseWorldPos );
 						break;
 					case TYPE_FINAL:
-						Play::GetGameObjectByType(TYPE_FINAL).pos = mouseWorldPos;
+						MoveEditorObject( Play::GetGameObjectByType( TYPE_FINAL ), mouseWorldPos );
 						break;
 					default:
-						editorState.selectedObj = Play::CreateGameObject( editorState.editMode, mouseWorldSnapPos, 50, SPRITE_NAMES[static_cast<int>( editorState.editMode )][0] );
+						editorState.selectedObj = CreateEditorObject( editorState.editMode, mouseWorldSnapPos, 50, Play::GetSpriteId( SPRITE_NAMES[static_cast<int>( editorState.editMode )][0] ) );
 						editorState.selectedOffset = { 0.0f, 0.0f };
 						break;
 				}
@@ -215,19 +279,19 @@ void HandleControls( void )
 		else
 		{
 			GameObject& obj = Play::GetGameObject( editorState.selectedObj );
-			obj.pos = mouseWorldSnapPos + editorState.selectedOffset;
+			MoveEditorObject( obj, mouseWorldSnapPos + editorState.selectedOffset );
 
 			if( Play::KeyDown( '1' ) )
-				obj.spriteId = Play::GetSpriteId( SPRITE_NAMES[static_cast<int>( editorState.editMode )][0] );
+				SetEditorObjectSprite( obj, Play::GetSpriteId( SPRITE_NAMES[static_cast<int>( editorState.editMode )][0] ) );
 
 			if( Play::KeyDown( '2' ) )
-				obj.spriteId = Play::GetSpriteId( SPRITE_NAMES[static_cast<int>( editorState.editMode )][1] );
+				SetEditorObjectSprite( obj, Play::GetSpriteId( SPRITE_NAMES[static_cast<int>( editorState.editMode )][1] ) );
 
 			if( Play::KeyDown( '3' ) )
-				obj.spriteId = Play::GetSpriteId( SPRITE_NAMES[static_cast<int>( editorState.editMode )][2] );
+				SetEditorObjectSprite( obj, Play::GetSpriteId( SPRITE_NAMES[static_cast<int>( editorState.editMode )][2] ) );
 
 			if( Play::KeyDown( '4' ) )
-				obj.spriteId = Play::GetSpriteId( SPRITE_NAMES[static_cast<int>( editorState.editMode )][3] );
+				SetEditorObjectSprite( obj, Play::GetSpriteId( SPRITE_NAMES[static_cast<int>( editorState.editMode )][3] ) );
 		}
 	}
 	else
@@ -237,33 +301,50 @@ void HandleControls( void )
 
 	if( Play::GetMouseButton( Play::RIGHT ) )
 	{
-		for( int id : Play::CollectGameObjectIDsByType( editorState.editMode ) )
+		// Holding shift drags out a box instead, and everything inside it is deleted when the button is released
+		if( editorState.boxSelecting || Play::KeyDown( VK_SHIFT ) )
 		{
-			GameObject& obj = Play::GetGameObject( id );
-			if( PointInsideSpriteBounds( mouseWorldPos, obj ) )
-			{
-				if( obj.type != TYPE_SHEEP )
-					Play::DestroyGameObject( id );
-			}
+			if( !editorState.boxSelecting )
+				editorState.boxStart = mouseWorldPos;
+
+			editorState.boxSelecting = true;
+			editorState.boxEnd = mouseWorldPos;
 		}
+		else
+		{
+			int id = spatialIndex.Pick( mouseWorldPos, editorState.editMode );
+			if( id != -1 && Play::GetGameObject( id ).type != TYPE_SHEEP )
+				DestroyEditorObject( id );
+		}
+	}
+	else if( editorState.boxSelecting )
+	{
+		Point2f topLeft = { std::min( editorState.boxStart.null, editorState.boxEnd.null ), std::min( editorState.boxStart.y, editorState.boxEnd.y ) };
+		Point2f bottomRight = { std::max( editorState.boxStart.null, editorState.boxEnd.null ), std::max( editorState.boxStart.y, editorState.boxEnd.y ) };
+
+		std::vector< int > vIds;
+		spatialIndex.Query( topLeft, bottomRight, editorState.editMode, vIds );
+
+		for( int id : vIds )
+		{
+			if( Play::GetGameObject( id ).type != TYPE_SHEEP )
+				DestroyEditorObject( id );
+		}
+
+		editorState.boxSelecting = false;
 	}
 
 	Play::SetCameraPosition( ( editorState.cameraTarget * editorState.zoom ) - HALF_DISPLAY );
 }
 
 //-------------------------------------------------------------------------
-void DrawScene( void )
+void DrawEditorScene( void )
 {
 	Play::DrawBackground();
 
-	DrawObjectsOfType( TYPE_ISLAND );
-	DrawObjectsOfType( TYPE_DOUGHNUT );
-	DrawObjectsOfType( TYPE_SHEEP );
-	DrawObjectsOfType( TYPE_SPIKE );
-	DrawObjectsOfType( TYPE_WOLF );
-	DrawObjectsOfType( TYPE_BUSH );
-	DrawObjectsOfType(TYPE_BLADE);
-	DrawObjectsOfType(TYPE_FINAL);
+	// Only the parts of the level which have been edited (or not seen at this zoom yet) are drawn object by object
+	Point2f cameraPos = Play::GetCameraPosition();
+	overviewCache.Draw( editorState.zoomLevel, cameraPos, cameraPos + Point2f( DISPLAY_WIDTH, DISPLAY_HEIGHT ) );
 
 	if( editorState.selectedObj != -1 )
 	{
@@ -275,6 +356,9 @@ void DrawScene( void )
 		Play::DrawDebugText( ( obj.pos - origin + Point2f( size.null / 2.0f, -10.0f / editorState.zoom ) ) * editorState.zoom, s.c_str(), Play::cWhite );
 	}
 
+	if( editorState.boxSelecting )
+		Play::DrawRect( editorState.boxStart * editorState.zoom, editorState.boxEnd * editorState.zoom, Play::cRed );
+
 }
 
 //-------------------------------------------------------------------------
@@ -318,9 +402,11 @@ void DrawUserInterface( void )
 		Play::DrawDebugText( { DISPLAY_WIDTH / 2, y += 20 }, "LEFT MOUSE DRAG = MOVE OBJECT", Play::cMagenta );
 		Play::DrawDebugText( { DISPLAY_WIDTH / 2, y += 20 }, "LEFT MOUSE DRAG AND KEYS 1-4 = CHANGE OBJECT SPRITE", Play::cWhite );
 		Play::DrawDebugText( { DISPLAY_WIDTH / 2, y += 20 }, "RIGHT MOUSE BUTTON = DELETE OBJECT", Play::cMagenta );
-		Play::DrawDebugText( { DISPLAY_WIDTH / 2, y += 20 }, "ARROW KEYS = SCROLL", Play::cWhite );
-		Play::DrawDebugText( { DISPLAY_WIDTH / 2, y += 20 }, "PLUS AND MINUS KEYS = ZOOM IN AND OUT", Play::cMagenta );
-		Play::DrawDebugText( { DISPLAY_WIDTH / 2, y += 20 }, "F1 = SHOW DEBUG INFO", Play::cWhite );
+		Play::DrawDebugText( { DISPLAY_WIDTH / 2, y += 20 }, "SHIFT AND RIGHT MOUSE DRAG = DELETE OBJECTS IN A BOX", Play::cWhite );
+		Play::DrawDebugText( { DISPLAY_WIDTH / 2, y += 20 }, "ARROW KEYS = SCROLL", Play::cMagenta );
+		Play::DrawDebugText( { DISPLAY_WIDTH / 2, y += 20 }, "PLUS AND MINUS KEYS = ZOOM IN AND OUT", Play::cWhite );
+		Play::DrawDebugText( { DISPLAY_WIDTH / 2, y += 20 }, "F1 = SHOW DEBUG INFO", Play::cMagenta );
+		Play::DrawDebugText( { DISPLAY_WIDTH / 2, y += 20 }, "F5 = PLAY THE LEVEL (F5 AGAIN TO STOP)", Play::cWhite );
 	}
 
 	if( --editorState.saveCooldown > 0 )
@@ -328,123 +414,157 @@ void DrawUserInterface( void )
 		Play::DrawRect( { 0, DISPLAY_HEIGHT - 50 }, { DISPLAY_WIDTH, DISPLAY_HEIGHT }, Play::cOrange, true );
 		Play::DrawFontText( "64px", "OVERWRITING LEVEL", { DISPLAY_WIDTH / 2, DISPLAY_HEIGHT - 25 }, Play::CENTRE );
 	}
+	else if( levelJournal.HasSaveFailed() )
+	{
+		Play::DrawRect( { 0, DISPLAY_HEIGHT - 50 }, { DISPLAY_WIDTH, DISPLAY_HEIGHT }, Play::cRed, true );
+		Play::DrawFontText( "64px", "LEVEL NOT SAVED", { DISPLAY_WIDTH / 2, DISPLAY_HEIGHT - 25 }, Play::CENTRE );
+	}
 
 	Play::SetDrawingSpace( Play::WORLD );
 }
 
 
 //-------------------------------------------------------------------------
-void DrawObjectsOfType( GameObjectType type )
+// Plays the level in the editor from the objects as they are now, then puts them back exactly as they were
+// > The game changes the objects while it runs, but the changes aren't edits so nothing else needs to know about them
+void TogglePlayInEditor( void )
 {
-	for( int id : Play::CollectGameObjectIDsByType( type ) )
+	if( editorState.playing )
 	{
-		GameObject& obj = Play::GetGameObject( id );
-		Play::DrawSpriteRotated( obj.spriteId, obj.pos * editorState.zoom, 0, 0, 1.0f * editorState.zoom );
+		EndPlayInEditor();
+		editorState.playing = false;
+		return;
 	}
+
+	// The game can't start without a sheep
+	if( Play::GetGameObjectByType( TYPE_SHEEP ).type == -1 )
+		return;
+
+	BeginPlayInEditor( LEVEL_TYPE_NAMES, []( int id ) -> const std::vector< LevelProperty >& { return levelJournal.GetProperties( id ); } );
+	editorState.playing = true;
 }
 
 //-------------------------------------------------------------------------
-bool PointInsideSpriteBounds( Point2f testPos, GameObject& obj )
+// Objects loaded from the level are created by LoadLevel() instead, as they're already in the files
+int CreateEditorObject( EditorObjectType type, Point2f pos, int radius, int spriteId )
 {
-	Point2f origin = Play::GetSpriteOrigin( obj.spriteId );
-	Point2f size = { Play::GetSpriteWidth( obj.spriteId ), Play::GetSpriteHeight( obj.spriteId ) };
-	Point2f topLeft = obj.pos - origin;
-	Point2f botRight = topLeft + size;
-	return testPos.null > topLeft.null && testPos.null < botRight.null&& testPos.y > topLeft.y && testPos.y < botRight.y;
+	int id = Play::CreateGameObject( type, pos, radius, spriteId );
+	IndexEditorObject( Play::GetGameObject( id ) );
+	levelJournal.Create( id, type, pos, spriteId );
+	return id;
 }
 
+//-------------------------------------------------------------------------
+void MoveEditorObject( GameObject& obj, Point2f pos )
+{
+	// The selected object is moved to the mouse every frame, even when the mouse is still
+	if( obj.pos.null == pos.null && obj.pos.y == pos.y )
+		return;
+
+	InvalidateEditorObject( obj );
+	obj.pos = pos;
+	IndexEditorObject( obj );
+	levelJournal.Move( obj.GetId(), pos );
+}
 
 //-------------------------------------------------------------------------
-// Loads the objects from the Baamageddon\Level.lev file
-void LoadLevel( void )
+void SetEditorObjectSprite( GameObject& obj, int spriteId )
 {
-	std::ifstream levelfile;
-	levelfile.open( "Level.lev" );
+	InvalidateEditorObject( obj );
+	obj.spriteId = spriteId;
+	IndexEditorObject( obj );
+	levelJournal.SetSprite( obj.GetId(), spriteId );
+}
 
-	std::string sType, sX, sY, sSprite;
+//-------------------------------------------------------------------------
+void DestroyEditorObject( int id )
+{
+	InvalidateEditorObject( Play::GetGameObject( id ) );
+	spatialIndex.Remove( id );
+	levelJournal.Destroy( id );
+	Play::DestroyGameObject( id );
+}
 
-	std::getline( levelfile, sType );
+//-------------------------------------------------------------------------
+// Updates the object's sprite bounds in the spatial index, and redraws them in the overview
+void IndexEditorObject( GameObject& obj )
+{
+	if( obj.type == -1 ) // Not for noObject
+		return;
 
-	while( !levelfile.eof() )
-	{
-		std::getline( levelfile, sType );
-		std::getline( levelfile, sX );
-		std::getline( levelfile, sY );
-		std::getline( levelfile, sSprite );
+	Point2f origin = Play::GetSpriteOrigin( obj.spriteId );
+	Point2f size = { Play::GetSpriteWidth( obj.spriteId ), Play::GetSpriteHeight( obj.spriteId ) };
+	Point2f topLeft = obj.pos - origin;
+	spatialIndex.Insert( obj.GetId(), obj.type, topLeft, topLeft + size );
+	overviewCache.Invalidate( topLeft, topLeft + size );
+}
 
-		if( sType == "TYPE_SHEEP" )
-			Play::CreateGameObject( TYPE_SHEEP, { std::stof( sX ), std::stof( sY ) }, 50, sSprite.c_str() );
+//-------------------------------------------------------------------------
+// Redraws the object's current sprite bounds in the overview, before it's moved, changed or destroyed
+void InvalidateEditorObject( GameObject& obj )
+{
+	if( obj.type == -1 ) // Not for noObject
+		return;
 
-		if( sType == "TYPE_ISLAND" )
-			Play::CreateGameObject( TYPE_ISLAND, { std::stof( sX ), std::stof( sY ) }, 0, sSprite.c_str() );
+	Point2f topLeft = obj.pos - Play::GetSpriteOrigin( obj.spriteId );
+	overviewCache.Invalidate( topLeft, topLeft + Point2f( Play::GetSpriteWidth( obj.spriteId ), Play::GetSpriteHeight( obj.spriteId ) ) );
+}
 
-		if( sType == "TYPE_DOUGHNUT" )
-			Play::CreateGameObject( TYPE_DOUGHNUT, { std::stof( sX ), std::stof( sY ) }, 30, sSprite.c_str() );
 
-		if (sType == "TYPE_SPIKE")
-			Play::CreateGameObject( TYPE_SPIKE, { std::stof(sX), std::stof(sY) }, 30, sSprite.c_str() );
+//-------------------------------------------------------------------------
+// Loads the objects from the Baamageddon\Level.lev file (using the binary version, which is created if necessary) and the journal
+void LoadLevel( void )
+{
+	std::vector< LevelEntry > vEntries;
+	if( !levelJournal.Load( vEntries ) )
+		return;
 
-		if (sType == "TYPE_WOLF")
-			Play::CreateGameObject( TYPE_WOLF, { std::stof(sX), std::stof(sY) }, 30, sSprite.c_str());
+	// Objects share sprite names, so each one is only looked up the first time it's used
+	std::map< std::string, int > spriteIds;
+	std::vector< Point2f > vPositions;
+	std::vector< int > vSpriteIds;
 
-		if (sType == "TYPE_BUSH")
-			Play::CreateGameObject( TYPE_BUSH, { std::stof(sX), std::stof(sY) }, 30, sSprite.c_str() );
+	// The level's objects come a block at a time, so each run of the same type is created in one go
+	for( size_t first = 0, last = 0; first < vEntries.size(); first = last )
+	{
+		for( last = first; last < vEntries.size() && vEntries[last].type == vEntries[first].type; last++ );
 
-		if (sType == "TYPE_BLADE")
-			Play::CreateGameObject(TYPE_BLADE, { std::stof(sX), std::stof(sY) }, 30, sSprite.c_str());
+		int typeIndex = FindLevelObjectType( vEntries[first].type.c_str() );
+		if( typeIndex < 0 )
+			continue;
 
-		if (sType == "TYPE_FINAL")
-			Play::CreateGameObject(TYPE_FINAL, { std::stof(sX), std::stof(sY) }, 30, sSprite.c_str());
-	}
+		vPositions.clear();
+		vSpriteIds.clear();
 
-	levelfile.close();
-}
+		for( size_t i = first; i < last; i++ )
+		{
+			auto it = spriteIds.find( vEntries[i].sprite );
+			if( it == spriteIds.end() )
+				it = spriteIds.emplace( vEntries[i].sprite, Play::GetSpriteId( vEntries[i].sprite.c_str() ) ).first;
 
-//-------------------------------------------------------------------------
-// Outputs the objects to the Baamageddon\Level.lev file
-void SaveLevel( void )
-{
-	std::ofstream levelfile;
-	levelfile.open( "Level.lev" );
+			vPositions.push_back( vEntries[i].pos );
+			vSpriteIds.push_back( it->second );
+		}
 
-	levelfile << "// This file is auto-generated by the Level Editor - it's not advisable to edit it directly as changes may be overwritten!\n";
+		EditorObjectType type = LEVEL_EDITOR_TYPES[typeIndex];
+		int count = static_cast<int>( last - first );
+		int firstId = Play::CreateGameObjects( type, count, vPositions.data(), vSpriteIds.data(), LEVEL_OBJECT_TYPES[typeIndex].radius );
 
-	for( int id : Play::CollectAllGameObjectIDs() )
-	{
-		GameObject& obj = Play::GetGameObject( id );
-		switch( obj.type )
+		// They aren't journalled, as they're already in the files
+		for( int i = 0; i < count; i++ )
 		{
-			case TYPE_SHEEP:
-				levelfile << "TYPE_SHEEP\n";
-				break;
-			case TYPE_ISLAND:
-				levelfile << "TYPE_ISLAND\n";
-				break;
-			case TYPE_DOUGHNUT:
-				levelfile << "TYPE_DOUGHNUT\n";
-				break;
-			case TYPE_SPIKE:
-				levelfile << "TYPE_SPIKE\n";
-				break;
-			case TYPE_WOLF:
-				levelfile << "TYPE_WOLF\n";
-				break;
-			case TYPE_BUSH:
-				levelfile << "TYPE_BUSH\n";
-				break;
-			case TYPE_BLADE:
-				levelfile << "TYPE_BLADE\n";
-				break;
-			case TYPE_FINAL:
-				levelfile << "TYPE_FINAL\n";
-				break;
-
+			const LevelEntry& entry = vEntries[first + i];
+			IndexEditorObject( Play::GetGameObject( firstId + i ) );
+			levelJournal.Track( firstId + i, type, entry.pos, vSpriteIds[i], &entry.vProperties );
 		}
-		levelfile << std::to_string( obj.pos.null ) + "f\n" << std::to_string( obj.pos.y ) + "f\n";
-		levelfile << Play::GetSpriteName( obj.spriteId ) << "\n";
 	}
-	
-	levelfile.close();
+}
 
+//-------------------------------------------------------------------------
+// Compacts the journal into the Baamageddon\Level.lev file, along with the binary version the game loads
+// > The files are written on a background thread, from a snapshot of the level
+void SaveLevel( void )
+{
+	levelJournal.Save();
 	editorState.saveCooldown = 100;
-}
\ No newline at end of file
+}
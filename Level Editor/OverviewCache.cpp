@@ -0,0 +1,276 @@
+///////////////////////////////////////////////////////////////////////////
+//	File		: OverviewCache.cpp
+//  Keeps the level editor's objects composed into tiles at each zoom
+//  level, so the whole scene is drawn with a few fast blits and only the
+//  areas which have been edited are composed again.
+///////////////////////////////////////////////////////////////////////////
+
+#define PLAY_USING_GAMEOBJECT_MANAGER
+#include "Play.h"
+#include "SpatialIndex.h"
+#include "OverviewCache.h"
+
+// How far (in zoomed pixels) a scaled sprite can reach beyond its scaled bounds, because of rounding
+constexpr int OVERVIEW_ROUNDING_MARGIN = 2;
+// The most separate areas to remember for a tile before they're merged into one
+constexpr int OVERVIEW_MAX_DIRTY_AREAS = 8;
+
+//-------------------------------------------------------------------------
+
+OverviewCache::OverviewCache( const SpatialIndex& index, std::vector< int > vDrawOrder )
+	: m_index( index ), m_vDrawOrder( std::move( vDrawOrder ) )
+{
+}
+
+//-------------------------------------------------------------------------
+
+void OverviewCache::Invalidate( Point2f topLeft, Point2f bottomRight )
+{
+	for( int zoomLevel = 0; zoomLevel < OVERVIEW_ZOOM_LEVELS; zoomLevel++ )
+	{
+		float zoom = GetZoom( zoomLevel );
+		int left = static_cast<int>( std::floor( topLeft.null * zoom ) ) - OVERVIEW_ROUNDING_MARGIN;
+		int top = static_cast<int>( std::floor( topLeft.y * zoom ) ) - OVERVIEW_ROUNDING_MARGIN;
+		int right = static_cast<int>( std::ceil( bottomRight.null * zoom ) ) + OVERVIEW_ROUNDING_MARGIN;
+		int bottom = static_cast<int>( std::ceil( bottomRight.y * zoom ) ) + OVERVIEW_ROUNDING_MARGIN;
+
+		// Tiles which haven't been created yet are composed in full when they're first drawn
+		for( int tileX = FloorDiv( left ); tileX <= FloorDiv( right - 1 ); tileX++ )
+		{
+			for( int tileY = FloorDiv( top ); tileY <= FloorDiv( bottom - 1 ); tileY++ )
+			{
+				auto it = m_tiles[zoomLevel].find( { tileX, tileY } );
+				if( it == m_tiles[zoomLevel].end() )
+					continue;
+
+				int originX = tileX * OVERVIEW_TILE_SIZE;
+				int originY = tileY * OVERVIEW_TILE_SIZE;
+				Rect area{ std::max( left - originX, 0 ), std::max( top - originY, 0 ), std::min( right - originX, OVERVIEW_TILE_SIZE ), std::min( bottom - originY, OVERVIEW_TILE_SIZE ) };
+
+				std::vector< Rect >& vDirty = it->second.vDirty;
+				if( static_cast<int>( vDirty.size() ) < OVERVIEW_MAX_DIRTY_AREAS )
+				{
+					vDirty.push_back( area );
+					continue;
+				}
+
+				// Lots of small changes (e.g. dragging an object) are cheaper to compose as one area than to keep track of
+				Rect merged = area;
+				for( const Rect& dirty : vDirty )
+					merged = { std::min( merged.left, dirty.left ), std::min( merged.top, dirty.top ), std::max( merged.right, dirty.right ), std::max( merged.bottom, dirty.bottom ) };
+
+				vDirty.assign( 1, merged );
+			}
+		}
+	}
+}
+
+//-------------------------------------------------------------------------
+
+void OverviewCache::Clear()
+{
+	for( std::map< TileKey, Tile >& tiles : m_tiles )
+	{
+		for( auto& tile : tiles )
+			FreeTile( tile.second );
+
+		tiles.clear();
+	}
+}
+
+//-------------------------------------------------------------------------
+
+void OverviewCache::Draw( int zoomLevel, Point2f viewTopLeft, Point2f viewBottomRight )
+{
+	PLAY_ASSERT_MSG( zoomLevel >= 0 && zoomLevel < OVERVIEW_ZOOM_LEVELS, "Invalid zoom level for the overview cache" );
+	m_frame++;
+
+	int left = static_cast<int>( std::floor( viewTopLeft.null ) );
+	int top = static_cast<int>( std::floor( viewTopLeft.y ) );
+	int right = static_cast<int>( std::ceil( viewBottomRight.null ) );
+	int bottom = static_cast<int>( std::ceil( viewBottomRight.y ) );
+
+	for( int tileY = FloorDiv( top ); tileY <= FloorDiv( bottom - 1 ); tileY++ )
+	{
+		for( int tileX = FloorDiv( left ); tileX <= FloorDiv( right - 1 ); tileX++ )
+		{
+			auto inserted = m_tiles[zoomLevel].try_emplace( { tileX, tileY } );
+			Tile& tile = inserted.first->second;
+
+			if( inserted.second )
+				tile.vDirty.push_back( { 0, 0, OVERVIEW_TILE_SIZE, OVERVIEW_TILE_SIZE } );
+
+			for( const Rect& area : tile.vDirty )
+				ComposeArea( zoomLevel, { tileX, tileY }, tile, area );
+
+			tile.vDirty.clear();
+			tile.lastUsedFrame = m_frame;
+
+			if( tile.pixels.pPixels )
+				Play::DrawComposite( tile.pixels, { tileX * OVERVIEW_TILE_SIZE, tileY * OVERVIEW_TILE_SIZE } );
+		}
+	}
+
+	int tileCount = 0;
+	for( const std::map< TileKey, Tile >& tiles : m_tiles )
+		tileCount += static_cast<int>( tiles.size() );
+
+	if( m_allocatedTiles > OVERVIEW_MAX_TILES || tileCount - m_allocatedTiles > OVERVIEW_MAX_EMPTY_TILES )
+		TrimTiles();
+}
+
+//-------------------------------------------------------------------------
+
+void OverviewCache::ComposeArea( int zoomLevel, TileKey key, Tile& tile, const Rect& area )
+{
+	float zoom = GetZoom( zoomLevel );
+	Point2f tileOrigin = { key.first * OVERVIEW_TILE_SIZE, key.second * OVERVIEW_TILE_SIZE };
+	Point2f areaTopLeft = { area.left, area.top };
+	Point2f areaBottomRight = { area.right, area.bottom };
+
+	// Any object which could have been drawn into the area is drawn again, but only the pixels inside it change
+	Point2f margin = { OVERVIEW_ROUNDING_MARGIN, OVERVIEW_ROUNDING_MARGIN };
+	Point2f queryTopLeft = ( tileOrigin + areaTopLeft - margin ) / zoom;
+	Point2f queryBottomRight = ( tileOrigin + areaBottomRight + margin ) / zoom;
+
+	if( tile.pixels.pPixels )
+		Play::ClearComposite( tile.pixels, areaTopLeft, areaBottomRight );
+
+	for( int type : m_vDrawOrder )
+	{
+		m_index.Query( queryTopLeft, queryBottomRight, type, m_vIds );
+
+		for( int id : m_vIds )
+		{
+			GameObject& obj = Play::GetGameObject( id );
+			if( obj.spriteId < 0 )
+				continue;
+
+			// Empty tiles don't need any pixel data
+			if( !tile.pixels.pPixels )
+			{
+				tile.pixels.width = OVERVIEW_TILE_SIZE;
+				tile.pixels.height = OVERVIEW_TILE_SIZE;
+				tile.pixels.pPixels = new Pixel[OVERVIEW_TILE_SIZE * OVERVIEW_TILE_SIZE];
+				Play::ClearComposite( tile.pixels, { 0, 0 }, { OVERVIEW_TILE_SIZE, OVERVIEW_TILE_SIZE } );
+				m_allocatedTiles++;
+			}
+
+			Play::ComposeSprite( tile.pixels, GetScaledSprite( zoomLevel, obj.spriteId ), ( obj.pos * zoom ) - tileOrigin, 0, areaTopLeft, areaBottomRight );
+		}
+	}
+}
+
+//-------------------------------------------------------------------------
+
+int OverviewCache::GetScaledSprite( int zoomLevel, int spriteId )
+{
+	// The last zoom level is full size
+	if( zoomLevel == OVERVIEW_ZOOM_LEVELS - 1 )
+		return spriteId;
+
+	// Each zoom level keeps its own copies, so switching back and forth doesn't scale the sprites again
+	auto it = m_scaledSprites[zoomLevel].find( spriteId );
+	if( it != m_scaledSprites[zoomLevel].end() )
+	{
+		it->second.lastUsedFrame = m_frame;
+		return it->second.id;
+	}
+
+	// Sprites can't be removed, so once there are enough copies the one which was composed least recently is scaled again instead
+	int oldestLevel = -1;
+	std::map< int, ScaledSprite >::iterator oldest;
+	for( int level = 0; level < OVERVIEW_ZOOM_LEVELS && m_scaledSpriteCount >= OVERVIEW_MAX_SCALED_SPRITES; level++ )
+	{
+		for( auto i = m_scaledSprites[level].begin(); i != m_scaledSprites[level].end(); ++i )
+		{
+			if( i->second.lastUsedFrame != m_frame && ( oldestLevel < 0 || i->second.lastUsedFrame < oldest->second.lastUsedFrame ) )
+			{
+				oldestLevel = level;
+				oldest = i;
+			}
+		}
+	}
+
+	int scaledId;
+	if( oldestLevel >= 0 )
+	{
+		scaledId = oldest->second.id;
+		m_scaledSprites[oldestLevel].erase( oldest );
+		Play::UpdateScaledSprite( scaledId, spriteId, GetZoom( zoomLevel ) );
+	}
+	else
+	{
+		scaledId = Play::CreateScaledSprite( spriteId, GetZoom( zoomLevel ) );
+		m_scaledSpriteCount++;
+	}
+
+	m_scaledSprites[zoomLevel][spriteId] = { scaledId, m_frame };
+	return scaledId;
+}
+
+//-------------------------------------------------------------------------
+
+void OverviewCache::FreeTile( Tile& tile )
+{
+	if( !tile.pixels.pPixels )
+		return;
+
+	delete[] tile.pixels.pPixels;
+	tile.pixels.pPixels = nullptr;
+	m_allocatedTiles--;
+}
+
+//-------------------------------------------------------------------------
+// Throws away the tiles which were drawn least recently until there are few enough of each kind (never the ones on screen)
+void OverviewCache::TrimTiles()
+{
+	struct Candidate
+	{
+		int lastUsedFrame;
+		int zoomLevel;
+		TileKey key;
+	};
+
+	std::vector< Candidate > vCandidates;
+	int emptyTiles = 0;
+	for( int zoomLevel = 0; zoomLevel < OVERVIEW_ZOOM_LEVELS; zoomLevel++ )
+	{
+		for( auto& tile : m_tiles[zoomLevel] )
+		{
+			if( !tile.second.pixels.pPixels )
+				emptyTiles++;
+
+			if( tile.second.lastUsedFrame != m_frame )
+				vCandidates.push_back( { tile.second.lastUsedFrame, zoomLevel, tile.first } );
+		}
+	}
+
+	std::sort( vCandidates.begin(), vCandidates.end(), []( const Candidate& a, const Candidate& b ) { return a.lastUsedFrame < b.lastUsedFrame; } );
+
+	for( const Candidate& candidate : vCandidates )
+	{
+		if( m_allocatedTiles <= OVERVIEW_MAX_TILES && emptyTiles <= OVERVIEW_MAX_EMPTY_TILES )
+			break;
+
+		// Only the kind of tile there are too many of is thrown away
+		auto it = m_tiles[candidate.zoomLevel].find( candidate.key );
+		bool empty = !it->second.pixels.pPixels;
+		if( empty ? emptyTiles <= OVERVIEW_MAX_EMPTY_TILES : m_allocatedTiles <= OVERVIEW_MAX_TILES )
+			continue;
+
+		// The tile is forgotten completely, so it's composed in full if it's drawn again
+		if( empty )
+			emptyTiles--;
+
+		FreeTile( it->second );
+		m_tiles[candidate.zoomLevel].erase( it );
+	}
+}
+
+//-------------------------------------------------------------------------
+
+int OverviewCache::FloorDiv( int pixels )
+{
+	return static_cast<int>( std::floor( static_cast<float>( pixels ) / OVERVIEW_TILE_SIZE ) );
+}
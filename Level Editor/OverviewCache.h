@@ -0,0 +1,84 @@
+#pragma once
+///////////////////////////////////////////////////////////////////////////
+//	File		: OverviewCache.h
+//  Keeps the level editor's objects composed into tiles at each zoom
+//  level, so the whole scene is drawn with a few fast blits and only the
+//  areas which have been edited are composed again.
+///////////////////////////////////////////////////////////////////////////
+
+class SpatialIndex;
+
+// The size of each tile in (zoomed) pixels
+constexpr int OVERVIEW_TILE_SIZE = 256;
+// The editor's zoom levels go from 0.2 to 1.0 in steps of 0.1
+constexpr int OVERVIEW_ZOOM_LEVELS = 9;
+constexpr float OVERVIEW_MIN_ZOOM = 0.2f;
+constexpr float OVERVIEW_ZOOM_STEP = 0.1f;
+// The most tiles to keep with pixel data (256KB each), before the ones which haven't been drawn recently are thrown away
+constexpr int OVERVIEW_MAX_TILES = 384;
+// The most empty tiles to remember, so empty parts of the level aren't composed again every time they're drawn
+constexpr int OVERVIEW_MAX_EMPTY_TILES = 4096;
+// The most scaled copies of sprites to keep, before the ones which haven't been composed recently are reused for others
+constexpr int OVERVIEW_MAX_SCALED_SPRITES = 256;
+
+//-------------------------------------------------------------------------
+
+class OverviewCache
+{
+public:
+	// The object types are composed in the order given, with later ones on top
+	OverviewCache( const SpatialIndex& index, std::vector< int > vDrawOrder );
+	~OverviewCache() { Clear(); }
+	OverviewCache( const OverviewCache& ) = delete;
+	OverviewCache& operator=( const OverviewCache& ) = delete;
+
+	// Marks an area of the level (in level co-ordinates) as changed, e.g. an object's bounds before and after it moves
+	// > The tiles which show it are composed again the next time they're drawn
+	void Invalidate( Point2f topLeft, Point2f bottomRight );
+	// Throws away all the tiles
+	void Clear();
+
+	// Draws the objects at a zoom level, for the area of the zoomed level which is on screen
+	void Draw( int zoomLevel, Point2f viewTopLeft, Point2f viewBottomRight );
+	// Gets the number of tiles which have pixel data
+	int GetTileCount() const { return m_allocatedTiles; }
+
+	// Gets the scale for a zoom level, which the editor uses as well so the tiles always line up with its view
+	static float GetZoom( int zoomLevel ) { return OVERVIEW_MIN_ZOOM + ( zoomLevel * OVERVIEW_ZOOM_STEP ); }
+
+private:
+	struct Rect
+	{
+		int left, top, right, bottom;
+	};
+
+	struct Tile
+	{
+		PixelData pixels; // No pixel data until an object is composed into the tile
+		std::vector< Rect > vDirty; // The areas to compose again, in the tile's pixels
+		int lastUsedFrame{ -1 };
+	};
+
+	using TileKey = std::pair< int, int >;
+
+	struct ScaledSprite
+	{
+		int id; // Made by Play::CreateScaledSprite()
+		int lastUsedFrame;
+	};
+
+	void ComposeArea( int zoomLevel, TileKey key, Tile& tile, const Rect& area );
+	int GetScaledSprite( int zoomLevel, int spriteId );
+	void FreeTile( Tile& tile );
+	void TrimTiles();
+	static int FloorDiv( int pixels );
+
+	const SpatialIndex& m_index;
+	std::vector< int > m_vDrawOrder;
+	std::map< TileKey, Tile > m_tiles[OVERVIEW_ZOOM_LEVELS];
+	std::map< int, ScaledSprite > m_scaledSprites[OVERVIEW_ZOOM_LEVELS]; // The scaled copy of each sprite at each zoom level
+	int m_scaledSpriteCount{ 0 };
+	std::vector< int > m_vIds; // Reused for the spatial index queries
+	int m_allocatedTiles{ 0 };
+	int m_frame{ 0 };
+};
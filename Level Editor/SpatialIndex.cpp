@@ -0,0 +1,135 @@
+///////////////////////////////////////////////////////////////////////////
+//	File		: SpatialIndex.cpp
+//  A grid of the level editor's objects by their sprite bounds, so picking
+//  and box selection only look at the objects near the mouse.
+///////////////////////////////////////////////////////////////////////////
+
+#include "Play.h"
+#include "SpatialIndex.h"
+
+//-------------------------------------------------------------------------
+
+void SpatialIndex::Insert( int id, int type, Point2f topLeft, Point2f bottomRight )
+{
+	auto it = m_entries.find( id );
+	if( it != m_entries.end() )
+		RemoveFromCells( id, it->second );
+
+	Entry& entry = m_entries[id];
+	entry.type = type;
+	entry.topLeft = topLeft;
+	entry.bottomRight = bottomRight;
+	AddToCells( id, entry );
+}
+
+//-------------------------------------------------------------------------
+
+void SpatialIndex::Remove( int id )
+{
+	auto it = m_entries.find( id );
+	if( it == m_entries.end() )
+		return;
+
+	RemoveFromCells( id, it->second );
+	m_entries.erase( it );
+}
+
+//-------------------------------------------------------------------------
+
+void SpatialIndex::Clear()
+{
+	m_entries.clear();
+	m_cells.clear();
+}
+
+//-------------------------------------------------------------------------
+
+int SpatialIndex::Pick( Point2f pos, int type ) const
+{
+	auto cell = m_cells.find( GetCell( pos ) );
+	if( cell == m_cells.end() )
+		return -1;
+
+	int topmost = -1;
+	for( int id : cell->second )
+	{
+		const Entry& entry = m_entries.at( id );
+		if( entry.type == type && id > topmost && pos.null > entry.topLeft.null && pos.null < entry.bottomRight.null && pos.y > entry.topLeft.y && pos.y < entry.bottomRight.y )
+			topmost = id;
+	}
+
+	return topmost;
+}
+
+//-------------------------------------------------------------------------
+
+void SpatialIndex::Query( Point2f topLeft, Point2f bottomRight, int type, std::vector< int >& vIds ) const
+{
+	vIds.clear();
+
+	Cell first = GetCell( topLeft );
+	Cell last = GetCell( bottomRight );
+
+	// Only the cells which exist are visited, so a huge rectangle over an empty area is still cheap
+	for( int cellX = first.first; cellX <= last.first; cellX++ )
+	{
+		for( auto cell = m_cells.lower_bound( { cellX, first.second } ); cell != m_cells.end() && cell->first.first == cellX && cell->first.second <= last.second; ++cell )
+		{
+			for( int id : cell->second )
+			{
+				const Entry& entry = m_entries.at( id );
+				if( entry.type == type && entry.topLeft.null < bottomRight.null && entry.bottomRight.null > topLeft.null && entry.topLeft.y < bottomRight.y && entry.bottomRight.y > topLeft.y )
+					vIds.push_back( id );
+			}
+		}
+	}
+
+	// Objects which span several cells are found more than once
+	std::sort( vIds.begin(), vIds.end() );
+	vIds.erase( std::unique( vIds.begin(), vIds.end() ), vIds.end() );
+}
+
+//-------------------------------------------------------------------------
+
+SpatialIndex::Cell SpatialIndex::GetCell( Point2f pos )
+{
+	return { static_cast<int>( std::floor( pos.null / SPATIAL_INDEX_CELL_SIZE ) ), static_cast<int>( std::floor( pos.y / SPATIAL_INDEX_CELL_SIZE ) ) };
+}
+
+//-------------------------------------------------------------------------
+
+void SpatialIndex::AddToCells( int id, const Entry& entry )
+{
+	Cell first = GetCell( entry.topLeft );
+	Cell last = GetCell( entry.bottomRight );
+
+	for( int cellX = first.first; cellX <= last.first; cellX++ )
+	{
+		for( int cellY = first.second; cellY <= last.second; cellY++ )
+			m_cells[{ cellX, cellY }].push_back( id );
+	}
+}
+
+//-------------------------------------------------------------------------
+
+void SpatialIndex::RemoveFromCells( int id, const Entry& entry )
+{
+	Cell first = GetCell( entry.topLeft );
+	Cell last = GetCell( entry.bottomRight );
+
+	for( int cellX = first.first; cellX <= last.first; cellX++ )
+	{
+		for( int cellY = first.second; cellY <= last.second; cellY++ )
+		{
+			auto cell = m_cells.find( { cellX, cellY } );
+			if( cell == m_cells.end() )
+				continue;
+
+			std::vector< int >& vIds = cell->second;
+			vIds.erase( std::remove( vIds.begin(), vIds.end(), id ), vIds.end() );
+
+			if( vIds.empty() )
+				m_cells.erase( cell );
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+///////////////////////////////////////////////////////////////////////////
+//	File		: SpatialIndex.h
+//  A grid of the level editor's objects by their sprite bounds, so picking
+//  and box selection only look at the objects near the mouse.
+///////////////////////////////////////////////////////////////////////////
+
+constexpr float SPATIAL_INDEX_CELL_SIZE = 256.0f;
+
+//-------------------------------------------------------------------------
+
+class SpatialIndex
+{
+public:
+	// Adds an object, or updates its bounds if it's already in the index
+	void Insert( int id, int type, Point2f topLeft, Point2f bottomRight );
+	// Removes an object (does nothing if it isn't in the index)
+	void Remove( int id );
+	// Removes all the objects
+	void Clear();
+
+	// Finds the topmost object of the given type whose bounds contain the point
+	// > Objects created later are drawn on top, so this is the one with the highest id. Returns -1 if there isn't one
+	int Pick( Point2f pos, int type ) const;
+	// Collects the ids of the objects of the given type whose bounds overlap the rectangle, in id order
+	void Query( Point2f topLeft, Point2f bottomRight, int type, std::vector< int >& vIds ) const;
+	// Gets the number of objects in the index
+	int GetCount() const { return static_cast<int>( m_entries.size() ); }
+
+private:
+	struct Entry
+	{
+		int type;
+		Point2f topLeft;
+		Point2f bottomRight;
+	};
+
+	using Cell = std::pair< int, int >;
+
+	static Cell GetCell( Point2f pos );
+	void AddToCells( int id, const Entry& entry );
+	void RemoveFromCells( int id, const Entry& entry );
+
+	std::map< int, Entry > m_entries;
+	std::map< Cell, std::vector< int > > m_cells; // Objects are in every cell their bounds overlap
+};
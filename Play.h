@@ -34,6 +34,8 @@
 #include <sstream>
 #include <vector>
 #include <map>
+#include <list>
+#include <memory>
 #include <algorithm>
 #include <chrono>
 #include <iostream>
@@ -41,6 +43,14 @@
 #include <filesystem>
 #include <thread>
 #include <future>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Define PLAY_PLATFORM_HEADLESS to build without Windows: there's no window, input is scripted and audio isn't played
+// > The game loop is driven by a synthetic clock, so the game can be run in benchmarks and soak tests on any platform
+#ifndef PLAY_PLATFORM_HEADLESS
 
 #define WIN32_LEAN_AND_MEAN // Exclude rarely-used content from the Windows headers
 #define NOMINMAX // Stop windows macros defining their own min and max macros
@@ -49,23 +59,29 @@
 #include <windows.h>
 #include <windowsx.h>
 #include <mmsystem.h>
+#include <psapi.h>
 
-// Includes the GDI plus headers.
+// Includes the desktop window manager and shell headers.
 // These are only needed by internal parts of the library.
 
 #include "dwmapi.h"
 #include <Shlobj.h>
-#pragma warning(push)
-#pragma warning(disable:4458) // Suppress warning for declaration of 'xyz' hides class member
 
- // Redirect the GDI to use the standard library for min and max
-namespace Gdiplus
-{
-	using std::min;
-	using std::max;
-}
-#include <GdiPlus.h>
-#pragma warning(pop)
+#else
+
+#include <cstdio>
+#include <cstring>
+#include <cstdarg>
+#include <ctime>
+#if defined( __GLIBC__ ) || defined( __APPLE__ )
+#include <execinfo.h> // For the call stacks of strict allocations
+#endif
+
+#endif
+
+#if defined( _M_X64 ) || defined( _M_IX86 ) || defined( __SSE2__ )
+#include <emmintrin.h>
+#endif
 
 // Macros for Assertion and Tracing
 void TracePrintf(const char* file, int line, const char* fmt, ...);
@@ -74,7 +90,7 @@ void DebugOutput( const char* s );
 void DebugOutput( std::string s );
 
 #ifdef _DEBUG
-#define PLAY_TRACE(fmt, ...) TracePrintf(__FILE__, __LINE__, fmt, __VA_ARGS__);
+#define PLAY_TRACE(fmt, ...) TracePrintf(__FILE__, __LINE__, fmt, ##__VA_ARGS__);
 #define PLAY_ASSERT(null) if(!(null)){ PLAY_TRACE(" *** ASSERT FAIL *** !("#null")\n\n"); AssertFailMessage(#null, __FILE__, __LINE__), __debugbreak(); }
 #define PLAY_ASSERT_MSG(null,y) if(!(null)){ PLAY_TRACE(" *** ASSERT FAIL *** !("#null")\n\n"); AssertFailMessage(y, __FILE__, __LINE__), __debugbreak(); }
 #else
@@ -86,18 +102,147 @@ void DebugOutput( std::string s );
 // Global constants such as PI
 constexpr float PLAY_PI	= 3.14159265358979323846f;   // pi
 
+// Returns true if a name appears anywhere in some upper case text, whatever the name's case (sprites and sounds are found like this)
+// > Compares in place rather than making an upper case copy of the name, so finding things by name doesn't allocate
+inline bool ContainsUpperCase( const std::string& upperText, const char* name )
+{
+	size_t length = strlen( name );
+	for( size_t start = 0; start + length <= upperText.size(); start++ )
+	{
+		size_t c = 0;
+		while( c < length && upperText[start + c] == static_cast<char>( toupper( name[c] ) ) )
+			c++;
+		if( c == length )
+			return true;
+	}
+	return false;
+}
+
+#ifdef PLAY_PLATFORM_HEADLESS
+#ifndef PLAY_PLAYHEADLESS_H
+#define PLAY_PLAYHEADLESS_H
+//********************************************************************************************************************************
+// File:		PlayHeadless.h
+// Description:	The parts of the Windows API which PlayBuffer programs use, for builds without Windows
+// Platform:	Headless
+// Notes:		Key codes match the Windows virtual key codes, so input scripts and recordings work on any platform
+//********************************************************************************************************************************
+
+// The virtual key codes, which are also the names input scripts use
+#define PLAY_HEADLESS_KEYS( KEY ) \
+	KEY( VK_LBUTTON, 0x01 ) KEY( VK_RBUTTON, 0x02 ) KEY( VK_BACK, 0x08 ) KEY( VK_TAB, 0x09 ) KEY( VK_RETURN, 0x0D ) \
+	KEY( VK_SHIFT, 0x10 ) KEY( VK_CONTROL, 0x11 ) KEY( VK_MENU, 0x12 ) KEY( VK_ESCAPE, 0x1B ) KEY( VK_SPACE, 0x20 ) \
+	KEY( VK_PRIOR, 0x21 ) KEY( VK_NEXT, 0x22 ) KEY( VK_END, 0x23 ) KEY( VK_HOME, 0x24 ) KEY( VK_LEFT, 0x25 ) \
+	KEY( VK_UP, 0x26 ) KEY( VK_RIGHT, 0x27 ) KEY( VK_DOWN, 0x28 ) KEY( VK_INSERT, 0x2D ) KEY( VK_DELETE, 0x2E ) \
+	KEY( VK_F1, 0x70 ) KEY( VK_F2, 0x71 ) KEY( VK_F3, 0x72 ) KEY( VK_F4, 0x73 ) KEY( VK_F5, 0x74 ) KEY( VK_F6, 0x75 ) \
+	KEY( VK_F7, 0x76 ) KEY( VK_F8, 0x77 ) KEY( VK_F9, 0x78 ) KEY( VK_F10, 0x79 ) KEY( VK_F11, 0x7A ) KEY( VK_F12, 0x7B ) \
+	KEY( VK_OEM_PLUS, 0xBB ) KEY( VK_OEM_COMMA, 0xBC ) KEY( VK_OEM_MINUS, 0xBD ) KEY( VK_OEM_PERIOD, 0xBE )
+
+#define PLAY_HEADLESS_DEFINE_KEY( name, code ) constexpr int name = code;
+PLAY_HEADLESS_KEYS( PLAY_HEADLESS_DEFINE_KEY )
+#undef PLAY_HEADLESS_DEFINE_KEY
+
+// Debug output goes to stderr
+inline void OutputDebugStringA( const char* s ) { fputs( s, stderr ); }
+
+#define UNREFERENCED_PARAMETER( P ) ( (void)( P ) )
+
+#ifndef _MSC_VER
+// Only Microsoft's compiler has these built in
+#define __debugbreak() __builtin_trap()
+#define _TRUNCATE ( static_cast<size_t>( -1 ) )
+
+template< size_t N > int sprintf_s( char ( &buffer )[N], const char* fmt, ... )
+{
+	va_list args;
+	va_start( args, fmt );
+	int len = vsnprintf( buffer, N, fmt, args );
+	va_end( args );
+	return len;
+}
+
+inline int sprintf_s( char* buffer, size_t size, const char* fmt, ... )
+{
+	va_list args;
+	va_start( args, fmt );
+	int len = vsnprintf( buffer, size, fmt, args );
+	va_end( args );
+	return len;
+}
+
+inline int vsprintf_s( char* buffer, size_t size, const char* fmt, va_list args ) { return vsnprintf( buffer, size, fmt, args ); }
+template< size_t N > int strcpy_s( char ( &dest )[N], const char* src ) { snprintf( dest, N, "%s", src ); return 0; }
+inline int strncpy_s( char* dest, size_t size, const char* src, size_t count ) { snprintf( dest, size, "%.*s", static_cast<int>( std::min( count, size - 1 ) ), src ); return 0; }
+inline int localtime_s( tm* pTm, const time_t* pTime ) { return localtime_r( pTime, pTm ) ? 0 : 1; }
+#endif
+
+#endif
+#endif // PLAY_PLATFORM_HEADLESS
+
 #ifndef PLAY_PLAYMEMORY_H
 #define PLAY_PLAYMEMORY_H
 //********************************************************************************************************************************
 // File:		PlayMemory.h
 // Platform:	Independent
 // Description:	Declaration for a simple memory tracker to prevent leaks
+// Notes:		Debug builds only. Allocations can be tagged to count them separately, and made strict to find any which
+//				happen where they shouldn't
 //********************************************************************************************************************************
 
 #ifdef _DEBUG
 	// Prints out all the currently allocated memory to the debug output
 	void PrintAllocations( const char* tagText );
 
+	// Counts of the tracked allocations, either all of them or just those with one tag
+	struct AllocationCounters
+	{
+		uint32_t allocations{ 0 }; // Since the program started
+		uint32_t liveAllocations{ 0 };
+		size_t liveBytes{ 0 };
+		uint32_t frameAllocations{ 0 }; // During the last complete frame
+		size_t frameBytes{ 0 };
+	};
+
+	// Tags the allocations this thread makes while it's in scope, so they're counted separately (use PLAY_ALLOCATION_TAG)
+	class AllocationTag
+	{
+	public:
+		// The tag should be a string literal, as only the pointer is kept
+		AllocationTag( const char* tag );
+		~AllocationTag();
+	private:
+		uint16_t m_previous;
+	};
+
+	// Gets the counters for all the allocations, or for just those with a tag
+	AllocationCounters GetAllocationCounters( const char* tag = nullptr );
+	// Gets the number of tags (including "Untagged", which is always the first)
+	int GetAllocationTagCount();
+	// Gets the name of a tag
+	const char* GetAllocationTagName( int tagIndex );
+	// Ends the frame for the frame allocation counters (called by the profiler at the end of each frame)
+	void EndAllocationFrame();
+	// Gets the number of allocations, and their bytes, this thread has made (the profiler's zones count their allocations with these)
+	void GetThreadAllocations( uint32_t& allocations, size_t& bytes );
+
+	// Makes every allocation on this thread log its call stack while it's on, if strict allocations are enabled
+	// > For checking the steady state of a game doesn't allocate at all. Expected allocations can use PLAY_ALLOW_ALLOCATIONS
+	void SetStrictAllocations( bool strict );
+	// Enables strict allocations ("--strict-allocations" on the command line does this)
+	void EnableStrictAllocations( bool enable );
+	// Gets the number of allocations which have been made while they were strict
+	uint32_t GetStrictAllocationCount();
+
+	// Allows the allocations this thread makes while it's in scope, even if they're strict (use PLAY_ALLOW_ALLOCATIONS)
+	class AllowAllocations
+	{
+	public:
+		AllowAllocations();
+		~AllowAllocations();
+	private:
+		bool m_previous;
+	};
+
 	// Allocate some memory with a known origin
 	void* operator new(size_t size, const char* file, int line);
 	// Allocate some memory with a known origin
@@ -113,8 +258,15 @@ constexpr float PLAY_PI	= 3.14159265358979323846f;   // pi
 	void operator delete[](void* p, const char* file, int line); 
 
 	#define new new( __FILE__ , __LINE__ )
+	#define PLAY_ALLOCATION_TAG( tag ) AllocationTag PLAY_ALLOCATION_CONCAT( playAllocationTag, __LINE__ )( tag )
+	#define PLAY_ALLOCATION_CONCAT_INNER( a, b ) a##b
+	#define PLAY_ALLOCATION_CONCAT( a, b ) PLAY_ALLOCATION_CONCAT_INNER( a, b )
+	#define PLAY_ALLOW_ALLOCATIONS() AllowAllocations PLAY_ALLOCATION_CONCAT( playAllowAllocations, __LINE__ )
 #else
 	#define PrintAllocations( x )
+	#define PLAY_ALLOCATION_TAG( tag )
+	#define SetStrictAllocations( x )
+	#define PLAY_ALLOW_ALLOCATIONS()
 #endif
 
 #endif
@@ -432,6 +584,45 @@ struct PixelData
 	bool preMultiplied = false;
 };
 
+#endif
+#ifndef PLAY_PLAYPNG_H
+#define PLAY_PLAYPNG_H
+//********************************************************************************************************************************
+// File:		PlayPNG.h
+// Description:	A portable PNG decoder for loading images without any platform libraries
+// Platform:	Independent
+// Notes:		Supports all the standard colour types, bit depths and interlacing, but ignores gamma and colour profiles
+//********************************************************************************************************************************
+
+// Decodes PNG images into 32-bit ARGB pixel data (not pre-multiplied)
+// > A static class with no shared state, so images can be decoded on several threads at once
+class PlayPNG
+{
+public:
+	// Reads the width and height of a PNG file from its header
+	// > Returns false if the file couldn't be read or isn't a PNG
+	static bool ReadSize( const std::string& fileAndPath, int& width, int& height );
+	// Loads and decodes a PNG file, allocating memory for the pixel data in the destination image
+	// > Returns false if the file couldn't be read or decoded
+	static bool LoadFile( const std::string& fileAndPath, PixelData& destImage );
+	// Decodes PNG data which is already in memory, allocating memory for the pixel data in the destination image
+	// > Returns false if the data couldn't be decoded
+	static bool Decode( const uint8_t* pData, size_t size, PixelData& destImage );
+	// Decompresses a zlib (deflate) data stream onto the end of the output
+	// > Returns false if the stream is invalid or incomplete, or if the output would grow beyond maxOutput bytes
+	static bool Inflate( const uint8_t* pData, size_t size, std::vector<uint8_t>& output, size_t maxOutput = SIZE_MAX );
+
+private:
+	struct BitReader;
+	struct Huffman;
+
+	// Decodes a single deflate block using the given literal/length and distance codes
+	static bool InflateBlock( BitReader& in, const Huffman& lengthCodes, const Huffman& distanceCodes, std::vector<uint8_t>& output, size_t maxOutput );
+	// Reverses the filtering applied to each row of the image data before it was compressed
+	// > Each row is preceded by its filter type and the rows are unfiltered in place
+	static bool Unfilter( uint8_t* pData, int rowBytes, int rows, int bytesPerPixel );
+};
+
 #endif
 #ifndef PLAY_PLAYMOUSE_H
 #define PLAY_PLAYMOUSE_H
@@ -456,8 +647,8 @@ struct MouseData
 //********************************************************************************************************************************
 // File:		PlayWindow.h
 // Description:	Platform specific code to provide a window to draw into
-// Platform:	Windows
-// Notes:		Uses a 32-bit ARGB display buffer
+// Platform:	Windows / Headless
+// Notes:		Uses a 32-bit ARGB display buffer. The headless version presents into an offscreen copy instead
 //********************************************************************************************************************************
 
 // The target frame rate
@@ -485,6 +676,7 @@ public:
 	// Destroys the PlayWindow instance
 	static void Destroy();
 
+#ifndef PLAY_PLATFORM_HEADLESS
 	// Windows functions
 	//********************************************************************************************************************************
 
@@ -492,6 +684,32 @@ public:
 	int HandleWindows( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR pCmdLine, int nCmdShow, LPCWSTR windowName );
 	// Handles Windows messages for the PlayWindow  
 	static LRESULT CALLBACK WndProc( HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam );
+#else
+	// Headless functions
+	//********************************************************************************************************************************
+
+	// An input event in a script, which happens at the start of a frame
+	struct InputEvent
+	{
+		int frame; // Counting from zero
+		int vKey; // Or -1 to move the mouse
+		bool down;
+		Point2f mousePos;
+	};
+
+	// Runs the game loop without a window: every frame is given the same elapsed time and nothing waits for real time
+	// > Stops when MainGameUpdate() returns true, or after the frame limit (zero for no limit)
+	int HandleHeadless( int frameLimit, float frameTime );
+	// Adds an input event to the script
+	void QueueInput( const InputEvent& inputEvent );
+	// Reads an input script with an event on each line: "<frame> down <key>", "<frame> up <key>" or "<frame> mouse <x> <y>"
+	// > Keys are the virtual key names (e.g. VK_SPACE), a character (e.g. A) or a number. Returns false if the file can't be read
+	bool LoadInputScript( const std::string& fileAndPath );
+	// Gets the number of frames which have been run
+	int GetFrameCount() const { return m_frameCount; }
+	// Gets a copy of the display buffer from the last time it was presented
+	const PixelData& GetPresentedFrame() const { return m_presentedFrame; }
+#endif
 	// Copies the display buffer pixels to the window
 	// > Returns the time taken for the present in seconds
 	double Present();
@@ -512,9 +730,20 @@ public:
 	//********************************************************************************************************************************
 
 	// Reads the width and height of a png image
-	static int ReadPNGImage( std::string& fileAndPath, int& width, int& height );
+	static int ReadPNGImage( const std::string& fileAndPath, int& width, int& height );
 	// Loads a png image and puts the image data into the destination image provided
-	static int LoadPNGImage( std::string& fileAndPath, PixelData& destImage );
+	static int LoadPNGImage( const std::string& fileAndPath, PixelData& destImage );
+	// Maps a whole file into memory as copy-on-write pages, so changes to the memory are never written back to the file
+	// > Returns nullptr if the file couldn't be mapped, otherwise pass the returned handle to UnmapFile when finished
+	static const void* MapFile( const std::string& fileAndPath, size_t& fileSize, void*& hMapping );
+	// Releases a file previously mapped using MapFile
+	static void UnmapFile( const void* pFile, void* hMapping );
+	// Removes part of a mapped file from the working set: the pages are reloaded automatically the next time they are used
+	static void ReleaseMappedPages( const void* pStart, size_t size );
+	// Converts a path written for Windows (e.g. "Data\\Sprites\\") to one which works on the current platform
+	static std::string GetPlatformPath( const std::string& path );
+	// Gets how much memory the process is using (its working set), or zero if the platform can't tell
+	static size_t GetProcessMemory();
 
 private:
 
@@ -542,10 +771,21 @@ private:
 	MouseData* m_pMouseData{ nullptr };
 	// Pointer to the instance.
 	static PlayWindow* s_pInstance;
+#ifndef PLAY_PLATFORM_HEADLESS
 	// The handle to the Window 
 	HWND m_hWindow{ nullptr };
-	// A GDI+ token
-	static unsigned long long s_pGDIToken;
+#else
+	// Applies the input events for the current frame
+	void ApplyInput();
+
+	// The input script, sorted by frame
+	std::vector< InputEvent > m_vInputEvents;
+	size_t m_nextInputEvent{ 0 };
+	int m_frameCount{ 0 };
+	// The offscreen copy of the display buffer
+	std::vector< Pixel > m_vPresentedPixels;
+	PixelData m_presentedFrame;
+#endif
 };
 
 #endif
@@ -571,6 +811,8 @@ public:
 
 	// Constructor
 	PlayBlitter( PixelData* pRenderTarget = nullptr );
+	// Destructor
+	~PlayBlitter();
 	// Set the render target for all subsequent drawing operations
 	// Returns a pointer to any previous render target
 	PixelData* SetRenderTarget( PixelData* pRenderTarget ) { PixelData* old = m_pRenderTarget; m_pRenderTarget = pRenderTarget; return old; }
@@ -588,15 +830,80 @@ public:
 	// Draws rotated and scaled pixel data to the render target (much slower than BlitPixels)
 	// > Setting alphaMultiply isn't a signfiicant additional slow down on RotateScalePixels
 	void RotateScalePixels( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, int originX, int originY, float angle, float scale, float alphaMultiply = 1.0f ) const;
+	// Draws scaled (but not rotated) pixel data to the render target, scaling around the origin using the nearest pixels
+	// > Much faster than RotateScalePixels, and uses the same pre-multiplied fast path as BlitPixels when alphaMultiply is 1
+	// > The scale must be positive, so mirrored drawing still has to use RotateScalePixels
+	void ScalePixels( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, int originX, int originY, float scale, float alphaMultiply = 1.0f ) const;
 	// Clears the render target using the given pixel colour
 	void ClearRenderTarget( Pixel colour );
 	// Copies a background image of the correct size to the render target
 	void BlitBackground( PixelData& backgroundImage );
 
+	// Composite functions
+	//********************************************************************************************************************************
+
+	// Clears an area of the render target to fully transparent, ready for pixel data to be composed into it
+	void ClearComposite( int left, int top, int right, int bottom );
+	// Draws pre-multiplied pixel data into the render target keeping the combined transparency, so the render target can be
+	// drawn with BlitPixels afterwards just like a sprite
+	// > Only pixels inside the clip rectangle are written (right and bottom are exclusive)
+	void ComposePixels( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, int clipLeft, int clipTop, int clipRight, int clipBottom ) const;
+
+	// Coverage culling functions
+	//********************************************************************************************************************************
+
+	// Creates (or frees) a per-pixel coverage mask for the current render target
+	// > Only drawing into that render target is culled, other targets are unaffected
+	void EnableCoverage( bool enable );
+	// Resets the coverage mask ready for a new front-to-back pass
+	// > Only the rows which were covered in the last pass are cleared
+	void ClearCoverage();
+	// Marks a horizontal run of pixels as covered by fully opaque pixels on the given layer
+	void AddCoverageSpan( int posX, int posY, int length, uint8_t layer );
+	// Sets the layer for subsequent drawing: pixels covered by a higher layer are not written
+	void SetCoverageLayer( uint8_t layer ) { m_coverageLayer = layer; }
+
+	// Overdraw functions
+	//********************************************************************************************************************************
+
+	// Creates (or frees) a per-pixel count of how many times each pixel of the current render target is written
+	void EnableOverdrawCount( bool enable );
+	// Replaces the render target contents with a heat-map of the overdraw counts
+	void DrawOverdrawHeatmap();
+	// Resets the overdraw counts ready for the next frame
+	void ResetOverdrawCount();
+
 private:
 
+	// Returns true if drawing into the current render target needs to test the coverage mask
+	bool IsCoverageCulling() const { return m_pCoverage && m_pRenderTarget == m_pCoverageTarget && m_coverageLayer < m_coverageMaxLayer; }
+	// Returns true if writes to the current render target need to be counted
+	bool IsCountingOverdraw() const { return m_pOverdraw && m_pRenderTarget == m_pOverdrawTarget; }
+	// Copies (or fills) a row of the render target, skipping any pixels covered by a higher layer
+	void CopyUncoveredRow( uint32_t* pDest, const uint32_t* pSrc, uint32_t fill, int row ) const;
+	// Rewrites the transparent run lengths in a row of a composite after the pixels from startX to endX have changed
+	void EncodeCompositeRow( int row, int startX, int endX ) const;
+	// Counts the pixels written by a BlitPixels call which isn't coverage culled
+	void CountBlitOverdraw( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight ) const;
+
 	PixelData* m_pRenderTarget{ nullptr };
 
+	// The coverage mask stores the layer of the front-most opaque pixel covering each pixel (0 = uncovered)
+	PixelData* m_pCoverageTarget{ nullptr };
+	uint8_t* m_pCoverage{ nullptr };
+	// The horizontal extent of the coverage on each row (min > max when a row has no coverage)
+	int* m_pCoverageRowMin{ nullptr };
+	int* m_pCoverageRowMax{ nullptr };
+	uint8_t m_coverageLayer{ 0 };
+	uint8_t m_coverageMaxLayer{ 0 };
+
+	// The number of times each pixel has been written since the last heat-map was drawn
+	PixelData* m_pOverdrawTarget{ nullptr };
+	uint8_t* m_pOverdraw{ nullptr };
+
+	// The source column for each destination column in the last ScalePixels call (kept so it isn't allocated for every draw)
+	mutable std::vector<int> m_scaleColumns;
+
 };
 
 #endif
@@ -661,7 +968,13 @@ public:
 	// Updates a sprite sheet dynamically from memory (custom asset pipelines)
 	// > Left to caller to release old PixelData
 	int UpdateSprite( const std::string& name, PixelData& pixelData, int hCount = 1, int vCount = 1 );
-	
+	// Adds a copy of a sprite which is scaled down in advance, so it can be drawn at that size with Draw() instead of DrawRotated()
+	// > The copy has no canvas, so it can't be coloured, and it's never evicted as there's nothing to reload it from
+	int AddScaledSprite( int spriteId, float scale );
+	// Replaces a scaled copy made by AddScaledSprite() with a new one, keeping its id and freeing the old pixel data
+	// > Lets a scaled copy be reused for another scale (or another sprite) rather than adding a new one each time
+	void UpdateScaledSprite( int scaledId, int spriteId, float scale );
+
 	// Loads a background image which is assumed to be the same size as the display buffer
 	// > Returns the index of the loaded background
 	int LoadBackground( const char* fileAndPath );
@@ -691,6 +1004,53 @@ public:
 	// Gets the number of sprites which have been loaded and created by PlayGraphics
 	int GetTotalLoadedSprites() const { return m_nTotalSprites; }
 
+	// Sprite memory functions
+	//********************************************************************************************************************************
+
+	// Sets the most sprite pixel data (in bytes) to keep in memory, or zero for no limit (the default)
+	// > Sprites which haven't been drawn recently are evicted at the end of the frame and reloaded the next time they're used
+	void SetSpriteMemoryBudget( size_t bytes ) { m_spriteMemoryBudget = bytes; }
+	// Gets the sprite memory budget in bytes (zero for no limit)
+	size_t GetSpriteMemoryBudget() const { return m_spriteMemoryBudget; }
+	// A sprite's canvas which has been decoded from its PNG by DecodeSprites() but not given to the sprite yet
+	struct DecodedSprite
+	{
+		int id{ -1 };
+		PixelData canvasBuffer;
+	};
+
+	// Loads the pixel data for any of the given sprites which have been evicted, decoding them in parallel
+	// > Use before a level transition so the new sprites don't have to be loaded individually when they're first drawn
+	void PreloadSprites( const std::vector<int>& spriteIds );
+	// Gets the ids of the sprites which have been evicted, in order, so a loading thread knows which ones to decode
+	std::vector<int> GetEvictedSprites() const;
+	// Decodes the canvases for the given sprites from their PNGs into new buffers, without changing the sprites themselves
+	// > Only reads each sprite's file and size, which never change once it's loaded, so it's safe to call from a loading thread
+	// > while the main thread is still drawing (as long as no sprites are being added)
+	std::vector<DecodedSprite> DecodeSprites( const std::vector<int>& spriteIds ) const;
+	// Gives decoded canvases to any of their sprites which are still evicted and makes them resident, freeing the rest
+	// > Changes the sprites and the resident list, so it must be called from the main thread
+	void AttachSprites( std::vector<DecodedSprite>& vDecoded );
+	// Frees decoded canvases which are no longer needed
+	static void DiscardSprites( std::vector<DecodedSprite>& vDecoded );
+	// Evicts the least recently used sprites until the pixel data in memory fits within the budget
+	// > Sprites drawn in the current frame are never evicted, so the budget can be exceeded if they don't fit
+	void TrimSpriteMemory();
+	// Gets the bytes of pixel data in memory for the sprite with the given id
+	size_t GetSpriteMemory( int spriteId ) const;
+	// Gets the bytes of pixel data in memory for all the sprites in a category
+	// > The category is the letters at the start of the sprite name e.g. "FONT" or "SPR"
+	size_t GetSpriteCategoryMemory( const char* category ) const;
+	// Gets the bytes of pixel data in memory for all the sprites
+	size_t GetTotalSpriteMemory() const { return m_spriteMemoryUsed; }
+	// Frees each sprite's original canvas once it has been pre-multiplied, roughly halving the sprite memory
+	// > Only sprites made mutable keep their canvas, and ColourSprite can't be used on the others
+	void EnableCompactSprites( bool enable );
+	// Returns true if compact sprites are enabled
+	bool IsCompactSpritesEnabled() const { return m_bCompactSprites; }
+	// Keeps the sprite's original canvas when compact sprites are enabled (reloading it if it has already been freed)
+	void MakeSpriteMutable( int spriteId );
+
 	// Sprite Drawing functions
 	//********************************************************************************************************************************
 
@@ -699,6 +1059,7 @@ public:
 	// Draw the sprite with transparency (slower than without transparency)
 	void DrawTransparent( int spriteId, Point2f pos, int frameIndex, float alphaMultiply ) const; // This just to force people to consider when they use an explicit alpha multiply
 	// Draw the sprite rotated with transparency (slowest draw)
+	// > Sprites which are only scaled (angle of zero) use a much faster scaling blit instead
 	void DrawRotated( int spriteId, Point2f pos, int frameIndex, float angle, float scale = 1.0f, float alphaMultiply = 1.0f ) const;
 	// Draws a previously loaded background image
 	void DrawBackground( int backgroundIndex = 0 );
@@ -707,9 +1068,9 @@ public:
 	void ColourSprite( int spriteId, int r, int g, int b );
 
 	// Draws a string using a sprite-based font exported from PlayFontTool
-	int DrawString( int fontId, Point2f pos, std::string text ) const;
+	int DrawString( int fontId, Point2f pos, const char* text ) const;
 	// Draws a centred string using a sprite-based font exported from PlayFontTool
-	int DrawStringCentred( int fontId, Point2f pos, std::string text ) const;
+	int DrawStringCentred( int fontId, Point2f pos, const char* text ) const;
 	// Draws an individual text character using a sprite-based font 
 	int DrawChar( int fontId, Point2f pos, char c ) const;
 	// Draws a rotated text character using a sprite-based font 
@@ -731,19 +1092,45 @@ public:
 		int originX{ 0 }, originY{ 0 }; // The origin and centre of rotation for the sprite (whole pixels only)
 		PixelData canvasBuffer; // The sprite image data
 		PixelData preMultAlpha; // The sprite data pre-multiplied with its own alpha
+		struct OpaqueSpan { int start, length; }; // A run of fully opaque pixels which never crosses a frame boundary
+		std::vector<OpaqueSpan> opaqueSpans; // The opaque runs in each row of the canvas (used for coverage culling)
+		std::vector<int> opaqueRowStart; // The index of the first opaque run in each row of the canvas (plus one for the end)
+		std::string fileAndPath; // The PNG the sprite was loaded from (empty if it was added from memory)
+		bool mapped{ false }; // Whether the pixel data is mapped from the sprite cache rather than owned by the sprite
+		bool resident{ false }; // Whether the pixel data is counted as being in memory (see SetSpriteMemoryBudget)
+		size_t residentBytes{ 0 }; // The memory counted for the sprite while it's resident
+		int lastUsedFrame{ -1 }; // The last frame the sprite was drawn in, so it isn't evicted while it's still in use
+		std::list<int>::iterator lruEntry; // The sprite's place in the resident list (only valid when resident)
+		Pixel tint{ 0x00FFFFFF }; // The colour from ColourSprite, which is applied again whenever the sprite is reloaded
+		uint64_t cacheCanvasOffset{ 0 }; // Where the canvas is in the sprite cache (mapped sprites only)
+		bool mutableCanvas{ false }; // Whether the canvas is kept when compact sprites are enabled (see MakeSpriteMutable)
+		bool font{ false }; // Whether the sprite is a font (in the "FONT" category, or drawn as one), so CompactSprite keeps its character widths
+		std::vector<uint8_t> fontWidths; // The character widths for fonts, copied from the canvas before it's freed
 		Sprite() = default;
 	};
 
+	// Composite functions
+	//********************************************************************************************************************************
+
+	// Clears an area of a composite to fully transparent, ready for sprites to be composed into it
+	void ClearComposite( PixelData& composite, Point2f topLeft, Point2f bottomRight );
+	// Draws a sprite into a composite, keeping its transparency so the composite can be drawn on top of other things later
+	// > Only the pixels inside the clip rectangle are changed
+	void Compose( PixelData& composite, int spriteId, Point2f pos, int frameIndex, Point2f clipTopLeft, Point2f clipBottomRight );
+	// Draws a composite into the display buffer (as quickly as drawing a sprite)
+	void DrawComposite( const PixelData& composite, Point2f pos ) const;
+
 	// Miscellaneous functions
 	//********************************************************************************************************************************
 
 	// Gets a pointer to the drawing buffer's pixel data
 	PixelData* GetDrawingBuffer( void ) { return &m_playBuffer; }
 	// Resets the timing bar data and sets the current timing bar segment to a specific colour
-	void TimingBarBegin( Pixel pix );
+	// > The timing bar is drawn from PlayProfiler's segments, which it also includes in its traces under their names
+	void TimingBarBegin( Pixel pix, const char* name );
 	// Sets the current timing bar segment to a specific colour
 	// > Returns the number of timing segments
-	int SetTimingBarColour( Pixel pix );
+	int SetTimingBarColour( Pixel pix, const char* name );
 	// Draws the timing bar for the previous frame at the given position and size
 	void DrawTimingBar( Point2f pos, Point2f size );
 	// Gets the duration (in milliseconds) of a specific timing segment
@@ -753,6 +1140,28 @@ public:
 	// Sets the render target for drawing operations
 	PixelData* SetRenderTarget( PixelData* renderTarget ) { return m_blitter.SetRenderTarget( renderTarget ); }
 
+	// Coverage culling functions
+	//********************************************************************************************************************************
+
+	// Enables front-to-back coverage culling of drawing into the display buffer
+	// > Occluders added each frame stop anything drawn on a lower layer from writing the pixels they cover
+	void EnableCoverageCulling( bool enable );
+	// Clears the previous frame's occluders ready for a new front-to-back pass
+	void BeginCoveragePass() { m_blitter.ClearCoverage(); }
+	// Marks the fully opaque pixels of a sprite as covering the display buffer on the given layer (1-255)
+	// > The sprite itself still needs to be drawn, on the same layer or higher
+	void AddOccluder( int spriteId, Point2f pos, int frameIndex, int layer );
+	// Sets the layer for all subsequent drawing (0-255)
+	void SetDrawLayer( int layer ) { m_blitter.SetCoverageLayer( static_cast<uint8_t>( std::clamp( layer, 0, 255 ) ) ); }
+	// Enables counting of how many times each display buffer pixel is written each frame
+	void EnableOverdrawHeatmap( bool enable ) { PixelData* old = m_blitter.SetRenderTarget( &m_playBuffer ); m_blitter.EnableOverdrawCount( enable ); m_blitter.SetRenderTarget( old ); m_bOverdrawHeatmap = enable; }
+	// Returns true if overdraw is being counted
+	bool IsOverdrawHeatmapEnabled() const { return m_bOverdrawHeatmap; }
+	// Replaces the display buffer contents with a heat-map of this frame's overdraw
+	void DrawOverdrawHeatmap() { m_blitter.DrawOverdrawHeatmap(); }
+	// Resets the overdraw counts ready for the next frame
+	void ResetOverdrawCount() { m_blitter.ResetOverdrawCount(); }
+
 
 
 private:
@@ -775,11 +1184,136 @@ private:
 	// Multiplies the sprite image by its own alpha transparency values to save repeating this calculation on every draw
 	// > A colour multiplication can also be applied at this stage, which affects all subseqent drawing operations on the sprite
 	void PreMultiplyAlpha( Pixel* source, Pixel* dest, int width, int height, int maxSkipWidth, float alphaMultiply, Pixel colourMultiply );
+	// Finds the runs of fully opaque pixels in the pre-multiplied sprite data which can be used as occluders
+	void FindOpaqueSpans( Sprite& s );
+	// Sets up a sprite from a decoded sprite sheet without adding it to the sprite list
+	// > Doesn't use any shared state, so sprites can be prepared on several threads at once
+	void PrepareSprite( Sprite& s, const std::string& name, PixelData& pixelData, int hCount, int vCount );
+	// Gives a prepared sprite the next id and adds it to the sprite list
+	int InsertSprite( Sprite& s );
+	// Prepares a scaled down copy of a sprite, for AddScaledSprite() and UpdateScaledSprite()
+	void ScaleSprite( int spriteId, float scale, Sprite& s );
+
+	// Internal functions relating to sprite memory
+	//********************************************************************************************************************************
+
+	// Gets a sprite for drawing, reloading its pixel data first if it has been evicted
+	// > Residency is just a cache of the sprite data, so this is allowed from const drawing functions
+	Sprite& UseSprite( int spriteId ) const;
+	// Decodes the pixel data for an evicted sprite from its PNG
+	// > Doesn't use any shared state, so sprites can be decoded on several threads at once
+	bool DecodeSpritePixels( Sprite& s );
+	// Loads a sprite's original canvas from its PNG, failing if it isn't the size the sprite was loaded with
+	bool LoadSpriteCanvas( const Sprite& s, PixelData& canvasBuffer ) const;
+	// Gives a sprite the canvas loaded for it and pre-multiplies it, without making it resident
+	void SetSpriteCanvas( Sprite& s, const PixelData& canvasBuffer );
+	// Adds a sprite to the front of the resident list and counts its memory
+	void AddResidentSprite( Sprite& s );
+	// Removes a sprite from the resident list and stops counting its memory
+	void RemoveResidentSprite( Sprite& s );
+	// Frees a sprite's pixel data, or releases its pages if it's mapped from the sprite cache
+	void EvictSprite( Sprite& s );
+	// Frees a sprite's original canvas if compact sprites are enabled, keeping any font widths from it first
+	// > Only changes the memory counted for the sprite if it's resident, so it can be used from DecodeSpritePixels
+	void CompactSprite( Sprite& s );
+	// Reloads the original canvas for a sprite which has been compacted
+	bool RestoreSpriteCanvas( Sprite& s );
+
+	// The resident sprite ids, most recently used first
+	std::list<int> m_residentSprites;
+	// The sprite memory budget and the amount currently in use (in bytes)
+	size_t m_spriteMemoryBudget{ 0 };
+	size_t m_spriteMemoryUsed{ 0 };
+	// Counts the frames so sprites which are still being drawn aren't evicted
+	int m_residencyFrame{ 0 };
+	// Whether the original canvases are freed after pre-multiplying
+	bool m_bCompactSprites{ false };
+
+	// Internal functions relating to the sprite cache
+	//********************************************************************************************************************************
+
+	// Maps the cooked sprite cache into memory, first replacing it with any newer cache written by the previous run
+	void OpenSpriteCache( const std::string& cacheFile );
+	// Sets up a sprite directly from the mapped sprite cache, as long as its PNG hasn't changed since it was cooked
+	// > Returns false if there is no valid cache entry for the PNG
+	bool ReadCachedSprite( const std::string& fileAndPath, const std::string& spriteName, const std::string& infoFile, Sprite& s );
+	// Sets up an evicted sprite from just the size in its PNG's header, its name and its .inf file, so it's decoded when it's first used
+	// > Returns false if the PNG can't be read
+	bool ReadUncachedSprite( const std::string& fileAndPath, const std::string& spriteName, const std::string& infoFile, Sprite& s );
+	// Cooks all the sprites which were loaded from PNGs into a new cache file, which replaces the current one on the next run
+	// > Sprites mapped from the current cache keep their entries' hashes and are copied across as they are, so only new or changed PNGs are processed
+	// > The new or changed PNGs are decoded and written one at a time, so they don't all need to be in memory at once
+	void WriteSpriteCache( const std::string& cacheFile );
+
+	// The header at the start of the sprite cache
+	struct SpriteCacheHeader
+	{
+		char magic[4]{ 'P','B','S','C' };
+		uint32_t version{ 0 };
+		uint32_t spriteCount{ 0 };
+		uint32_t reserved{ 0 };
+	};
+
+	// The manifest entry for each sprite in the cache: offsets are from the start of the file
+	struct SpriteCacheEntry
+	{
+		char name[128]{ 0 }; // The upper-case sprite name
+		int64_t pngTime{ 0 }, infTime{ 0 }; // The last write times of the source files (zero if there's no .inf)
+		uint64_t pngSize{ 0 };
+		uint32_t pngHash{ 0 }; // Used to spot PNGs which have been touched but haven't changed
+		int32_t hCount{ 0 }, vCount{ 0 };
+		int32_t canvasWidth{ 0 }, canvasHeight{ 0 };
+		int32_t originX{ 0 }, originY{ 0 };
+		uint32_t spanCount{ 0 };
+		uint64_t canvasOffset{ 0 }, preMultOffset{ 0 }, spanRowOffset{ 0 }, spanOffset{ 0 };
+	};
+
+	// The memory-mapped sprite cache
+	const uint8_t* m_pSpriteCache{ nullptr };
+	void* m_hSpriteCacheMapping{ nullptr };
+	size_t m_spriteCacheSize{ 0 };
+	// The valid manifest entries in the mapped cache, and how many of them have been used
+	std::map< std::string, const SpriteCacheEntry* > m_spriteCacheEntries;
+	int m_nCachedSpritesUsed{ 0 };
+	// Whether the cache needs re-cooking because a PNG was added or changed
+	bool m_bSpriteCacheStale{ false };
+
+	// Internal functions relating to the worker threads
+	//********************************************************************************************************************************
+
+	// A ParallelFor() call which the worker threads can help with
+	struct ParallelJob
+	{
+		int count{ 0 };
+		std::atomic<int> next{ 0 }; // The next index to hand out
+		int workers{ 0 }; // The worker threads still running indices from the job (guarded by m_jobMutex)
+		void* pFunction{ nullptr };
+		void ( *pInvoke )( void* pFunction, int index ){ nullptr };
+	};
+
+	// Calls the function for every index from 0 to count-1, sharing the work between the worker threads and the calling thread
+	// > The order the indices are processed in isn't defined, so the function mustn't depend on it
+	// > Can be called from several threads at once, e.g. by a level loading in the background while the main thread draws
+	template< typename Function > void ParallelFor( int count, Function function ) const;
+	// Runs indices from a job until they've all been handed out
+	static void RunParallelJob( ParallelJob& job );
+	// Helps with each ParallelFor() call in turn until the workers are stopped
+	void WorkerThread() const;
+
+	// Started once with the singleton so ParallelFor() doesn't create threads every time it's called
+	std::vector< std::thread > m_vWorkers;
+	mutable std::mutex m_jobMutex;
+	mutable std::condition_variable m_jobAdded;
+	mutable std::condition_variable m_jobFinished;
+	mutable std::vector< ParallelJob* > m_vJobs;
+	bool m_bStopWorkers{ false };
 
 	// Count of the total number of sprites loaded
 	int m_nTotalSprites{ 0 };
 	// Whether the singleton has been initialised yet
 	bool m_bInitialised{ false };
+	// Whether overdraw is being counted for the heat-map
+	bool m_bOverdrawHeatmap{ false };
 
 	// Allocates a buffer for the debug font and copies the font pixel data to it
 	void DecompressDubugFont( void );
@@ -787,21 +1321,6 @@ private:
 	int GetDebugStringWidth( const std::string& s );
 	// Draws the offset points from the origin in all octants
 	void DrawCircleOctants( int posX, int posY, int offX, int offY, Pixel pix );
-	// Ends the current timing segment and calculates the duration
-	LARGE_INTEGER EndTimingSegment();
-
-	struct TimingSegment
-	{
-		Pixel pix;
-		long long begin{ 0 };
-		long long end{ 0 };
-		float millisecs{ 0 };
-	};
-
-	// Vectors of timing data segments
-	std::vector<TimingSegment> m_vTimings;
-	std::vector<TimingSegment> m_vPrevTimings;
-
 	// The PlayBlitter used for drawing
 	PlayBlitter m_blitter;
 
@@ -863,8 +1382,23 @@ private:
 	// The copy operator is removed to prevent copying of a singleton class
 	PlayAudio( const PlayAudio& ) = delete;
 
-	// Vector of mp3 strings
-	std::vector< std::string > vSoundStrings;
+	// Sends a command to the audio device (the headless version has no device, so the sounds are never heard)
+	void SendCommand( const char* command );
+
+	// An mp3 and the commands for it, which are made when it's loaded so playing it doesn't build strings
+	struct Sound
+	{
+		std::string alias; // The upper case path
+		std::string playCommand;
+		std::string loopCommand;
+		std::string stopCommand;
+	};
+
+	// Finds a sound by part or all of its name
+	const Sound* FindSound( const char* name ) const;
+
+	// Vector of mp3s
+	std::vector< Sound > vSounds;
 	// Pointer to the singleton
 	static PlayAudio* s_pInstance;
 };
@@ -876,12 +1410,13 @@ private:
 //********************************************************************************************************************************
 // File:		PlayInput.h
 // Description:	Manages keyboard and mouse input 
-// Platform:	Windows
-// Notes:		Obtains mouse data from PlayWindow via MouseData structure
+// Platform:	Windows / Headless
+// Notes:		Obtains mouse data from PlayWindow via MouseData structure. The headless version's keys are set by PlayWindow
 //********************************************************************************************************************************
 
 // Manages keyboard and mouse input 
 // > Singleton class accessed using PlayInput::Instance()
+// > The input is latched for each frame, so it doesn't change part way through one (and can be recorded and replayed)
 class PlayInput
 {
 public:
@@ -892,6 +1427,14 @@ public:
 		BUTTON_RIGHT
 	};
 
+	// The input seen during a frame
+	struct FrameInput
+	{
+		uint32_t keys[8]{}; // A bit for each virtual key code which is held down
+		Point2f mousePos{ 0.0f, 0.0f };
+		uint32_t mouseButtons{ 0 }; // Bit 0 is the left button and bit 1 is the right
+	};
+
 	// Instance functions
 	//********************************************************************************************************************************
 
@@ -906,16 +1449,30 @@ public:
 	// Returns the status of the supplied mouse button (0=left, 1=right)
 	bool GetMouseDown( MouseButton button ) const;
 	// Get the screen position of the mouse cursor
-	Point2f GetMousePos() const { return m_mouseData.pos; }
+	Point2f GetMousePos() const { return m_frameInput.mousePos; }
 	// Returns true if the key has been pressed since it was last released
 	// > https://docs.microsoft.com/en-us/windows/win32/inputdev/virtual-key-codes
 	bool KeyPressed( int vKey );
 	// Returns true if the key is currently being held down
 	// > https://docs.microsoft.com/en-us/windows/win32/inputdev/virtual-key-codes
 	bool KeyDown( int vKey );
+#ifdef PLAY_PLATFORM_HEADLESS
+	// Sets whether a key is being held down, as there's no keyboard to ask
+	void SetKeyDown( int vKey, bool down ) { m_keys[vKey & 0xFF] = down; }
+#endif
 
 	MouseData* GetMouseData( void ) { return &m_mouseData; }
 
+	// Frame latching functions
+	//********************************************************************************************************************************
+
+	// Starts latching the input for a new frame: the mouse is latched now, and each key the first time it's asked about
+	void BeginFrame();
+	// Gets the input latched during this frame (keys which haven't been asked about are up)
+	const FrameInput& GetFrameInput() const { return m_frameInput; }
+	// Replaces the input for this frame, e.g. with one from a replay
+	void SetFrameInput( const FrameInput& frameInput );
+
 private:
 
 	// Constructor / destructor
@@ -930,8 +1487,19 @@ private:
 	// The copy constructor is removed to prevent copying of a singleton class
 	PlayInput( const PlayInput& ) = delete;
 
+	// Asks the platform whether a key is being held down right now
+	bool SampleKey( int vKey ) const;
 
 	MouseData m_mouseData;
+	FrameInput m_frameInput;
+	// A bit for each key which has been latched during this frame
+	uint32_t m_keysLatched[8]{};
+	// Whether each key was down when KeyPressed() last asked about it
+	bool m_keysHeld[256]{};
+#ifdef PLAY_PLATFORM_HEADLESS
+	// Indexed by virtual key code
+	bool m_keys[256]{};
+#endif
 	// Pointer to the singleton
 	static PlayInput* s_pInstance;
 
@@ -940,114 +1508,657 @@ private:
 
 #endif
 
-
-#ifndef PLAY_PLAYMANAGER_H
-#define PLAY_PLAYMANAGER_H
+#ifndef PLAY_PLAYREPLAY_H
+#define PLAY_PLAYREPLAY_H
 //********************************************************************************************************************************
-// File:		PlayManager.h
-// Description:	A manager for providing simplified access to the PlayBuffer framework with managed GameObjects
+// File:		PlayReplay.h
+// Description:	Records the input for each frame, along with the random seed, so a session can be replayed exactly
 // Platform:	Independent
-// Notes:		The GameObject management is "opt in" as many will want to create their own GameObject class
+// Notes:		Recording starts with "--record=<file>" on the command line, and replaying with "--replay=<file>"
 //********************************************************************************************************************************
 
-#ifdef PLAY_USING_GAMEOBJECT_MANAGER
-
-#ifndef PLAY_ADD_GAMEOBJECT_MEMBERS
-#define PLAY_ADD_GAMEOBJECT_MEMBERS 
-#endif
+constexpr uint32_t REPLAY_FILE_VERSION = 1;
 
-// PlayManager manges a map of GameObject structures
-// > Additional member variables can be added with PLAY_ADD_GAMEOBJECT_MEMBERS 
-struct GameObject
+// Records and replays the input latched by PlayInput each frame
+// > Singleton class accessed using PlayReplay::Instance()
+// > A checksum of the game's state is stored for every frame, so a replay which goes out of sync with its recording is spotted straight away
+// > Recordings and replays are given a fixed frame time, and replays run as fast as they can
+class PlayReplay
 {
-	GameObject( int type, Point2D pos, int collisionRadius, int spriteId );
+public:
+	// Instance functions
+	//********************************************************************************************************************************
 
-	// Default member variables: don't change these!
-	int type{ -1 };
-	int spriteId{ -1 };
-	Point2D pos{ 0.0f, 0.0f };
-	Point2D oldPos{ 0.0f, 0.0f };
-	Vector2D velocity{ 0.0f, 0.0f };
-	Vector2D acceleration{ 0.0f, 0.0f };
-	float rotation{ 0.0f };
-	float rotSpeed{ 0.0f };
-	float oldRot{ 0.0f };
-	int frame{ 0 };
-	float framePos{ 0.0f };
-	float animSpeed{ 0.0f };
-	int radius{ 0 };
-	float scale{ 1 };
-	PLAY_ADD_GAMEOBJECT_MEMBERS
+	// Creates / Returns the PlayReplay instance
+	static PlayReplay& Instance();
+	// Destroys the PlayReplay instance
+	static void Destroy();
 
-	int GetId() { return m_id; }
+	// Recording and replaying functions
+	//********************************************************************************************************************************
+
+	// Starts recording, which picks a new random seed (call before MainGameEntry so the game is seeded with it)
+	void StartRecording( const std::string& fileAndPath );
+	// Starts replaying a recording, which sets the random seed to the recorded one (call before MainGameEntry)
+	// > Returns false if the file is missing or isn't a valid recording
+	bool StartReplay( const std::string& fileAndPath );
+	// Writes the recording out or reports how the replay went
+	// > Returns false if a recording couldn't be written or a replay went out of sync
+	bool Stop();
+	// Returns true while recording
+	bool IsRecording() const { return m_mode == MODE_RECORD; }
+	// Returns true while replaying
+	bool IsReplaying() const { return m_mode == MODE_REPLAY; }
+	// Returns true once every frame of a replay has been played
+	bool IsFinished() const { return m_mode == MODE_REPLAY && m_frameCount >= m_header.frameCount; }
+	// Gets the seed for the random number generator: the recorded one when replaying, otherwise it comes from the time
+	unsigned int GetRandomSeed() const { return m_header.seed; }
+	// Gets the number of frames recorded or replayed so far
+	int GetFrameCount() const { return static_cast<int>( m_frameCount ); }
+	// Gets the first frame of a replay which didn't match its recording (-1 if they all have)
+	int GetDesyncFrame() const { return m_desyncFrame; }
+	// Sets the function which sums up the game's state at the end of each frame
+	// > The manager sets this to GetGameObjectChecksum() for games which use its GameObjects
+	void SetChecksumFunction( uint32_t( *pChecksumFunction )() ) { m_pChecksumFunction = pChecksumFunction; }
+	// Computes a checksum (FNV-1a), continuing from a previous one if it's given
+	static uint32_t Checksum( const void* pData, size_t size, uint32_t checksum = 2166136261u );
+
+	// Frame functions (called by PlayWindow around MainGameUpdate)
+	//********************************************************************************************************************************
+
+	// Latches the input for the frame, which is replaced with the recorded input when replaying
+	void BeginFrame();
+	// Records the frame's input and checksum, or checks the checksum against the recorded one
+	void EndFrame();
+
+	// The header at the start of a recording
+	struct Header
+	{
+		char magic[4]{ 'P','R','E','C' };
+		uint32_t version{ REPLAY_FILE_VERSION };
+		uint32_t seed{ 0 };
+		uint32_t frameCount{ 0 };
+	};
 
 private:
-	// The GameObject's id should never be changed manually so we make it private!
-	int m_id{ -1 };
+	// Constructor / destructor
+	//********************************************************************************************************************************
 
-	// Preventing assignment and copying reduces the potential for bugs
-	GameObject& operator=( const GameObject& ) = delete;
-	GameObject( const GameObject& ) = delete;
+	// Private constructor
+	PlayReplay();
+	// Private destructor
+	~PlayReplay();
+	// The assignment operator is removed to prevent copying of a singleton class
+	PlayReplay& operator=( const PlayReplay& ) = delete;
+	// The copy constructor is removed to prevent copying of a singleton class
+	PlayReplay( const PlayReplay& ) = delete;
+
+	// Each frame is stored as a flags byte, then its input if it's changed since the last frame, then its checksum
+	static constexpr uint8_t FRAME_INPUT_CHANGED = 1;
+
+	enum Mode
+	{
+		MODE_OFF = 0,
+		MODE_RECORD,
+		MODE_REPLAY
+	};
+
+	Mode m_mode{ MODE_OFF };
+	std::string m_fileAndPath;
+	Header m_header;
+	// The frames after the header, which are all read in before a replay or written out at the end of a recording
+	std::vector< uint8_t > m_vFrameData;
+	size_t m_framePos{ 0 };
+	uint32_t m_frameCount{ 0 };
+	PlayInput::FrameInput m_lastInput;
+	int m_desyncFrame{ -1 };
+	uint32_t( *m_pChecksumFunction )() { nullptr };
+
+	// Pointer to the singleton
+	static PlayReplay* s_pInstance;
 };
 
 #endif
 
-namespace Play
+#ifndef PLAY_PLAYPROFILER_H
+#define PLAY_PLAYPROFILER_H
+//********************************************************************************************************************************
+// File:		PlayProfiler.h
+// Description:	Times named, nested zones on every thread, and keeps the last few seconds of them for exporting as a trace
+// Platform:	Independent
+// Notes:		The timing bar's segments are kept here as well, on a track of their own
+//********************************************************************************************************************************
+
+constexpr int PROFILER_HISTORY_SECONDS = 10;
+constexpr const char* PROFILER_TRACE_FILENAME = "profile.json";
+// Frame time statistics are taken over this many frames
+constexpr int PROFILER_STATS_FRAMES = 600;
+// Timing bar segments with further names aren't included in the statistics
+constexpr int PROFILER_MAX_STATS_SEGMENTS = 16;
+// Hitch dumps cover this many seconds before the hitch, and there's at most one dump in this time
+constexpr int PROFILER_HITCH_SECONDS = 5;
+constexpr const char* PROFILER_HITCH_FILENAME = "hitch";
+// Each thread's zones are kept in a ring of this size, so a busy thread may keep less history than the frames do
+constexpr int PROFILER_TRACK_EVENTS = 1 << 16;
+// The engine's counters and any the game registers share this many slots
+constexpr int PROFILER_MAX_COUNTERS = 32;
+
+// The counters the engine adds to, which are always registered in this order
+enum PlayCounter
+{
+	COUNTER_SPRITE_DRAWS = 0,
+	COUNTER_SPRITES_CULLED, // Entirely outside the render target
+	COUNTER_PLAIN_BLITS,
+	COUNTER_SCALED_BLITS,
+	COUNTER_ROTATED_BLITS,
+	COUNTER_PIXELS_WRITTEN, // By all three kinds of blit
+	COUNTER_PIXELS_SKIPPED, // Transparent or hidden by the coverage mask, within the clipped area of a blit
+	COUNTER_CIRCLE_TESTS,
+	COUNTER_OBJECTS_CREATED,
+	COUNTER_OBJECTS_DESTROYED,
+	COUNTER_AUDIO_COMMANDS,
+	COUNTER_ENGINE_COUNT
+};
+
+#define PLAY_PROFILE_CONCAT_INNER( a, b ) a##b
+#define PLAY_PROFILE_CONCAT( a, b ) PLAY_PROFILE_CONCAT_INNER( a, b )
+// Times the rest of the enclosing scope as a zone with the given name (which must be a string literal or otherwise outlive the profiler)
+#define PLAY_PROFILE_ZONE( name ) PlayProfiler::Zone PLAY_PROFILE_CONCAT( playProfileZone, __LINE__ )( name )
+// Times the rest of the enclosing function as a zone named after it
+#define PLAY_PROFILE_FUNCTION() PLAY_PROFILE_ZONE( __FUNCTION__ )
+
+// Records zones into a ring buffer for each thread, which only that thread writes to so no locks are needed
+// > Singleton class accessed using PlayProfiler::Instance(), which CreateManager() creates before any other threads can use it
+// > The trace can be saved with F3, or when the game exits by passing "--profile=<file>" on the command line
+// > Frames which take longer than the hitch threshold are dumped automatically, along with the frames' input and allocations
+class PlayProfiler
 {
-	// Alignment for font drawing operations
-	enum Align
+public:
+	// Instance functions
+	//********************************************************************************************************************************
+
+	// Creates / Returns the PlayProfiler instance
+	static PlayProfiler& Instance();
+	// Destroys the PlayProfiler instance
+	static void Destroy();
+
+	struct Track;
+
+	// Times a scope: use PLAY_PROFILE_ZONE() rather than creating these directly
+	class Zone
 	{
-		LEFT = 0,
-		RIGHT,
-		CENTRE,
+	public:
+		Zone( const char* name );
+		~Zone();
+		Zone( const Zone& ) = delete;
+		Zone& operator=( const Zone& ) = delete;
+
+	private:
+		const char* m_name;
+		Track* m_pTrack{ nullptr };
+		long long m_begin{ 0 };
+#ifdef _DEBUG
+		uint32_t m_allocations{ 0 };
+		size_t m_allocationBytes{ 0 };
+#endif
 	};
 
-	enum Direction
+	// A section of a frame on the timing bar
+	struct Segment
 	{
-		HORIZONTAL = 0,
-		VERTICAL,
-		ALL,
+		const char* name{ nullptr };
+		Pixel pix;
+		long long begin{ 0 };
+		long long end{ 0 };
+		float millisecs{ 0 };
 	};
 
-	enum DrawingSpace
+	// Frame time percentiles (in milliseconds) over the last PROFILER_STATS_FRAMES frames
+	struct FrameStats
 	{
-		WORLD = 0,
-		SCREEN,
+		float p50{ 0 };
+		float p95{ 0 };
+		float p99{ 0 };
+		float max{ 0 };
+		int overBudget{ 0 }; // Frames which took longer than 1/FRAMES_PER_SECOND
+		int frames{ 0 }; // Less than PROFILER_STATS_FRAMES until there have been that many
 	};
 
-	// PlayManager uses colour values from 0-100 for red, green, blue and alpha
-	struct Colour
+	// What happened in a frame of the main loop, which the last few seconds of are kept for traces and hitch dumps
+	struct FrameRecord
 	{
-		Colour( float r, float g, float b ) : red( r ), green( g ), blue( b ) {}
-		Colour( int r, int g, int b ) : red( static_cast<float>( r ) ), green( static_cast<float>( g ) ), blue( static_cast<float>( b ) ) {}
-		float red, green, blue;
+		long long begin{ 0 };
+		long long end{ 0 };
+		uint32_t allocations{ 0 }; // Made during the frame (debug builds only)
+		uint32_t allocationBytes{ 0 };
+		uint32_t liveAllocations{ 0 }; // At the end of the frame (debug builds only)
+		PlayInput::FrameInput input;
+		uint32_t counters[PROFILER_MAX_COUNTERS]{};
 	};
 
-	extern Colour cBlack, cRed, cGreen, cBlue, cMagenta, cCyan, cYellow, cOrange, cWhite, cGrey;
+	// Frame and timing bar functions (main thread only)
+	//********************************************************************************************************************************
 
-	// Manager creation and deletion
-	//**************************************************************************************************
+	// Starts a new frame, with its first timing bar segment
+	void BeginFrame( Pixel pix, const char* segmentName );
+	// Ends the current timing bar segment and starts another
+	// > Returns the number of segments in this frame
+	int BeginSegment( Pixel pix, const char* segmentName );
+	// Brings the current segment's end up to now (it carries on until the next one begins)
+	void EndSegment();
+	// Gets the current frame's segments
+	const std::vector< Segment >& GetSegments() const { return m_vSegments; }
+	// Gets the previous frame's segments
+	const std::vector< Segment >& GetPreviousSegments() const { return m_vPrevSegments; }
+
+	// Frame time statistics functions (main thread only)
+	//********************************************************************************************************************************
 
-	// Initialises the managers and creates a window of the required dimensions
-	void CreateManager( int width, int height, int scale );
-	// Shuts down the managers and closes the window
-	void DestroyManager();
+	// Gets the percentiles for the whole frame
+	// > The percentiles are only worked out when they're asked for, so recording the frame times costs next to nothing
+	FrameStats GetFrameStats() const { return CalculateStats( m_vFrameTimes ); }
+	// Gets the number of differently named timing bar segments which have been seen
+	int GetStatsSegmentCount() const { return static_cast<int>( m_vSegmentHistories.size() ); }
+	// Gets the name of a timing bar segment which has been seen
+	const char* GetStatsSegmentName( int index ) const { return m_vSegmentHistories[index].name; }
+	// Gets the colour of a timing bar segment which has been seen
+	Pixel GetStatsSegmentColour( int index ) const { return m_vSegmentHistories[index].pix; }
+	// Gets the percentiles for the time spent in the segments with a name (which are zero in frames without one)
+	FrameStats GetSegmentStats( int index ) const { return CalculateStats( m_vSegmentHistories[index].vTimes ); }
+	// Finds a timing bar segment's index by name, or -1 if it hasn't been seen
+	int FindStatsSegment( const char* name ) const;
+	// Gets the number of frames which have been timed, up to PROFILER_STATS_FRAMES
+	int GetStatsFrameCount() const { return static_cast<int>( std::min< uint64_t >( m_statsFrameCount, PROFILER_STATS_FRAMES ) ); }
+	// Gets how long a frame took (0 is the last frame, 1 the one before that and so on)
+	float GetFrameTime( int framesAgo ) const { return m_vFrameTimes[( m_statsFrameCount - 1 - framesAgo ) % PROFILER_STATS_FRAMES]; }
+	// Gets how long a frame spent in the segments with a name (framesAgo is the same as for GetFrameTime)
+	float GetSegmentTime( int index, int framesAgo ) const { return m_vSegmentHistories[index].vTimes[( m_statsFrameCount - 1 - framesAgo ) % PROFILER_STATS_FRAMES]; }
+
+	// Counter functions
+	//********************************************************************************************************************************
 
-	// PlayWindow functions
-	//**************************************************************************************************
+	// Registers a counter of the work done in each frame, returning its index (the same name always gets the same counter)
+	// > The engine's counters are registered first, so their indices are the PlayCounter values. Main thread only
+	int RegisterCounter( const char* name );
+	// Adds to one of the current frame's counters (from any thread, and safe to call when there's no profiler)
+	static void Count( int counter, uint32_t amount = 1 )
+	{
+		if( s_pInstance )
+			s_pInstance->m_counters[counter].fetch_add( amount, std::memory_order_relaxed );
+	}
+	// Gets the number of registered counters
+	int GetCounterCount() const { return m_counterCount; }
+	// Gets the name of a counter
+	const char* GetCounterName( int counter ) const { return m_counterNames[counter]; }
+	// Gets a counter's total for the last complete frame
+	uint32_t GetCounterValue( int counter ) const { return m_lastCounters[counter]; }
+
+	// Hitch functions (main thread only)
+	//********************************************************************************************************************************
 
-	// Copies the contents of the drawing buffer to the window
-	void PresentDrawingBuffer();
-	// Gets the co-ordinates of the mouse cursor within the display buffer
-	Point2D GetMousePos();
-	// Gets the status of the left or right mouse buttons
-	bool GetMouseButton( Align button );
-	// Gets the width of the display buffer
-	int GetBufferWidth();
-	// Gets the height of the display buffer
-	int GetBufferHeight();
+	// Ends a frame of the main loop, keeping a record of it and dumping it if it's a hitch (called by PlayWindow after MainGameUpdate)
+	void EndFrame();
+	// Sets how long a frame has to take (including waiting for the next one) to be dumped as a hitch, or zero to stop dumping them
+	// > Hitches are dumped to a timestamped file on another thread, so writing it doesn't cause another
+	void SetHitchThreshold( float millisecs ) { m_hitchThreshold = millisecs; }
+	// Gets the hitch threshold in milliseconds (zero when hitches aren't being dumped)
+	float GetHitchThreshold() const { return m_hitchThreshold; }
+	// Gets the number of hitches which have been dumped
+	int GetHitchCount() const { return m_hitchCount; }
+
+	// Export functions
+	//********************************************************************************************************************************
 
-	// PlayAudio functions
+	// Writes the last few seconds of zones from every thread as a Chrome trace (which Perfetto can also open)
+	// > The frames are included as counters, and their input as instant events
+	bool WriteChromeTrace( const std::string& fileAndPath );
+	// Sets a file to write the trace to when the manager is destroyed
+	void SetExitTraceFile( const std::string& fileAndPath ) { m_exitTraceFile = fileAndPath; }
+	// Writes the trace to the exit trace file, if one was set
+	void WriteExitTrace();
+
+	// Gets the time in nanoseconds
+	static long long GetTime();
+
+private:
+	// Constructor / destructor
+	//********************************************************************************************************************************
+
+	// Private constructor
+	PlayProfiler();
+	// Private destructor
+	~PlayProfiler();
+	// The assignment operator is removed to prevent copying of a singleton class
+	PlayProfiler& operator=( const PlayProfiler& ) = delete;
+	// The copy constructor is removed to prevent copying of a singleton class
+	PlayProfiler( const PlayProfiler& ) = delete;
+
+public:
+	// A zone which has ended
+	struct Event
+	{
+		const char* name;
+		long long begin;
+		long long end;
+		int depth;
+		uint32_t allocations{ 0 }; // Made during the zone, including its children (debug builds only)
+		uint32_t allocationBytes{ 0 };
+	};
+
+	// The ring of zones for a thread
+	// > Only its thread writes events, and it publishes them by advancing the count
+	struct Track
+	{
+		std::string name;
+		int id{ 0 };
+		std::vector< Event > vEvents;
+		std::atomic< uint64_t > count{ 0 };
+		int depth{ 0 };
+		std::atomic< bool > inUse{ false };
+
+		void Add( const char* name, long long begin, long long end, int depth, uint32_t allocations = 0, uint32_t allocationBytes = 0 );
+	};
+
+private:
+	// Gets the calling thread's track, giving it one the first time it asks
+	Track& GetThreadTrack();
+	// Gives a thread a track, reusing one from a thread which has exited if there is one
+	Track* AcquireTrack();
+	// Copies of the zones and frames in a trace, which can be written out on another thread
+	struct TraceCapture
+	{
+		struct TrackEvents
+		{
+			std::string name;
+			int id;
+			std::vector< Event > vEvents;
+		};
+
+		long long startTime{ 0 };
+		std::vector< TrackEvents > vTracks;
+		std::vector< FrameRecord > vFrames;
+		std::vector< const char* > vCounterNames;
+		int hitchFrame{ -1 }; // Index into vFrames
+	};
+
+	// Copies everything which began after a time
+	void CaptureTrace( long long since, TraceCapture& capture );
+	// Writes a captured trace as Chrome trace JSON
+	static bool WriteTrace( const TraceCapture& capture, const std::string& fileAndPath );
+	// Captures the last few seconds and starts writing them to a timestamped file on another thread
+	void DumpHitch();
+
+	// Writes the current segment to the timing bar track
+	void CommitSegment();
+	// Adds a finished frame's times to the statistics
+	void RecordFrameStats( long long frameEnd );
+	// Works out the percentiles of some frame times
+	FrameStats CalculateStats( const std::vector< float >& vTimes ) const;
+
+	// The frame times for one name of timing bar segment
+	struct SegmentHistory
+	{
+		const char* name;
+		Pixel pix;
+		std::vector< float > vTimes;
+	};
+
+	std::mutex m_trackMutex;
+	std::vector< Track* > m_vTracks;
+	std::thread::id m_mainThread;
+	long long m_startTime{ 0 };
+	std::string m_exitTraceFile;
+
+	Track m_segmentTrack;
+	std::vector< Segment > m_vSegments;
+	std::vector< Segment > m_vPrevSegments;
+	// A ring of the last few seconds of frames, which is how much history is exported
+	std::vector< FrameRecord > m_vFrameRecords;
+	uint64_t m_frameCount{ 0 };
+	long long m_lastFrameEnd{ 0 };
+
+	// The current frame's counters, which EndFrame() moves into its frame record
+	std::atomic< uint32_t > m_counters[PROFILER_MAX_COUNTERS]{};
+	uint32_t m_lastCounters[PROFILER_MAX_COUNTERS]{};
+	const char* m_counterNames[PROFILER_MAX_COUNTERS]{};
+	int m_counterCount{ 0 };
+
+	float m_hitchThreshold{ 0.0f };
+	long long m_lastHitchTime{ 0 };
+	int m_hitchCount{ 0 };
+	std::future< bool > m_hitchWrite;
+
+	// Rings of frame times in milliseconds, with the segments' laid out in the same way
+	std::vector< float > m_vFrameTimes;
+	std::vector< SegmentHistory > m_vSegmentHistories;
+	uint64_t m_statsFrameCount{ 0 };
+	// Used for sorting the frame times, so working out percentiles doesn't allocate
+	mutable std::vector< float > m_vSortedTimes;
+
+	// Pointer to the singleton
+	static PlayProfiler* s_pInstance;
+};
+
+#endif
+
+#ifndef PLAY_PLAYBENCHMARK_H
+#define PLAY_PLAYBENCHMARK_H
+//********************************************************************************************************************************
+// File:		PlayBenchmark.h
+// Description:	Times the rendering functions in isolation on render targets of several sizes, so changes to them can be measured
+// Platform:	Independent
+// Notes:		Runs instead of the game with "--benchmark=<file>" on the command line, and "--baseline=<file>" compares with earlier results
+//********************************************************************************************************************************
+
+constexpr uint32_t BENCHMARK_FILE_VERSION = 1;
+constexpr const char* BENCHMARK_FILENAME = "benchmark.json";
+// Each case is drawn over and over until at least this much time has passed
+constexpr float BENCHMARK_CASE_SECONDS = 0.25f;
+
+// Times each of the blitter's drawing functions on 720p, 1080p and 4K render targets, using both the game's own sprites and
+// synthetic ones made to stress particular paths (opaque, partly transparent and mostly transparent)
+// > Singleton class accessed using PlayBenchmark::Instance()
+// > Runs after MainGameEntry() so the game's sprites are loaded, and writes the throughput of each case in pixels per nanosecond as JSON
+// > Each case's output is checksummed after a single draw, so comparing with a baseline taken from the plain reference blitter also
+//   catches any optimisation which changes what's drawn
+class PlayBenchmark
+{
+public:
+	// Instance functions
+	//********************************************************************************************************************************
+
+	// Creates / Returns the PlayBenchmark instance
+	static PlayBenchmark& Instance();
+	// Destroys the PlayBenchmark instance
+	static void Destroy();
+	// Returns true if a benchmark has been asked for on the command line (which is what creates the instance)
+	static bool IsRequested() { return s_pInstance != nullptr; }
+
+	// Benchmark functions
+	//********************************************************************************************************************************
+
+	// Sets the file to write the results to (BENCHMARK_FILENAME by default)
+	void SetResultsFile( const std::string& fileAndPath ) { m_resultsFile = fileAndPath; }
+	// Sets a file of earlier results to compare with (the checksums must match and the speed-up is reported)
+	void SetBaselineFile( const std::string& fileAndPath ) { m_baselineFile = fileAndPath; }
+	// Runs every case on each size of render target and writes the results
+	// > Returns false if the results couldn't be written, or a case's output doesn't match the baseline
+	bool Run();
+
+private:
+	// Constructor / destructor
+	//********************************************************************************************************************************
+
+	// Private constructor
+	PlayBenchmark();
+	// Private destructor
+	~PlayBenchmark();
+	// The assignment operator is removed to prevent copying of a singleton class
+	PlayBenchmark& operator=( const PlayBenchmark& ) = delete;
+	// The copy constructor is removed to prevent copying of a singleton class
+	PlayBenchmark( const PlayBenchmark& ) = delete;
+
+	// A drawing function to time, which returns the number of pixels it covers
+	struct Case
+	{
+		std::string name;
+		std::function< uint64_t() > draw;
+	};
+
+	struct Result
+	{
+		std::string name;
+		std::string target; // e.g. "1920x1080"
+		uint64_t pixels{ 0 }; // Covered by all the repeats
+		int repeats{ 0 };
+		long long nanoseconds{ 0 };
+		uint32_t checksum{ 0 }; // Of the render target after a single draw
+		double baselinePixelsPerNs{ 0.0 }; // Zero if the case isn't in the baseline
+		bool matchesBaseline{ true };
+		double GetPixelsPerNs() const { return nanoseconds > 0 ? static_cast<double>( pixels ) / nanoseconds : 0.0; }
+	};
+
+	// Adds the synthetic sprites to PlayGraphics (the first time only)
+	void AddSyntheticSprites();
+	// Adds the cases for a render target of the given size
+	void AddCases( std::vector< Case >& vCases, PixelData& target );
+	// Draws a case once to checksum its output and then times it
+	Result RunCase( const Case& benchCase, PixelData& target );
+	// Reads the results from an earlier run
+	bool ReadResults( const std::string& fileAndPath, std::vector< Result >& vResults ) const;
+	// Writes the results as JSON, one case per line
+	bool WriteResults( const std::string& fileAndPath, const std::vector< Result >& vResults ) const;
+
+	std::string m_resultsFile{ BENCHMARK_FILENAME };
+	std::string m_baselineFile;
+
+	// The game's sprites are the ones before the synthetic ones
+	int m_firstSyntheticSprite{ -1 };
+	int m_opaqueSprite{ -1 };
+	int m_softSprite{ -1 };
+	int m_sparseSprite{ -1 };
+	int m_rotatedSprite{ -1 };
+
+	// Used directly for the functions which PlayGraphics only uses on the display buffer
+	PlayBlitter m_blitter;
+	PixelData m_background;
+
+	// Pointer to the singleton
+	static PlayBenchmark* s_pInstance;
+};
+
+#endif
+
+
+#ifndef PLAY_PLAYMANAGER_H
+#define PLAY_PLAYMANAGER_H
+//********************************************************************************************************************************
+// File:		PlayManager.h
+// Description:	A manager for providing simplified access to the PlayBuffer framework with managed GameObjects
+// Platform:	Independent
+// Notes:		The GameObject management is "opt in" as many will want to create their own GameObject class
+//********************************************************************************************************************************
+
+#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+
+#ifndef PLAY_ADD_GAMEOBJECT_MEMBERS
+#define PLAY_ADD_GAMEOBJECT_MEMBERS 
+#endif
+
+// PlayManager manges a map of GameObject structures
+// > Additional member variables can be added with PLAY_ADD_GAMEOBJECT_MEMBERS 
+struct GameObject
+{
+	GameObject( int type, Point2D pos, int collisionRadius, int spriteId );
+
+	// Default member variables: don't change these!
+	int type{ -1 };
+	int spriteId{ -1 };
+	Point2D pos{ 0.0f, 0.0f };
+	Point2D oldPos{ 0.0f, 0.0f };
+	Vector2D velocity{ 0.0f, 0.0f };
+	Vector2D acceleration{ 0.0f, 0.0f };
+	float rotation{ 0.0f };
+	float rotSpeed{ 0.0f };
+	float oldRot{ 0.0f };
+	int frame{ 0 };
+	float framePos{ 0.0f };
+	float animSpeed{ 0.0f };
+	int radius{ 0 };
+	float scale{ 1 };
+	PLAY_ADD_GAMEOBJECT_MEMBERS
+
+	int GetId() { return m_id; }
+
+private:
+	// The GameObject's id should never be changed manually so we make it private!
+	int m_id{ -1 };
+
+	// Preventing assignment and copying reduces the potential for bugs
+	// > Only the manager can copy GameObjects, when reusing destroyed ones and restoring snapshots
+	friend struct GameObjectCopier;
+	GameObject& operator=( const GameObject& ) = default;
+	GameObject( const GameObject& ) = default;
+};
+
+#endif
+
+namespace Play
+{
+	// Alignment for font drawing operations
+	enum Align
+	{
+		LEFT = 0,
+		RIGHT,
+		CENTRE,
+	};
+
+	enum Direction
+	{
+		HORIZONTAL = 0,
+		VERTICAL,
+		ALL,
+	};
+
+	enum DrawingSpace
+	{
+		WORLD = 0,
+		SCREEN,
+	};
+
+	// PlayManager uses colour values from 0-100 for red, green, blue and alpha
+	struct Colour
+	{
+		Colour( float r, float g, float b ) : red( r ), green( g ), blue( b ) {}
+		Colour( int r, int g, int b ) : red( static_cast<float>( r ) ), green( static_cast<float>( g ) ), blue( static_cast<float>( b ) ) {}
+		float red, green, blue;
+	};
+
+	extern Colour cBlack, cRed, cGreen, cBlue, cMagenta, cCyan, cYellow, cOrange, cWhite, cGrey;
+
+	// Manager creation and deletion
+	//**************************************************************************************************
+
+	// Initialises the managers and creates a window of the required dimensions
+	void CreateManager( int width, int height, int scale );
+	// Shuts down the managers and closes the window
+	void DestroyManager();
+
+	// PlayWindow functions
+	//**************************************************************************************************
+
+	// Copies the contents of the drawing buffer to the window
+	void PresentDrawingBuffer();
+	// Gets the co-ordinates of the mouse cursor within the display buffer
+	Point2D GetMousePos();
+	// Gets the status of the left or right mouse buttons
+	bool GetMouseButton( Align button );
+	// Gets the width of the display buffer
+	int GetBufferWidth();
+	// Gets the height of the display buffer
+	int GetBufferHeight();
+
+	// PlayAudio functions
 	//**************************************************************************************************
 
 	// Plays an mp3 audio file from the "Data\Sounds" directory
@@ -1099,6 +2210,29 @@ namespace Play
 	// Blends the sprite with the given colour (works best on white sprites)
 	// > Note that colouring affects subsequent DrawSprite calls using the same sprite!!
 	void ColourSprite( const char* spriteName, Colour col );
+	// Sets the most sprite pixel data (in bytes) to keep in memory, or zero for no limit (the default)
+	// > Sprites which haven't been drawn recently are evicted at the end of the frame and reloaded when they're next drawn
+	void SetSpriteMemoryBudget( size_t bytes );
+	// Loads any of the given sprites which have been evicted (e.g. before a level transition)
+	void PreloadSprites( const std::vector<int>& spriteIds );
+	// Gets the ids of the sprites which have been evicted, in order, so a loading thread knows which ones to decode
+	std::vector<int> GetEvictedSprites();
+	// Decodes the given sprites into new buffers without changing the sprites, so it can be used on a loading thread
+	// > The main thread carries on drawing as normal, and gives the sprites their pixel data with AttachSprites()
+	std::vector<PlayGraphics::DecodedSprite> DecodeSprites( const std::vector<int>& spriteIds );
+	// Gives sprites the pixel data decoded for them, if they still need it, and makes them resident (on the main thread)
+	void AttachSprites( std::vector<PlayGraphics::DecodedSprite>& vDecoded );
+	// Frees pixel data decoded by DecodeSprites() which is no longer needed
+	void DiscardSprites( std::vector<PlayGraphics::DecodedSprite>& vDecoded );
+	// Gets the bytes of pixel data in memory for the sprite with the given id
+	size_t GetSpriteMemory( int spriteId );
+	// Gets the bytes of pixel data in memory for a category of sprites (the letters at the start of their names e.g. "SPR")
+	size_t GetSpriteCategoryMemory( const char* category );
+	// Frees each sprite's original image once it has been pre-multiplied, roughly halving the sprite memory
+	// > Sprites must be made mutable first if they're going to be coloured with ColourSprite
+	void EnableCompactSprites( bool enable );
+	// Keeps the original image for the first sprite found matching the given name, so it can still be coloured
+	void MakeSpriteMutable( const char* spriteName );
 
 	// Centres the origin of the first sprite found matching the given name
 	void CentreSpriteOrigin( const char* spriteName );
@@ -1131,8 +2265,21 @@ namespace Play
 	void DrawSpriteTransparent( int spriteID, Point2D pos, int frame, float opacity );
 	// Draws the sprite with rotation and transparency (slowest DrawSprite)
 	void DrawSpriteRotated( const char* spriteName, Point2D pos, int frame, float angle, float scale = 1.0f, float opacity = 1.0f );
-	// Draws the sprite with rotation and transparency (slowest DrawSprite)
+	// Draws the sprite with rotation and transparency (slowest DrawSprite, unless the angle is zero)
 	void DrawSpriteRotated( int spriteID, Point2D pos, int frame, float angle, float scale, float opacity = 1.0f );
+	// Creates a copy of a sprite scaled down in advance, so it can be drawn at that size with DrawSprite instead of DrawSpriteRotated
+	// > Returns the id of the new sprite, which can't be coloured
+	int CreateScaledSprite( int spriteId, float scale );
+	// Replaces a sprite made by CreateScaledSprite() with a copy of a sprite at another scale, keeping the same id
+	// > The old copy's pixel data is freed, so scaled sprites can be reused instead of created again
+	void UpdateScaledSprite( int scaledId, int spriteId, float scale );
+	// Clears an area of a composite (pixel data which sprites are drawn into to be drawn again later) to fully transparent
+	void ClearComposite( PixelData& composite, Point2D topLeft, Point2D bottomRight );
+	// Draws a sprite into a composite, only changing the pixels inside the clip rectangle
+	// > The position and clip rectangle are in the composite's pixels, whatever the drawing space
+	void ComposeSprite( PixelData& composite, int spriteID, Point2D pos, int frame, Point2D clipTopLeft, Point2D clipBottomRight );
+	// Draws a composite as quickly as a sprite (the position is its top left)
+	void DrawComposite( const PixelData& composite, Point2D pos );
 	// Draws a single-pixel wide line between two points in the given colour
 	void DrawLine( Point2D start, Point2D end, Colour col );
 	// Draws a single-pixel wide circle in the given colour
@@ -1146,16 +2293,38 @@ namespace Play
 	// > Note that colouring affects subsequent DrawSprite calls using the same sprite!!
 	void DrawSpriteCircle( Point2D pos, int radius, const char* penSprite, Colour c = cWhite );
 	// Draws text using a sprite-based font exported from PlayFontTool
-	void DrawFontText( const char* fontId, std::string text, Point2D pos, Align justify = LEFT );
+	void DrawFontText( const char* fontId, const char* text, Point2D pos, Align justify = LEFT );
+	// Draws text using a sprite-based font exported from PlayFontTool
+	void DrawFontText( const char* fontId, const std::string& text, Point2D pos, Align justify = LEFT );
 	// Adds a sprite dynamically from memory (custom asset pipelines)
 
 	// Resets the timing bar data and sets the current timing bar segment to a specific colour
-	void BeginTimingBar( Pixel pix );
+	// > The name is what the segment is called in the profiler's traces
+	void BeginTimingBar( Colour c, const char* name = "Timing bar" );
 	// Sets the current timing bar segment to a specific colour
 	// > Returns the number of timing segments
-	int ColourTimingBar( Pixel pix );
+	int ColourTimingBar( Colour c, const char* name = "Timing bar" );
 	// Draws the timing bar for the previous frame at the given position and size
 	void DrawTimingBar( Point2f pos, Point2f size );
+	// Gets the frame time percentiles over the last 600 frames, or those of the timing bar segments with a name
+	// > Frames are timed from one BeginTimingBar() to the next. The F1 debug view shows these too
+	PlayProfiler::FrameStats GetFrameTimeStats( const char* segmentName = nullptr );
+	// Dumps the last few seconds of the profile whenever a frame takes longer than this, or never if it's zero (the default)
+	// > The dumps are written to timestamped "hitch_*.json" files. "--hitch=<ms>" on the command line sets this too
+	void SetHitchThreshold( float millisecs );
+	// Gets the hitch threshold in milliseconds
+	float GetHitchThreshold();
+
+	// Enables front-to-back coverage culling: occluders stop lower layers writing the pixels they cover
+	// > Press F2 to see the overdraw heat-map
+	void EnableCoverageCulling( bool enable );
+	// Clears the previous frame's occluders ready for a new front-to-back pass
+	void BeginCoveragePass();
+	// Marks the fully opaque pixels of a sprite as covering everything drawn on lower layers (1-255)
+	// > The sprite itself must still be drawn afterwards on the same layer or a higher one
+	void AddOccluder( int spriteId, Point2D pos, int frame, int layer );
+	// Sets the layer for all subsequent drawing (0-255)
+	void SetDrawLayer( int layer );
 
 	// GameObject functions
 	//**************************************************************************************************
@@ -1165,6 +2334,12 @@ namespace Play
 	// Creates a new GameObject and adds it to the managed list.
 	// > Returns the new object's unique id
 	int CreateGameObject( int type, Point2D pos, int collisionRadius, const char* spriteName );
+	// Creates a new GameObject using a sprite id which has already been looked up (e.g. when loading lots of objects)
+	// > Returns the new object's unique id
+	int CreateGameObject( int type, Point2D pos, int collisionRadius, int spriteId );
+	// Creates a number of GameObjects of the same type in one go (e.g. when a level is loaded), with a position and sprite id for each
+	// > Returns the first new object's unique id: the others follow it consecutively
+	int CreateGameObjects( int type, int count, const Point2D* pPositions, const int* pSpriteIds, int collisionRadius );
 	// Retrieves a GameObject based on its id
 	// > Returns an object with a type of -1 if no object can be found
 	GameObject& GetGameObject( int id );
@@ -1173,6 +2348,9 @@ namespace Play
 	GameObject& GetGameObjectByType( int type );
 	// Collects the IDs of all of the GameObjects with the matching type
 	std::vector<int> CollectGameObjectIDsByType( int type );
+	// Collects the IDs of all of the GameObjects with the matching type into a vector, replacing what was in it
+	// > Reusing the same vector every frame means it doesn't allocate once it's big enough
+	void CollectGameObjectIDsByType( int type, std::vector<int>& vIds );
 	// Collects the IDs of all of the GameObjects
 	std::vector<int> CollectAllGameObjectIDs();
 	// Performs a typical update of the object's position and animation
@@ -1182,6 +2360,13 @@ namespace Play
 	void DestroyGameObject( int id );
 	// Deletes all GameObjects with the corresponding type
 	void DestroyGameObjectsByType( int type );
+	// Takes a copy of all the GameObjects (e.g. just after a level has loaded) which can be restored later
+	void SaveGameObjectSnapshot();
+	// Puts all the GameObjects back exactly as they were in the snapshot, keeping their ids
+	// > Destroyed objects are reused, so this doesn't allocate any memory once the game is running
+	void RestoreGameObjectSnapshot();
+	// Gets a checksum of the state of all the GameObjects, which replays use to spot when they've gone out of sync
+	uint32_t GetGameObjectChecksum();
 	
 	// Checks whether the two objects are within each other's collision radii
 	bool IsColliding( GameObject& obj1, GameObject& obj2 );
@@ -1217,6 +2402,9 @@ namespace Play
 	// Returns true if the key is currently being held down
 	// > https://docs.microsoft.com/en-us/windows/win32/inputdev/virtual-key-codes
 	bool KeyDown( int vKey );
+	// Returns true while the input is being recorded or replayed (see PlayReplay)
+	// > Anything which depends on how long things take, such as loading on other threads, should wait for it so every run plays out the same
+	bool IsRecordingOrReplaying();
 
 	// Returns a random number as if you rolled a die with this many sides
 	int RandomRoll( int sides );
@@ -1275,128 +2463,441 @@ namespace Play
 #pragma push_macro("new")
 #undef new
 
-constexpr int MAX_ALLOCATIONS = 8192 * 4;
+// The allocations are kept in a hash table on their address, which grows (using malloc) as it fills up
+constexpr unsigned int MIN_ALLOCATION_TABLE_SIZE = 4096;
+// File names and tags are interned, so each allocation only stores an index for them
+constexpr int MAX_ALLOCATION_FILES = 1024;
+constexpr int MAX_ALLOCATION_TAGS = 64;
 constexpr int MAX_FILENAME = 1024;
+// Only this many strict allocations have their call stacks logged (they're all counted)
+constexpr uint32_t MAX_STRICT_ALLOCATION_REPORTS = 32;
+constexpr int MAX_STRICT_ALLOCATION_FRAMES = 24;
 
 unsigned int g_allocId = 0;
 
 // A structure to store data on each memory allocation
 struct ALLOC
 {
-	void* address = 0;
-	char file[MAX_FILENAME] = { 0 };
-	int line = 0;
+	void* address = nullptr;
 	size_t size = 0;
 	int id = 0;
-
-	ALLOC( void* a, const char* fn, int l, size_t s ) { address = a; line = l; size = s; id = g_allocId++; strcpy_s( file, fn ); };
-	ALLOC( void ) {};
+	int line = 0;
+	uint16_t file = 0; // Index into g_allocFiles
+	uint16_t tag = 0; // Index into g_allocTags
 };
 
-ALLOC g_allocations[MAX_ALLOCATIONS];
+ALLOC* g_pAllocations = nullptr;
+unsigned int g_allocTableSize = 0; // Always a power of two
 unsigned int g_allocCount = 0;
 
+// The file names passed to new are __FILE__ literals, so they're interned by their address
+struct ALLOC_FILE
+{
+	const char* pFile = nullptr;
+	const char* pName = nullptr; // Without the path
+};
+
+ALLOC_FILE g_allocFiles[MAX_ALLOCATION_FILES] = { { nullptr, "Unknown" } };
+int g_allocFileCount = 1;
+uint16_t g_allocFileSlots[MAX_ALLOCATION_FILES * 2] = { 0 }; // A hash table of indices into g_allocFiles, where zero is empty
+
+struct ALLOC_TAG
+{
+	const char* pName = nullptr;
+	AllocationCounters counters;
+	uint32_t currentFrame = 0;
+	size_t currentFrameBytes = 0;
+};
+
+ALLOC_TAG g_allocTags[MAX_ALLOCATION_TAGS] = { { "Untagged", {}, 0, 0 } };
+int g_allocTagCount = 1;
+AllocationCounters g_allocTotals;
+uint32_t g_allocCurrentFrame = 0;
+size_t g_allocCurrentFrameBytes = 0;
+
+// The tag for each thread's allocations is set by the AllocationTag in scope
+thread_local uint16_t g_allocTag = 0;
+thread_local uint32_t g_threadAllocations = 0;
+thread_local size_t g_threadAllocationBytes = 0;
+
+bool g_strictAllocationsEnabled = false;
+std::atomic< uint32_t > g_strictAllocationCount{ 0 };
+thread_local bool g_strictAllocations = false;
+thread_local bool g_allowAllocations = false;
+thread_local bool g_reportingAllocation = false; // Logging a strict allocation can allocate too
+
+// Sprites are decoded on several threads at once, so the allocation list is protected by a simple spin lock
+// > A spin lock because it can't allocate memory itself and the time spent holding it is short
+std::atomic_flag g_allocLock = ATOMIC_FLAG_INIT;
+
+struct AllocationLock
+{
+	AllocationLock() { while( g_allocLock.test_and_set( std::memory_order_acquire ) ) std::this_thread::yield(); }
+	~AllocationLock() { g_allocLock.clear( std::memory_order_release ); }
+};
+
 
 void CreateStaticObject( void );
-void PrintAllocation( const char* tagText, ALLOC& a );
+void PrintAllocation( const char* tagText, const ALLOC& a );
 
 //********************************************************************************************************************************
-// Overrides for new operator (x4)
+// The allocation table (all of these must be called with the lock held)
 //********************************************************************************************************************************
 
-// The file and line are passed through using the macro defined in PlayMemory.h which redefines new. This will only happen if 
-// PlayMemory.h has been parsed in advance of the use of new in the relevant code. This approach is problematic for classes 
-// the safest approach. The two definitions of new without the file and line pick up any other memory allocations for completeness.
-void* operator new( size_t size, const char* file, int line )
+unsigned int AllocationHash( const void* p, unsigned int tableSize )
 {
-	PLAY_ASSERT( g_allocCount < MAX_ALLOCATIONS );
-	CreateStaticObject();
-	void* p = malloc( size );
-	g_allocations[g_allocCount++] = ALLOC{ p, file, line, size };
-	return p;
+	// Allocations are at least 8 byte aligned, so the low bits are dropped before hashing
+	uint64_t hash = ( reinterpret_cast<uint64_t>( p ) >> 3 ) * 0x9E3779B97F4A7C15ull;
+	return static_cast<unsigned int>( hash >> 32 ) & ( tableSize - 1 );
 }
 
-void* operator new[]( size_t size, const char* file, int line )
+unsigned int AllocationSlot( void* p )
 {
-	PLAY_ASSERT( g_allocCount < MAX_ALLOCATIONS );
-	CreateStaticObject();
-	void* p = malloc( size );
-	g_allocations[g_allocCount++] = ALLOC{ p, file, line, size };
-	return p;
+	return AllocationHash( p, g_allocTableSize );
 }
 
-void* operator new( size_t size )
+uint16_t InternAllocationFile( const char* file )
 {
-	PLAY_ASSERT( g_allocCount < MAX_ALLOCATIONS );
-	CreateStaticObject();
-	void* p = malloc( size );
-	g_allocations[g_allocCount++] = ALLOC{ p, "Unknown", 0, size };
-	return p;
-}
+	if( !file )
+		return 0;
 
-void* operator new[]( size_t size )
-{
-	PLAY_ASSERT( g_allocCount < MAX_ALLOCATIONS );
-	CreateStaticObject();
-	void* p = malloc( size );
-	g_allocations[g_allocCount++] = ALLOC{ p, "Unknown", 0, size };
-	return p;
-}
+	constexpr unsigned int slotCount = MAX_ALLOCATION_FILES * 2;
+	unsigned int slot = AllocationHash( file, slotCount );
+	while( g_allocFileSlots[slot] != 0 )
+	{
+		if( g_allocFiles[g_allocFileSlots[slot]].pFile == file )
+			return g_allocFileSlots[slot];
+		slot = ( slot + 1 ) & ( slotCount - 1 );
+	}
 
-//********************************************************************************************************************************
-// Overrides for delete operator (x4)
-//********************************************************************************************************************************
+	if( g_allocFileCount == MAX_ALLOCATION_FILES )
+		return 0;
 
-// The definitions with file and line are only included for exception handling, where it looks for a form of delete that matches 
-// the new that was used to allocate it.
-void operator delete( void* p, const char* file, int line )
-{
-	UNREFERENCED_PARAMETER( line );
-	UNREFERENCED_PARAMETER( file );
-	operator delete( p );
-}
+	// __FILE__ can use either kind of slash, depending on the compiler and how the file was included
+	const char* pName = file;
+	for( const char* pChar = file; *pChar; pChar++ )
+	{
+		if( *pChar == '\\' || *pChar == '/' )
+			pName = pChar + 1;
+	}
 
-int g_id = -1;
+	g_allocFiles[g_allocFileCount] = { file, pName };
+	g_allocFileSlots[slot] = static_cast<uint16_t>( g_allocFileCount );
+	return static_cast<uint16_t>( g_allocFileCount++ );
+}
 
-void operator delete( void* p )
+void InsertAllocation( void* p, const char* file, int line, size_t size )
 {
-	for( unsigned int a = 0; a < g_allocCount; a++ )
+	if( !p )
+		return;
+
+	// Grows at half full, which keeps the runs of occupied slots short
+	if( ( g_allocCount + 1 ) * 2 > g_allocTableSize )
 	{
-		if( g_allocations[a].address == p )
-		{
-			if( g_allocations[a].id == g_id )
-				g_allocations[a].id = g_id;
+		ALLOC* pOld = g_pAllocations;
+		unsigned int oldSize = g_allocTableSize;
+
+		g_allocTableSize = oldSize ? oldSize * 2 : MIN_ALLOCATION_TABLE_SIZE;
+		g_pAllocations = static_cast<ALLOC*>( calloc( g_allocTableSize, sizeof( ALLOC ) ) );
+		PLAY_ASSERT_MSG( g_pAllocations, "Out of memory for the allocation tracker" );
 
-			g_allocations[a] = g_allocations[g_allocCount - 1];
-			g_allocations[g_allocCount - 1].address = nullptr;
-			g_allocCount--;
+		for( unsigned int a = 0; a < oldSize; a++ )
+		{
+			if( pOld[a].address )
+			{
+				unsigned int slot = AllocationSlot( pOld[a].address );
+				while( g_pAllocations[slot].address )
+					slot = ( slot + 1 ) & ( g_allocTableSize - 1 );
+				g_pAllocations[slot] = pOld[a];
+			}
 		}
+		free( pOld );
 	}
-	free( p );
-}
 
-void operator delete[]( void* p, const char* file, int line )
-{
-	UNREFERENCED_PARAMETER( line );
-	UNREFERENCED_PARAMETER( file );
-	operator delete[]( p );
+	unsigned int slot = AllocationSlot( p );
+	while( g_pAllocations[slot].address )
+		slot = ( slot + 1 ) & ( g_allocTableSize - 1 );
+
+	ALLOC& a = g_pAllocations[slot];
+	a.address = p;
+	a.size = size;
+	a.id = g_allocId++;
+	a.line = line;
+	a.file = InternAllocationFile( file );
+	a.tag = g_allocTag;
+	g_allocCount++;
+
+	AllocationCounters& tag = g_allocTags[a.tag].counters;
+	tag.allocations++;
+	tag.liveAllocations++;
+	tag.liveBytes += size;
+	g_allocTags[a.tag].currentFrame++;
+	g_allocTags[a.tag].currentFrameBytes += size;
+
+	g_allocTotals.allocations++;
+	g_allocTotals.liveAllocations++;
+	g_allocTotals.liveBytes += size;
+	g_allocCurrentFrame++;
+	g_allocCurrentFrameBytes += size;
+	g_threadAllocations++;
+	g_threadAllocationBytes += size;
 }
 
-void operator delete[]( void* p )
+// Logs the call stack of an allocation made while they're strict (called without the lock held)
+void CheckStrictAllocation( const char* file, int line, size_t size )
 {
-	for( unsigned int a = 0; a < g_allocCount; a++ )
+	if( !g_strictAllocations || !g_strictAllocationsEnabled || g_allowAllocations || g_reportingAllocation )
+		return;
+
+	g_reportingAllocation = true;
+	uint32_t count = ++g_strictAllocationCount;
+	if( count <= MAX_STRICT_ALLOCATION_REPORTS )
 	{
-		if( g_allocations[a].address == p )
-		{
-			if( g_allocations[a].id == g_id )
-				g_allocations[a].id = g_id;
+		char buffer[MAX_FILENAME * 2] = { 0 };
+		sprintf_s( buffer, "<STRICT ALLOCATION> %s(%d): %d bytes [%d]\n", file ? file : "Unknown", line, static_cast<int>( size ), static_cast<int>( count ) );
+		DebugOutput( buffer );
 
-			g_allocations[a] = g_allocations[g_allocCount - 1];
-			g_allocations[g_allocCount - 1].address = nullptr;
-			g_allocCount--;
+		// The addresses can be looked up in the debugger (or with addr2line for headless builds)
+		void* frames[MAX_STRICT_ALLOCATION_FRAMES] = { nullptr };
+#ifndef PLAY_PLATFORM_HEADLESS
+		int frameCount = CaptureStackBackTrace( 2, MAX_STRICT_ALLOCATION_FRAMES, frames, NULL );
+		for( int f = 0; f < frameCount; f++ )
+		{
+			sprintf_s( buffer, "    0x%p\n", frames[f] );
+			DebugOutput( buffer );
 		}
+#elif defined( __GLIBC__ ) || defined( __APPLE__ )
+		int frameCount = backtrace( frames, MAX_STRICT_ALLOCATION_FRAMES );
+		backtrace_symbols_fd( frames + 2, frameCount > 2 ? frameCount - 2 : 0, 2 );
+#endif
 	}
-	free( p );
+	g_reportingAllocation = false;
+}
+
+void RemoveAllocation( void* p )
+{
+	if( !p || !g_pAllocations )
+		return;
+
+	unsigned int mask = g_allocTableSize - 1;
+	unsigned int slot = AllocationSlot( p );
+	while( g_pAllocations[slot].address != p )
+	{
+		// Not tracked, so it was allocated some other way
+		if( !g_pAllocations[slot].address )
+			return;
+		slot = ( slot + 1 ) & mask;
+	}
+
+	AllocationCounters& tag = g_allocTags[g_pAllocations[slot].tag].counters;
+	tag.liveAllocations--;
+	tag.liveBytes -= g_pAllocations[slot].size;
+	g_allocTotals.liveAllocations--;
+	g_allocTotals.liveBytes -= g_pAllocations[slot].size;
+	g_allocCount--;
+
+	// Shifts back any later entries in the run which would no longer be found past the gap
+	unsigned int gap = slot;
+	for( unsigned int next = ( gap + 1 ) & mask; g_pAllocations[next].address; next = ( next + 1 ) & mask )
+	{
+		unsigned int home = AllocationSlot( g_pAllocations[next].address );
+		if( ( ( next - home ) & mask ) >= ( ( next - gap ) & mask ) )
+		{
+			g_pAllocations[gap] = g_pAllocations[next];
+			gap = next;
+		}
+	}
+	g_pAllocations[gap] = ALLOC{};
+}
+
+//********************************************************************************************************************************
+// Overrides for new operator (x4)
+//********************************************************************************************************************************
+
+// The file and line are passed through using the macro defined in PlayMemory.h which redefines new. This will only happen if 
+// PlayMemory.h has been parsed in advance of the use of new in the relevant code. This approach is problematic for classes 
+// the safest approach. The two definitions of new without the file and line pick up any other memory allocations for completeness.
+void* operator new( size_t size, const char* file, int line )
+{
+	CreateStaticObject();
+	void* p = malloc( size );
+	{
+		AllocationLock lock;
+		InsertAllocation( p, file, line, size );
+	}
+	CheckStrictAllocation( file, line, size );
+	return p;
+}
+
+void* operator new[]( size_t size, const char* file, int line )
+{
+	CreateStaticObject();
+	void* p = malloc( size );
+	{
+		AllocationLock lock;
+		InsertAllocation( p, file, line, size );
+	}
+	CheckStrictAllocation( file, line, size );
+	return p;
+}
+
+void* operator new( size_t size )
+{
+	CreateStaticObject();
+	void* p = malloc( size );
+	{
+		AllocationLock lock;
+		InsertAllocation( p, nullptr, 0, size );
+	}
+	CheckStrictAllocation( nullptr, 0, size );
+	return p;
+}
+
+void* operator new[]( size_t size )
+{
+	CreateStaticObject();
+	void* p = malloc( size );
+	{
+		AllocationLock lock;
+		InsertAllocation( p, nullptr, 0, size );
+	}
+	CheckStrictAllocation( nullptr, 0, size );
+	return p;
+}
+
+//********************************************************************************************************************************
+// Overrides for delete operator (x4)
+//********************************************************************************************************************************
+
+// The definitions with file and line are only included for exception handling, where it looks for a form of delete that matches 
+// the new that was used to allocate it.
+void operator delete( void* p, const char* file, int line )
+{
+	UNREFERENCED_PARAMETER( line );
+	UNREFERENCED_PARAMETER( file );
+	operator delete( p );
+}
+
+void operator delete( void* p )
+{
+	{
+		AllocationLock lock;
+		RemoveAllocation( p );
+	}
+	free( p );
+}
+
+void operator delete[]( void* p, const char* file, int line )
+{
+	UNREFERENCED_PARAMETER( line );
+	UNREFERENCED_PARAMETER( file );
+	operator delete[]( p );
+}
+
+void operator delete[]( void* p )
+{
+	{
+		AllocationLock lock;
+		RemoveAllocation( p );
+	}
+	free( p );
+}
+
+//********************************************************************************************************************************
+// Tags and counters
+//********************************************************************************************************************************
+
+AllocationTag::AllocationTag( const char* tag )
+	: m_previous( g_allocTag )
+{
+	AllocationLock lock;
+	int t = 0;
+	while( t < g_allocTagCount && g_allocTags[t].pName != tag && strcmp( g_allocTags[t].pName, tag ) != 0 )
+		t++;
+
+	if( t == g_allocTagCount && g_allocTagCount < MAX_ALLOCATION_TAGS )
+		g_allocTags[g_allocTagCount++].pName = tag;
+
+	g_allocTag = static_cast<uint16_t>( t < MAX_ALLOCATION_TAGS ? t : 0 );
+}
+
+AllocationTag::~AllocationTag()
+{
+	g_allocTag = m_previous;
+}
+
+AllocationCounters GetAllocationCounters( const char* tag )
+{
+	AllocationLock lock;
+	if( !tag )
+		return g_allocTotals;
+
+	for( int t = 0; t < g_allocTagCount; t++ )
+	{
+		if( strcmp( g_allocTags[t].pName, tag ) == 0 )
+			return g_allocTags[t].counters;
+	}
+	return AllocationCounters();
+}
+
+int GetAllocationTagCount()
+{
+	AllocationLock lock;
+	return g_allocTagCount;
+}
+
+const char* GetAllocationTagName( int tagIndex )
+{
+	AllocationLock lock;
+	return tagIndex >= 0 && tagIndex < g_allocTagCount ? g_allocTags[tagIndex].pName : "";
+}
+
+void EndAllocationFrame()
+{
+	AllocationLock lock;
+	for( int t = 0; t < g_allocTagCount; t++ )
+	{
+		g_allocTags[t].counters.frameAllocations = g_allocTags[t].currentFrame;
+		g_allocTags[t].counters.frameBytes = g_allocTags[t].currentFrameBytes;
+		g_allocTags[t].currentFrame = 0;
+		g_allocTags[t].currentFrameBytes = 0;
+	}
+	g_allocTotals.frameAllocations = g_allocCurrentFrame;
+	g_allocTotals.frameBytes = g_allocCurrentFrameBytes;
+	g_allocCurrentFrame = 0;
+	g_allocCurrentFrameBytes = 0;
+}
+
+void GetThreadAllocations( uint32_t& allocations, size_t& bytes )
+{
+	allocations = g_threadAllocations;
+	bytes = g_threadAllocationBytes;
+}
+
+void SetStrictAllocations( bool strict )
+{
+	g_strictAllocations = strict;
+}
+
+void EnableStrictAllocations( bool enable )
+{
+	g_strictAllocationsEnabled = enable;
+}
+
+uint32_t GetStrictAllocationCount()
+{
+	return g_strictAllocationCount;
+}
+
+AllowAllocations::AllowAllocations()
+	: m_previous( g_allowAllocations )
+{
+	g_allowAllocations = true;
+}
+
+AllowAllocations::~AllowAllocations()
+{
+	g_allowAllocations = m_previous;
 }
 
 //********************************************************************************************************************************
@@ -1434,20 +2935,14 @@ void CreateStaticObject( void )
 	static DestroyedLast last;
 }
 
-void PrintAllocation( const char* tagText, ALLOC& a )
+void PrintAllocation( const char* tagText, const ALLOC& a )
 {
 	char buffer[MAX_FILENAME * 2] = { 0 };
 
 	if( a.address != nullptr )
 	{
-		char* lastSlash = strrchr( a.file, '\\' );
-		if( lastSlash )
-		{
-			strcpy_s( buffer, lastSlash + 1 );
-			strcpy_s( a.file, buffer );
-		}
 		// Format in such a way that VS can double click to jump to the allocation.
-		sprintf_s( buffer, "%s %s(%d): 0x%02X %d bytes [%d]\n", tagText, a.file, a.line, static_cast<int>( reinterpret_cast<long long>( a.address ) ), static_cast<int>( a.size ), a.id );
+		sprintf_s( buffer, "%s %s(%d): 0x%02X %d bytes [%d]\n", tagText, g_allocFiles[a.file].pName, a.line, static_cast<int>( reinterpret_cast<long long>( a.address ) ), static_cast<int>( a.size ), a.id );
 		DebugOutput( buffer );
 	}
 }
@@ -1459,12 +2954,28 @@ void PrintAllocations( const char* tagText )
 	DebugOutput( "****************************************************\n" );
 	DebugOutput( "MEMORY ALLOCATED\n" );
 	DebugOutput( "****************************************************\n" );
-	for( unsigned int n = 0; n < g_allocCount; n++ )
+
+	// Printed in the order they were allocated, from a copy so that printing can allocate
+	ALLOC* pSorted = nullptr;
+	unsigned int count = 0;
+	{
+		AllocationLock lock;
+		pSorted = static_cast<ALLOC*>( malloc( ( g_allocCount + 1 ) * sizeof( ALLOC ) ) );
+		for( unsigned int a = 0; pSorted && a < g_allocTableSize; a++ )
+		{
+			if( g_pAllocations[a].address )
+				pSorted[count++] = g_pAllocations[a];
+		}
+	}
+	qsort( pSorted, count, sizeof( ALLOC ), []( const void* a, const void* b ) { return static_cast<const ALLOC*>( a )->id - static_cast<const ALLOC*>( b )->id; } );
+
+	for( unsigned int n = 0; n < count; n++ )
 	{
-		ALLOC& a = g_allocations[n];
-		PrintAllocation( tagText, a );
-		bytes += static_cast<int>(a.size);
+		PrintAllocation( tagText, pSorted[n] );
+		bytes += static_cast<int>( pSorted[n].size );
 	}
+	free( pSorted );
+
 	sprintf_s( buffer, "%s Total = %d bytes\n", tagText, bytes );
 	DebugOutput( buffer );
 	DebugOutput( "**************************************************\n" );
@@ -1478,14 +2989,10 @@ void PrintAllocations( const char* tagText )
 //********************************************************************************************************************************
 // File:		PlayWindow.cpp
 // Description:	Platform specific code to provide a window to draw into
-// Platform:	Windows
-// Notes:		Uses a 32-bit ARGB display buffer
+// Platform:	Windows / Headless
+// Notes:		Uses a 32-bit ARGB display buffer. The headless version presents into an offscreen copy instead
 //********************************************************************************************************************************
 
-// Instruct Visual Studio to add these to the list of libraries to link
-#pragma comment(lib, "gdiplus.lib")
-#pragma comment(lib, "dwmapi.lib")
-
 PlayWindow* PlayWindow::s_pInstance = nullptr;
 
 // External functions which must be implemented by the user 
@@ -1493,22 +3000,93 @@ extern void MainGameEntry( int argc, char* argv[] );
 extern bool MainGameUpdate( float ); // Called every frame
 extern int MainGameExit( void ); // Called on quit
 
-ULONG_PTR g_pGDIToken = 0;
+// Starts recording or replaying if "--record=<file>" or "--replay=<file>" is on the command line
+// > "--profile=<file>" saves the profiler's trace when the game exits, and "--hitch=<ms>" sets the hitch threshold
+// > "--strict-allocations" logs any allocations made while the game has made them strict (debug builds only)
+// > "--benchmark=<file>" runs PlayBenchmark instead of the game, comparing with "--baseline=<file>" if it's given
+static void ReadCommandLine( int argc, char* argv[] )
+{
+	for( int i = 1; i < argc; i++ )
+	{
+		if( strncmp( argv[i], "--benchmark=", 12 ) == 0 )
+			PlayBenchmark::Instance().SetResultsFile( argv[i] + 12 );
+		else if( strncmp( argv[i], "--baseline=", 11 ) == 0 )
+			PlayBenchmark::Instance().SetBaselineFile( argv[i] + 11 );
+		else if( strncmp( argv[i], "--profile=", 10 ) == 0 )
+			PlayProfiler::Instance().SetExitTraceFile( argv[i] + 10 );
+		else if( strncmp( argv[i], "--hitch=", 8 ) == 0 )
+			PlayProfiler::Instance().SetHitchThreshold( static_cast<float>( atof( argv[i] + 8 ) ) );
+#ifdef _DEBUG
+		else if( strcmp( argv[i], "--strict-allocations" ) == 0 )
+			EnableStrictAllocations( true );
+#endif
+		else if( strncmp( argv[i], "--record=", 9 ) == 0 )
+			PlayReplay::Instance().StartRecording( argv[i] + 9 );
+		else if( strncmp( argv[i], "--replay=", 9 ) == 0 && !PlayReplay::Instance().StartReplay( argv[i] + 9 ) )
+			DebugOutput( std::string( "PlayBuffer: Couldn't read the replay " ) + ( argv[i] + 9 ) + "\n" );
+	}
+}
 
-int WINAPI WinMain( _In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPSTR lpCmdLine, _In_ int nShowCmd )
+// Runs the benchmark once the game has loaded its sprites, and then cleans up without running the game
+static int RunBenchmark()
 {
-	// Initialize GDI+
-	Gdiplus::GdiplusStartupInput startupInput;
-	ULONG_PTR token;
-	Gdiplus::Status gdiStatus = Gdiplus::GdiplusStartup( &token, &startupInput, NULL );
-	PLAY_ASSERT( Gdiplus::Ok == gdiStatus );
-	g_pGDIToken = token;
+	bool bPassed = PlayBenchmark::Instance().Run();
+	PlayBenchmark::Destroy();
+	PlayReplay::Destroy();
+	MainGameExit();
+
+	return bPassed ? PLAY_OK : PLAY_ERROR;
+}
+
+#ifndef PLAY_PLATFORM_HEADLESS
+
+// Instruct Visual Studio to add these to the list of libraries to link
+#pragma comment(lib, "dwmapi.lib")
+#pragma comment(lib, "psapi.lib")
 
+int WINAPI WinMain( _In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPSTR lpCmdLine, _In_ int nShowCmd )
+{
+	ReadCommandLine( __argc, __argv );
 	MainGameEntry( __argc, __argv );
 
+	if( PlayBenchmark::IsRequested() )
+		return RunBenchmark();
+
 	return PlayWindow::Instance().HandleWindows( hInstance, hPrevInstance, lpCmdLine, nShowCmd, L"PlayBuffer" );
 }
 
+#else
+
+// Takes "--frames=<count>" to stop after a number of frames and "--input=<file>" to run an input script
+// > Replays (see PlayReplay) stop when they reach the end of their recording
+// > The whole command line is passed on to MainGameEntry() as well
+int main( int argc, char* argv[] )
+{
+	int frameLimit = 0;
+	std::string inputScript;
+
+	for( int i = 1; i < argc; i++ )
+	{
+		if( strncmp( argv[i], "--frames=", 9 ) == 0 )
+			frameLimit = atoi( argv[i] + 9 );
+		else if( strncmp( argv[i], "--input=", 8 ) == 0 )
+			inputScript = argv[i] + 8;
+	}
+
+	ReadCommandLine( argc, argv );
+	MainGameEntry( argc, argv );
+
+	if( PlayBenchmark::IsRequested() )
+		return RunBenchmark();
+
+	if( !inputScript.empty() && !PlayWindow::Instance().LoadInputScript( inputScript ) )
+		DebugOutput( "PlayBuffer: Couldn't read the input script " + inputScript + "\n" );
+
+	return PlayWindow::Instance().HandleHeadless( frameLimit, 1.0f / FRAMES_PER_SECOND );
+}
+
+#endif
+
 //********************************************************************************************************************************
 // Constructor / Destructor (Private)
 //********************************************************************************************************************************
@@ -1519,6 +3097,12 @@ PlayWindow::PlayWindow( PixelData* pDisplayBuffer, int nScale )
 	PLAY_ASSERT( nScale > 0 );
 	m_pPlayBuffer = pDisplayBuffer;
 	m_scale = nScale;
+#ifdef PLAY_PLATFORM_HEADLESS
+	m_vPresentedPixels.resize( static_cast<size_t>( pDisplayBuffer->width ) * pDisplayBuffer->height );
+	m_presentedFrame.width = pDisplayBuffer->width;
+	m_presentedFrame.height = pDisplayBuffer->height;
+	m_presentedFrame.pPixels = m_vPresentedPixels.data();
+#endif
 }
 
 PlayWindow::~PlayWindow( void )
@@ -1552,6 +3136,7 @@ void PlayWindow::Destroy()
 	s_pInstance = nullptr;
 }
 
+#ifndef PLAY_PLATFORM_HEADLESS
 //********************************************************************************************************************************
 // Windows functions
 //********************************************************************************************************************************
@@ -1625,30 +3210,44 @@ int PlayWindow::HandleWindows( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPS
 			}
 		}
 
+		// Replays run as fast as they can, so they don't wait for the next frame or the compositor
+		bool bReplaying = PlayReplay::Instance().IsReplaying();
+
 		do
 		{
 			QueryPerformanceCounter( &now );
 			elapsedTime = ( now.QuadPart - lastDrawTime.QuadPart ) * 1000.0 / frequency.QuadPart;
 
-		} while( elapsedTime < 1000.0f / FRAMES_PER_SECOND );
+		} while( !bReplaying && elapsedTime < 1000.0f / FRAMES_PER_SECOND );
+
+		// Recordings and replays see a steady frame rate, so they play out the same however long the frames actually take
+		if( PlayReplay::Instance().IsRecording() || bReplaying )
+			elapsedTime = 1000.0 / FRAMES_PER_SECOND;
 
 		// Call the main game update function (only while we have the input focus in release mode)
 #ifndef _DEBUG
-		if( GetFocus() == m_hWindow )
+		if( GetFocus() == m_hWindow || bReplaying )
 #endif
+		{
+			PlayReplay::Instance().BeginFrame();
 			quit = MainGameUpdate( static_cast<float>( elapsedTime ) / 1000.0f );
+			PlayReplay::Instance().EndFrame();
+			quit = quit || PlayReplay::Instance().IsFinished();
+		}
 
+		PlayProfiler::Instance().EndFrame();
 		lastDrawTime = now;
 
-		DwmFlush(); // Waits for DWM compositor to finish
+		if( !bReplaying )
+			DwmFlush(); // Waits for DWM compositor to finish
 	}
 
+	PlayReplay::Instance().Stop();
+	PlayReplay::Destroy();
+
 	// Call the main game cleanup function
 	MainGameExit();
 
-	PLAY_ASSERT( g_pGDIToken );
-	Gdiplus::GdiplusShutdown( g_pGDIToken );
-
 	return static_cast<int>( msg.wParam );
 }
 
@@ -1732,1588 +3331,4856 @@ double PlayWindow::Present( void )
 	return elapsedTime;
 }
 
+#else
 //********************************************************************************************************************************
-// Loading functions
+// Headless functions
 //********************************************************************************************************************************
 
-int PlayWindow::ReadPNGImage( std::string& fileAndPath, int& width, int& height )
+int PlayWindow::HandleHeadless( int frameLimit, float frameTime )
 {
-	// Convert filename from single to wide string for GDI+ compatibility
-	size_t newsize = strlen( fileAndPath.c_str() ) + 1;
-	wchar_t* wcstring = new wchar_t[newsize];
-	size_t convertedChars = 0;
-	mbstowcs_s( &convertedChars, wcstring, newsize, fileAndPath.c_str(), _TRUNCATE );
-
-	HBITMAP hBitmap = NULL;
+	bool quit = false;
 
-	// Use GDI+ to load file into Bitmap structure
-	Gdiplus::Bitmap* bitmap = Gdiplus::Bitmap::FromFile( wcstring, false );
-	int status = bitmap->GetLastStatus();
+	// The game sees a steady frame rate however fast or slow the frames actually run
+	while( !quit && ( frameLimit <= 0 || m_frameCount < frameLimit ) )
+	{
+		ApplyInput();
+		PlayReplay::Instance().BeginFrame();
+		quit = MainGameUpdate( frameTime );
+		PlayReplay::Instance().EndFrame();
+		quit = quit || PlayReplay::Instance().IsFinished();
+		PlayProfiler::Instance().EndFrame();
+		m_frameCount++;
+	}
 
-	if( status != Gdiplus::Ok )
-		return -status;
+	bool bReplayOk = PlayReplay::Instance().Stop();
+	PlayReplay::Destroy();
 
-	bitmap->GetHBITMAP( Gdiplus::Color( 255, 255, 255 ), &hBitmap );
+	// Call the main game cleanup function (which destroys this instance)
+	MainGameExit();
 
-	width = bitmap->GetWidth();
-	height = bitmap->GetHeight();
+#ifdef _DEBUG
+	// Strict allocations fail the run, so soak tests catch any allocations creeping back into the game loop
+	if( GetStrictAllocationCount() > 0 )
+	{
+		DebugOutput( "PlayBuffer: " + std::to_string( GetStrictAllocationCount() ) + " strict allocations were made\n" );
+		return PLAY_ERROR;
+	}
+#endif
 
-	delete bitmap;
-	delete[] wcstring;
+	return bReplayOk ? PLAY_OK : PLAY_ERROR;
+}
 
-	return 1;
+void PlayWindow::QueueInput( const InputEvent& inputEvent )
+{
+	// Events for the same frame keep their order
+	auto i = std::upper_bound( m_vInputEvents.begin() + m_nextInputEvent, m_vInputEvents.end(), inputEvent, []( const InputEvent& a, const InputEvent& b ) { return a.frame < b.frame; } );
+	m_vInputEvents.insert( i, inputEvent );
 }
 
-int PlayWindow::LoadPNGImage( std::string& fileAndPath, PixelData& destImage )
+bool PlayWindow::LoadInputScript( const std::string& fileAndPath )
 {
-	// Convert filename from single to wide string for GDI+ compatibility
-	size_t newsize = strlen( fileAndPath.c_str() ) + 1;
-	wchar_t* wcstring = new wchar_t[newsize];
-	size_t convertedChars = 0;
-	mbstowcs_s( &convertedChars, wcstring, newsize, fileAndPath.c_str(), _TRUNCATE );
+	std::ifstream script( GetPlatformPath( fileAndPath ) );
+	if( !script )
+		return false;
 
-	HBITMAP hBitmap = NULL;
+	std::string line;
+	while( std::getline( script, line ) )
+	{
+		std::istringstream stream( line );
+		InputEvent inputEvent{ 0, -1, false, { 0.0f, 0.0f } };
+		std::string action, key;
+
+		// Anything which isn't an event (e.g. a comment) is skipped
+		if( !( stream >> inputEvent.frame >> action ) )
+			continue;
+
+		if( action == "mouse" )
+		{
+			if( stream >> inputEvent.mousePos.null >> inputEvent.mousePos.y )
+				QueueInput( inputEvent );
+			continue;
+		}
 
-	// Use GDI+ to load file into Bitmap structure
-	Gdiplus::Bitmap* bitmap = Gdiplus::Bitmap::FromFile( wcstring, false );
-	int status = bitmap->GetLastStatus();
+		if( ( action != "down" && action != "up" ) || !( stream >> key ) )
+			continue;
 
-	if( status != Gdiplus::Ok )
-		return -status;
+		inputEvent.down = action == "down";
 
-	bitmap->GetHBITMAP( Gdiplus::Color( 255, 255, 255 ), &hBitmap );
+#define PLAY_HEADLESS_MATCH_KEY( name, code ) if( key == #name ) inputEvent.vKey = code;
+		PLAY_HEADLESS_KEYS( PLAY_HEADLESS_MATCH_KEY )
+#undef PLAY_HEADLESS_MATCH_KEY
 
-	// Create BitmapData structure to pull the data into
-	Gdiplus::BitmapData* bitmapData = new Gdiplus::BitmapData;
+		if( inputEvent.vKey < 0 && key.length() == 1 )
+			inputEvent.vKey = toupper( key[0] );
+		else if( inputEvent.vKey < 0 )
+			inputEvent.vKey = atoi( key.c_str() );
 
-	destImage.width = bitmap->GetWidth();
-	destImage.height = bitmap->GetHeight();
+		if( inputEvent.vKey > 0 && inputEvent.vKey < 256 )
+			QueueInput( inputEvent );
+	}
 
-	// Lock the bitmap in advance of reading its data
-	Gdiplus::Rect rect( 0, 0, destImage.width, destImage.height );
-	bitmap->LockBits( &rect, Gdiplus::ImageLockModeRead, PixelFormat32bppARGB, bitmapData );
+	return true;
+}
 
-	// Get a pointer to the actual bit data
-	Pixel* sourcePixels = static_cast<Pixel*>( bitmapData->Scan0 );
+void PlayWindow::ApplyInput()
+{
+	for( ; m_nextInputEvent < m_vInputEvents.size() && m_vInputEvents[m_nextInputEvent].frame <= m_frameCount; m_nextInputEvent++ )
+	{
+		const InputEvent& inputEvent = m_vInputEvents[m_nextInputEvent];
 
-	destImage.pPixels = new Pixel[destImage.width * destImage.height];
-	memset( destImage.pPixels, 0, sizeof( Pixel ) * destImage.width * destImage.height );
+		if( inputEvent.vKey < 0 )
+		{
+			if( m_pMouseData )
+				m_pMouseData->pos = inputEvent.mousePos;
+			continue;
+		}
 
-	Pixel* destPixels = destImage.pPixels;
+		// The mouse buttons are seen through the mouse data, as they would be with a window
+		if( m_pMouseData && inputEvent.vKey == VK_LBUTTON )
+			m_pMouseData->left = inputEvent.down;
+		else if( m_pMouseData && inputEvent.vKey == VK_RBUTTON )
+			m_pMouseData->right = inputEvent.down;
 
-	// Copy the data across
-	for( int b = 0; b < destImage.width * destImage.height; b++ )
-		*destPixels++ = *sourcePixels++;
+		PlayInput::Instance().SetKeyDown( inputEvent.vKey, inputEvent.down );
+	}
+}
 
-	//Unlock the bitmap
-	bitmap->UnlockBits( bitmapData );
+double PlayWindow::Present( void )
+{
+	std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
 
-	delete bitmap;
-	delete bitmapData;
-	delete[] wcstring;
+	memcpy( m_presentedFrame.pPixels, m_pPlayBuffer->pPixels, sizeof( Pixel ) * m_vPresentedPixels.size() );
 
-	return 1;
+	return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - before ).count();
 }
 
+#endif
+
 //********************************************************************************************************************************
-// Miscellaneous functions
+// Loading functions
 //********************************************************************************************************************************
 
-void AssertFailMessage( const char* message, const char* file, long line )
+int PlayWindow::ReadPNGImage( const std::string& fileAndPath, int& width, int& height )
 {
-	// file - the file in which the assertion failed ( __FILE__ )
-	// line - the line of code where the assertion failed ( __LINE__ )
-	std::filesystem::path p = file;
-	std::string s = p.filename().string() + " : LINE " + std::to_string( line );
-	s += "\n" + std::string( message );
-	int wide_count = MultiByteToWideChar( CP_UTF8, 0, s.c_str(), -1, NULL, 0 );
-	wchar_t* wide = new wchar_t[wide_count];
-	MultiByteToWideChar( CP_UTF8, 0, s.c_str(), -1, wide, wide_count );
-	MessageBox( NULL, wide, (LPCWSTR)L"Assertion Failure", MB_ICONWARNING );
-	delete[] wide;
+	if( !PlayPNG::ReadSize( fileAndPath, width, height ) )
+		return -1;
+
+	return 1;
 }
 
-void DebugOutput( const char* s )
+int PlayWindow::LoadPNGImage( const std::string& fileAndPath, PixelData& destImage )
 {
-	OutputDebugStringA( s );
+	if( !PlayPNG::LoadFile( fileAndPath, destImage ) )
+		return -1;
+
+	return 1;
 }
 
-void DebugOutput( std::string s )
+#ifndef PLAY_PLATFORM_HEADLESS
+const void* PlayWindow::MapFile( const std::string& fileAndPath, size_t& fileSize, void*& hMapping )
 {
-	OutputDebugStringA( s.c_str() );
+	hMapping = nullptr;
+	fileSize = 0;
+
+	HANDLE hFile = CreateFileA( fileAndPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if( hFile == INVALID_HANDLE_VALUE )
+		return nullptr;
+
+	LARGE_INTEGER size;
+	if( !GetFileSizeEx( hFile, &size ) || size.QuadPart == 0 )
+	{
+		CloseHandle( hFile );
+		return nullptr;
+	}
+
+	// The mapping keeps the file open so we don't need the file handle any more
+	HANDLE hMap = CreateFileMappingA( hFile, nullptr, PAGE_WRITECOPY, 0, 0, nullptr );
+	CloseHandle( hFile );
+
+	if( !hMap )
+		return nullptr;
+
+	const void* pFile = MapViewOfFile( hMap, FILE_MAP_COPY, 0, 0, 0 );
+	if( !pFile )
+	{
+		CloseHandle( hMap );
+		return nullptr;
+	}
+
+	hMapping = hMap;
+	fileSize = static_cast<size_t>( size.QuadPart );
+	return pFile;
 }
 
-void TracePrintf( const char* file, int line, const char* fmt, ... )
+void PlayWindow::UnmapFile( const void* pFile, void* hMapping )
 {
-	constexpr size_t kMaxBufferSize = 512u;
-	char buffer[kMaxBufferSize];
+	if( pFile )
+		UnmapViewOfFile( pFile );
 
-	va_list args;
-	va_start( args, fmt );
-	// format should be double click-able in VS 
-	int len = sprintf_s( buffer, kMaxBufferSize, "%s(%d): ", file, line );
-	vsprintf_s( buffer + len, kMaxBufferSize - len, fmt, args );
-	DebugOutput( buffer );
-	va_end( args );
+	if( hMapping )
+		CloseHandle( hMapping );
 }
 
-//********************************************************************************************************************************
-// File:		PlayBlitter.cpp
-// Description:	A software pixel renderer for drawing 2D primitives into a PixelData buffer
-// Platform:	Independent
-//********************************************************************************************************************************
-
+void PlayWindow::ReleaseMappedPages( const void* pStart, size_t size )
+{
+	// Unlocking pages which aren't locked fails, but still removes them from the working set
+	VirtualUnlock( const_cast<void*>( pStart ), size );
+}
 
-PlayBlitter::PlayBlitter( PixelData* pRenderTarget )
+std::string PlayWindow::GetPlatformPath( const std::string& path )
 {
-	m_pRenderTarget = pRenderTarget;
+	return path;
 }
 
+size_t PlayWindow::GetProcessMemory()
+{
+	PROCESS_MEMORY_COUNTERS counters;
+	if( !GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) )
+		return 0;
 
-void PlayBlitter::DrawPixel( int posX, int posY, Pixel srcPix )
+	return counters.WorkingSetSize;
+}
+#else
+const void* PlayWindow::MapFile( const std::string& fileAndPath, size_t& fileSize, void*& hMapping )
 {
-	if( srcPix.a == 0x00 || posX < 0 || posX >= m_pRenderTarget->width || posY < 0 || posY >= m_pRenderTarget->height )
-		return;
+	hMapping = nullptr;
+	fileSize = 0;
 
-	Pixel* destPix = &m_pRenderTarget->pPixels[( posY * m_pRenderTarget->width ) + posX];
+	// Without the Windows API the file is simply read into memory, which is private to the caller just like a copy-on-write mapping
+	std::ifstream file( GetPlatformPath( fileAndPath ), std::ios::binary | std::ios::ate );
+	if( !file )
+		return nullptr;
 
-	if( srcPix.a == 0xFF ) // Completely opaque pixel - no need to blend
+	std::streamoff size = file.tellg();
+	if( size <= 0 )
+		return nullptr;
+
+	uint8_t* pFile = new uint8_t[static_cast<size_t>( size )];
+	file.seekg( 0 );
+
+	if( !file.read( reinterpret_cast<char*>( pFile ), size ) )
 	{
-		*destPix = srcPix.bits;
+		delete[] pFile;
+		return nullptr;
 	}
-	else
-	{
-		Pixel blendPix = *destPix;
-		float srcAlpha = srcPix.a / 255.0f;
-		float oneMinusSrcAlpha = 1.0f - srcAlpha;
 
-		blendPix.a = 0xFF;
-		blendPix.r = static_cast<uint8_t>( ( srcAlpha * srcPix.r ) + ( oneMinusSrcAlpha * blendPix.r ) );
-		blendPix.g = static_cast<uint8_t>( ( srcAlpha * srcPix.g ) + ( oneMinusSrcAlpha * blendPix.g ) );
-		blendPix.b = static_cast<uint8_t>( ( srcAlpha * srcPix.b ) + ( oneMinusSrcAlpha * blendPix.b ) );
+	hMapping = pFile;
+	fileSize = static_cast<size_t>( size );
+	return pFile;
+}
 
-		*destPix = blendPix.bits;
-	}
+void PlayWindow::UnmapFile( const void* pFile, void* hMapping )
+{
+	PLAY_ASSERT_MSG( pFile == hMapping, "Unmapping a file with the wrong handle" );
+	delete[] static_cast<uint8_t*>( hMapping );
+}
 
-	return;
+void PlayWindow::ReleaseMappedPages( const void*, size_t )
+{
+	// The file was read into ordinary memory, so there's nothing to release
 }
 
-void PlayBlitter::DrawLine( int startX, int startY, int endX, int endY, Pixel pix )
+std::string PlayWindow::GetPlatformPath( const std::string& path )
 {
-	//Implementation of Bresenham's Line Drawing Algorithm
-	int dx = abs( endX - startX );
-	int sx = 1;
-	if( endX < startX ) { sx = -1; }
+	// Windows accepts forward slashes too, so they work everywhere
+	std::string platformPath( path );
+	std::replace( platformPath.begin(), platformPath.end(), '\\', '/' );
+	return platformPath;
+}
 
-	int dy = -abs( endY - startY );
-	int sy = 1;
-	if( endY < startY ) { sy = -1; }
+size_t PlayWindow::GetProcessMemory()
+{
+	// Linux reports the resident set in kilobytes, and other platforms would need their own APIs
+	std::ifstream status( "/proc/self/status" );
+	std::string line;
+	while( std::getline( status, line ) )
+	{
+		if( line.compare( 0, 6, "VmRSS:" ) == 0 )
+			return static_cast<size_t>( strtoull( line.c_str() + 6, nullptr, 10 ) ) * 1024;
+	}
 
-	int err = dx + dy;
+	return 0;
+}
+#endif
 
-	if( err == 0 ) return;
+//********************************************************************************************************************************
+// Miscellaneous functions
+//********************************************************************************************************************************
 
-	int null = startX;
-	int y = startY;
+void AssertFailMessage( const char* message, const char* file, long line )
+{
+	// file - the file in which the assertion failed ( __FILE__ )
+	// line - the line of code where the assertion failed ( __LINE__ )
+	std::filesystem::path p = file;
+	std::string s = p.filename().string() + " : LINE " + std::to_string( line );
+	s += "\n" + std::string( message );
+#ifdef PLAY_PLATFORM_HEADLESS
+	// There's nobody to click on a message box
+	DebugOutput( "Assertion Failure: " + s + "\n" );
+#else
+	int wide_count = MultiByteToWideChar( CP_UTF8, 0, s.c_str(), -1, NULL, 0 );
+	wchar_t* wide = new wchar_t[wide_count];
+	MultiByteToWideChar( CP_UTF8, 0, s.c_str(), -1, wide, wide_count );
+	MessageBox( NULL, wide, (LPCWSTR)L"Assertion Failure", MB_ICONWARNING );
+	delete[] wide;
+#endif
+}
 
-	while( true )
-	{
-		DrawPixel( null, y, pix );
+void DebugOutput( const char* s )
+{
+	OutputDebugStringA( s );
+}
 
-		if( null == endX && y == endY )
-			break;
+void DebugOutput( std::string s )
+{
+	OutputDebugStringA( s.c_str() );
+}
 
-		int e2 = 2 * err;
-		if( e2 >= dy )
-		{
-			err += dy;
-			null += sx;
-		}
-		if( e2 <= dx )
-		{
-			err += dx;
-			y += sy;
-		}
-	}
+void TracePrintf( const char* file, int line, const char* fmt, ... )
+{
+	constexpr size_t kMaxBufferSize = 512u;
+	char buffer[kMaxBufferSize];
+
+	va_list args;
+	va_start( args, fmt );
+	// format should be double click-able in VS 
+	int len = sprintf_s( buffer, kMaxBufferSize, "%s(%d): ", file, line );
+	vsprintf_s( buffer + len, kMaxBufferSize - len, fmt, args );
+	DebugOutput( buffer );
+	va_end( args );
 }
 
 //********************************************************************************************************************************
-// Function:	BlitPixels - draws image data with and without a global alpha multiply
-// Parameters:	spriteId = the id of the sprite to draw
-//				xpos, ypos = the position you want to draw the sprite
-//				frameIndex = which frame of the animation to draw (wrapped)
-// Notes:		Alpha multiply approach is relatively unoptimized
+// File:		PlayPNG.cpp
+// Description:	A portable PNG decoder for loading images without any platform libraries
+// Platform:	Independent
+// Notes:		The row filters use SSE2 (where available) for the four bytes per pixel images used by most sprites
 //********************************************************************************************************************************
-void PlayBlitter::BlitPixels( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, float alphaMultiply ) const
+
+// Reads the compressed data a few bytes at a time, least significant bit first
+struct PlayPNG::BitReader
 {
-	PLAY_ASSERT_MSG( m_pRenderTarget, "Render target not set for PlayBlitter" );
+	const uint8_t* pData{ nullptr };
+	const uint8_t* pEnd{ nullptr };
+	uint64_t bits{ 0 };
+	int count{ 0 };
+	int padding{ 0 }; // The number of zero bytes added after the end of the data
 
-	// Nothing within the display buffer to draw
-	if( blitX > m_pRenderTarget->width || blitX + blitWidth < 0 || blitY > m_pRenderTarget->height || blitY + blitHeight < 0 )
-		return;
+	BitReader( const uint8_t* pStart, const uint8_t* pFinish ) : pData( pStart ), pEnd( pFinish ) {}
 
-	// Work out if we need to clip to the display buffer (and by how much)
-	int xClipStart = -blitX;
-	if( xClipStart < 0 ) { xClipStart = 0; }
+	// Tops up the bit buffer so there are always at least 56 bits available
+	void Refill()
+	{
+		while( count <= 56 )
+		{
+			uint64_t byte = 0;
+			if( pData < pEnd ) byte = *pData++; else padding++;
+			bits |= byte << count;
+			count += 8;
+		}
+	}
+	// Returns true if more bits have been used than were in the data
+	bool Overrun() const { return padding * 8 > count; }
+	uint32_t Get( int n ) { if( count < n ) Refill(); uint32_t value = static_cast<uint32_t>( bits & ( ( 1ull << n ) - 1 ) ); bits >>= n; count -= n; return value; }
+	// Discards any bits left in the current byte and moves the read pointer back to the first unused byte
+	void AlignToByte()
+	{
+		bits >>= count & 7;
+		count -= count & 7;
+		int unused = ( count / 8 ) - padding;
+		pData -= std::max( unused, 0 );
+		padding = std::max( padding - ( count / 8 ), 0 );
+		bits = 0;
+		count = 0;
+	}
+};
 
-	int xClipEnd = ( blitX + blitWidth ) - m_pRenderTarget->width;
-	if( xClipEnd < 0 ) { xClipEnd = 0; }
+// A canonical Huffman code with a lookup table for the short codes
+struct PlayPNG::Huffman
+{
+	static constexpr int FAST_BITS = 10;
+	uint16_t fast[1 << FAST_BITS]{ 0 }; // ( symbol << 4 ) | length for codes up to FAST_BITS long, zero otherwise
+	uint16_t counts[16]{ 0 }; // The number of codes of each length
+	uint16_t symbols[320]{ 0 }; // The symbols ordered by code length
 
-	int yClipStart = -blitY;
-	if( yClipStart < 0 ) { yClipStart = 0; }
+	// Creates the codes from a list of code lengths (one per symbol)
+	// > Returns false if the lengths don't make a valid code
+	bool Build( const uint8_t* pLengths, int n )
+	{
+		memset( fast, 0, sizeof( fast ) );
+		memset( counts, 0, sizeof( counts ) );
 
-	int yClipEnd = ( blitY + blitHeight ) - m_pRenderTarget->height;
-	if( yClipEnd < 0 ) { yClipEnd = 0; }
+		for( int s = 0; s < n; s++ )
+			counts[pLengths[s]]++;
+		counts[0] = 0;
 
-	// Set up the source and destination pointers based on clipping
-	int destOffset = ( m_pRenderTarget->width * ( blitY + yClipStart ) ) + ( blitX + xClipStart );
-	uint32_t* destPixels = &m_pRenderTarget->pPixels->bits + destOffset;
+		int left = 1;
+		for( int len = 1; len < 16; len++ )
+		{
+			left = ( left << 1 ) - counts[len];
+			if( left < 0 ) return false; // Over-subscribed (incomplete codes are allowed)
+		}
 
-	int srcClipOffset = ( srcPixelData.width * yClipStart ) + xClipStart;
-	uint32_t* srcPixels = &srcPixelData.pPixels->bits + srcOffset + srcClipOffset;
+		int offsets[16]{ 0 };
+		int codes[16]{ 0 };
+		for( int len = 1, code = 0; len < 16; len++ )
+		{
+			offsets[len] = offsets[len - 1] + counts[len - 1];
+			code = ( code + counts[len - 1] ) << 1;
+			codes[len] = code;
+		}
 
-	// Work out in advance how much we need to add to src and dest to reach the next row 
-	int destInc = m_pRenderTarget->width - blitWidth + xClipEnd + xClipStart;
-	int srcInc = srcPixelData.width - blitWidth + xClipEnd + xClipStart;
+		for( int s = 0; s < n; s++ )
+		{
+			int len = pLengths[s];
+			if( len == 0 )
+				continue;
 
-	//Work out final pixel in destination.
-	int destColOffset = ( m_pRenderTarget->width * ( blitHeight - yClipEnd - yClipStart - 1 ) ) + ( blitWidth - xClipEnd - xClipStart );
-	uint32_t* destColEnd = destPixels + destColOffset;
+			symbols[offsets[len]++] = static_cast<uint16_t>( s );
+			int code = codes[len]++;
 
-	//How many pixels per row in sprite.
-	int endRow = blitWidth - xClipEnd - xClipStart;
+			if( len <= FAST_BITS )
+			{
+				// The codes are packed most significant bit first, so reverse them to match the order the bits are read in
+				int reversed = 0;
+				for( int b = 0; b < len; b++ )
+					reversed |= ( ( code >> b ) & 1 ) << ( len - 1 - b );
 
-	if( alphaMultiply < 1.0f )
+				for( int i = reversed; i < ( 1 << FAST_BITS ); i += 1 << len )
+					fast[i] = static_cast<uint16_t>( ( s << 4 ) | len );
+			}
+		}
+		return true;
+	}
+
+	// Reads the next symbol
+	// > Returns -1 if the bits don't match any code
+	int Decode( BitReader& in ) const
 	{
-		// *******************************************************************************************************************************************************
-		// A basic (unoptimized) approach which separates the channels and performs a 'typical' alpha blending operation: (src * srcAlpha)+(dest * (1-srcAlpha))
-		// Has the advantage that a global alpha multiplication can be easily added over the top, so we use this method when a global multiply is required
-		// *******************************************************************************************************************************************************
+		if( in.count < 16 ) in.Refill();
 
-		// Slightly more optimised iterations without the additions in the loop
-		while( destPixels < destColEnd )
+		uint16_t entry = fast[in.bits & ( ( 1 << FAST_BITS ) - 1 )];
+		if( entry )
 		{
-			uint32_t* destRowEnd = destPixels + endRow;
+			in.bits >>= entry & 15;
+			in.count -= entry & 15;
+			return entry >> 4;
+		}
 
-			while( destPixels < destRowEnd )
-			{
-				uint32_t src = *srcPixels++;
-				uint32_t dest = *destPixels;
+		// Longer codes are decoded a bit at a time
+		int code = 0, first = 0, index = 0;
+		for( int len = 1; len < 16; len++ )
+		{
+			code |= in.Get( 1 );
+			int count = counts[len];
+			if( code - count < first )
+				return symbols[index + ( code - first )];
+			index += count;
+			first = ( first + count ) << 1;
+			code <<= 1;
+		}
+		return -1;
+	}
+};
 
-				// If this isn't a fully transparent pixel 
-				if( src < 0xFF000000 )
-				{
-					int srcAlpha = static_cast<int>( ( 0xFF - ( src >> 24 ) ) * alphaMultiply );
-					int constAlpha = static_cast<int>( 255 * alphaMultiply );
+bool PlayPNG::ReadSize( const std::string& fileAndPath, int& width, int& height )
+{
+	// The signature and IHDR chunk are always the first 24 bytes of the file
+	uint8_t header[24];
+	std::ifstream file( fileAndPath, std::ios::binary );
+	if( !file.read( reinterpret_cast<char*>( header ), sizeof( header ) ) || memcmp( header + 12, "IHDR", 4 ) != 0 )
+		return false;
 
-					// Source pixels are already multiplied by srcAlpha so we just apply the constant alpha multiplier
-					int destRed = constAlpha * ( ( src >> 16 ) & 0xFF );
-					int destGreen = constAlpha * ( ( src >> 8 ) & 0xFF );
-					int destBlue = constAlpha * ( src & 0xFF );
+	width = ( header[16] << 24 ) | ( header[17] << 16 ) | ( header[18] << 8 ) | header[19];
+	height = ( header[20] << 24 ) | ( header[21] << 16 ) | ( header[22] << 8 ) | header[23];
+	return true;
+}
 
-					int invSrcAlpha = 0xFF - srcAlpha;
+bool PlayPNG::LoadFile( const std::string& fileAndPath, PixelData& destImage )
+{
+	std::ifstream file( fileAndPath, std::ios::binary | std::ios::ate );
+	if( !file )
+		return false;
 
-					// Apply a standard Alpha blend [ src*srcAlpha + dest*(1-SrcAlpha) ]
-					destRed += invSrcAlpha * ( ( dest >> 16 ) & 0xFF );
-					destGreen += invSrcAlpha * ( ( dest >> 8 ) & 0xFF );
-					destBlue += invSrcAlpha * ( dest & 0xFF );
+	std::vector<uint8_t> data( static_cast<size_t>( file.tellg() ) );
+	file.seekg( 0 );
+	if( !file.read( reinterpret_cast<char*>( data.data() ), static_cast<std::streamsize>( data.size() ) ) )
+		return false;
 
-					// Bring back to the range 0-255
-					destRed >>= 8;
-					destGreen >>= 8;
-					destBlue >>= 8;
+	return Decode( data.data(), data.size(), destImage );
+}
 
-					// Put ARGB components back together again
-					*destPixels++ = 0xFF000000 | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
-				}
-				else
-				{
-					// If this is a fully transparent pixel then the low bits store how many there are in a row
-					// This means we can skip to the next pixel which isn't fully transparent
-					uint32_t skip = static_cast<uint32_t>( destRowEnd - destPixels ) - 1;
-					src = src & 0x00FFFFFF;
-					if( skip > src ) skip = src;
+bool PlayPNG::Inflate( const uint8_t* pData, size_t size, std::vector<uint8_t>& output, size_t maxOutput )
+{
+	// The zlib header: compression method 8 (deflate), a valid check value and no preset dictionary
+	if( size < 2 || ( pData[0] & 0x0F ) != 8 || ( ( pData[0] << 8 ) | pData[1] ) % 31 != 0 || ( pData[1] & 0x20 ) )
+		return false;
 
-					srcPixels += skip;
-					++destPixels += skip;
-				}
-			}
-			// Increase buffers by pre-calculated amounts
-			destPixels += destInc;
-			srcPixels += srcInc;
-		}
+	BitReader in( pData + 2, pData + size );
+	Huffman lengthCodes, distanceCodes;
+	bool lastBlock = false;
 
-	}
-	else
+	while( !lastBlock )
 	{
-		// *******************************************************************************************************************************************************
-		// An optimized approach which uses pre-multiplied alpha, parallel channel multiplication and pixel skipping to achieve the same 'typical' alpha 
-		// blending operation (src * srcAlpha)+(dest * (1-srcAlpha)). Not easy to apply a global alpha multiplication over the top, but used everywhere else.
-		// *******************************************************************************************************************************************************
+		lastBlock = in.Get( 1 ) == 1;
+		uint32_t type = in.Get( 2 );
 
-		// Slightly more optimised iterations without the additions in the loop
-		while( destPixels < destColEnd )
+		if( type == 0 )
 		{
-			uint32_t* destRowEnd = destPixels + endRow;
+			// Stored block: copied straight from the input
+			in.AlignToByte();
+			if( in.pEnd - in.pData < 4 )
+				return false;
 
-			while( destPixels < destRowEnd )
+			int length = in.pData[0] | ( in.pData[1] << 8 );
+			int check = in.pData[2] | ( in.pData[3] << 8 );
+			in.pData += 4;
+
+			if( length != ( ~check & 0xFFFF ) || in.pEnd - in.pData < length || static_cast<size_t>( length ) > maxOutput - output.size() )
+				return false;
+
+			output.insert( output.end(), in.pData, in.pData + length );
+			in.pData += length;
+			continue;
+		}
+		else if( type == 1 )
+		{
+			// Fixed codes defined by the deflate specification
+			uint8_t lengths[288 + 30];
+			std::fill( lengths, lengths + 144, static_cast<uint8_t>( 8 ) );
+			std::fill( lengths + 144, lengths + 256, static_cast<uint8_t>( 9 ) );
+			std::fill( lengths + 256, lengths + 280, static_cast<uint8_t>( 7 ) );
+			std::fill( lengths + 280, lengths + 288, static_cast<uint8_t>( 8 ) );
+			std::fill( lengths + 288, lengths + 288 + 30, static_cast<uint8_t>( 5 ) );
+			lengthCodes.Build( lengths, 288 );
+			distanceCodes.Build( lengths + 288, 30 );
+		}
+		else if( type == 2 )
+		{
+			// Dynamic codes: the code lengths are themselves compressed using another Huffman code
+			static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+			int nLengths = in.Get( 5 ) + 257;
+			int nDistances = in.Get( 5 ) + 1;
+			int nCodeLengths = in.Get( 4 ) + 4;
+
+			uint8_t codeLengths[19]{ 0 };
+			for( int i = 0; i < nCodeLengths; i++ )
+				codeLengths[order[i]] = static_cast<uint8_t>( in.Get( 3 ) );
+
+			Huffman codeLengthCodes;
+			if( nLengths > 286 || nDistances > 30 || !codeLengthCodes.Build( codeLengths, 19 ) )
+				return false;
+
+			uint8_t lengths[286 + 30]{ 0 };
+			for( int i = 0; i < nLengths + nDistances; )
 			{
-				uint32_t src = *srcPixels++;
-				uint32_t dest = *destPixels;
+				int symbol = codeLengthCodes.Decode( in );
+				int repeat = 0;
+				uint8_t value = 0;
 
-				// If this isn't a fully transparent pixel 
-				if( src < 0xFF000000 )
+				if( symbol < 0 || in.Overrun() )
+					return false;
+				else if( symbol < 16 )
 				{
-					// This performes the dest*(1-srcAlpha) calculation for all channels in parallel with minor accuracy loss in dest colour.
-					// It does this by shifting all the destination channels down by 4 bits in order to "make room" for the later multiplication.
-					// After shifting down, it masks out the bits which have shifted into the adjacent channel data.
-					// This causes the RGB data to be rounded down to their nearest 16 producing a reduction in colour accuracy.
-					// This is then multiplied by the inverse alpha (inversed in PreMultiplyAlpha), also divided by 16 (hence >> 8+8+8+4).
-					// The multiplication brings our RGB values back up to their original bit ranges (albeit rounded to the nearest 16).
-					// As the colour accuracy only affects the destination pixels behind semi-transparent source pixels and so isn't very obvious.
-					dest = ( ( ( dest >> 4 ) & 0x000F0F0F ) * ( src >> 28 ) );
-					// Add the (pre-multiplied Alpha) source to the destination and force alpha to opaque
-					*destPixels++ = ( src + dest ) | 0xFF000000;
+					lengths[i++] = static_cast<uint8_t>( symbol );
+					continue;
 				}
-				else
+				else if( symbol == 16 )
 				{
-					// If this is a fully transparent pixel then the low bits store how many there are in a row
-					// This means we can skip to the next pixel which isn't fully transparent
-					uint32_t skip = static_cast<uint32_t>( destRowEnd - destPixels ) - 1;
-					src = src & 0x00FFFFFF;
-					if( skip > src ) skip = src;
-
-					srcPixels += skip;
-					++destPixels += skip;
+					if( i == 0 ) return false;
+					value = lengths[i - 1];
+					repeat = 3 + in.Get( 2 );
 				}
+				else if( symbol == 17 )
+					repeat = 3 + in.Get( 3 );
+				else
+					repeat = 11 + in.Get( 7 );
+
+				if( i + repeat > nLengths + nDistances )
+					return false;
+
+				while( repeat-- )
+					lengths[i++] = value;
 			}
-			// Increase buffers by pre-calculated amounts
-			destPixels += destInc;
-			srcPixels += srcInc;
+
+			if( lengths[256] == 0 || !lengthCodes.Build( lengths, nLengths ) || !distanceCodes.Build( lengths + nLengths, nDistances ) )
+				return false;
+		}
+		else
+		{
+			return false;
 		}
 
+		if( !InflateBlock( in, lengthCodes, distanceCodes, output, maxOutput ) )
+			return false;
 	}
 
-	return;
+	return true;
 }
 
-//********************************************************************************************************************************
-// Function:	RotateScaleSprite - draws a rotated and scaled sprite with global alpha multiply
-// Parameters:	s = the sprite to draw
-//				xpos, ypos = the position of the center of rotation.
-//				frameIndex = which frame of the animation to draw (wrapped)
-//				angle = rotation angle
-//				scale = parameter to magnify the sprite.
-//				rotOffX, rotOffY = offset of centre of rotation to the top left of the sprite
-//				alpha = the fraction defining the amount of sprite and background that is draw. 255 = all sprite, 0 = all background.
-// Notes:		Pre-calculates roughly where the sprite will be in the display buffer and only processes those pixels. 
-//				Approx 15 times slower than not rotating.
-//********************************************************************************************************************************
-void PlayBlitter::RotateScalePixels( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, int originX, int originY, float angle, float scale, float alphaMultiply ) const
+bool PlayPNG::InflateBlock( BitReader& in, const Huffman& lengthCodes, const Huffman& distanceCodes, std::vector<uint8_t>& output, size_t maxOutput )
 {
-	PLAY_ASSERT_MSG( m_pRenderTarget, "Render target not set for PlayBlitter" );
-
-	//pointers to start of source and destination buffers
-	uint32_t* pSrcBase = &srcPixelData.pPixels->bits + srcOffset;
-	uint32_t* pDstBase = &m_pRenderTarget->pPixels->bits;
-
-	//the centre of rotation in the sprite frame relative to the top corner
-	float fRotCentreU = static_cast<float>( originX );
-	float fRotCentreV = static_cast<float>( originY );
-
-	//u/v are co-ordinates in the rotated sprite frame. x/y are screen buffer co-ordinates.
-	//change in u/v for a unit change in x/y.
-	float dUdX = static_cast<float>( cos( -angle ) ) * ( 1.0f / scale );
-	float dVdX = static_cast<float>( sin( -angle ) ) * ( 1.0f / scale );
-	float dUdY = -dVdX;
-	float dVdY = dUdX;
-
-	//Position in the sprite rotated frame with origin at the center of rotation of the sprite corners.
-	float leftU = -fRotCentreU * scale;
-	float rightU = ( blitWidth + -fRotCentreU ) * scale;
-	float topV = ( -fRotCentreV ) * scale;
-	float bottomV = ( blitHeight - fRotCentreV ) * scale;
-
-	//Scale added in to cancel out the scale in dUdX.
-	float boundingBoxCorners[4][2]
-	{
-		{ ( dUdX * leftU + dVdX * topV ) * scale,			( dUdY * leftU + dVdY * topV ) * scale		},	// Top left
-		{ ( dUdX * leftU + dVdX * bottomV ) * scale,		( dUdY * leftU + dVdY * bottomV ) * scale		},	// Bottom left
-		{ ( dUdX * rightU + dVdX * bottomV ) * scale,		( dUdY * rightU + dVdY * bottomV ) * scale	},	// Bottom right
-		{ ( dUdX * rightU + dVdX * topV ) * scale,			( dUdY * rightU + dVdY * topV ) * scale,		},	// Top right
-	};
+	static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	static const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
 
-	float minX = std::numeric_limits<float>::infinity();
-	float minY = std::numeric_limits<float>::infinity();
-	float maxX = -std::numeric_limits<float>::infinity();
-	float maxY = -std::numeric_limits<float>::infinity();
-
-	//calculate the extremes of the rotated corners.
-	for( int i = 0; i < 4; i++ )
+	for( ;; )
 	{
-		minX = std::min( minX, boundingBoxCorners[i][0] );
-		maxX = std::max( maxX, boundingBoxCorners[i][0] );
-		minY = std::min( minY, boundingBoxCorners[i][1] );
-		maxY = std::max( maxY, boundingBoxCorners[i][1] );
-	}
-
-	//clip the starting and finishing positions.
-	int startY = blitY + static_cast<int>( minY );
-	if( startY < 0 ) { startY = 0; minY = static_cast<float>( -blitY ); }
+		int symbol = lengthCodes.Decode( in );
 
-	int endY = blitY + static_cast<int>( maxY );
-	if( endY > m_pRenderTarget->height ) { endY = m_pRenderTarget->height; }
+		if( symbol < 0 || in.Overrun() )
+			return false;
 
-	int startX = blitX + static_cast<int>( minX );
-	if( startX < 0 ) { startX = 0; minX = static_cast<float>( -blitX ); }
+		if( symbol < 256 )
+		{
+			if( output.size() == maxOutput )
+				return false;
 
-	int endX = blitX + static_cast<int>( maxX );
-	if( endX > m_pRenderTarget->width ) { endX = m_pRenderTarget->width; }
+			output.push_back( static_cast<uint8_t>( symbol ) );
+		}
+		else if( symbol == 256 )
+		{
+			return true;
+		}
+		else
+		{
+			// A repeat of earlier output: the source and destination may overlap so it's copied a byte at a time
+			symbol -= 257;
+			if( symbol >= 29 )
+				return false;
+
+			size_t length = lengthBase[symbol] + in.Get( lengthExtra[symbol] );
+			int distanceSymbol = distanceCodes.Decode( in );
+			if( distanceSymbol < 0 || distanceSymbol >= 30 )
+				return false;
+
+			size_t distance = distanceBase[distanceSymbol] + in.Get( distanceExtra[distanceSymbol] );
+			if( distance > output.size() || length > maxOutput - output.size() )
+				return false;
+
+			size_t start = output.size() - distance;
+			output.resize( output.size() + length );
+			uint8_t* pOut = output.data() + output.size() - length;
+			const uint8_t* pFrom = output.data() + start;
+			for( size_t i = 0; i < length; i++ )
+				pOut[i] = pFrom[i];
+		}
+	}
+}
 
-	//rotate the basis so we get the edge of the bounding box in the sprite frame.
-	float startingU = dUdX * minX + dUdY * minY + fRotCentreU;
-	float startingV = dVdY * minY + dVdX * minX + fRotCentreV;
+// The Paeth predictor from the PNG specification
+static inline uint8_t PaethPredictor( int a, int b, int c )
+{
+	int p = a + b - c;
+	int pa = abs( p - a ), pb = abs( p - b ), pc = abs( p - c );
+	if( pa <= pb && pa <= pc ) return static_cast<uint8_t>( a );
+	if( pb <= pc ) return static_cast<uint8_t>( b );
+	return static_cast<uint8_t>( c );
+}
 
-	float rowU = startingU;
-	float rowV = startingV;
+#if defined( _M_X64 ) || defined( _M_IX86 ) || defined( __SSE2__ )
+#define PLAY_PNG_SSE2
+#endif
 
-	uint32_t* destPixels = pDstBase + ( static_cast<size_t>( m_pRenderTarget->width ) * startY ) + startX;
-	int nextRow = m_pRenderTarget->width - ( endX - startX );
+#ifdef PLAY_PNG_SSE2
+// Loads four bytes into the bottom of an SSE register
+static inline __m128i LoadPixel( const uint8_t* p ) { int32_t v; memcpy( &v, p, 4 ); return _mm_cvtsi32_si128( v ); }
+// Stores the bottom four bytes of an SSE register
+static inline void StorePixel( uint8_t* p, __m128i v ) { int32_t i = _mm_cvtsi128_si32( v ); memcpy( p, &i, 4 ); }
+#endif
 
-	uint32_t* srcPixels = pSrcBase;
+bool PlayPNG::Unfilter( uint8_t* pData, int rowBytes, int rows, int bytesPerPixel )
+{
+	const int bpp = bytesPerPixel;
+	std::vector<uint8_t> zeroRow( rowBytes, 0 );
+	const uint8_t* prior = zeroRow.data();
 
-	//Start of double for loop. 
-	for( int y = startY; y < endY; y++ )
+	for( int r = 0; r < rows; r++ )
 	{
-		float u = rowU;
-		float v = rowV;
+		uint8_t filter = pData[0];
+		uint8_t* row = pData + 1;
+		int i = 0;
 
-		for( int null = startX; null < endX; null++ )
+		switch( filter )
 		{
-			//Check to see if u and v correspond to a valid pixel in sprite.
-			if( u > 0 && v > 0 && u < blitWidth && v < blitHeight )
-			{
-				srcPixels = pSrcBase + static_cast<size_t>( u ) + ( static_cast<size_t>( v ) * srcPixelData.width );
-				uint32_t src = *srcPixels;
+			case 0: // None
+				break;
 
-				if( src < 0xFF000000 )
+			case 1: // Sub
+#ifdef PLAY_PNG_SSE2
+				if( bpp == 4 )
 				{
-					int srcAlpha = static_cast<int>( ( 0xFF - ( src >> 24 ) ) * alphaMultiply );
-					int constAlpha = static_cast<int>( 255 * alphaMultiply );
-
-					// Source pixels are already multiplied by srcAlpha so we just apply the constant alpha multiplier
-					int destRed = constAlpha * ( ( src >> 16 ) & 0xFF );
-					int destGreen = constAlpha * ( ( src >> 8 ) & 0xFF );
-					int destBlue = constAlpha * ( src & 0xFF );
-
-					uint32_t dest = *destPixels;
-					int invSrcAlpha = 0xFF - srcAlpha;
-
-					// Apply a standard Alpha blend [ src*srcAlpha + dest*(1-SrcAlpha) ]
-					destRed += invSrcAlpha * ( ( dest >> 16 ) & 0xFF );
-					destGreen += invSrcAlpha * ( ( dest >> 8 ) & 0xFF );
-					destBlue += invSrcAlpha * ( dest & 0xFF );
+					__m128i a = _mm_setzero_si128();
+					for( ; i < rowBytes; i += 4 )
+					{
+						a = _mm_add_epi8( a, LoadPixel( row + i ) );
+						StorePixel( row + i, a );
+					}
+					break;
+				}
+#endif
+				for( i = bpp; i < rowBytes; i++ )
+					row[i] = static_cast<uint8_t>( row[i] + row[i - bpp] );
+				break;
 
-					// Bring back to the range 0-255
-					destRed >>= 8;
-					destGreen >>= 8;
-					destBlue >>= 8;
+			case 2: // Up
+#ifdef PLAY_PNG_SSE2
+				for( ; i + 16 <= rowBytes; i += 16 )
+				{
+					__m128i sum = _mm_add_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i*>( row + i ) ), _mm_loadu_si128( reinterpret_cast<const __m128i*>( prior + i ) ) );
+					_mm_storeu_si128( reinterpret_cast<__m128i*>( row + i ), sum );
+				}
+#endif
+				for( ; i < rowBytes; i++ )
+					row[i] = static_cast<uint8_t>( row[i] + prior[i] );
+				break;
 
-					// Put ARGB components back together again
-					*destPixels = 0xFF000000 | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
+			case 3: // Average
+#ifdef PLAY_PNG_SSE2
+				if( bpp == 4 )
+				{
+					// _mm_avg_epu8 rounds up, so subtract one where the sum was odd
+					const __m128i one = _mm_set1_epi8( 1 );
+					__m128i a = _mm_setzero_si128();
+					for( ; i < rowBytes; i += 4 )
+					{
+						__m128i b = LoadPixel( prior + i );
+						__m128i average = _mm_sub_epi8( _mm_avg_epu8( a, b ), _mm_and_si128( _mm_xor_si128( a, b ), one ) );
+						a = _mm_add_epi8( LoadPixel( row + i ), average );
+						StorePixel( row + i, a );
+					}
+					break;
 				}
-			}
+#endif
+				for( ; i < bpp; i++ )
+					row[i] = static_cast<uint8_t>( row[i] + ( prior[i] >> 1 ) );
+				for( ; i < rowBytes; i++ )
+					row[i] = static_cast<uint8_t>( row[i] + ( ( row[i - bpp] + prior[i] ) >> 1 ) );
+				break;
 
-			destPixels++;
+			case 4: // Paeth
+#ifdef PLAY_PNG_SSE2
+				if( bpp == 4 )
+				{
+					// Works on 16-bit lanes so the differences can't overflow
+					const __m128i zero = _mm_setzero_si128();
+					const __m128i mask = _mm_set1_epi16( 0xFF );
+					__m128i a = zero, c = zero;
+					for( ; i < rowBytes; i += 4 )
+					{
+						__m128i b = _mm_unpacklo_epi8( LoadPixel( prior + i ), zero );
+						__m128i pa = _mm_sub_epi16( b, c ); // |p-a| = |b-c|
+						__m128i pb = _mm_sub_epi16( a, c ); // |p-b| = |a-c|
+						__m128i pc = _mm_add_epi16( pa, pb ); // |p-c| = |a+b-2c|
+						pa = _mm_max_epi16( pa, _mm_sub_epi16( zero, pa ) );
+						pb = _mm_max_epi16( pb, _mm_sub_epi16( zero, pb ) );
+						pc = _mm_max_epi16( pc, _mm_sub_epi16( zero, pc ) );
+
+						__m128i smallest = _mm_min_epi16( pc, _mm_min_epi16( pa, pb ) );
+						__m128i useA = _mm_cmpeq_epi16( smallest, pa );
+						__m128i useB = _mm_cmpeq_epi16( smallest, pb );
+						__m128i bOrC = _mm_or_si128( _mm_and_si128( useB, b ), _mm_andnot_si128( useB, c ) );
+						__m128i nearest = _mm_or_si128( _mm_and_si128( useA, a ), _mm_andnot_si128( useA, bOrC ) );
+
+						a = _mm_and_si128( _mm_add_epi16( _mm_unpacklo_epi8( LoadPixel( row + i ), zero ), nearest ), mask );
+						StorePixel( row + i, _mm_packus_epi16( a, a ) );
+						c = b;
+					}
+					break;
+				}
+#endif
+				for( ; i < bpp; i++ )
+					row[i] = static_cast<uint8_t>( row[i] + prior[i] );
+				for( ; i < rowBytes; i++ )
+					row[i] = static_cast<uint8_t>( row[i] + PaethPredictor( row[i - bpp], prior[i], prior[i - bpp] ) );
+				break;
 
-			// Change the position in the sprite frame for changing X in the display
-			u += dUdX;
-			v += dVdX;
+			default:
+				return false;
 		}
 
-		// Work out the change in the sprite frame for changing Y in the display
-		rowU += dUdY;
-		rowV += dVdY;
-		// Next row
-		destPixels += nextRow;
+		prior = row;
+		pData += rowBytes + 1;
 	}
 
+	return true;
 }
 
-
-void PlayBlitter::ClearRenderTarget( Pixel colour )
+bool PlayPNG::Decode( const uint8_t* pData, size_t size, PixelData& destImage )
 {
-	Pixel* pBuffEnd = m_pRenderTarget->pPixels + ( m_pRenderTarget->width * m_pRenderTarget->height );
-	for( Pixel* pBuff = m_pRenderTarget->pPixels; pBuff < pBuffEnd; *pBuff++ = colour.bits );
-	m_pRenderTarget->preMultiplied = false;
-}
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+	if( size < 8 || memcmp( pData, signature, 8 ) != 0 )
+		return false;
 
-void PlayBlitter::BlitBackground( PixelData& backgroundImage )
-{
-	PLAY_ASSERT_MSG( backgroundImage.height == m_pRenderTarget->height && backgroundImage.width == m_pRenderTarget->width, "Background size doesn't match render target!" );
-	// Takes about 1ms for 720p screen on i7-8550U
-	memcpy( m_pRenderTarget->pPixels, backgroundImage.pPixels, sizeof( Pixel ) * m_pRenderTarget->width * m_pRenderTarget->height );
-}
+	int width = 0, height = 0, bitDepth = 0, colourType = 0, interlace = 0;
+	uint32_t palette[256];
+	std::fill( palette, palette + 256, 0xFF000000 );
+	int transparentKey[3]{ -1, -1, -1 }; // The colour which is transparent for greyscale and RGB images (if any)
+	std::vector<uint8_t> compressed;
 
+	auto readInt = []( const uint8_t* p ) { return static_cast<uint32_t>( ( p[0] << 24 ) | ( p[1] << 16 ) | ( p[2] << 8 ) | p[3] ); };
 
-//********************************************************************************************************************************
-// File:		PlayGraphics.cpp
-// Description:	Manages 2D graphics operations on a PixelData buffer 
-// Platform:	Independent
-// Notes:		Uses PNG format. The end of the filename indicates the number of frames e.g. "bat_4.png" or "tiles_10x10.png"
-//********************************************************************************************************************************
+	// Gather the chunks we need: everything else is optional and can be ignored
+	for( size_t pos = 8; pos + 12 <= size; )
+	{
+		uint32_t length = readInt( pData + pos );
+		const uint8_t* pType = pData + pos + 4;
+		const uint8_t* pChunk = pData + pos + 8;
 
+		if( length > size - pos - 12 )
+			return false;
 
-PlayGraphics* PlayGraphics::s_pInstance = nullptr;
+		if( memcmp( pType, "IHDR", 4 ) == 0 && length >= 13 )
+		{
+			width = static_cast<int>( readInt( pChunk ) );
+			height = static_cast<int>( readInt( pChunk + 4 ) );
+			bitDepth = pChunk[8];
+			colourType = pChunk[9];
+			interlace = pChunk[12];
+		}
+		else if( memcmp( pType, "PLTE", 4 ) == 0 )
+		{
+			for( uint32_t i = 0; i < length / 3 && i < 256; i++ )
+				palette[i] = 0xFF000000 | ( pChunk[i * 3] << 16 ) | ( pChunk[i * 3 + 1] << 8 ) | pChunk[i * 3 + 2];
+		}
+		else if( memcmp( pType, "tRNS", 4 ) == 0 )
+		{
+			if( colourType == 3 )
+			{
+				for( uint32_t i = 0; i < length && i < 256; i++ )
+					palette[i] = ( palette[i] & 0x00FFFFFF ) | ( pChunk[i] << 24 );
+			}
+			else
+			{
+				for( uint32_t i = 0; i < length / 2 && i < 3; i++ )
+					transparentKey[i] = ( pChunk[i * 2] << 8 ) | pChunk[i * 2 + 1];
+			}
+		}
+		else if( memcmp( pType, "IDAT", 4 ) == 0 )
+		{
+			compressed.insert( compressed.end(), pChunk, pChunk + length );
+		}
+		else if( memcmp( pType, "IEND", 4 ) == 0 )
+		{
+			break;
+		}
 
-//********************************************************************************************************************************
-// Constructor / Destructor (Private)
-//********************************************************************************************************************************
+		pos += static_cast<size_t>( length ) + 12;
+	}
 
-PlayGraphics::PlayGraphics( int bufferWidth, int bufferHeight, const char* path )
-{
-	// A working buffer for our display. Each pixel is stored as an unsigned 32-bit integer: alpha<<24 | red<<16 | green<<8 | blue
-	m_playBuffer.width = bufferWidth;
-	m_playBuffer.height = bufferHeight;
-	m_playBuffer.pPixels = new Pixel[static_cast<size_t>( bufferWidth ) * bufferHeight];
-	m_playBuffer.preMultiplied = false;
-	PLAY_ASSERT( m_playBuffer.pPixels );
+	// Anything bigger than this is assumed to be a corrupt header rather than a real sprite
+	constexpr int MAX_DIMENSION = 16384;
 
-	memset( m_playBuffer.pPixels, 0, sizeof( uint32_t ) * bufferWidth * bufferHeight );
+	static const int channelCounts[7] = { 1, 0, 3, 1, 2, 0, 4 };
+	if( width <= 0 || height <= 0 || width > MAX_DIMENSION || height > MAX_DIMENSION || colourType > 6 || channelCounts[colourType] == 0 || interlace > 1 ||
+		( bitDepth != 1 && bitDepth != 2 && bitDepth != 4 && bitDepth != 8 && bitDepth != 16 ) || ( colourType == 3 && bitDepth == 16 ) )
+		return false;
 
-	// Make the display buffer the render target for the blitter
-	m_blitter.SetRenderTarget( &m_playBuffer );
+	int channels = channelCounts[colourType];
+	int bitsPerPixel = channels * bitDepth;
+	int bytesPerPixel = std::max( bitsPerPixel / 8, 1 );
 
-	// Iterate through the directory
-	PLAY_ASSERT_MSG( std::filesystem::exists( path ), "PlayBuffer: Drectory provided does not exist." );
+	// Non-interlaced images have a single pass covering every pixel, interlaced ones have seven (Adam7)
+	static const int passStartX[7] = { 0, 4, 0, 2, 0, 1, 0 }, passStartY[7] = { 0, 0, 4, 0, 2, 0, 1 };
+	static const int passStepX[7] = { 8, 8, 4, 4, 2, 2, 1 }, passStepY[7] = { 8, 8, 8, 4, 4, 2, 2 };
+	int passes = interlace ? 7 : 1;
 
-	for( const auto& p : std::filesystem::directory_iterator( path ) )
+	// The header gives the exact size of the decompressed data (each row has a filter byte), so a corrupt or
+	// malicious stream can't make it grow any bigger than that
+	size_t rawSize = 0;
+	for( int pass = 0; pass < passes; pass++ )
 	{
-		// Switch everything to uppercase to avoid need to check case each time
-		std::string filename = p.path().string();
-		for( char& c : filename ) c = static_cast<char>( toupper( c ) );
-
-		// Only attempt to load PNG files
-		if( filename.find( ".PNG" ) != std::string::npos )
-		{
-			std::ifstream png_infile;
-			png_infile.open( filename, std::ios::binary ); // Don't do this as part of the constructor or we lose 16 bytes!
+		int passWidth = interlace ? ( width - passStartX[pass] + passStepX[pass] - 1 ) / passStepX[pass] : width;
+		int passHeight = interlace ? ( height - passStartY[pass] + passStepY[pass] - 1 ) / passStepY[pass] : height;
 
-			// If the PNG was opened okay
-			if( png_infile )
-			{
-				int spriteId = LoadSpriteSheet( p.path().parent_path().string() + "\\", p.path().stem().string() );
+		if( passWidth > 0 && passHeight > 0 )
+			rawSize += ( ( ( static_cast<size_t>( passWidth ) * bitsPerPixel + 7 ) / 8 ) + 1 ) * passHeight;
+	}
 
-				// Now we check for .inf file for each sprite and load origins
-				int originX = 0, originY = 0;
+	std::vector<uint8_t> raw;
+	raw.reserve( rawSize );
+	if( !Inflate( compressed.data(), compressed.size(), raw, rawSize ) )
+		return false;
 
-				std::string info_filename = filename.replace( filename.find( ".PNG" ), 4, ".INF" );
+	destImage.width = width;
+	destImage.height = height;
+	destImage.pPixels = new Pixel[static_cast<size_t>( width ) * height];
+	destImage.preMultiplied = false;
 
-				if( std::filesystem::exists( info_filename ) )
-				{
-					std::ifstream info_infile;
-					info_infile.open( info_filename, std::ios::in );
+	// Reads a single sample from a row, scaled to 8 bits (or returned as-is for comparing against the transparent key)
+	auto readSample = [bitDepth]( const uint8_t* row, int index, bool scale ) -> int
+	{
+		if( bitDepth == 8 ) return row[index];
+		if( bitDepth == 16 ) return scale ? row[index * 2] : ( row[index * 2] << 8 ) | row[index * 2 + 1];
+		int bit = index * bitDepth;
+		int value = ( row[bit >> 3] >> ( 8 - bitDepth - ( bit & 7 ) ) ) & ( ( 1 << bitDepth ) - 1 );
+		return scale ? value * ( 255 / ( ( 1 << bitDepth ) - 1 ) ) : value;
+	};
 
-					PLAY_ASSERT_MSG( info_infile.is_open(), std::string( "Unable to load existing .inf file: " + info_filename ).c_str() );
-					if( info_infile.is_open() )
-					{
-						std::string type;
-						info_infile >> type;
-						info_infile >> originX;
-						info_infile >> originY;
-					}
+	size_t offset = 0;
 
-					info_infile.close();
-				}
+	for( int pass = 0; pass < passes; pass++ )
+	{
+		int startX = interlace ? passStartX[pass] : 0, startY = interlace ? passStartY[pass] : 0;
+		int stepX = interlace ? passStepX[pass] : 1, stepY = interlace ? passStepY[pass] : 1;
+		int passWidth = ( width - startX + stepX - 1 ) / stepX;
+		int passHeight = ( height - startY + stepY - 1 ) / stepY;
 
-				SetSpriteOrigin( spriteId, { originX, originY } );
-			}
+		if( passWidth <= 0 || passHeight <= 0 )
+			continue;
 
-			png_infile.close();
+		int rowBytes = static_cast<int>( ( static_cast<size_t>( passWidth ) * bitsPerPixel + 7 ) / 8 );
+		if( raw.size() - offset < static_cast<size_t>( rowBytes + 1 ) * passHeight || !Unfilter( raw.data() + offset, rowBytes, passHeight, bytesPerPixel ) )
+		{
+			delete[] destImage.pPixels;
+			destImage.pPixels = nullptr;
+			return false;
 		}
-	}
-}
 
-PlayGraphics::~PlayGraphics()
-{
-	for( Sprite& s : vSpriteData )
-	{
-		if( s.canvasBuffer.pPixels )
-			delete[] s.canvasBuffer.pPixels;
+		for( int r = 0; r < passHeight; r++ )
+		{
+			const uint8_t* row = raw.data() + offset + ( static_cast<size_t>( rowBytes + 1 ) * r ) + 1;
+			uint32_t* pDest = &destImage.pPixels[( ( startY + r * stepY ) * width ) + startX].bits;
 
-		if( s.preMultAlpha.pPixels )
-			delete[] s.preMultAlpha.pPixels;
-	}
+			// Most sprites are 8-bit RGBA so they get their own loop
+			if( colourType == 6 && bitDepth == 8 )
+			{
+				for( int c = 0; c < passWidth; c++, row += 4 )
+					pDest[c * stepX] = ( row[3] << 24 ) | ( row[0] << 16 ) | ( row[1] << 8 ) | row[2];
+				continue;
+			}
 
-	for( PixelData& pBgBuffer : vBackgroundData )
-		delete[] pBgBuffer.pPixels;
+			for( int c = 0; c < passWidth; c++ )
+			{
+				uint32_t a = 0xFF, red, green, blue;
 
-	if( m_pDebugFontBuffer )
-		delete[] m_pDebugFontBuffer;
+				switch( colourType )
+				{
+					case 0: // Greyscale
+						red = green = blue = readSample( row, c, true );
+						if( readSample( row, c, false ) == transparentKey[0] ) a = 0;
+						break;
+					case 2: // RGB
+						red = readSample( row, c * 3, true );
+						green = readSample( row, c * 3 + 1, true );
+						blue = readSample( row, c * 3 + 2, true );
+						if( readSample( row, c * 3, false ) == transparentKey[0] && readSample( row, c * 3 + 1, false ) == transparentKey[1] && readSample( row, c * 3 + 2, false ) == transparentKey[2] ) a = 0;
+						break;
+					case 3: // Palette
+						pDest[c * stepX] = palette[readSample( row, c, false )];
+						continue;
+					case 4: // Greyscale and alpha
+						red = green = blue = readSample( row, c * 2, true );
+						a = readSample( row, c * 2 + 1, true );
+						break;
+					default: // RGB and alpha
+						red = readSample( row, c * 4, true );
+						green = readSample( row, c * 4 + 1, true );
+						blue = readSample( row, c * 4 + 2, true );
+						a = readSample( row, c * 4 + 3, true );
+						break;
+				}
 
-	delete[] m_playBuffer.pPixels;
+				pDest[c * stepX] = ( a << 24 ) | ( red << 16 ) | ( green << 8 ) | blue;
+			}
+		}
+
+		offset += static_cast<size_t>( rowBytes + 1 ) * passHeight;
+	}
+
+	return true;
 }
 
 //********************************************************************************************************************************
-// Instance functions
+// File:		PlayBlitter.cpp
+// Description:	A software pixel renderer for drawing 2D primitives into a PixelData buffer
+// Platform:	Independent
 //********************************************************************************************************************************
 
-PlayGraphics& PlayGraphics::Instance()
+
+PlayBlitter::PlayBlitter( PixelData* pRenderTarget )
 {
-	PLAY_ASSERT_MSG( s_pInstance, "Trying to use PlayGraphics without initialising it!" );
-	return *s_pInstance;
+	m_pRenderTarget = pRenderTarget;
 }
 
-PlayGraphics& PlayGraphics::Instance( int bufferWidth, int bufferHeight, const char* path )
+PlayBlitter::~PlayBlitter()
 {
-	PLAY_ASSERT_MSG( !s_pInstance, "Trying to create multiple instances of singleton class!" );
-	s_pInstance = new PlayGraphics( bufferWidth, bufferHeight, path );
-	return *s_pInstance;
+	EnableCoverage( false );
+	EnableOverdrawCount( false );
 }
 
-void PlayGraphics::Destroy()
+
+void PlayBlitter::DrawPixel( int posX, int posY, Pixel srcPix )
 {
-	PLAY_ASSERT_MSG( s_pInstance, "Trying to use destroy PlayGraphics when it hasn't been instanced!" );
-	delete s_pInstance;
-	s_pInstance = nullptr;
+	if( srcPix.a == 0x00 || posX < 0 || posX >= m_pRenderTarget->width || posY < 0 || posY >= m_pRenderTarget->height )
+		return;
+
+	Pixel* destPix = &m_pRenderTarget->pPixels[( posY * m_pRenderTarget->width ) + posX];
+
+	if( IsCountingOverdraw() )
+	{
+		uint8_t& count = m_pOverdraw[( posY * m_pRenderTarget->width ) + posX];
+		if( count < 0xFF ) count++;
+	}
+
+	if( srcPix.a == 0xFF ) // Completely opaque pixel - no need to blend
+	{
+		*destPix = srcPix.bits;
+	}
+	else
+	{
+		Pixel blendPix = *destPix;
+		float srcAlpha = srcPix.a / 255.0f;
+		float oneMinusSrcAlpha = 1.0f - srcAlpha;
+
+		blendPix.a = 0xFF;
+		blendPix.r = static_cast<uint8_t>( ( srcAlpha * srcPix.r ) + ( oneMinusSrcAlpha * blendPix.r ) );
+		blendPix.g = static_cast<uint8_t>( ( srcAlpha * srcPix.g ) + ( oneMinusSrcAlpha * blendPix.g ) );
+		blendPix.b = static_cast<uint8_t>( ( srcAlpha * srcPix.b ) + ( oneMinusSrcAlpha * blendPix.b ) );
+
+		*destPix = blendPix.bits;
+	}
+
+	return;
+}
+
+void PlayBlitter::DrawLine( int startX, int startY, int endX, int endY, Pixel pix )
+{
+	//Implementation of Bresenham's Line Drawing Algorithm
+	int dx = abs( endX - startX );
+	int sx = 1;
+	if( endX < startX ) { sx = -1; }
+
+	int dy = -abs( endY - startY );
+	int sy = 1;
+	if( endY < startY ) { sy = -1; }
+
+	int err = dx + dy;
+
+	if( err == 0 ) return;
+
+	int null = startX;
+	int y = startY;
+
+	while( true )
+	{
+		DrawPixel( null, y, pix );
+
+		if( null == endX && y == endY )
+			break;
+
+		int e2 = 2 * err;
+		if( e2 >= dy )
+		{
+			err += dy;
+			null += sx;
+		}
+		if( e2 <= dx )
+		{
+			err += dx;
+			y += sy;
+		}
+	}
 }
 
 //********************************************************************************************************************************
-// Loading functions
+// Function:	BlitPixels - draws image data with and without a global alpha multiply
+// Parameters:	spriteId = the id of the sprite to draw
+//				xpos, ypos = the position you want to draw the sprite
+//				frameIndex = which frame of the animation to draw (wrapped)
+// Notes:		Alpha multiply approach is relatively unoptimized
 //********************************************************************************************************************************
-
-int PlayGraphics::LoadSpriteSheet( const std::string& path, const std::string& filename )
+void PlayBlitter::BlitPixels( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, float alphaMultiply ) const
 {
-	PixelData canvasBuffer;
-	std::string spriteName = filename;
-	int hCount = 1;
-	int vCount = 1;
+	PLAY_ASSERT_MSG( m_pRenderTarget, "Render target not set for PlayBlitter" );
 
-	// Switch everything to uppercase to avoid need to check case each time
-	for( char& c : spriteName ) c = static_cast<char>( toupper( c ) );
+	// Nothing within the display buffer to draw
+	if( blitX > m_pRenderTarget->width || blitX + blitWidth < 0 || blitY > m_pRenderTarget->height || blitY + blitHeight < 0 )
+	{
+		PlayProfiler::Count( COUNTER_SPRITES_CULLED );
+		return;
+	}
 
-	// Look for the final number in the filename to pull out the number of frames across the width
-	size_t frameWidthEnd = spriteName.find_last_of( "0123456789" );
-	size_t frameWidthStart = spriteName.find_last_not_of( "0123456789" );
+	PlayProfiler::Count( COUNTER_PLAIN_BLITS );
 
-	if( frameWidthEnd == spriteName.length() - 1 )
-	{
-		// Grab the number of frames
-		std::string widthString = spriteName.substr( frameWidthStart + 1, frameWidthEnd - frameWidthStart );
+	// Work out if we need to clip to the display buffer (and by how much)
+	int xClipStart = -blitX;
+	if( xClipStart < 0 ) { xClipStart = 0; }
 
-		// Make sure the number is valid 
-		size_t num = widthString.find_first_of( "0123456789" );
-		PLAY_ASSERT_MSG( num == 0, std::string( "Incorrectly named sprite: " + filename ).c_str() );
+	int xClipEnd = ( blitX + blitWidth ) - m_pRenderTarget->width;
+	if( xClipEnd < 0 ) { xClipEnd = 0; }
 
-		hCount = stoi( widthString );
+	int yClipStart = -blitY;
+	if( yClipStart < 0 ) { yClipStart = 0; }
 
-		if( spriteName[frameWidthStart] == 'X' )
+	int yClipEnd = ( blitY + blitHeight ) - m_pRenderTarget->height;
+	if( yClipEnd < 0 ) { yClipEnd = 0; }
+
+	// Set up the source and destination pointers based on clipping
+	int destOffset = ( m_pRenderTarget->width * ( blitY + yClipStart ) ) + ( blitX + xClipStart );
+	uint32_t* destPixels = &m_pRenderTarget->pPixels->bits + destOffset;
+
+	int srcClipOffset = ( srcPixelData.width * yClipStart ) + xClipStart;
+	uint32_t* srcPixels = &srcPixelData.pPixels->bits + srcOffset + srcClipOffset;
+
+	// Work out in advance how much we need to add to src and dest to reach the next row 
+	int destInc = m_pRenderTarget->width - blitWidth + xClipEnd + xClipStart;
+	int srcInc = srcPixelData.width - blitWidth + xClipEnd + xClipStart;
+
+	//Work out final pixel in destination.
+	int destColOffset = ( m_pRenderTarget->width * ( blitHeight - yClipEnd - yClipStart - 1 ) ) + ( blitWidth - xClipEnd - xClipStart );
+	uint32_t* destColEnd = destPixels + destColOffset;
+
+	//How many pixels per row in sprite.
+	int endRow = blitWidth - xClipEnd - xClipStart;
+
+	// Pixels which aren't written are counted, as the transparent ones are skipped in runs
+	uint32_t clippedArea = static_cast<uint32_t>( endRow * ( blitHeight - yClipEnd - yClipStart ) );
+	uint32_t skipped = 0;
+
+	if( IsCoverageCulling() )
+	{
+		// *******************************************************************************************************************************************************
+		// A per-pixel approach which tests the coverage mask before each write, so pixels hidden behind opaque pixels on a higher layer are never touched.
+		// Uses the same blending as the two paths below, but doesn't bother with skipping transparent runs as culled draws are usually large and opaque.
+		// *******************************************************************************************************************************************************
+		int rowCount = blitHeight - yClipEnd - yClipStart;
+		int destX = blitX + xClipStart;
+		int destY = blitY + yClipStart;
+		bool countOverdraw = IsCountingOverdraw();
+
+		for( int row = 0; row < rowCount; row++, destPixels += m_pRenderTarget->width, srcPixels += srcPixelData.width )
 		{
-			//Two dimensional sprite sheet so the width was actually the height: copy it over and work out the real width
-			vCount = hCount;
+			int destRowOffset = ( ( destY + row ) * m_pRenderTarget->width ) + destX;
+			const uint8_t* pCover = m_pCoverage + destRowOffset;
+			uint8_t* pCount = countOverdraw ? m_pOverdraw + destRowOffset : nullptr;
 
-			// Cut off the last number we just found plus an "x", then check for another number indicating a frame height (optional)
-			std::string truncated = spriteName.substr( 0, frameWidthStart );
-			frameWidthEnd = truncated.find_last_of( "0123456789" );
-			frameWidthStart = truncated.find_last_not_of( "0123456789" );
+			// Rows with no coverage overlapping the blit don't need to test the mask
+			if( m_pCoverageRowMax[destY + row] < destX || m_pCoverageRowMin[destY + row] >= destX + endRow )
+				pCover = nullptr;
 
-			if( frameWidthEnd == truncated.length() - 1 && frameWidthStart != std::string::npos )
+			for( int i = 0; i < endRow; i++ )
 			{
-				// Grab the number of images in the height
-				widthString = truncated.substr( frameWidthStart + 1, frameWidthEnd - frameWidthStart );
+				uint32_t src = srcPixels[i];
 
-				// Make sure the number is valid
-				num = widthString.find_first_of( "0123456789" );
-				PLAY_ASSERT_MSG( num == 0, std::string( "Incorrectly named sprite: " + filename ).c_str() );
+				if( src >= 0xFF000000 || ( pCover && pCover[i] > m_coverageLayer ) )
+				{
+					skipped++;
+					continue;
+				}
 
-				hCount = stoi( widthString );
-			}
-			else
-			{
-				PLAY_ASSERT_MSG( false, std::string( "Incorrectly named sprite: " + filename ).c_str() );
+				uint32_t dest = destPixels[i];
+
+				if( alphaMultiply < 1.0f )
+				{
+					int srcAlpha = static_cast<int>( ( 0xFF - ( src >> 24 ) ) * alphaMultiply );
+					int constAlpha = static_cast<int>( 255 * alphaMultiply );
+					int invSrcAlpha = 0xFF - srcAlpha;
+
+					int destRed = ( constAlpha * ( ( src >> 16 ) & 0xFF ) + invSrcAlpha * ( ( dest >> 16 ) & 0xFF ) ) >> 8;
+					int destGreen = ( constAlpha * ( ( src >> 8 ) & 0xFF ) + invSrcAlpha * ( ( dest >> 8 ) & 0xFF ) ) >> 8;
+					int destBlue = ( constAlpha * ( src & 0xFF ) + invSrcAlpha * ( dest & 0xFF ) ) >> 8;
+
+					destPixels[i] = 0xFF000000 | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
+				}
+				else
+				{
+					dest = ( ( ( dest >> 4 ) & 0x000F0F0F ) * ( src >> 28 ) );
+					destPixels[i] = ( src + dest ) | 0xFF000000;
+				}
+
+				if( pCount && pCount[i] < 0xFF )
+					pCount[i]++;
 			}
 		}
-		else
-		{
-			vCount = 1;
-		}
+		PlayProfiler::Count( COUNTER_PIXELS_WRITTEN, clippedArea - skipped );
+		PlayProfiler::Count( COUNTER_PIXELS_SKIPPED, skipped );
+		return;
 	}
 
-	std::string fileAndPath( path + spriteName + ".PNG" );
-	PlayWindow::LoadPNGImage( fileAndPath, canvasBuffer ); // Allocates memory as we don't know the size
-	
-	return AddSprite( filename, canvasBuffer, hCount, vCount );
-}
+	if( IsCountingOverdraw() )
+		CountBlitOverdraw( srcPixelData, srcOffset + srcClipOffset, blitX + xClipStart, blitY + yClipStart, endRow, blitHeight - yClipEnd - yClipStart );
 
-int PlayGraphics::AddSprite( const std::string& name, PixelData& pixelData, int hCount, int vCount )
-{
-	// Switch everything to uppercase to avoid need to check case each time
-	std::string spriteName = name;
-	for( char& c : spriteName ) c = static_cast<char>( toupper( c ) );
+	if( alphaMultiply < 1.0f )
+	{
+		// *******************************************************************************************************************************************************
+		// A basic (unoptimized) approach which separates the channels and performs a 'typical' alpha blending operation: (src * srcAlpha)+(dest * (1-srcAlpha))
+		// Has the advantage that a global alpha multiplication can be easily added over the top, so we use this method when a global multiply is required
+		// *******************************************************************************************************************************************************
 
-	Sprite s;
-	s.id = m_nTotalSprites++;
-	s.name = spriteName;
-	s.originX = s.originY = 0;
-	s.hCount = hCount;
-	s.vCount = vCount;
-	s.canvasBuffer = pixelData; // copy including pointer to pixel data
+		// Slightly more optimised iterations without the additions in the loop
+		while( destPixels < destColEnd )
+		{
+			uint32_t* destRowEnd = destPixels + endRow;
 
-	s.totalCount = s.hCount * s.vCount;
-	s.width = s.canvasBuffer.width / s.hCount;
-	s.height = s.canvasBuffer.height / s.vCount;
+			while( destPixels < destRowEnd )
+			{
+				uint32_t src = *srcPixels++;
+				uint32_t dest = *destPixels;
 
-	// Create a separate buffer with the pre-multiplyied alpha
-	s.preMultAlpha.pPixels = new Pixel[static_cast<size_t>( s.canvasBuffer.width ) * s.canvasBuffer.height];
-	s.preMultAlpha.width = s.canvasBuffer.width;
+				// If this isn't a fully transparent pixel 
+				if( src < 0xFF000000 )
+				{
+					int srcAlpha = static_cast<int>( ( 0xFF - ( src >> 24 ) ) * alphaMultiply );
+					int constAlpha = static_cast<int>( 255 * alphaMultiply );
+
+					// Source pixels are already multiplied by srcAlpha so we just apply the constant alpha multiplier
+					int destRed = constAlpha * ( ( src >> 16 ) & 0xFF );
+					int destGreen = constAlpha * ( ( src >> 8 ) & 0xFF );
+					int destBlue = constAlpha * ( src & 0xFF );
+
+					int invSrcAlpha = 0xFF - srcAlpha;
+
+					// Apply a standard Alpha blend [ src*srcAlpha + dest*(1-SrcAlpha) ]
+					destRed += invSrcAlpha * ( ( dest >> 16 ) & 0xFF );
+					destGreen += invSrcAlpha * ( ( dest >> 8 ) & 0xFF );
+					destBlue += invSrcAlpha * ( dest & 0xFF );
+
+					// Bring back to the range 0-255
+					destRed >>= 8;
+					destGreen >>= 8;
+					destBlue >>= 8;
+
+					// Put ARGB components back together again
+					*destPixels++ = 0xFF000000 | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
+				}
+				else
+				{
+					// If this is a fully transparent pixel then the low bits store how many there are in a row
+					// This means we can skip to the next pixel which isn't fully transparent
+					uint32_t skip = static_cast<uint32_t>( destRowEnd - destPixels ) - 1;
+					src = src & 0x00FFFFFF;
+					if( skip > src ) skip = src;
+
+					skipped += skip + 1;
+					srcPixels += skip;
+					++destPixels += skip;
+				}
+			}
+			// Increase buffers by pre-calculated amounts
+			destPixels += destInc;
+			srcPixels += srcInc;
+		}
+
+	}
+	else
+	{
+		// *******************************************************************************************************************************************************
+		// An optimized approach which uses pre-multiplied alpha, parallel channel multiplication and pixel skipping to achieve the same 'typical' alpha 
+		// blending operation (src * srcAlpha)+(dest * (1-srcAlpha)). Not easy to apply a global alpha multiplication over the top, but used everywhere else.
+		// *******************************************************************************************************************************************************
+
+		// Slightly more optimised iterations without the additions in the loop
+		while( destPixels < destColEnd )
+		{
+			uint32_t* destRowEnd = destPixels + endRow;
+
+			while( destPixels < destRowEnd )
+			{
+				uint32_t src = *srcPixels++;
+				uint32_t dest = *destPixels;
+
+				// If this isn't a fully transparent pixel 
+				if( src < 0xFF000000 )
+				{
+					// This performes the dest*(1-srcAlpha) calculation for all channels in parallel with minor accuracy loss in dest colour.
+					// It does this by shifting all the destination channels down by 4 bits in order to "make room" for the later multiplication.
+					// After shifting down, it masks out the bits which have shifted into the adjacent channel data.
+					// This causes the RGB data to be rounded down to their nearest 16 producing a reduction in colour accuracy.
+					// This is then multiplied by the inverse alpha (inversed in PreMultiplyAlpha), also divided by 16 (hence >> 8+8+8+4).
+					// The multiplication brings our RGB values back up to their original bit ranges (albeit rounded to the nearest 16).
+					// As the colour accuracy only affects the destination pixels behind semi-transparent source pixels and so isn't very obvious.
+					dest = ( ( ( dest >> 4 ) & 0x000F0F0F ) * ( src >> 28 ) );
+					// Add the (pre-multiplied Alpha) source to the destination and force alpha to opaque
+					*destPixels++ = ( src + dest ) | 0xFF000000;
+				}
+				else
+				{
+					// If this is a fully transparent pixel then the low bits store how many there are in a row
+					// This means we can skip to the next pixel which isn't fully transparent
+					uint32_t skip = static_cast<uint32_t>( destRowEnd - destPixels ) - 1;
+					src = src & 0x00FFFFFF;
+					if( skip > src ) skip = src;
+
+					skipped += skip + 1;
+					srcPixels += skip;
+					++destPixels += skip;
+				}
+			}
+			// Increase buffers by pre-calculated amounts
+			destPixels += destInc;
+			srcPixels += srcInc;
+		}
+
+	}
+
+	PlayProfiler::Count( COUNTER_PIXELS_WRITTEN, clippedArea - skipped );
+	PlayProfiler::Count( COUNTER_PIXELS_SKIPPED, skipped );
+	return;
+}
+
+//********************************************************************************************************************************
+// Function:	RotateScaleSprite - draws a rotated and scaled sprite with global alpha multiply
+// Parameters:	s = the sprite to draw
+//				xpos, ypos = the position of the center of rotation.
+//				frameIndex = which frame of the animation to draw (wrapped)
+//				angle = rotation angle
+//				scale = parameter to magnify the sprite.
+//				rotOffX, rotOffY = offset of centre of rotation to the top left of the sprite
+//				alpha = the fraction defining the amount of sprite and background that is draw. 255 = all sprite, 0 = all background.
+// Notes:		Pre-calculates roughly where the sprite will be in the display buffer and only processes those pixels. 
+//				Approx 15 times slower than not rotating.
+//********************************************************************************************************************************
+void PlayBlitter::RotateScalePixels( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, int originX, int originY, float angle, float scale, float alphaMultiply ) const
+{
+	PLAY_ASSERT_MSG( m_pRenderTarget, "Render target not set for PlayBlitter" );
+
+	//pointers to start of source and destination buffers
+	uint32_t* pSrcBase = &srcPixelData.pPixels->bits + srcOffset;
+	uint32_t* pDstBase = &m_pRenderTarget->pPixels->bits;
+
+	//the centre of rotation in the sprite frame relative to the top corner
+	float fRotCentreU = static_cast<float>( originX );
+	float fRotCentreV = static_cast<float>( originY );
+
+	//u/v are co-ordinates in the rotated sprite frame. x/y are screen buffer co-ordinates.
+	//change in u/v for a unit change in x/y.
+	float dUdX = static_cast<float>( cos( -angle ) ) * ( 1.0f / scale );
+	float dVdX = static_cast<float>( sin( -angle ) ) * ( 1.0f / scale );
+	float dUdY = -dVdX;
+	float dVdY = dUdX;
+
+	//Position in the sprite rotated frame with origin at the center of rotation of the sprite corners.
+	float leftU = -fRotCentreU * scale;
+	float rightU = ( blitWidth + -fRotCentreU ) * scale;
+	float topV = ( -fRotCentreV ) * scale;
+	float bottomV = ( blitHeight - fRotCentreV ) * scale;
+
+	//Scale added in to cancel out the scale in dUdX.
+	float boundingBoxCorners[4][2]
+	{
+		{ ( dUdX * leftU + dVdX * topV ) * scale,			( dUdY * leftU + dVdY * topV ) * scale		},	// Top left
+		{ ( dUdX * leftU + dVdX * bottomV ) * scale,		( dUdY * leftU + dVdY * bottomV ) * scale		},	// Bottom left
+		{ ( dUdX * rightU + dVdX * bottomV ) * scale,		( dUdY * rightU + dVdY * bottomV ) * scale	},	// Bottom right
+		{ ( dUdX * rightU + dVdX * topV ) * scale,			( dUdY * rightU + dVdY * topV ) * scale,		},	// Top right
+	};
+
+	float minX = std::numeric_limits<float>::infinity();
+	float minY = std::numeric_limits<float>::infinity();
+	float maxX = -std::numeric_limits<float>::infinity();
+	float maxY = -std::numeric_limits<float>::infinity();
+
+	//calculate the extremes of the rotated corners.
+	for( int i = 0; i < 4; i++ )
+	{
+		minX = std::min( minX, boundingBoxCorners[i][0] );
+		maxX = std::max( maxX, boundingBoxCorners[i][0] );
+		minY = std::min( minY, boundingBoxCorners[i][1] );
+		maxY = std::max( maxY, boundingBoxCorners[i][1] );
+	}
+
+	//clip the starting and finishing positions.
+	int startY = blitY + static_cast<int>( minY );
+	if( startY < 0 ) { startY = 0; minY = static_cast<float>( -blitY ); }
+
+	int endY = blitY + static_cast<int>( maxY );
+	if( endY > m_pRenderTarget->height ) { endY = m_pRenderTarget->height; }
+
+	int startX = blitX + static_cast<int>( minX );
+	if( startX < 0 ) { startX = 0; minX = static_cast<float>( -blitX ); }
+
+	int endX = blitX + static_cast<int>( maxX );
+	if( endX > m_pRenderTarget->width ) { endX = m_pRenderTarget->width; }
+
+	if( startX >= endX || startY >= endY )
+	{
+		PlayProfiler::Count( COUNTER_SPRITES_CULLED );
+		return;
+	}
+
+	PlayProfiler::Count( COUNTER_ROTATED_BLITS );
+
+	//rotate the basis so we get the edge of the bounding box in the sprite frame.
+	float startingU = dUdX * minX + dUdY * minY + fRotCentreU;
+	float startingV = dVdY * minY + dVdX * minX + fRotCentreV;
+
+	float rowU = startingU;
+	float rowV = startingV;
+
+	uint32_t* destPixels = pDstBase + ( static_cast<size_t>( m_pRenderTarget->width ) * startY ) + startX;
+	int nextRow = m_pRenderTarget->width - ( endX - startX );
+
+	uint32_t* srcPixels = pSrcBase;
+
+	uint8_t* pCount = IsCountingOverdraw() ? m_pOverdraw + ( static_cast<size_t>( m_pRenderTarget->width ) * startY ) + startX : nullptr;
+	uint32_t written = 0;
+
+	//Start of double for loop. 
+	for( int y = startY; y < endY; y++ )
+	{
+		float u = rowU;
+		float v = rowV;
+
+		for( int null = startX; null < endX; null++ )
+		{
+			//Check to see if u and v correspond to a valid pixel in sprite.
+			if( u > 0 && v > 0 && u < blitWidth && v < blitHeight )
+			{
+				srcPixels = pSrcBase + static_cast<size_t>( u ) + ( static_cast<size_t>( v ) * srcPixelData.width );
+				uint32_t src = *srcPixels;
+
+				if( src < 0xFF000000 )
+				{
+					int srcAlpha = static_cast<int>( ( 0xFF - ( src >> 24 ) ) * alphaMultiply );
+					int constAlpha = static_cast<int>( 255 * alphaMultiply );
+
+					// Source pixels are already multiplied by srcAlpha so we just apply the constant alpha multiplier
+					int destRed = constAlpha * ( ( src >> 16 ) & 0xFF );
+					int destGreen = constAlpha * ( ( src >> 8 ) & 0xFF );
+					int destBlue = constAlpha * ( src & 0xFF );
+
+					uint32_t dest = *destPixels;
+					int invSrcAlpha = 0xFF - srcAlpha;
+
+					// Apply a standard Alpha blend [ src*srcAlpha + dest*(1-SrcAlpha) ]
+					destRed += invSrcAlpha * ( ( dest >> 16 ) & 0xFF );
+					destGreen += invSrcAlpha * ( ( dest >> 8 ) & 0xFF );
+					destBlue += invSrcAlpha * ( dest & 0xFF );
+
+					// Bring back to the range 0-255
+					destRed >>= 8;
+					destGreen >>= 8;
+					destBlue >>= 8;
+
+					// Put ARGB components back together again
+					*destPixels = 0xFF000000 | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
+					written++;
+
+					if( pCount && *pCount < 0xFF )
+						( *pCount )++;
+				}
+			}
+
+			destPixels++;
+			if( pCount ) pCount++;
+
+			// Change the position in the sprite frame for changing X in the display
+			u += dUdX;
+			v += dVdX;
+		}
+
+		// Work out the change in the sprite frame for changing Y in the display
+		rowU += dUdY;
+		rowV += dVdY;
+		// Next row
+		destPixels += nextRow;
+		if( pCount ) pCount += nextRow;
+	}
+
+	// Everything in the clipped bounding box which wasn't written was either outside the sprite or transparent
+	PlayProfiler::Count( COUNTER_PIXELS_WRITTEN, written );
+	PlayProfiler::Count( COUNTER_PIXELS_SKIPPED, static_cast<uint32_t>( ( endX - startX ) * ( endY - startY ) ) - written );
+}
+
+//********************************************************************************************************************************
+// Function:	ScalePixels - draws scaled pixel data with and without a global alpha multiply
+// Parameters:	blitX, blitY = where the origin of the pixel data is drawn (the centre of the scaling)
+//				originX, originY = offset of the centre of scaling from the top left of the pixel data
+//				scale = how much bigger (or smaller) to draw the pixel data
+// Notes:		Each destination pixel takes the source pixel under its centre. The source column for each destination column is
+//				the same for every row, so it's worked out once in advance and the inner loop is just a table lookup and a blend.
+//********************************************************************************************************************************
+void PlayBlitter::ScalePixels( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, int originX, int originY, float scale, float alphaMultiply ) const
+{
+	PLAY_ASSERT_MSG( m_pRenderTarget, "Render target not set for PlayBlitter" );
+
+	int destWidth = static_cast<int>( blitWidth * scale + 0.5f );
+	int destHeight = static_cast<int>( blitHeight * scale + 0.5f );
+	int destLeft = blitX - static_cast<int>( originX * scale + 0.5f );
+	int destTop = blitY - static_cast<int>( originY * scale + 0.5f );
+
+	// Clip the whole span to the render target before doing anything per pixel
+	int startX = std::max( destLeft, 0 );
+	int startY = std::max( destTop, 0 );
+	int endX = std::min( destLeft + destWidth, m_pRenderTarget->width );
+	int endY = std::min( destTop + destHeight, m_pRenderTarget->height );
+
+	if( destWidth <= 0 || destHeight <= 0 || startX >= endX || startY >= endY )
+	{
+		PlayProfiler::Count( COUNTER_SPRITES_CULLED );
+		return;
+	}
+
+	PlayProfiler::Count( COUNTER_SCALED_BLITS );
+
+	m_scaleColumns.resize( static_cast<size_t>( endX - startX ) );
+	for( int col = startX; col < endX; col++ )
+		m_scaleColumns[col - startX] = static_cast<int>( ( ( 2ll * ( col - destLeft ) + 1 ) * blitWidth ) / ( 2ll * destWidth ) );
+
+	const int* pColumns = m_scaleColumns.data() - startX;
+	bool coverageCulling = IsCoverageCulling();
+	bool countOverdraw = IsCountingOverdraw();
+	int constAlpha = static_cast<int>( 255 * alphaMultiply );
+	uint32_t written = 0;
+
+	for( int row = startY; row < endY; row++ )
+	{
+		int srcRow = static_cast<int>( ( ( 2ll * ( row - destTop ) + 1 ) * blitHeight ) / ( 2ll * destHeight ) );
+		const uint32_t* srcPixels = &srcPixelData.pPixels->bits + srcOffset + ( static_cast<size_t>( srcPixelData.width ) * srcRow );
+
+		size_t rowOffset = static_cast<size_t>( m_pRenderTarget->width ) * row;
+		uint32_t* destPixels = &m_pRenderTarget->pPixels->bits + rowOffset;
+		uint8_t* pCount = countOverdraw ? m_pOverdraw + rowOffset : nullptr;
+
+		// Rows with no coverage overlapping the span don't need to test the mask
+		const uint8_t* pCover = nullptr;
+		if( coverageCulling && m_pCoverageRowMax[row] >= startX && m_pCoverageRowMin[row] < endX )
+			pCover = m_pCoverage + rowOffset;
+
+		if( alphaMultiply < 1.0f )
+		{
+			for( int col = startX; col < endX; col++ )
+			{
+				uint32_t src = srcPixels[pColumns[col]];
+
+				if( src >= 0xFF000000 || ( pCover && pCover[col] > m_coverageLayer ) )
+					continue;
+
+				// The same blend as BlitPixels with a global alpha multiply
+				uint32_t dest = destPixels[col];
+				int srcAlpha = static_cast<int>( ( 0xFF - ( src >> 24 ) ) * alphaMultiply );
+				int invSrcAlpha = 0xFF - srcAlpha;
+
+				int destRed = ( constAlpha * ( ( src >> 16 ) & 0xFF ) + invSrcAlpha * ( ( dest >> 16 ) & 0xFF ) ) >> 8;
+				int destGreen = ( constAlpha * ( ( src >> 8 ) & 0xFF ) + invSrcAlpha * ( ( dest >> 8 ) & 0xFF ) ) >> 8;
+				int destBlue = ( constAlpha * ( src & 0xFF ) + invSrcAlpha * ( dest & 0xFF ) ) >> 8;
+
+				destPixels[col] = 0xFF000000 | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
+				written++;
+
+				if( pCount && pCount[col] < 0xFF )
+					pCount[col]++;
+			}
+		}
+		else
+		{
+			for( int col = startX; col < endX; col++ )
+			{
+				uint32_t src = srcPixels[pColumns[col]];
+
+				if( src >= 0xFF000000 || ( pCover && pCover[col] > m_coverageLayer ) )
+					continue;
+
+				// The same pre-multiplied blend as BlitPixels: dest * ( 1 - srcAlpha ) for all channels in parallel, plus src
+				uint32_t dest = ( ( ( destPixels[col] >> 4 ) & 0x000F0F0F ) * ( src >> 28 ) );
+				destPixels[col] = ( src + dest ) | 0xFF000000;
+				written++;
+
+				if( pCount && pCount[col] < 0xFF )
+					pCount[col]++;
+			}
+		}
+	}
+
+	PlayProfiler::Count( COUNTER_PIXELS_WRITTEN, written );
+	PlayProfiler::Count( COUNTER_PIXELS_SKIPPED, static_cast<uint32_t>( ( endX - startX ) * ( endY - startY ) ) - written );
+}
+
+//********************************************************************************************************************************
+// Function:	ComposePixels - draws pre-multiplied pixel data into a composite without losing its transparency
+// Parameters:	srcPixelData = the pre-multiplied pixel data (e.g. a sprite's preMultAlpha)
+//				blitX, blitY = the top left of the pixels in the render target
+//				clipLeft, clipTop, clipRight, clipBottom = the only area of the render target which can change
+// Notes:		The composite uses the same format as pre-multiplied sprite data (inverted alpha and transparent runs) so it can
+//				be drawn with BlitPixels. Only used when a composite changes, so it sticks to the straightforward calculation.
+//********************************************************************************************************************************
+void PlayBlitter::ComposePixels( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, int clipLeft, int clipTop, int clipRight, int clipBottom ) const
+{
+	PLAY_ASSERT_MSG( m_pRenderTarget, "Render target not set for PlayBlitter" );
+
+	int startX = std::max( { blitX, clipLeft, 0 } );
+	int startY = std::max( { blitY, clipTop, 0 } );
+	int endX = std::min( { blitX + blitWidth, clipRight, m_pRenderTarget->width } );
+	int endY = std::min( { blitY + blitHeight, clipBottom, m_pRenderTarget->height } );
+
+	if( startX >= endX || startY >= endY )
+		return;
+
+	for( int row = startY; row < endY; row++ )
+	{
+		const uint32_t* srcPixels = &srcPixelData.pPixels->bits + srcOffset + ( srcPixelData.width * ( row - blitY ) ) - blitX;
+		uint32_t* destPixels = &m_pRenderTarget->pPixels[row * m_pRenderTarget->width].bits;
+
+		for( int col = startX; col < endX; col++ )
+		{
+			uint32_t src = srcPixels[col];
+			uint32_t dest = destPixels[col];
+
+			// Fully transparent source pixels leave the composite as it is
+			if( src >= 0xFF000000 )
+				continue;
+
+			// Fully transparent composite pixels only hold a run length, so the source pixel replaces them
+			if( dest >= 0xFF000000 )
+			{
+				destPixels[col] = src;
+				continue;
+			}
+
+			// Both alphas are inverted, so multiplying them gives the inverted alpha of the combination
+			uint32_t invSrcAlpha = src >> 24;
+			uint32_t invAlpha = ( ( dest >> 24 ) * invSrcAlpha ) / 0xFF;
+			uint32_t red = std::min( ( ( src >> 16 ) & 0xFF ) + ( ( ( dest >> 16 ) & 0xFF ) * invSrcAlpha ) / 0xFF, 0xFFu );
+			uint32_t green = std::min( ( ( src >> 8 ) & 0xFF ) + ( ( ( dest >> 8 ) & 0xFF ) * invSrcAlpha ) / 0xFF, 0xFFu );
+			uint32_t blue = std::min( ( src & 0xFF ) + ( ( dest & 0xFF ) * invSrcAlpha ) / 0xFF, 0xFFu );
+
+			destPixels[col] = ( invAlpha << 24 ) | ( red << 16 ) | ( green << 8 ) | blue;
+		}
+
+		EncodeCompositeRow( row, startX, endX );
+	}
+}
+
+void PlayBlitter::ClearComposite( int left, int top, int right, int bottom )
+{
+	PLAY_ASSERT_MSG( m_pRenderTarget, "Render target not set for PlayBlitter" );
+
+	left = std::max( left, 0 );
+	top = std::max( top, 0 );
+	right = std::min( right, m_pRenderTarget->width );
+	bottom = std::min( bottom, m_pRenderTarget->height );
+
+	if( left >= right || top >= bottom )
+		return;
+
+	for( int row = top; row < bottom; row++ )
+	{
+		uint32_t* destPixels = &m_pRenderTarget->pPixels[row * m_pRenderTarget->width].bits;
+		std::fill( destPixels + left, destPixels + right, 0xFF000000 );
+		EncodeCompositeRow( row, left, right );
+	}
+}
+
+void PlayBlitter::EncodeCompositeRow( int row, int startX, int endX ) const
+{
+	uint32_t* pixels = &m_pRenderTarget->pPixels[row * m_pRenderTarget->width].bits;
+
+	// Like PreMultiplyAlpha, each fully transparent pixel stores how many more follow it so BlitPixels can skip them
+	uint32_t following = 0;
+	if( endX < m_pRenderTarget->width && pixels[endX] >= 0xFF000000 )
+		following = ( pixels[endX] & 0x00FFFFFF ) + 1;
+
+	// Runs which reach into the changed pixels from the left need their lengths updating too
+	for( int col = endX - 1; col >= 0; col-- )
+	{
+		if( pixels[col] >= 0xFF000000 )
+		{
+			pixels[col] = 0xFF000000 | following++;
+		}
+		else
+		{
+			if( col < startX )
+				break;
+			following = 0;
+		}
+	}
+}
+
+
+void PlayBlitter::ClearRenderTarget( Pixel colour )
+{
+	if( IsCoverageCulling() || IsCountingOverdraw() )
+	{
+		for( int row = 0; row < m_pRenderTarget->height; row++ )
+			CopyUncoveredRow( &m_pRenderTarget->pPixels[row * m_pRenderTarget->width].bits, nullptr, colour.bits, row );
+	}
+	else
+	{
+		Pixel* pBuffEnd = m_pRenderTarget->pPixels + ( m_pRenderTarget->width * m_pRenderTarget->height );
+		for( Pixel* pBuff = m_pRenderTarget->pPixels; pBuff < pBuffEnd; *pBuff++ = colour.bits );
+	}
+	m_pRenderTarget->preMultiplied = false;
+}
+
+void PlayBlitter::BlitBackground( PixelData& backgroundImage )
+{
+	PLAY_ASSERT_MSG( backgroundImage.height == m_pRenderTarget->height && backgroundImage.width == m_pRenderTarget->width, "Background size doesn't match render target!" );
+
+	if( IsCoverageCulling() || IsCountingOverdraw() )
+	{
+		// Only copy the parts of each row which won't be hidden by opaque pixels drawn later on
+		for( int row = 0; row < m_pRenderTarget->height; row++ )
+		{
+			int rowOffset = row * m_pRenderTarget->width;
+			CopyUncoveredRow( &m_pRenderTarget->pPixels[rowOffset].bits, &backgroundImage.pPixels[rowOffset].bits, 0, row );
+		}
+		return;
+	}
+
+	// Takes about 1ms for 720p screen on i7-8550U
+	memcpy( m_pRenderTarget->pPixels, backgroundImage.pPixels, sizeof( Pixel ) * m_pRenderTarget->width * m_pRenderTarget->height );
+}
+
+void PlayBlitter::CopyUncoveredRow( uint32_t* pDest, const uint32_t* pSrc, uint32_t fill, int row ) const
+{
+	int width = m_pRenderTarget->width;
+	uint8_t* pCount = IsCountingOverdraw() ? m_pOverdraw + ( row * width ) : nullptr;
+
+	// Writes a run of uncovered pixels from the source (or the fill colour if there's no source)
+	auto writeRun = [&]( int start, int end )
+	{
+		if( end <= start )
+			return;
+
+		if( pSrc )
+			memcpy( pDest + start, pSrc + start, sizeof( uint32_t ) * ( end - start ) );
+		else
+			std::fill( pDest + start, pDest + end, fill );
+
+		if( pCount )
+		{
+			for( int i = start; i < end; i++ )
+				if( pCount[i] < 0xFF ) pCount[i]++;
+		}
+	};
+
+	if( !IsCoverageCulling() || m_pCoverageRowMin[row] > m_pCoverageRowMax[row] )
+	{
+		writeRun( 0, width );
+		return;
+	}
+
+	// Everything outside the covered extent of the row can be written in one go
+	const uint8_t* pCover = m_pCoverage + ( row * width );
+	int runStart = 0;
+	int pos = m_pCoverageRowMin[row];
+	int end = m_pCoverageRowMax[row];
+
+	while( pos <= end )
+	{
+		if( pCover[pos] > m_coverageLayer )
+		{
+			writeRun( runStart, pos );
+			while( pos <= end && pCover[pos] > m_coverageLayer ) pos++;
+			runStart = pos;
+		}
+		else
+		{
+			pos++;
+		}
+	}
+
+	writeRun( runStart, width );
+}
+
+void PlayBlitter::CountBlitOverdraw( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight ) const
+{
+	for( int row = 0; row < blitHeight; row++ )
+	{
+		const uint32_t* pSrc = &srcPixelData.pPixels->bits + srcOffset + ( row * srcPixelData.width );
+		uint8_t* pCount = m_pOverdraw + ( ( blitY + row ) * m_pRenderTarget->width ) + blitX;
+
+		for( int i = 0; i < blitWidth; i++ )
+		{
+			if( pSrc[i] < 0xFF000000 && pCount[i] < 0xFF )
+				pCount[i]++;
+		}
+	}
+}
+
+//********************************************************************************************************************************
+// Coverage culling functions
+//********************************************************************************************************************************
+
+void PlayBlitter::EnableCoverage( bool enable )
+{
+	delete[] m_pCoverage;
+	delete[] m_pCoverageRowMin;
+	delete[] m_pCoverageRowMax;
+	m_pCoverage = nullptr;
+	m_pCoverageRowMin = m_pCoverageRowMax = nullptr;
+	m_pCoverageTarget = nullptr;
+	m_coverageMaxLayer = 0;
+
+	if( !enable )
+		return;
+
+	PLAY_ASSERT_MSG( m_pRenderTarget, "Render target not set for PlayBlitter" );
+	m_pCoverageTarget = m_pRenderTarget;
+
+	m_pCoverage = new uint8_t[static_cast<size_t>( m_pRenderTarget->width ) * m_pRenderTarget->height];
+	memset( m_pCoverage, 0, static_cast<size_t>( m_pRenderTarget->width ) * m_pRenderTarget->height );
+
+	m_pCoverageRowMin = new int[m_pRenderTarget->height];
+	m_pCoverageRowMax = new int[m_pRenderTarget->height];
+	std::fill( m_pCoverageRowMin, m_pCoverageRowMin + m_pRenderTarget->height, m_pRenderTarget->width );
+	std::fill( m_pCoverageRowMax, m_pCoverageRowMax + m_pRenderTarget->height, -1 );
+}
+
+void PlayBlitter::ClearCoverage()
+{
+	if( !m_pCoverage )
+		return;
+
+	int width = m_pCoverageTarget->width;
+
+	for( int row = 0; row < m_pCoverageTarget->height; row++ )
+	{
+		if( m_pCoverageRowMin[row] <= m_pCoverageRowMax[row] )
+			memset( m_pCoverage + ( row * width ) + m_pCoverageRowMin[row], 0, m_pCoverageRowMax[row] - m_pCoverageRowMin[row] + 1 );
+
+		m_pCoverageRowMin[row] = width;
+		m_pCoverageRowMax[row] = -1;
+	}
+
+	m_coverageMaxLayer = 0;
+}
+
+void PlayBlitter::AddCoverageSpan( int posX, int posY, int length, uint8_t layer )
+{
+	if( !m_pCoverage || layer == 0 || posY < 0 || posY >= m_pCoverageTarget->height )
+		return;
+
+	int start = std::max( posX, 0 );
+	int end = std::min( posX + length, m_pCoverageTarget->width );
+
+	if( start >= end )
+		return;
+
+	uint8_t* pCover = m_pCoverage + ( posY * m_pCoverageTarget->width );
+
+	for( int i = start; i < end; i++ )
+		if( pCover[i] < layer ) pCover[i] = layer;
+
+	m_pCoverageRowMin[posY] = std::min( m_pCoverageRowMin[posY], start );
+	m_pCoverageRowMax[posY] = std::max( m_pCoverageRowMax[posY], end - 1 );
+	m_coverageMaxLayer = std::max( m_coverageMaxLayer, layer );
+}
+
+//********************************************************************************************************************************
+// Overdraw functions
+//********************************************************************************************************************************
+
+void PlayBlitter::EnableOverdrawCount( bool enable )
+{
+	delete[] m_pOverdraw;
+	m_pOverdraw = nullptr;
+	m_pOverdrawTarget = nullptr;
+
+	if( !enable )
+		return;
+
+	PLAY_ASSERT_MSG( m_pRenderTarget, "Render target not set for PlayBlitter" );
+	m_pOverdrawTarget = m_pRenderTarget;
+
+	m_pOverdraw = new uint8_t[static_cast<size_t>( m_pRenderTarget->width ) * m_pRenderTarget->height];
+	memset( m_pOverdraw, 0, static_cast<size_t>( m_pRenderTarget->width ) * m_pRenderTarget->height );
+}
+
+void PlayBlitter::DrawOverdrawHeatmap()
+{
+	if( !IsCountingOverdraw() )
+		return;
+
+	// Black = never written, then blue, green, yellow, orange and red for five or more writes
+	static const uint32_t heatColours[6] = { 0xFF000000, 0xFF0000A0, 0xFF00C000, 0xFFFFFF00, 0xFFFF8000, 0xFFFF0000 };
+
+	size_t total = static_cast<size_t>( m_pRenderTarget->width ) * m_pRenderTarget->height;
+	uint32_t* pDest = &m_pRenderTarget->pPixels->bits;
+
+	for( size_t i = 0; i < total; i++ )
+		pDest[i] = heatColours[std::min<int>( m_pOverdraw[i], 5 )];
+}
+
+void PlayBlitter::ResetOverdrawCount()
+{
+	if( m_pOverdraw )
+		memset( m_pOverdraw, 0, static_cast<size_t>( m_pOverdrawTarget->width ) * m_pOverdrawTarget->height );
+}
+
+
+//********************************************************************************************************************************
+// File:		PlayGraphics.cpp
+// Description:	Manages 2D graphics operations on a PixelData buffer 
+// Platform:	Independent
+// Notes:		Uses PNG format. The end of the filename indicates the number of frames e.g. "bat_4.png" or "tiles_10x10.png"
+//********************************************************************************************************************************
+
+
+PlayGraphics* PlayGraphics::s_pInstance = nullptr;
+
+// The cooked sprite cache lives alongside the PNGs it was created from
+constexpr const char* SPRITE_CACHE_FILENAME = "sprites.cooked";
+constexpr uint32_t SPRITE_CACHE_VERSION = 1;
+
+// Works out the number of frames across and down a sprite sheet from the end of its name e.g. "bat_4" or "tiles_10x10"
+static void ReadSpriteFrameCounts( const std::string& filename, int& hCount, int& vCount )
+{
+	std::string spriteName = filename;
+	hCount = 1;
+	vCount = 1;
+
+	// Switch everything to uppercase to avoid need to check case each time
+	for( char& c : spriteName ) c = static_cast<char>( toupper( c ) );
+
+	// Look for the final number in the filename to pull out the number of frames across the width
+	size_t frameWidthEnd = spriteName.find_last_of( "0123456789" );
+	size_t frameWidthStart = spriteName.find_last_not_of( "0123456789" );
+
+	if( frameWidthEnd == spriteName.length() - 1 )
+	{
+		// Grab the number of frames
+		std::string widthString = spriteName.substr( frameWidthStart + 1, frameWidthEnd - frameWidthStart );
+
+		// Make sure the number is valid 
+		size_t num = widthString.find_first_of( "0123456789" );
+		PLAY_ASSERT_MSG( num == 0, std::string( "Incorrectly named sprite: " + filename ).c_str() );
+
+		hCount = stoi( widthString );
+
+		if( spriteName[frameWidthStart] == 'X' )
+		{
+			//Two dimensional sprite sheet so the width was actually the height: copy it over and work out the real width
+			vCount = hCount;
+
+			// Cut off the last number we just found plus an "x", then check for another number indicating a frame height (optional)
+			std::string truncated = spriteName.substr( 0, frameWidthStart );
+			frameWidthEnd = truncated.find_last_of( "0123456789" );
+			frameWidthStart = truncated.find_last_not_of( "0123456789" );
+
+			if( frameWidthEnd == truncated.length() - 1 && frameWidthStart != std::string::npos )
+			{
+				// Grab the number of images in the height
+				widthString = truncated.substr( frameWidthStart + 1, frameWidthEnd - frameWidthStart );
+
+				// Make sure the number is valid
+				num = widthString.find_first_of( "0123456789" );
+				PLAY_ASSERT_MSG( num == 0, std::string( "Incorrectly named sprite: " + filename ).c_str() );
+
+				hCount = stoi( widthString );
+			}
+			else
+			{
+				PLAY_ASSERT_MSG( false, std::string( "Incorrectly named sprite: " + filename ).c_str() );
+			}
+		}
+		else
+		{
+			vCount = 1;
+		}
+	}
+}
+
+// Checks whether an upper-case sprite name is in a category: the letters at the start of the name e.g. "FONT" or "SPR"
+static bool IsSpriteInCategory( const std::string& spriteName, const std::string& category )
+{
+	size_t letters = 0;
+	while( letters < spriteName.length() && isalpha( static_cast<unsigned char>( spriteName[letters] ) ) )
+		letters++;
+
+	return letters == category.length() && spriteName.compare( 0, letters, category ) == 0;
+}
+
+// Reads the origin from a sprite's .inf file (if it has one)
+static void ReadSpriteInfo( const std::string& infoFile, int& originX, int& originY )
+{
+	if( !std::filesystem::exists( infoFile ) )
+		return;
+
+	std::ifstream info_infile;
+	info_infile.open( infoFile, std::ios::in );
+
+	PLAY_ASSERT_MSG( info_infile.is_open(), std::string( "Unable to load existing .inf file: " + infoFile ).c_str() );
+	if( info_infile.is_open() )
+	{
+		std::string type;
+		info_infile >> type;
+		info_infile >> originX;
+		info_infile >> originY;
+	}
+
+	info_infile.close();
+}
+
+// Gets the last write time of a file (or zero if it doesn't exist)
+static int64_t FileWriteTime( const std::string& fileAndPath )
+{
+	std::error_code error;
+	std::filesystem::file_time_type time = std::filesystem::last_write_time( fileAndPath, error );
+	return error ? 0 : static_cast<int64_t>( time.time_since_epoch().count() );
+}
+
+// Calculates a 32-bit FNV-1a hash of a file's contents
+static uint32_t HashFile( const std::string& fileAndPath )
+{
+	uint32_t hash = 2166136261u;
+	std::ifstream file( fileAndPath, std::ios::binary );
+	char buffer[4096];
+
+	while( file )
+	{
+		file.read( buffer, sizeof( buffer ) );
+		for( std::streamsize i = 0; i < file.gcount(); i++ )
+			hash = ( hash ^ static_cast<uint8_t>( buffer[i] ) ) * 16777619u;
+	}
+
+	return hash;
+}
+
+//********************************************************************************************************************************
+// Worker thread functions
+//********************************************************************************************************************************
+
+template< typename Function >
+void PlayGraphics::ParallelFor( int count, Function function ) const
+{
+	ParallelJob job;
+	job.count = count;
+	job.pFunction = &function;
+	job.pInvoke = []( void* pFunction, int index ) { ( *static_cast<Function*>( pFunction ) )( index ); };
+
+	if( count > 1 && !m_vWorkers.empty() )
+	{
+		std::lock_guard<std::mutex> lock( m_jobMutex );
+		m_vJobs.push_back( &job );
+		m_jobAdded.notify_all();
+	}
+
+	RunParallelJob( job ); // The calling thread does its share too
+
+	// Once every index has been handed out the job is withdrawn, and it only goes out of scope when the workers have finished with it
+	std::unique_lock<std::mutex> lock( m_jobMutex );
+	m_vJobs.erase( std::remove( m_vJobs.begin(), m_vJobs.end(), &job ), m_vJobs.end() );
+	m_jobFinished.wait( lock, [&job]() { return job.workers == 0; } );
+}
+
+void PlayGraphics::RunParallelJob( ParallelJob& job )
+{
+	for( int i = job.next++; i < job.count; i = job.next++ )
+		job.pInvoke( job.pFunction, i );
+}
+
+void PlayGraphics::WorkerThread() const
+{
+	std::unique_lock<std::mutex> lock( m_jobMutex );
+
+	for( ;; )
+	{
+		m_jobAdded.wait( lock, [this]() { return m_bStopWorkers || !m_vJobs.empty(); } );
+		if( m_bStopWorkers )
+			return;
+
+		ParallelJob& job = *m_vJobs.front();
+		job.workers++;
+
+		lock.unlock();
+		RunParallelJob( job );
+		lock.lock();
+
+		// Every index has been handed out, so no other worker needs to pick the job up
+		m_vJobs.erase( std::remove( m_vJobs.begin(), m_vJobs.end(), &job ), m_vJobs.end() );
+		if( --job.workers == 0 )
+			m_jobFinished.notify_all();
+	}
+}
+
+//********************************************************************************************************************************
+// Constructor / Destructor (Private)
+//********************************************************************************************************************************
+
+PlayGraphics::PlayGraphics( int bufferWidth, int bufferHeight, const char* path )
+{
+	PLAY_ALLOCATION_TAG( "Sprites" );
+
+	// The calling thread always helps with its own ParallelFor() calls, so it's one fewer than the hardware threads
+	int nWorkers = static_cast<int>( std::thread::hardware_concurrency() ) - 1;
+	m_vJobs.reserve( 4 );
+	for( int t = 0; t < nWorkers; t++ )
+		m_vWorkers.emplace_back( &PlayGraphics::WorkerThread, this );
+
+	// A working buffer for our display. Each pixel is stored as an unsigned 32-bit integer: alpha<<24 | red<<16 | green<<8 | blue
+	m_playBuffer.width = bufferWidth;
+	m_playBuffer.height = bufferHeight;
+	m_playBuffer.pPixels = new Pixel[static_cast<size_t>( bufferWidth ) * bufferHeight];
+	m_playBuffer.preMultiplied = false;
+	PLAY_ASSERT( m_playBuffer.pPixels );
+
+	memset( m_playBuffer.pPixels, 0, sizeof( uint32_t ) * bufferWidth * bufferHeight );
+
+	// Make the display buffer the render target for the blitter
+	m_blitter.SetRenderTarget( &m_playBuffer );
+
+	// Iterate through the directory
+	std::string spritePath = PlayWindow::GetPlatformPath( path );
+	PLAY_ASSERT_MSG( std::filesystem::exists( spritePath ), "PlayBuffer: Drectory provided does not exist." );
+
+	// Sprites which haven't changed since they were last cooked are mapped straight from the sprite cache
+	std::string cacheFile = spritePath + SPRITE_CACHE_FILENAME;
+	OpenSpriteCache( cacheFile );
+
+	// The sprites are sorted by filename so they always get the same ids, however the directory happens to be ordered
+	struct SpriteJob
+	{
+		std::string pngFile, infoFile, spriteName, sortName;
+		Sprite sprite;
+	};
+
+	std::vector<SpriteJob> vJobs;
+
+	for( const auto& p : std::filesystem::directory_iterator( spritePath ) )
+	{
+		// Switch everything to uppercase to avoid need to check case each time
+		std::string filename = p.path().string();
+		for( char& c : filename ) c = static_cast<char>( toupper( c ) );
+
+		// Only attempt to load PNG files
+		if( filename.find( ".PNG" ) != std::string::npos )
+		{
+			// The files themselves are opened by their real names, as not every platform ignores case
+			SpriteJob job;
+			job.pngFile = p.path().string();
+			job.infoFile = std::filesystem::path( p.path() ).replace_extension( ".INF" ).string();
+			job.sortName = filename;
+			job.spriteName = p.path().stem().string();
+			for( char& c : job.spriteName ) c = static_cast<char>( toupper( c ) );
+			vJobs.push_back( std::move( job ) );
+		}
+	}
+
+	std::sort( vJobs.begin(), vJobs.end(), []( const SpriteJob& a, const SpriteJob& b ) { return a.sortName < b.sortName; } );
+
+	// The sprites are added in filename order
+	for( SpriteJob& job : vJobs )
+	{
+		// Anything which isn't in the cache only has its size read here, and is left evicted until it's first used
+		if( !ReadCachedSprite( job.pngFile, job.spriteName, job.infoFile, job.sprite ) )
+		{
+			bool readSize = ReadUncachedSprite( job.pngFile, job.spriteName, job.infoFile, job.sprite );
+			PLAY_ASSERT_MSG( readSize, std::string( "Unable to read sprite: " + job.pngFile ).c_str() );
+			if( !readSize )
+				continue;
+
+			m_bSpriteCacheStale = true;
+		}
+
+		InsertSprite( job.sprite );
+	}
+
+	// Re-cook the cache if any of the PNGs have been added, changed or removed since last time
+	if( m_bSpriteCacheStale || m_nCachedSpritesUsed != static_cast<int>( m_spriteCacheEntries.size() ) )
+		WriteSpriteCache( cacheFile );
+}
+
+PlayGraphics::~PlayGraphics()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_jobMutex );
+		m_bStopWorkers = true;
+		m_jobAdded.notify_all();
+	}
+
+	for( std::thread& worker : m_vWorkers )
+		worker.join();
+
+	for( Sprite& s : vSpriteData )
+	{
+		// Mapped sprites point into the sprite cache which is unmapped below
+		if( s.mapped )
+			continue;
+
+		if( s.canvasBuffer.pPixels )
+			delete[] s.canvasBuffer.pPixels;
+
+		if( s.preMultAlpha.pPixels )
+			delete[] s.preMultAlpha.pPixels;
+	}
+
+	PlayWindow::UnmapFile( m_pSpriteCache, m_hSpriteCacheMapping );
+
+	for( PixelData& pBgBuffer : vBackgroundData )
+		delete[] pBgBuffer.pPixels;
+
+	if( m_pDebugFontBuffer )
+		delete[] m_pDebugFontBuffer;
+
+	delete[] m_playBuffer.pPixels;
+}
+
+//********************************************************************************************************************************
+// Instance functions
+//********************************************************************************************************************************
+
+PlayGraphics& PlayGraphics::Instance()
+{
+	PLAY_ASSERT_MSG( s_pInstance, "Trying to use PlayGraphics without initialising it!" );
+	return *s_pInstance;
+}
+
+PlayGraphics& PlayGraphics::Instance( int bufferWidth, int bufferHeight, const char* path )
+{
+	PLAY_ASSERT_MSG( !s_pInstance, "Trying to create multiple instances of singleton class!" );
+	s_pInstance = new PlayGraphics( bufferWidth, bufferHeight, path );
+	return *s_pInstance;
+}
+
+void PlayGraphics::Destroy()
+{
+	PLAY_ASSERT_MSG( s_pInstance, "Trying to use destroy PlayGraphics when it hasn't been instanced!" );
+	delete s_pInstance;
+	s_pInstance = nullptr;
+}
+
+//********************************************************************************************************************************
+// Loading functions
+//********************************************************************************************************************************
+
+int PlayGraphics::LoadSpriteSheet( const std::string& path, const std::string& filename )
+{
+	PixelData canvasBuffer;
+	std::string spriteName = filename;
+	int hCount = 1;
+	int vCount = 1;
+
+	// Switch everything to uppercase to avoid need to check case each time
+	for( char& c : spriteName ) c = static_cast<char>( toupper( c ) );
+
+	ReadSpriteFrameCounts( filename, hCount, vCount );
+
+	std::string fileAndPath( path + spriteName + ".PNG" );
+	PlayWindow::LoadPNGImage( fileAndPath, canvasBuffer ); // Allocates memory as we don't know the size
+	
+	int spriteId = AddSprite( filename, canvasBuffer, hCount, vCount );
+	vSpriteData[spriteId].fileAndPath = fileAndPath;
+	return spriteId;
+}
+
+int PlayGraphics::AddSprite( const std::string& name, PixelData& pixelData, int hCount, int vCount )
+{
+	Sprite s;
+	PrepareSprite( s, name, pixelData, hCount, vCount );
+	return InsertSprite( s );
+}
+
+void PlayGraphics::PrepareSprite( Sprite& s, const std::string& name, PixelData& pixelData, int hCount, int vCount )
+{
+	// Switch everything to uppercase to avoid need to check case each time
+	std::string spriteName = name;
+	for( char& c : spriteName ) c = static_cast<char>( toupper( c ) );
+
+	s.name = spriteName;
+	s.originX = s.originY = 0;
+	s.hCount = hCount;
+	s.vCount = vCount;
+	s.canvasBuffer = pixelData; // copy including pointer to pixel data
+
+	s.totalCount = s.hCount * s.vCount;
+	s.width = s.canvasBuffer.width / s.hCount;
+	s.height = s.canvasBuffer.height / s.vCount;
+
+	// Create a separate buffer with the pre-multiplyied alpha
+	s.preMultAlpha.pPixels = new Pixel[static_cast<size_t>( s.canvasBuffer.width ) * s.canvasBuffer.height];
+	s.preMultAlpha.width = s.canvasBuffer.width;
+	s.preMultAlpha.height = s.canvasBuffer.height;
+	memset( s.preMultAlpha.pPixels, 0, sizeof( uint32_t ) * s.canvasBuffer.width * s.canvasBuffer.height );
+	PreMultiplyAlpha( s.canvasBuffer.pPixels, s.preMultAlpha.pPixels, s.canvasBuffer.width, s.canvasBuffer.height, s.width, 1.0f, 0x00FFFFFF );
+	s.canvasBuffer.preMultiplied = true;
+	FindOpaqueSpans( s );
+}
+
+int PlayGraphics::InsertSprite( Sprite& s )
+{
+	s.id = m_nTotalSprites++;
+	s.font = IsSpriteInCategory( s.name, "FONT" );
+
+	// Add the sprite to our vector (sprites which haven't been decoded yet start off evicted)
+	vSpriteData.push_back( std::move( s ) );
+	if( vSpriteData.back().mapped || vSpriteData.back().preMultAlpha.pPixels )
+		AddResidentSprite( vSpriteData.back() );
+
+	return vSpriteData.back().id;
+}
+
+int PlayGraphics::UpdateSprite( const std::string& name, PixelData& pixelData, int hCount, int vCount )
+{
+	// Switch everything to uppercase to avoid need to check case each time
+	std::string spriteName = name;
+	for( char& c : spriteName ) c = static_cast<char>( toupper( c ) );
+
+	for( Sprite& s : vSpriteData )
+	{
+		if( s.name.find( spriteName ) != std::string::npos )
+		{
+			if( s.resident )
+				RemoveResidentSprite( s );
+
+			// delete the old premultiplied buffer (unless it belongs to the sprite cache)
+			if( !s.mapped )
+				delete s.preMultAlpha.pPixels;
+
+			s.mapped = false;
+			s.fileAndPath.clear();
+			s.tint = 0x00FFFFFF;
+			s.fontWidths.clear();
+
+			s.hCount = hCount;
+			s.vCount = vCount;
+			s.canvasBuffer = pixelData; // copy including pointer to pixel data
+
+			s.totalCount = s.hCount * s.vCount;
+			s.width = s.canvasBuffer.width / s.hCount;
+			s.height = s.canvasBuffer.height / s.vCount;
+
+			// Create a new buffer with the pre-multiplyied alpha
+			s.preMultAlpha.pPixels = new Pixel[static_cast<size_t>( s.canvasBuffer.width ) * s.canvasBuffer.height];
+			s.preMultAlpha.width = s.canvasBuffer.width;
+			s.preMultAlpha.height = s.canvasBuffer.height;
+			memset( s.preMultAlpha.pPixels, 0, sizeof( uint32_t ) * s.canvasBuffer.width * s.canvasBuffer.height );
+			PreMultiplyAlpha( s.canvasBuffer.pPixels, s.preMultAlpha.pPixels, s.canvasBuffer.width, s.canvasBuffer.height, s.width, 1.0f, 0x00FFFFFF );
+			s.canvasBuffer.preMultiplied = true;
+			FindOpaqueSpans( s );
+			AddResidentSprite( s );
+
+			return s.id;
+		}
+	}
+
+	return -1;
+}
+
+int PlayGraphics::AddScaledSprite( int spriteId, float scale )
+{
+	Sprite s;
+	ScaleSprite( spriteId, scale, s );
+	return InsertSprite( s );
+}
+
+void PlayGraphics::UpdateScaledSprite( int scaledId, int spriteId, float scale )
+{
+	PLAY_ASSERT_MSG( scaledId >= 0 && scaledId < m_nTotalSprites && vSpriteData[scaledId].fileAndPath.empty() && !vSpriteData[scaledId].canvasBuffer.pPixels, "Only scaled sprites can be updated" );
+
+	Sprite s;
+	ScaleSprite( spriteId, scale, s );
+
+	// The new copy takes the old one's place, so its id stays the same
+	Sprite& dest = vSpriteData[scaledId];
+	if( dest.resident )
+		RemoveResidentSprite( dest );
+
+	delete[] dest.preMultAlpha.pPixels;
+	s.id = scaledId;
+	dest = std::move( s );
+	AddResidentSprite( dest );
+}
+
+void PlayGraphics::ScaleSprite( int spriteId, float scale, Sprite& s )
+{
+	PLAY_ASSERT_MSG( scale > 0.0f && scale <= 1.0f, "Scaled sprites can only be smaller than the original" );
+
+	const Sprite& src = UseSprite( spriteId );
+
+	s.name = src.name + "_SCALED_" + std::to_string( static_cast<int>( scale * 100.0f + 0.5f ) );
+	s.hCount = src.hCount;
+	s.vCount = src.vCount;
+	s.totalCount = src.totalCount;
+	s.width = std::max( 1, static_cast<int>( src.width * scale + 0.5f ) );
+	s.height = std::max( 1, static_cast<int>( src.height * scale + 0.5f ) );
+	s.originX = static_cast<int>( src.originX * scale + 0.5f );
+	s.originY = static_cast<int>( src.originY * scale + 0.5f );
+
+	// There's no canvas, but its size is still used to find each frame in the pre-multiplied data
+	s.canvasBuffer.width = s.width * s.hCount;
+	s.canvasBuffer.height = s.height * s.vCount;
+	s.preMultAlpha.width = s.canvasBuffer.width;
+	s.preMultAlpha.height = s.canvasBuffer.height;
+	s.preMultAlpha.pPixels = new Pixel[static_cast<size_t>( s.preMultAlpha.width ) * s.preMultAlpha.height];
+	s.preMultAlpha.preMultiplied = true;
+
+	// Each destination pixel is the average of the source pixels it covers, which is correct for pre-multiplied colours
+	for( int destY = 0; destY < s.preMultAlpha.height; destY++ )
+	{
+		int frameY = destY / s.height;
+		int srcTop = ( frameY * src.height ) + ( ( destY % s.height ) * src.height ) / s.height;
+		int srcBottom = std::max( srcTop + 1, ( frameY * src.height ) + ( ( ( destY % s.height ) + 1 ) * src.height ) / s.height );
+
+		for( int destX = 0; destX < s.preMultAlpha.width; destX++ )
+		{
+			int frameX = destX / s.width;
+			int srcLeft = ( frameX * src.width ) + ( ( destX % s.width ) * src.width ) / s.width;
+			int srcRight = std::max( srcLeft + 1, ( frameX * src.width ) + ( ( ( destX % s.width ) + 1 ) * src.width ) / s.width );
+
+			uint32_t alpha = 0, red = 0, green = 0, blue = 0;
+			for( int srcY = srcTop; srcY < srcBottom; srcY++ )
+			{
+				const uint32_t* srcPixels = &src.preMultAlpha.pPixels[srcY * src.preMultAlpha.width].bits;
+				for( int srcX = srcLeft; srcX < srcRight; srcX++ )
+				{
+					uint32_t pix = srcPixels[srcX];
+					if( pix >= 0xFF000000 ) // Fully transparent (the colour bits are a run length)
+						continue;
+
+					alpha += 0xFF - ( pix >> 24 );
+					red += ( pix >> 16 ) & 0xFF;
+					green += ( pix >> 8 ) & 0xFF;
+					blue += pix & 0xFF;
+				}
+			}
+
+			uint32_t count = static_cast<uint32_t>( ( srcBottom - srcTop ) * ( srcRight - srcLeft ) );
+			alpha = ( alpha + count / 2 ) / count;
+			uint32_t& destPix = s.preMultAlpha.pPixels[( destY * s.preMultAlpha.width ) + destX].bits;
+
+			if( alpha == 0 )
+				destPix = 0xFF000000;
+			else
+				destPix = ( ( 0xFF - alpha ) << 24 ) | ( ( ( red + count / 2 ) / count ) << 16 ) | ( ( ( green + count / 2 ) / count ) << 8 ) | ( ( blue + count / 2 ) / count );
+		}
+	}
+
+	// Store the transparent run lengths the way PreMultiplyAlpha does, stopping at the edge of each frame
+	for( int row = 0; row < s.preMultAlpha.height; row++ )
+	{
+		uint32_t* pixels = &s.preMultAlpha.pPixels[row * s.preMultAlpha.width].bits;
+		uint32_t following = 0;
+
+		for( int col = s.preMultAlpha.width - 1; col >= 0; col-- )
+		{
+			if( ( col + 1 ) % s.width == 0 )
+				following = 0;
+
+			if( pixels[col] >= 0xFF000000 )
+				pixels[col] = 0xFF000000 | following++;
+			else
+				following = 0;
+		}
+	}
+
+	FindOpaqueSpans( s );
+}
+
+
+int PlayGraphics::LoadBackground( const char* fileAndPath )
+{
+	// The background image may not be the right size for the background so we make sure the buffer is 
+	PixelData backgroundImage;
+	Pixel* pSrc, * pDest;
+
+	Pixel* correctSizeBuffer = new Pixel[static_cast<size_t>( m_playBuffer.width ) * m_playBuffer.height];
+	PLAY_ASSERT( correctSizeBuffer );
+
+	std::string pngFile = PlayWindow::GetPlatformPath( fileAndPath );
+	PLAY_ASSERT_MSG( std::filesystem::exists( pngFile ), "The background png does not exist at the given location." );
+	PlayWindow::LoadPNGImage( pngFile, backgroundImage ); // Allocates memory in function as we don't know the size
+
+	pSrc = backgroundImage.pPixels;
+	pDest = correctSizeBuffer;
+
+	//Copy the image to our background buffer clipping where necessary
+	for( int h = 0; h < std::min( backgroundImage.height, m_playBuffer.height ); h++ )
+	{
+		for( int w = 0; w < std::min( backgroundImage.width, m_playBuffer.width ); w++ )
+			*pDest++ = *pSrc++;
+
+		// Skip pixels if we're clipping
+		pDest += std::max( m_playBuffer.width - backgroundImage.width, 0 );
+		pSrc += std::max( backgroundImage.width - m_playBuffer.width, 0 );
+	}
+
+	// Free up the loading buffer
+	delete backgroundImage.pPixels;
+	backgroundImage.pPixels = correctSizeBuffer;
+
+	vBackgroundData.push_back( backgroundImage );
+
+	return static_cast<int>( vBackgroundData.size() ) - 1;
+}
+
+
+//********************************************************************************************************************************
+// Sprite cache functions
+//********************************************************************************************************************************
+
+void PlayGraphics::OpenSpriteCache( const std::string& cacheFile )
+{
+	// The cache can't be replaced while it's mapped, so the previous run may have left a newer one waiting
+	std::error_code error;
+	if( std::filesystem::exists( cacheFile + ".new", error ) )
+		std::filesystem::rename( cacheFile + ".new", cacheFile, error );
+
+	size_t size = 0;
+	m_pSpriteCache = static_cast<const uint8_t*>( PlayWindow::MapFile( cacheFile, size, m_hSpriteCacheMapping ) );
+	m_spriteCacheSize = size;
+
+	if( !m_pSpriteCache )
+		return;
+
+	const SpriteCacheHeader* pHeader = reinterpret_cast<const SpriteCacheHeader*>( m_pSpriteCache );
+	const SpriteCacheHeader expected;
+
+	if( size < sizeof( SpriteCacheHeader ) || memcmp( pHeader->magic, expected.magic, sizeof( expected.magic ) ) != 0 || pHeader->version != SPRITE_CACHE_VERSION ||
+		size < sizeof( SpriteCacheHeader ) + ( sizeof( SpriteCacheEntry ) * pHeader->spriteCount ) )
+	{
+		// An old or damaged cache is just ignored and re-cooked from scratch
+		m_bSpriteCacheStale = true;
+		return;
+	}
+
+	const SpriteCacheEntry* pEntries = reinterpret_cast<const SpriteCacheEntry*>( pHeader + 1 );
+
+	for( uint32_t i = 0; i < pHeader->spriteCount; i++ )
+	{
+		const SpriteCacheEntry& entry = pEntries[i];
+		uint64_t pixels = static_cast<uint64_t>( entry.canvasWidth ) * entry.canvasHeight * sizeof( Pixel );
+
+		// Entries which point outside the file are treated as missing
+		if( entry.canvasOffset + pixels > size || entry.preMultOffset + pixels > size || entry.hCount <= 0 || entry.vCount <= 0 ||
+			entry.spanRowOffset + ( ( entry.canvasHeight + 1ull ) * sizeof( int ) ) > size || entry.spanOffset + ( entry.spanCount * sizeof( Sprite::OpaqueSpan ) ) > size )
+		{
+			m_bSpriteCacheStale = true;
+			continue;
+		}
+
+		m_spriteCacheEntries[std::string( entry.name, strnlen( entry.name, sizeof( entry.name ) ) )] = &entry;
+	}
+}
+
+bool PlayGraphics::ReadCachedSprite( const std::string& fileAndPath, const std::string& spriteName, const std::string& infoFile, Sprite& s )
+{
+	auto it = m_spriteCacheEntries.find( spriteName );
+	if( it == m_spriteCacheEntries.end() )
+		return false;
+
+	const SpriteCacheEntry& entry = *it->second;
+
+	std::error_code error;
+	uint64_t pngSize = std::filesystem::file_size( fileAndPath, error );
+	if( error || pngSize != entry.pngSize )
+		return false;
+
+	// A PNG with a new timestamp may just have been touched, so only re-cook it if the contents have changed
+	if( FileWriteTime( fileAndPath ) != entry.pngTime )
+	{
+		if( HashFile( fileAndPath ) != entry.pngHash )
+			return false;
+
+		m_bSpriteCacheStale = true; // Saves hashing the file again next time
+	}
+
+	s.name = spriteName;
+	s.hCount = entry.hCount;
+	s.vCount = entry.vCount;
+	s.totalCount = s.hCount * s.vCount;
+	s.width = entry.canvasWidth / s.hCount;
+	s.height = entry.canvasHeight / s.vCount;
+	s.fileAndPath = fileAndPath;
+	s.mapped = true;
+	s.cacheCanvasOffset = entry.canvasOffset;
+
+	// The cache is mapped copy-on-write so the pixels can still be changed (by ColourSprite for example) without affecting the file
+	s.canvasBuffer.width = s.preMultAlpha.width = entry.canvasWidth;
+	s.canvasBuffer.height = s.preMultAlpha.height = entry.canvasHeight;
+	s.canvasBuffer.pPixels = reinterpret_cast<Pixel*>( const_cast<uint8_t*>( m_pSpriteCache + entry.canvasOffset ) );
+	s.preMultAlpha.pPixels = reinterpret_cast<Pixel*>( const_cast<uint8_t*>( m_pSpriteCache + entry.preMultOffset ) );
+	s.canvasBuffer.preMultiplied = true;
+
+	const int* pRowStart = reinterpret_cast<const int*>( m_pSpriteCache + entry.spanRowOffset );
+	const Sprite::OpaqueSpan* pSpans = reinterpret_cast<const Sprite::OpaqueSpan*>( m_pSpriteCache + entry.spanOffset );
+	s.opaqueRowStart.assign( pRowStart, pRowStart + entry.canvasHeight + 1 );
+	s.opaqueSpans.assign( pSpans, pSpans + entry.spanCount );
+
+	// The origin is cached as well, unless the .inf file has changed
+	if( FileWriteTime( infoFile ) == entry.infTime )
+	{
+		s.originX = entry.originX;
+		s.originY = entry.originY;
+	}
+	else
+	{
+		ReadSpriteInfo( infoFile, s.originX, s.originY );
+		m_bSpriteCacheStale = true;
+	}
+
+	m_nCachedSpritesUsed++;
+
+	return true;
+}
+
+bool PlayGraphics::ReadUncachedSprite( const std::string& fileAndPath, const std::string& spriteName, const std::string& infoFile, Sprite& s )
+{
+	int canvasWidth = 0, canvasHeight = 0;
+	if( PlayWindow::ReadPNGImage( fileAndPath, canvasWidth, canvasHeight ) < 0 )
+		return false;
+
+	s.name = spriteName;
+	ReadSpriteFrameCounts( spriteName, s.hCount, s.vCount );
+	s.totalCount = s.hCount * s.vCount;
+	s.width = canvasWidth / s.hCount;
+	s.height = canvasHeight / s.vCount;
+	s.fileAndPath = fileAndPath;
+
+	// The same sizes an evicted sprite keeps, which LoadSpriteCanvas checks the PNG against when it's decoded
+	s.canvasBuffer.width = s.preMultAlpha.width = canvasWidth;
+	s.canvasBuffer.height = s.preMultAlpha.height = canvasHeight;
+
+	ReadSpriteInfo( infoFile, s.originX, s.originY );
+	return true;
+}
+
+void PlayGraphics::WriteSpriteCache( const std::string& cacheFile )
+{
+	PLAY_ALLOCATION_TAG( "Sprites" );
+
+	// Only the sprites loaded from PNGs are cooked: this is called before anything can change their origins or colours
+	std::vector<const Sprite*> vCooked;
+	for( const Sprite& s : vSpriteData )
+	{
+		if( !s.fileAndPath.empty() )
+			vCooked.push_back( &s );
+	}
+
+	// Written alongside the current cache because that one can't be replaced while it's mapped
+	std::ofstream file( cacheFile + ".new", std::ios::binary | std::ios::trunc );
+	if( !file )
+		return;
+
+	auto align = []( uint64_t offset ) { return ( offset + 15 ) & ~15ull; };
+
+	auto writeAt = [&file]( uint64_t offset, const void* pData, size_t size )
+	{
+		static const char padding[16]{ 0 };
+		uint64_t pos = static_cast<uint64_t>( file.tellp() );
+		if( offset > pos ) file.write( padding, static_cast<std::streamsize>( offset - pos ) );
+		file.write( static_cast<const char*>( pData ), static_cast<std::streamsize>( size ) );
+	};
+
+	// The manifest is filled in last, once the size of every sprite's spans is known
+	SpriteCacheHeader header;
+	header.version = SPRITE_CACHE_VERSION;
+	std::vector<SpriteCacheEntry> vEntries( vCooked.size() );
+	file.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+	file.write( reinterpret_cast<const char*>( vEntries.data() ), static_cast<std::streamsize>( sizeof( SpriteCacheEntry ) * vEntries.size() ) );
+
+	uint64_t offset = align( sizeof( SpriteCacheHeader ) + ( sizeof( SpriteCacheEntry ) * vEntries.size() ) );
+
+	for( const Sprite* pSprite : vCooked )
+	{
+		// Sprites which aren't mapped from the current cache are decoded into a temporary sprite and freed once they've been written
+		Sprite decoded;
+		if( !pSprite->mapped )
+		{
+			PixelData canvasBuffer;
+			if( !LoadSpriteCanvas( *pSprite, canvasBuffer ) )
+				continue;
+
+			PrepareSprite( decoded, pSprite->name, canvasBuffer, pSprite->hCount, pSprite->vCount );
+		}
+
+		const Sprite& s = pSprite->mapped ? *pSprite : decoded;
+		SpriteCacheEntry& entry = vEntries[header.spriteCount++];
+		std::string infoFile = std::filesystem::path( pSprite->fileAndPath ).replace_extension( ".INF" ).string();
+		std::error_code error;
+
+		strncpy_s( entry.name, sizeof( entry.name ), pSprite->name.c_str(), _TRUNCATE );
+		entry.pngTime = FileWriteTime( pSprite->fileAndPath );
+		entry.infTime = FileWriteTime( infoFile );
+
+		// Sprites mapped from the old cache were checked against their entries as they loaded, so only new or changed PNGs are hashed
+		auto cached = pSprite->mapped ? m_spriteCacheEntries.find( pSprite->name ) : m_spriteCacheEntries.end();
+		if( cached != m_spriteCacheEntries.end() )
+		{
+			entry.pngSize = cached->second->pngSize;
+			entry.pngHash = cached->second->pngHash;
+		}
+		else
+		{
+			entry.pngSize = std::filesystem::file_size( pSprite->fileAndPath, error );
+			entry.pngHash = HashFile( pSprite->fileAndPath );
+		}
+		entry.hCount = pSprite->hCount;
+		entry.vCount = pSprite->vCount;
+		entry.canvasWidth = s.canvasBuffer.width;
+		entry.canvasHeight = s.canvasBuffer.height;
+		entry.originX = pSprite->originX;
+		entry.originY = pSprite->originY;
+		entry.spanCount = static_cast<uint32_t>( s.opaqueSpans.size() );
+
+		size_t pixels = static_cast<size_t>( s.canvasBuffer.width ) * s.canvasBuffer.height * sizeof( Pixel );
+		entry.canvasOffset = offset;
+		entry.preMultOffset = offset = align( offset + pixels );
+		entry.spanRowOffset = offset = align( offset + pixels );
+		entry.spanOffset = offset = align( offset + ( s.opaqueRowStart.size() * sizeof( int ) ) );
+		offset = align( offset + ( s.opaqueSpans.size() * sizeof( Sprite::OpaqueSpan ) ) );
+
+		writeAt( entry.canvasOffset, s.canvasBuffer.pPixels, pixels );
+		writeAt( entry.preMultOffset, s.preMultAlpha.pPixels, pixels );
+		writeAt( entry.spanRowOffset, s.opaqueRowStart.data(), s.opaqueRowStart.size() * sizeof( int ) );
+		writeAt( entry.spanOffset, s.opaqueSpans.data(), s.opaqueSpans.size() * sizeof( Sprite::OpaqueSpan ) );
+
+		delete[] decoded.canvasBuffer.pPixels;
+		delete[] decoded.preMultAlpha.pPixels;
+	}
+
+	// Any sprites which couldn't be decoded just leave the last few manifest entries unused
+	file.seekp( 0 );
+	file.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+	file.write( reinterpret_cast<const char*>( vEntries.data() ), static_cast<std::streamsize>( sizeof( SpriteCacheEntry ) * header.spriteCount ) );
+
+	// Nothing is mapped on the first run, so the new cache can be used straight away
+	file.close();
+	if( !m_pSpriteCache )
+	{
+		std::error_code error;
+		std::filesystem::rename( cacheFile + ".new", cacheFile, error );
+	}
+}
+
+//********************************************************************************************************************************
+// Sprite Getters and Setters
+//********************************************************************************************************************************
+int PlayGraphics::GetSpriteId( const char* name ) const
+{
+	// Sprite names are stored in upper case, and this is called every frame, so the name isn't copied to convert it
+	for( const Sprite& s : vSpriteData )
+	{
+		if( ContainsUpperCase( s.name, name ) )
+			return s.id;
+	}
+	PLAY_ASSERT_MSG( false, "The sprite name is invalid!" );
+	return -1;
+}
+
+const std::string& PlayGraphics::GetSpriteName( int spriteId )
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get name of invalid sprite id" );
+	return vSpriteData[spriteId].name;
+}
+
+Vector2f PlayGraphics::GetSpriteSize( int spriteId ) const
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get width of invalid sprite id" );
+	return { vSpriteData[spriteId].width, vSpriteData[spriteId].height };
+}
+
+int PlayGraphics::GetSpriteFrames( int spriteId ) const
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get frames of invalid sprite id" );
+	return vSpriteData[spriteId].totalCount;
+}
+
+Vector2f PlayGraphics::GetSpriteOrigin( int spriteId ) const
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get origin with invalid sprite id" );
+	return { vSpriteData[spriteId].originX, vSpriteData[spriteId].originY };
+}
+
+void PlayGraphics::SetSpriteOrigin( int spriteId, Vector2f newOrigin, bool relative )
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to set origin with invalid sprite id" );
+	if( relative )
+	{
+		vSpriteData[spriteId].originX += static_cast<int>( newOrigin.null );
+		vSpriteData[spriteId].originY += static_cast<int>( newOrigin.y );
+	}
+	else
+	{
+		vSpriteData[spriteId].originX = static_cast<int>( newOrigin.null );
+		vSpriteData[spriteId].originY = static_cast<int>( newOrigin.y );
+	}
+}
+
+void PlayGraphics::CentreSpriteOrigin( int spriteId )
+{
+	SetSpriteOrigin( spriteId, GetSpriteSize( spriteId ) / 2 );
+}
+
+void PlayGraphics::CentreAllSpriteOrigins( void )
+{
+	for( Sprite& s : vSpriteData )
+		CentreSpriteOrigin( s.id );
+}
+
+void PlayGraphics::SetSpriteOrigins( const char* rootName, Vector2f newOrigin, bool relative )
+{
+	std::string tofind( rootName );
+	for( char& c : tofind ) c = static_cast<char>( toupper( c ) );
+
+	for( Sprite& s : vSpriteData )
+	{
+		if( s.name.find( tofind ) != std::string::npos )
+		{
+			if( relative )
+			{
+				s.originX += static_cast<int>( newOrigin.null );
+				s.originY += static_cast<int>( newOrigin.y );
+			}
+			else
+			{
+				s.originX = static_cast<int>( newOrigin.null );
+				s.originY = static_cast<int>( newOrigin.y );
+			}
+		}
+	}
+}
+
+//********************************************************************************************************************************
+// Sprite memory functions
+//********************************************************************************************************************************
+
+PlayGraphics::Sprite& PlayGraphics::UseSprite( int spriteId ) const
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to use an invalid sprite id" );
+
+	PlayGraphics& self = const_cast<PlayGraphics&>( *this );
+	Sprite& s = self.vSpriteData[spriteId];
+
+	if( !s.resident )
+	{
+		// Mapped sprites still point at the sprite cache, so their pages are just faulted back in as they're drawn
+		if( !s.mapped && !s.preMultAlpha.pPixels )
+		{
+			bool decoded = self.DecodeSpritePixels( s );
+			PLAY_ASSERT_MSG( decoded, std::string( "Unable to reload sprite: " + s.fileAndPath ).c_str() );
+		}
+
+		self.AddResidentSprite( s );
+	}
+	else if( s.lruEntry != m_residentSprites.begin() )
+	{
+		self.m_residentSprites.splice( self.m_residentSprites.begin(), self.m_residentSprites, s.lruEntry );
+	}
+
+	s.lastUsedFrame = m_residencyFrame;
+	return s;
+}
+
+bool PlayGraphics::DecodeSpritePixels( Sprite& s )
+{
+	PLAY_ALLOCATION_TAG( "Sprites" );
+
+	PixelData canvasBuffer;
+	if( !LoadSpriteCanvas( s, canvasBuffer ) )
+		return false;
+
+	SetSpriteCanvas( s, canvasBuffer );
+	return true;
+}
+
+bool PlayGraphics::LoadSpriteCanvas( const Sprite& s, PixelData& canvasBuffer ) const
+{
+	if( PlayWindow::LoadPNGImage( s.fileAndPath, canvasBuffer ) < 0 )
+		return false;
+
+	// The sprite's metadata was worked out from the original PNG, so it can't change size now
+	if( canvasBuffer.width != s.preMultAlpha.width || canvasBuffer.height != s.preMultAlpha.height )
+	{
+		delete[] canvasBuffer.pPixels;
+		canvasBuffer.pPixels = nullptr;
+		return false;
+	}
+
+	return true;
+}
+
+void PlayGraphics::SetSpriteCanvas( Sprite& s, const PixelData& canvasBuffer )
+{
+	PLAY_ASSERT( !s.resident && !s.mapped && !s.preMultAlpha.pPixels );
+
+	s.canvasBuffer = canvasBuffer;
+	s.preMultAlpha.pPixels = new Pixel[static_cast<size_t>( s.canvasBuffer.width ) * s.canvasBuffer.height];
+	s.preMultAlpha.width = s.canvasBuffer.width;
 	s.preMultAlpha.height = s.canvasBuffer.height;
-	memset( s.preMultAlpha.pPixels, 0, sizeof( uint32_t ) * s.canvasBuffer.width * s.canvasBuffer.height );
-	PreMultiplyAlpha( s.canvasBuffer.pPixels, s.preMultAlpha.pPixels, s.canvasBuffer.width, s.canvasBuffer.height, s.width, 1.0f, 0x00FFFFFF );
+	PreMultiplyAlpha( s.canvasBuffer.pPixels, s.preMultAlpha.pPixels, s.canvasBuffer.width, s.canvasBuffer.height, s.width, 1.0f, s.tint );
+	s.canvasBuffer.preMultiplied = true;
+	FindOpaqueSpans( s );
+	CompactSprite( s );
+}
+
+void PlayGraphics::AddResidentSprite( Sprite& s )
+{
+	PLAY_ASSERT( !s.resident );
+	s.resident = true;
+	s.residentBytes = static_cast<size_t>( s.preMultAlpha.width ) * s.preMultAlpha.height * sizeof( Pixel ) * ( s.canvasBuffer.pPixels ? 2 : 1 );
+	s.lruEntry = m_residentSprites.insert( m_residentSprites.begin(), s.id );
+	m_spriteMemoryUsed += s.residentBytes;
+}
+
+void PlayGraphics::RemoveResidentSprite( Sprite& s )
+{
+	PLAY_ASSERT( s.resident );
+	m_residentSprites.erase( s.lruEntry );
+	m_spriteMemoryUsed -= s.residentBytes;
+	s.residentBytes = 0;
+	s.resident = false;
+}
+
+void PlayGraphics::EvictSprite( Sprite& s )
+{
+	RemoveResidentSprite( s );
+
+	size_t pixelBytes = static_cast<size_t>( s.preMultAlpha.width ) * s.preMultAlpha.height * sizeof( Pixel );
+
+	if( s.mapped )
+	{
+		// Any changes from ColourSprite are kept because the pages are copy-on-write
+		if( s.canvasBuffer.pPixels )
+			PlayWindow::ReleaseMappedPages( s.canvasBuffer.pPixels, pixelBytes );
+		PlayWindow::ReleaseMappedPages( s.preMultAlpha.pPixels, pixelBytes );
+		return;
+	}
+
+	delete[] s.canvasBuffer.pPixels;
+	delete[] s.preMultAlpha.pPixels;
+	s.canvasBuffer.pPixels = nullptr;
+	s.preMultAlpha.pPixels = nullptr;
+	s.opaqueSpans.clear();
+	s.opaqueSpans.shrink_to_fit();
+}
+
+void PlayGraphics::PreloadSprites( const std::vector<int>& spriteIds )
+{
+	std::vector<int> vEvicted;
+
+	// Mapped sprites don't need decoding, so they're only added to the residency list
+	for( int id : spriteIds )
+	{
+		PLAY_ASSERT_MSG( id >= 0 && id < m_nTotalSprites, "Trying to preload an invalid sprite id" );
+		Sprite& s = vSpriteData[id];
+
+		if( s.resident )
+			continue;
+
+		if( s.mapped || s.preMultAlpha.pPixels )
+			AddResidentSprite( s );
+		else if( std::find( vEvicted.begin(), vEvicted.end(), id ) == vEvicted.end() )
+			vEvicted.push_back( id );
+	}
+
+	std::vector<DecodedSprite> vDecoded = DecodeSprites( vEvicted );
+	AttachSprites( vDecoded );
+}
+
+std::vector<int> PlayGraphics::GetEvictedSprites() const
+{
+	std::vector<int> vEvicted;
+
+	for( int id = 0; id < m_nTotalSprites; id++ )
+	{
+		const Sprite& s = vSpriteData[id];
+
+		if( !s.resident && !s.mapped && !s.preMultAlpha.pPixels )
+			vEvicted.push_back( id );
+	}
+
+	return vEvicted;
+}
+
+std::vector<PlayGraphics::DecodedSprite> PlayGraphics::DecodeSprites( const std::vector<int>& spriteIds ) const
+{
+	PLAY_ALLOCATION_TAG( "Sprites" );
+
+	std::vector<DecodedSprite> vDecoded;
+
+	// The sprites' pixel data and residency belong to the main thread, so nothing but the file and size is read here
+	for( int id : spriteIds )
+	{
+		PLAY_ASSERT_MSG( id >= 0 && id < m_nTotalSprites, "Trying to decode an invalid sprite id" );
+
+		if( !vSpriteData[id].mapped )
+			vDecoded.push_back( { id, {} } );
+	}
+
+	std::vector<char> vLoaded( vDecoded.size(), 0 ); // Not vector<bool> as each thread writes its own element
+
+	ParallelFor( static_cast<int>( vDecoded.size() ), [&]( int i )
+	{
+		vLoaded[i] = LoadSpriteCanvas( vSpriteData[vDecoded[i].id], vDecoded[i].canvasBuffer );
+	} );
+
+	for( size_t i = 0; i < vDecoded.size(); i++ )
+		PLAY_ASSERT_MSG( vLoaded[i], std::string( "Unable to reload sprite: " + vSpriteData[vDecoded[i].id].fileAndPath ).c_str() );
+
+	return vDecoded;
+}
+
+void PlayGraphics::AttachSprites( std::vector<DecodedSprite>& vDecoded )
+{
+	// Sprites which were drawn while they were being decoded have already been reloaded, so their copies aren't needed
+	for( DecodedSprite& decoded : vDecoded )
+	{
+		const Sprite& s = vSpriteData[decoded.id];
+
+		if( s.resident || s.mapped || s.preMultAlpha.pPixels )
+		{
+			delete[] decoded.canvasBuffer.pPixels;
+			decoded.canvasBuffer.pPixels = nullptr;
+		}
+	}
+
+	// Pre-multiplying is the slow part, and each sprite only changes its own data
+	ParallelFor( static_cast<int>( vDecoded.size() ), [&]( int i )
+	{
+		if( vDecoded[i].canvasBuffer.pPixels )
+			SetSpriteCanvas( vSpriteData[vDecoded[i].id], vDecoded[i].canvasBuffer );
+	} );
+
+	for( const DecodedSprite& decoded : vDecoded )
+	{
+		if( decoded.canvasBuffer.pPixels )
+			AddResidentSprite( vSpriteData[decoded.id] );
+	}
+
+	vDecoded.clear();
+}
+
+void PlayGraphics::DiscardSprites( std::vector<DecodedSprite>& vDecoded )
+{
+	for( DecodedSprite& decoded : vDecoded )
+		delete[] decoded.canvasBuffer.pPixels;
+
+	vDecoded.clear();
+}
+
+void PlayGraphics::TrimSpriteMemory()
+{
+	int frame = m_residencyFrame++;
+
+	if( m_spriteMemoryBudget == 0 )
+		return;
+
+	// Work back from the least recently used sprite until we're within budget or reach the sprites drawn this frame
+	auto it = m_residentSprites.end();
+	while( m_spriteMemoryUsed > m_spriteMemoryBudget && it != m_residentSprites.begin() )
+	{
+		Sprite& s = vSpriteData[*--it];
+
+		if( s.lastUsedFrame == frame )
+			break;
+
+		// Sprites added from memory can't be reloaded
+		if( s.fileAndPath.empty() )
+			continue;
+
+		it = std::next( it );
+		EvictSprite( s );
+	}
+}
+
+size_t PlayGraphics::GetSpriteMemory( int spriteId ) const
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to use an invalid sprite id" );
+	return vSpriteData[spriteId].residentBytes;
+}
+
+size_t PlayGraphics::GetSpriteCategoryMemory( const char* category ) const
+{
+	std::string categoryName = category;
+	for( char& c : categoryName ) c = static_cast<char>( toupper( c ) );
+
+	size_t bytes = 0;
+	for( const Sprite& s : vSpriteData )
+	{
+		if( IsSpriteInCategory( s.name, categoryName ) )
+			bytes += s.residentBytes;
+	}
+
+	return bytes;
+}
+
+void PlayGraphics::EnableCompactSprites( bool enable )
+{
+	m_bCompactSprites = enable;
+
+	for( Sprite& s : vSpriteData )
+	{
+		if( enable )
+		{
+			CompactSprite( s );
+		}
+		else if( !s.canvasBuffer.pPixels && s.preMultAlpha.pPixels )
+		{
+			bool restored = RestoreSpriteCanvas( s );
+			PLAY_ASSERT_MSG( restored, std::string( "Unable to reload sprite: " + s.fileAndPath ).c_str() );
+		}
+	}
+}
+
+void PlayGraphics::MakeSpriteMutable( int spriteId )
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to make an invalid sprite id mutable" );
+
+	Sprite& s = vSpriteData[spriteId];
+	s.mutableCanvas = true;
+
+	// Evicted sprites get their canvas back when they're reloaded
+	if( !s.canvasBuffer.pPixels && s.preMultAlpha.pPixels )
+	{
+		bool restored = RestoreSpriteCanvas( s );
+		PLAY_ASSERT_MSG( restored, std::string( "Unable to reload sprite: " + s.fileAndPath ).c_str() );
+	}
+}
+
+void PlayGraphics::CompactSprite( Sprite& s )
+{
+	// Sprites added from memory have nowhere to reload their canvas from, so they always keep it
+	if( !m_bCompactSprites || s.mutableCanvas || !s.canvasBuffer.pPixels || s.fileAndPath.empty() )
+		return;
+
+	// GetFontCharWidth reads the character widths hidden in the first row of a font's canvas
+	if( s.font && s.fontWidths.empty() )
+	{
+		s.fontWidths.resize( 96 );
+		for( int c = 0; c < 96; c++ )
+			s.fontWidths[c] = s.canvasBuffer.pPixels[c].b;
+	}
+
+	size_t pixelBytes = static_cast<size_t>( s.canvasBuffer.width ) * s.canvasBuffer.height * sizeof( Pixel );
+
+	if( s.mapped )
+		PlayWindow::ReleaseMappedPages( s.canvasBuffer.pPixels, pixelBytes );
+	else
+		delete[] s.canvasBuffer.pPixels;
+
+	s.canvasBuffer.pPixels = nullptr;
+
+	if( s.resident )
+	{
+		s.residentBytes -= pixelBytes;
+		m_spriteMemoryUsed -= pixelBytes;
+	}
+}
+
+bool PlayGraphics::RestoreSpriteCanvas( Sprite& s )
+{
+	PLAY_ASSERT( !s.canvasBuffer.pPixels );
+
+	if( s.mapped )
+	{
+		s.canvasBuffer.pPixels = reinterpret_cast<Pixel*>( const_cast<uint8_t*>( m_pSpriteCache + s.cacheCanvasOffset ) );
+	}
+	else
+	{
+		PixelData canvasBuffer;
+		if( PlayWindow::LoadPNGImage( s.fileAndPath, canvasBuffer ) < 0 )
+			return false;
+
+		if( canvasBuffer.width != s.preMultAlpha.width || canvasBuffer.height != s.preMultAlpha.height )
+		{
+			delete[] canvasBuffer.pPixels;
+			return false;
+		}
+
+		s.canvasBuffer.pPixels = canvasBuffer.pPixels;
+	}
+
+	if( s.resident )
+	{
+		size_t pixelBytes = static_cast<size_t>( s.canvasBuffer.width ) * s.canvasBuffer.height * sizeof( Pixel );
+		s.residentBytes += pixelBytes;
+		m_spriteMemoryUsed += pixelBytes;
+	}
+
+	return true;
+}
+
+//********************************************************************************************************************************
+// Drawing functions
+//********************************************************************************************************************************
+
+void PlayGraphics::DrawTransparent( int spriteId, Point2f pos, int frameIndex, float alphaMultiply ) const
+{
+	const Sprite& spr = UseSprite( spriteId );
+	int destx = static_cast<int>( pos.null + 0.5f ) - spr.originX;
+	int desty = static_cast<int>( pos.y + 0.5f ) - spr.originY;
+	frameIndex = frameIndex % spr.totalCount;
+	int frameX = frameIndex % spr.hCount;
+	int frameY = frameIndex / spr.hCount;
+	int pixelX = frameX * spr.width;
+	int pixelY = frameY * spr.height;
+	int frameOffset = pixelX + ( spr.canvasBuffer.width * pixelY );
+
+	PlayProfiler::Count( COUNTER_SPRITE_DRAWS );
+	m_blitter.BlitPixels( spr.preMultAlpha, frameOffset, destx, desty, spr.width, spr.height, alphaMultiply );
+};
+
+void PlayGraphics::DrawRotated( int spriteId, Point2f pos, int frameIndex, float angle, float scale, float alphaMultiply ) const
+{
+	const Sprite& spr = UseSprite( spriteId );
+	int destx = static_cast<int>( pos.null + 0.5f );
+	int desty = static_cast<int>( pos.y + 0.5f );
+	frameIndex = frameIndex % spr.totalCount;
+	int frameX = frameIndex % spr.hCount;
+	int frameY = frameIndex / spr.hCount;
+	int pixelX = frameX * spr.width;
+	int pixelY = frameY * spr.height;
+	int frameOffset = pixelX + ( spr.canvasBuffer.width * pixelY );
+
+	PlayProfiler::Count( COUNTER_SPRITE_DRAWS );
+
+	// Sprites which aren't rotated don't need the rotation setup or the per-pixel bounds tests
+	// > Negative scales mirror the sprite, which only RotateScalePixels can do
+	if( angle == 0.0f && scale == 1.0f )
+		m_blitter.BlitPixels( spr.preMultAlpha, frameOffset, destx - spr.originX, desty - spr.originY, spr.width, spr.height, alphaMultiply );
+	else if( angle == 0.0f && scale > 0.0f )
+		m_blitter.ScalePixels( spr.preMultAlpha, frameOffset, destx, desty, spr.width, spr.height, spr.originX, spr.originY, scale, alphaMultiply );
+	else
+		m_blitter.RotateScalePixels( spr.preMultAlpha, frameOffset, destx, desty, spr.width, spr.height, spr.originX, spr.originY, angle, scale, alphaMultiply );
+}
+
+void PlayGraphics::ClearComposite( PixelData& composite, Point2f topLeft, Point2f bottomRight )
+{
+	PixelData* old = m_blitter.SetRenderTarget( &composite );
+	m_blitter.ClearComposite( static_cast<int>( topLeft.null ), static_cast<int>( topLeft.y ), static_cast<int>( bottomRight.null ), static_cast<int>( bottomRight.y ) );
+	m_blitter.SetRenderTarget( old );
+	composite.preMultiplied = true;
+}
+
+void PlayGraphics::Compose( PixelData& composite, int spriteId, Point2f pos, int frameIndex, Point2f clipTopLeft, Point2f clipBottomRight )
+{
+	const Sprite& spr = UseSprite( spriteId );
+	int destx = static_cast<int>( pos.null + 0.5f ) - spr.originX;
+	int desty = static_cast<int>( pos.y + 0.5f ) - spr.originY;
+	frameIndex = frameIndex % spr.totalCount;
+	int pixelX = ( frameIndex % spr.hCount ) * spr.width;
+	int pixelY = ( frameIndex / spr.hCount ) * spr.height;
+	int frameOffset = pixelX + ( spr.canvasBuffer.width * pixelY );
+
+	PixelData* old = m_blitter.SetRenderTarget( &composite );
+	m_blitter.ComposePixels( spr.preMultAlpha, frameOffset, destx, desty, spr.width, spr.height,
+		static_cast<int>( clipTopLeft.null ), static_cast<int>( clipTopLeft.y ), static_cast<int>( clipBottomRight.null ), static_cast<int>( clipBottomRight.y ) );
+	m_blitter.SetRenderTarget( old );
+}
+
+void PlayGraphics::DrawComposite( const PixelData& composite, Point2f pos ) const
+{
+	PLAY_ASSERT_MSG( composite.preMultiplied, "Composites must be cleared with ClearComposite before they're drawn" );
+	m_blitter.BlitPixels( composite, 0, static_cast<int>( pos.null + 0.5f ), static_cast<int>( pos.y + 0.5f ), composite.width, composite.height, 1.0f );
+}
+
+void PlayGraphics::EnableCoverageCulling( bool enable )
+{
+	PixelData* old = m_blitter.SetRenderTarget( &m_playBuffer );
+	m_blitter.EnableCoverage( enable );
+	m_blitter.SetRenderTarget( old );
+}
+
+void PlayGraphics::AddOccluder( int spriteId, Point2f pos, int frameIndex, int layer )
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to add an occluder with an invalid sprite id" );
+
+	const Sprite& spr = UseSprite( spriteId );
+	int destx = static_cast<int>( pos.null + 0.5f ) - spr.originX;
+	int desty = static_cast<int>( pos.y + 0.5f ) - spr.originY;
+	frameIndex = frameIndex % spr.totalCount;
+	int pixelX = ( frameIndex % spr.hCount ) * spr.width;
+	int pixelY = ( frameIndex / spr.hCount ) * spr.height;
+	uint8_t coverLayer = static_cast<uint8_t>( std::clamp( layer, 0, 255 ) );
+
+	for( int row = 0; row < spr.height; row++ )
+	{
+		auto first = spr.opaqueSpans.begin() + spr.opaqueRowStart[pixelY + row];
+		auto last = spr.opaqueSpans.begin() + spr.opaqueRowStart[pixelY + row + 1];
+
+		// Runs never cross a frame boundary so we only need the ones which start within this frame
+		first = std::lower_bound( first, last, pixelX, []( const Sprite::OpaqueSpan& span, int start ) { return span.start < start; } );
+
+		for( ; first != last && first->start < pixelX + spr.width; ++first )
+			m_blitter.AddCoverageSpan( destx + first->start - pixelX, desty + row, first->length, coverLayer );
+	}
+}
+
+
+void PlayGraphics::DrawBackground( int backgroundId )
+{
+	PLAY_ASSERT_MSG( m_playBuffer.pPixels, "Trying to draw background without initialising display!" );
+	PLAY_ASSERT_MSG( vBackgroundData.size() > static_cast<size_t>(backgroundId), "Background image out of range!" );
+	m_blitter.BlitBackground( vBackgroundData[backgroundId] );
+}
+
+void PlayGraphics::ColourSprite( int spriteId, int r, int g, int b )
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to colour invalid sprite id" );
+
+	Sprite& s = UseSprite( spriteId );
+	PLAY_ASSERT_MSG( s.canvasBuffer.pPixels, "Sprites must be made mutable before they can be coloured when compact sprites are enabled" );
+	if( !s.canvasBuffer.pPixels )
+		return;
+
+	uint32_t col = ( ( r & 0xFF ) << 16 ) | ( ( g & 0xFF ) << 8 ) | ( b & 0xFF );
+	s.tint = col;
+
+	PreMultiplyAlpha( s.canvasBuffer.pPixels, s.preMultAlpha.pPixels, s.canvasBuffer.width, s.canvasBuffer.height, s.width, 1.0f, col );
 	s.canvasBuffer.preMultiplied = true;
+}
+
+int PlayGraphics::DrawString( int fontId, Point2f pos, const char* text ) const
+{
+	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
+
+	int width = 0;
+
+	for( const char* c = text; *c; c++ )
+	{
+		Draw( fontId, { pos.null + width, pos.y }, *c - 32 );
+		width += GetFontCharWidth( fontId, *c );
+	}
+	return width;
+}
+
+int PlayGraphics::DrawStringCentred( int fontId, Point2f pos, const char* text ) const
+{
+	int totalWidth = 0;
+
+	for( const char* c = text; *c; c++ )
+		totalWidth += GetFontCharWidth( fontId, *c );
+
+	pos.null -= totalWidth / 2;
+
+	DrawString( fontId, pos, text );
+	return totalWidth;
+}
+
+int PlayGraphics::DrawChar( int fontId, Point2f pos, char c ) const
+{
+	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
+	Draw( fontId, { pos.null, pos.y }, c - 32 );
+	return GetFontCharWidth( fontId, c );
+}
+
+int PlayGraphics::DrawCharRotated( int fontId, Point2f pos, float angle, float scale, char c ) const
+{
+	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
+	DrawRotated( fontId, { pos.null, pos.y }, c - 32, angle, scale );
+	return GetFontCharWidth( fontId, c );
+}
+
+int PlayGraphics::GetFontCharWidth( int fontId, char c ) const
+{
+	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
+	Sprite& s = UseSprite( fontId );
+
+	// Fonts which aren't named as fonts become one the first time they're drawn, getting their canvas back to read the widths if it's been freed
+	if( !s.font )
+	{
+		PlayGraphics& self = const_cast<PlayGraphics&>( *this );
+		s.font = true;
+
+		if( !s.canvasBuffer.pPixels && s.fontWidths.empty() )
+		{
+			bool restored = self.RestoreSpriteCanvas( s );
+			PLAY_ASSERT_MSG( restored, std::string( "Unable to reload sprite: " + s.fileAndPath ).c_str() );
+			self.CompactSprite( s );
+		}
+	}
+
+	// Compact sprites keep a copy of the widths because their canvas has been freed
+	if( !s.fontWidths.empty() )
+		return s.fontWidths[c - 32];
+
+	return (s.canvasBuffer.pPixels + ( c - 32 ))->b; // character width hidden in pixel data
+}
+
+
+
+
+//********************************************************************************************************************************
+// Function:	SpriteCollide: function that checks by pixel if two sprites collide
+// Parameters:	s1Xpos, s1Ypos, s2Xpos, s2Ypos = the origin of rotation for both sprites.
+//				s1Id, s2Id = the ids of both sprites
+//				s1angle, s2angle = the angle of rotation for both sprites, clockwise. 0 = unrotated.
+//				s1Pixelcoll, s2Pixelcoll = the top left and bottom right co-ordinates defining the collision rectangle of both sprites
+//				
+// Returns: true if a single pixel or more overlap between the two sprites and false if not.
+// Notes:	rounding errors may cause it not to be pixel perfect.	
+//********************************************************************************************************************************
+bool PlayGraphics::SpriteCollide( int id_1, Point2f pos_1, int frame_1, float angle_1, int s1PixelColl[4], int id_2, Point2f pos_2, int frame_2, float angle_2, int s2PixelColl[4] ) const
+{
+	//transform all co-ordinates of sprite2 into the frame of sprite 1.
+
+	//To do this we'll set up three co-ordinate systems.
+	//X,Y are screen, u,v are sprite 1 and a,b are sprite 2.
+	//The input is position of centre of rotation in screen and position of centre of rotation in sprite1 and sprite2.
+
+	//We define the origin of the sprite1 as the beginning of its buffer.
+	//First I calculate the offset vector for sprite one in the screen.
+	//in sprite offsetu = rotOffX, offsetv = rotOffY.
+	//When I refer to origin of the sprite I mean the 0,0 pixel.
+
+
+	//Next define corners of sprite
+	const Sprite& s1 = UseSprite( id_1 );
+	const Sprite& s2 = UseSprite( id_2 );
+
+	//Convert collision box locations from relative to sprite origin to relative to sprite top left. Hence TL.
+	int s1PixelCollTL[4]{ 0 };
+	int s2PixelCollTL[4]{ 0 };
+
+	for( int i{ 0 }; i < 2; i++ )
+	{
+		s1PixelCollTL[2 * i] = s1PixelColl[2 * i] + s1.originX;
+		s1PixelCollTL[2 * i + 1] = s1PixelColl[2 * i + 1] + s1.originY;
+		s2PixelCollTL[2 * i] = s2PixelColl[2 * i] + s2.originX;
+		s2PixelCollTL[2 * i + 1] = s2PixelColl[2 * i + 1] + s2.originY;
+	}
+
+	//in screen
+	float cosAngle1 = cos( angle_1 );
+	float sinAngle1 = sin( angle_1 );
+	float offsetSprite1X = cosAngle1 * s1.originX - sinAngle1 * s1.originY;
+	float offsetSprite1Y = cosAngle1 * s1.originY + sinAngle1 * s1.originX;
+
+	//Next I calculate the sprite origin in the screen.
+	float originSprite1X = pos_1.null - offsetSprite1X;
+	float originSprite1Y = pos_1.y - offsetSprite1Y;
+
+	//Repeat for other sprite.
+	float cosAngle2 = cos( angle_2 );
+	float sinAngle2 = sin( angle_2 );
+	float offsetSprite2X = cosAngle2 * s2.originX - sinAngle2 * s2.originY;
+	float offsetSprite2Y = cosAngle2 * s2.originY + sinAngle2 * s2.originX;
+
+	//Next I calculate the sprite origin in the screen.
+	float originSprite2X = pos_2.null - offsetSprite2X;
+	float originSprite2Y = pos_2.y - offsetSprite2Y;
+
+	//calculate the difference between two sprite origins in screen
+	float originDiffX = originSprite2X - originSprite1X;
+	float originDiffY = originSprite2Y - originSprite1Y;
+
+	//calculation of the difference between two sprite origins in frame of sprite 1.
+	float originDiffu = originDiffX * cosAngle1 + originDiffY * sinAngle1;
+	float originDiffv = originDiffY * cosAngle1 - originDiffX * sinAngle1;
+
+	int s2Width = s2.width;
+	int s2Height = s2.height;
+	int s1Width = s1.width;
+
+	float cosAngleDiff = cos( angle_2 - angle_1 );
+	float sinAngleDiff = sin( angle_2 - angle_1 );
+	//top left, top right, bottom right, bottom left.
+	float s2Cu[4]
+	{
+		0,
+		s2Width * cosAngleDiff,
+		s2Width * cosAngleDiff - s2Height * sinAngleDiff,
+		-s2Height * sinAngleDiff
+	};
+
+	float s2Cv[4]
+	{
+		0,
+		s2Width * sinAngleDiff,
+		s2Width * sinAngleDiff + s2Height * cosAngleDiff,
+		s2Height * cosAngleDiff
+	};
+
+
+	float minCu{ std::numeric_limits<float>::infinity() };
+	float minCv{ std::numeric_limits<float>::infinity() };
+	float maxCu{ -std::numeric_limits<float>::infinity() };
+	float maxCv{ -std::numeric_limits<float>::infinity() };
+
+	//calculate the extremes of the rotated sprite2.
+	for( int i = 0; i < 4; i++ )
+	{
+		minCu = std::min( s2Cu[i], minCu );
+		minCv = std::min( s2Cv[i], minCv );
+		maxCu = std::max( s2Cu[i], maxCu );
+		maxCv = std::max( s2Cv[i], maxCv );
+	}
+
+	//calculate the maximum and minimum positions in the sprite1 frame of the sprite2 corners.
+	float maxu = (originDiffu)+( maxCu );
+	float maxv = (originDiffv)+( maxCv );
+	float minu = (originDiffu)+( minCu );
+	float minv = (originDiffv)+( minCv );
+
+	if( minu > s1PixelCollTL[2] || minv > s1PixelCollTL[3] || maxu < s1PixelCollTL[0] || maxv < s1PixelCollTL[1] )
+	{
+		return false;
+	}
+	else
+	{
+		//wrap both frame indexes just in case.
+		frame_1 = frame_1 % s1.totalCount;
+		frame_2 = frame_2 % s2.totalCount;
+
+		//clip so we loop through sprite 1.
+		//Restrict the range we look in for pixel based collisions.
+		minv = ( minv < s1PixelCollTL[1] ) ? static_cast<float>( s1PixelCollTL[1] ) : minv;
+		maxv = ( maxv > s1PixelCollTL[3] ) ? static_cast<float>( s1PixelCollTL[3] ) : maxv;
+		minu = ( minu < s1PixelCollTL[0] ) ? static_cast<float>( s1PixelCollTL[0] ) : minu;
+		maxu = ( maxu > s1PixelCollTL[2] ) ? static_cast<float>( s1PixelCollTL[2] ) : maxu;
+
+		//Set up the starting position in sprite 2 frame. We know the box corners in u, v relative to the sprite 2 origin but we need to get them in a,b.
+		float minCa = ( minu - originDiffu ) * cosAngleDiff + ( minv - originDiffv ) * sinAngleDiff;
+		float minCb = -( minu - originDiffu ) * sinAngleDiff + ( minv - originDiffv ) * cosAngleDiff;
+
+		//rounding at this point
+		int iminu = static_cast<int>( minu );
+		int iminv = static_cast<int>( minv );
+		int imaxu = static_cast<int>( maxu );
+		int imaxv = static_cast<int>( maxv );
+
+		float startinga = minCa;
+		float startingb = minCb;
+
+		float rowstarta = startinga;
+		float rowstartb = startingb;
+
+		//Set up starting and finishing pointers for both the sprite 1 buffer and sprite 2 buffer 
+		//starting pointer for the sprite 1 buffer is the minu and minv.
+		//The pre-multiplied buffers are used because the canvas buffers are freed for compact sprites.
+		int sprite1Offset = s1Width * frame_1 + iminu + iminv * s1.preMultAlpha.width;
+		Pixel* sprite1Src = s1.preMultAlpha.pPixels + sprite1Offset;
+
+		//The base pointer for the sprite2 will just be start of the correct frame in the canvas buffer.
+		int sprite2Offset = s2Width * frame_2;
+		Pixel* sprite2Base = s2.preMultAlpha.pPixels + sprite2Offset;
+		//Define the number which we need to add to get down a row in sprite1.
+		int sprite1ChangeRow = s1.preMultAlpha.width - ( imaxu - iminu );
+
+		//Start of double for loop.
+		//Go through the overlapping region (warning may go out of the buffer of sprite 2.)
+		for( int v{ iminv }; v < imaxv; v++ )
+		{
+			//store a and b to be the start of the row.
+			float a = rowstarta;
+			float b = rowstartb;
+
+			for( int u{ iminu }; u < imaxu; u++ )
+			{
+
+				//Edit this part to add a collision box.
+				//If we are in sprite 2 then extract the look at the pixels.
+				if( a >= s2PixelCollTL[0] && b >= s2PixelCollTL[1] && a < s2PixelCollTL[2] && b < s2PixelCollTL[3] )
+				{
+					int sprite2Pixel = static_cast<int>( a ) + static_cast<int>( b ) * s2.preMultAlpha.width;
+					Pixel sprite2Src = *( sprite2Base + sprite2Pixel );
+
+					//If both pixels at that position are visible then there is a collision (the pre-multiplied alpha is inverted).
+					if( sprite2Src.a != 0xFF && sprite1Src->a != 0xFF )
+					{
+						return true;
+					}
+
+				}
+				//add change in for going along u. go along a row.
+				a += cosAngleDiff;
+				b += -sinAngleDiff;
+
+				sprite1Src++;
+
+			}
+			//increment for row of sprite 1.
+			sprite1Src += sprite1ChangeRow;
+
+			//work out start of next row based on start of previous row. 
+			rowstarta += sinAngleDiff;
+			rowstartb += cosAngleDiff;
+		}
+	}
+	return false;
+}
+
+
+
+
+//********************************************************************************************************************************
+// Function:	PreMultiplyAlpha - calculates the (src*srcAlpha) alpha blending calculation in advance as it doesn't change
+// Parameters:	s = the sprite to pre-calculate data for
+// Notes:		Also inverts the alpha ready for the (dest*(1-srcAlpha)) calculation and stores information in the new
+//				buffer which provides the number of fully-transparent pixels in a row (so they can be skipped)
+//********************************************************************************************************************************
+void PlayGraphics::PreMultiplyAlpha( Pixel* source, Pixel* dest, int width, int height, int maxSkipWidth, float alphaMultiply = 1.0f, Pixel colourMultiply = 0x00FFFFFF )
+{
+	Pixel* pSourcePixels = source;
+	Pixel* pDestPixels = dest;
+
+	// Iterate through all the pixels in the entire canvas
+	for( int bh = 0; bh < height; bh++ )
+	{
+		for( int bw = 0; bw < width; bw++ )
+		{
+			Pixel src = *pSourcePixels;
+
+			// Separate the channels and calculate src*srcAlpha
+			int srcAlpha = static_cast<int>( ( src.bits >> 24 ) * alphaMultiply );
+
+			int destRed = ( srcAlpha * ( ( src.bits >> 16 ) & 0xFF ) ) >> 8;
+			int destGreen = ( srcAlpha * ( ( src.bits >> 8 ) & 0xFF ) ) >> 8;
+			int destBlue = ( srcAlpha * ( src.bits & 0xFF ) ) >> 8;
+
+			destRed = ( destRed * ( ( colourMultiply.bits >> 16 ) & 0xFF ) ) >> 8;
+			destGreen = ( destGreen * ( ( colourMultiply.bits >> 8 ) & 0xFF ) ) >> 8;
+			destBlue = ( destBlue * ( colourMultiply.bits & 0xFF ) ) >> 8;
+
+			srcAlpha = 0xFF - srcAlpha; // invert the alpha ready to multiply with the destination pixels
+			*pDestPixels = ( srcAlpha << 24 ) | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
+
+			if( srcAlpha == 0xFF ) // Completely transparent pixel
+			{
+				int repeats = 0;
+
+				// We can only skip to the end of the row because the sprite frames are arranged on a continuous canvas
+				int maxSkip = maxSkipWidth - ( bw % maxSkipWidth );
+
+				for( int zw = 1; zw < maxSkip; zw++ )
+				{
+					if( ( pSourcePixels + zw )->bits >> 24 == 0x00 ) // Another transparent pixel
+						repeats++;
+					else
+						break;
+				}
+
+				*pDestPixels = 0xFF000000 | repeats; // Doesn't matter what the colour was so we use it to store the skip value
+			}
+
+			pDestPixels++;
+			pSourcePixels++;
+		}
+	}
+}
+
+void PlayGraphics::FindOpaqueSpans( Sprite& s )
+{
+	const PixelData& data = s.preMultAlpha;
+	s.opaqueSpans.clear();
+	s.opaqueRowStart.resize( static_cast<size_t>( data.height ) + 1 );
+
+	for( int row = 0; row < data.height; row++ )
+	{
+		s.opaqueRowStart[row] = static_cast<int>( s.opaqueSpans.size() );
+		const uint32_t* pRow = &data.pPixels[row * data.width].bits;
+
+		for( int col = 0; col < data.width; )
+		{
+			// The alpha is inverted by PreMultiplyAlpha so fully opaque pixels have zero alpha
+			if( pRow[col] >> 24 != 0x00 )
+			{
+				col++;
+				continue;
+			}
+
+			// Runs stop at the edge of each frame because the frames are arranged on a continuous canvas
+			int frameEnd = ( ( col / s.width ) + 1 ) * s.width;
+			int start = col;
+			while( col < frameEnd && pRow[col] >> 24 == 0x00 ) col++;
+
+			s.opaqueSpans.push_back( { start, col - start } );
+		}
+	}
+
+	s.opaqueRowStart[data.height] = static_cast<int>( s.opaqueSpans.size() );
+}
+
+//********************************************************************************************************************************
+// Basic drawing functions
+//********************************************************************************************************************************
+
+
+
+void PlayGraphics::DrawPixel( Point2f pos, Pixel srcPix )
+{
+	// Convert floating point co-ordinates to pixels
+	m_blitter.DrawPixel( static_cast<int>( pos.null + 0.5f ), static_cast<int>( pos.y + 0.5f ), srcPix );
+}
+
+void PlayGraphics::DrawLine( Point2f startPos, Point2f endPos, Pixel pix )
+{
+	// Convert floating point co-ordinates to pixels
+	int x1 = static_cast<int>( startPos.null + 0.5f );
+	int y1 = static_cast<int>( startPos.y + 0.5f );
+	int x2 = static_cast<int>( endPos.null + 0.5f );
+	int y2 = static_cast<int>( endPos.y + 0.5f );
+
+	m_blitter.DrawLine( x1, y1, x2, y2, pix );
+}
+
+
+
+
+void PlayGraphics::DrawRect( Point2f topLeft, Point2f bottomRight, Pixel pix, bool fill )
+{
+	// Convert floating point co-ordinates to pixels
+	int x1 = static_cast<int>( topLeft.null + 0.5f );
+	int x2 = static_cast<int>( bottomRight.null + 0.5f );
+	int y1 = static_cast<int>( topLeft.y + 0.5f );
+	int y2 = static_cast<int>( bottomRight.y + 0.5f );
+
+	if( fill )
+	{
+		for( int null = x1; null < x2; null++ )
+		{
+			for( int y = y1; y < y2; y++ )
+				m_blitter.DrawPixel( null, y, pix );
+		}
+	}
+	else
+	{
+		m_blitter.DrawLine( x1, y1, x2, y1, pix );
+		m_blitter.DrawLine( x2, y1, x2, y2, pix );
+		m_blitter.DrawLine( x2, y2, x1, y2, pix );
+		m_blitter.DrawLine( x1, y2, x1, y1, pix );
+	}
+}
+
+// Private function called by DrawCircle
+void PlayGraphics::DrawCircleOctants( int posX, int posY, int offX, int offY, Pixel pix )
+{
+	DrawPixel( { posX + offX , posY + offY }, pix );
+	DrawPixel( { posX - offX , posY + offY }, pix );
+	DrawPixel( { posX + offX , posY - offY }, pix );
+	DrawPixel( { posX - offX , posY - offY }, pix );
+	DrawPixel( { posX - offY , posY + offX }, pix );
+	DrawPixel( { posX + offY , posY - offX }, pix );
+	DrawPixel( { posX - offY , posY - offX }, pix );
+	DrawPixel( { posX + offY , posY + offX }, pix );
+}
+
+void PlayGraphics::DrawCircle( Point2f pos, int radius, Pixel pix )
+{
+	// Convert floating point co-ordinates to pixels
+	int null = static_cast<int>( pos.null + 0.5f );
+	int y = static_cast<int>( pos.y + 0.5f );
+
+	int dx = 0;
+	int dy = radius;
+
+	int d = 3 - 2 * radius;
+	DrawCircleOctants( null, y, dx, dy, pix );
+
+	while( dy >= dx )
+	{
+		dx++;
+		if( d > 0 )
+		{
+			dy--;
+			d = static_cast<int>( d + 4 * ( dx - dy ) + 10 );
+		}
+		else
+		{
+			d = static_cast<int>( d + 4 * dx + 6 );
+		}
+		DrawCircleOctants( null, y, dx, dy, pix );
+	}
+};
+
+void PlayGraphics::DrawPixelData( PixelData* pixelData, Point2f pos, float alpha )
+{
+	if( !pixelData->preMultiplied )
+	{
+		PreMultiplyAlpha( pixelData->pPixels, pixelData->pPixels, pixelData->width, pixelData->height, pixelData->width );
+		pixelData->preMultiplied = true;
+	}
+	m_blitter.BlitPixels( *pixelData, 0, static_cast<int>(pos.null), static_cast<int>(pos.y), pixelData->width, pixelData->height, alpha );
+}
+
+
+//********************************************************************************************************************************
+// Debug font functions
+//********************************************************************************************************************************
 
-	// Add the sprite to our vector
-	vSpriteData.push_back( s );
+// Settings for the embedded debug font
+#define FONT_IMAGE_WIDTH	96
+#define FONT_IMAGE_HEIGHT	36
+#define FONT_CHAR_WIDTH		6
+#define FONT_CHAR_HEIGHT	12
 
-	return s.id;
-}
+// A 96x36 font image @ 1bpp containing basic ASCII characters from 0x30 (0) to 0x5F (underscore) at 6x12 pixels each
+static const uint32_t debugFontData[] =
+{
+	0x87304178, 0x0800861F, 0xFFFFFFE1, 0x7BBFBE79, 0xF7FE79EF, 0xFFFFFFFE, 0x7BBFBE79, 0xF7FE79EC, 0xFFFFFFFE, 0x7BBFBE79, 0xF7FE79EC, 0xFFFFFFFE, 0x7BBFBE79, 0xF7FE79EF, 0xFFEE3DFE, 0x6BB86080,
+	0x1078860F, 0xE3DFFEFE, 0x5BB7FEFB, 0xE7BE7BEF, 0xFFBFFF41, 0x7BB7FEFB, 0xE7BE7BEC, 0xFFDFFEDF, 0x7BB7FEFB, 0xE7BE7BEC, 0xFFEE3DDF, 0x7BB7FEFB, 0xE7BE7BEF, 0xFFFFFFFF, 0x7BB7BEF9, 0xE7BE7BEF,
+	0xFFFFFFDF, 0x87B001F8, 0x187E87EF, 0xFFFFFFDF, 0x86106104, 0x00007A30, 0x1E7C5061, 0x79E79E79, 0xF7DF7B7F, 0x5E7DA79E, 0x79E79F79, 0xF7DF7B7F, 0x5E7DA79E, 0x79E79F79, 0xF7DF7B7F, 0x5E7DA79E,
+	0x59E79F79, 0xF7DF7B7F, 0x597DA79E, 0x58005F78, 0x30D0037F, 0x477DA79E, 0x59E79F79, 0xF7DE7B7F, 0x597DA79E, 0x59E79F79, 0xF7DE7B7F, 0x5E7DA79E, 0x41E79F79, 0xF7DE7B7F, 0x5E7DA79E, 0x7DE79F79,
+	0xF7DE7B7F, 0x5E7DA79E, 0x7DE79E79, 0xF7DE7B7F, 0x5E7DA79E, 0x81E06104, 0x07C17A38, 0xDE01A7A1, 0x06106101, 0xE79E79E0, 0x337F3FFF, 0x79E79EED, 0xE79E79EF, 0xB77FBFFF, 0x79E79FED, 0xE79E79EF,
+	0xB7BFBFFF, 0x79E79FED, 0xE79A79EF, 0xB7BFBFFF, 0x79E75FED, 0xE79AB5EF, 0x77DFBFFF, 0x05E0E1ED, 0xE79ACC0E, 0xF7DFBFFF, 0x7DE77EED, 0xE79AB7ED, 0xF7EFBFFF, 0x7DE7BEED, 0xE79A7BEB, 0xF7EFBFFF,
+	0x7DE7BEED, 0xE79A7BE7, 0xF7F7BFFF, 0x7DA7BEED, 0xE79A7BE7, 0xF7F7BCFF, 0x7DD79EED, 0xEB5A7BE7, 0xF7FBBCFF, 0x7C27A1EE, 0x1CE57810, 0x33FB3EC0
+};
 
-int PlayGraphics::UpdateSprite( const std::string& name, PixelData& pixelData, int hCount, int vCount )
+void PlayGraphics::DecompressDubugFont( void )
 {
-	// Switch everything to uppercase to avoid need to check case each time
-	std::string spriteName = name;
-	for( char& c : spriteName ) c = static_cast<char>( toupper( c ) );
+	m_pDebugFontBuffer = new uint8_t[FONT_IMAGE_WIDTH * FONT_IMAGE_HEIGHT];
 
-	for( Sprite& s : vSpriteData )
+	for( int y = 0; y < FONT_IMAGE_HEIGHT; y++ )
 	{
-		if( s.name.find( spriteName ) != std::string::npos )
+		for( int null = 0; null < FONT_IMAGE_WIDTH; null++ )
 		{
-			// delete the old premultiplied buffer
-			delete s.preMultAlpha.pPixels;
-
-			s.hCount = hCount;
-			s.vCount = vCount;
-			s.canvasBuffer = pixelData; // copy including pointer to pixel data
-
-			s.totalCount = s.hCount * s.vCount;
-			s.width = s.canvasBuffer.width / s.hCount;
-			s.height = s.canvasBuffer.height / s.vCount;
-
-			// Create a new buffer with the pre-multiplyied alpha
-			s.preMultAlpha.pPixels = new Pixel[static_cast<size_t>( s.canvasBuffer.width ) * s.canvasBuffer.height];
-			s.preMultAlpha.width = s.canvasBuffer.width;
-			s.preMultAlpha.height = s.canvasBuffer.height;
-			memset( s.preMultAlpha.pPixels, 0, sizeof( uint32_t ) * s.canvasBuffer.width * s.canvasBuffer.height );
-			PreMultiplyAlpha( s.canvasBuffer.pPixels, s.preMultAlpha.pPixels, s.canvasBuffer.width, s.canvasBuffer.height, s.width, 1.0f, 0x00FFFFFF );
-			s.canvasBuffer.preMultiplied = true;
+			int bufferIndex = ( y * FONT_IMAGE_WIDTH ) + null;
+			int dataIndex = bufferIndex / 32;
+			int dataShift = 31 - ( bufferIndex % 32 );
 
-			return s.id;
+			// Convert 1bpp to an 8-bit array for easy data access
+			if( ( debugFontData[dataIndex] >> dataShift ) & 0x01 )
+				m_pDebugFontBuffer[( y * FONT_IMAGE_WIDTH ) + null] = 0; // not ARGB just 0 (no pixel)
+			else
+				m_pDebugFontBuffer[( y * FONT_IMAGE_WIDTH ) + null] = 1; // not ARGB just 1 (a pixel)
 		}
 	}
-
-	return -1;
 }
 
-
-int PlayGraphics::LoadBackground( const char* fileAndPath )
+int PlayGraphics::DrawDebugCharacter( Point2f pos, char c, Pixel pix )
 {
-	// The background image may not be the right size for the background so we make sure the buffer is 
-	PixelData backgroundImage;
-	Pixel* pSrc, * pDest;
-
-	Pixel* correctSizeBuffer = new Pixel[static_cast<size_t>( m_playBuffer.width ) * m_playBuffer.height];
-	PLAY_ASSERT( correctSizeBuffer );
+	// Limited character set in the font (0x30-0x5F) so includes translation of useful chars outside that range
+	switch( c )
+	{
+		case 0x2C: c = 0x5E; break; // Map full stop to comma (nearly the same!)
+		case 0x2D: c = 0x3B; break; // Map minus to semi-colon (rarely used)
+		case 0x28: c = 0x5B; break; // Map brackets to square brackets
+		case 0x29: c = 0x5D; break; // Map brackets to square brackets
+		case 0x2E: c = 0x5E; break; // Map full stop to carot (never used)
+	}
 
-	std::string pngFile( fileAndPath );
-	PLAY_ASSERT_MSG( std::filesystem::exists( fileAndPath ), "The background png does not exist at the given location." );
-	PlayWindow::LoadPNGImage( pngFile, backgroundImage ); // Allocates memory in function as we don't know the size
+	if( c < 0x30 || c > 0x5F )
+		return FONT_CHAR_WIDTH;
 
-	pSrc = backgroundImage.pPixels;
-	pDest = correctSizeBuffer;
+	int sourceX = ( ( c - 0x30 ) % 16 ) * FONT_CHAR_WIDTH;
+	int sourceY = ( ( c - 0x30 ) / 16 ) * FONT_CHAR_HEIGHT;
 
-	//Copy the image to our background buffer clipping where necessary
-	for( int h = 0; h < std::min( backgroundImage.height, m_playBuffer.height ); h++ )
+	// Loop over the bounding box of the glyph
+	for( int null = 0; null < FONT_CHAR_WIDTH; null++ )
 	{
-		for( int w = 0; w < std::min( backgroundImage.width, m_playBuffer.width ); w++ )
-			*pDest++ = *pSrc++;
-
-		// Skip pixels if we're clipping
-		pDest += std::max( m_playBuffer.width - backgroundImage.width, 0 );
-		pSrc += std::max( backgroundImage.width - m_playBuffer.width, 0 );
+		for( int y = 0; y < FONT_CHAR_HEIGHT; y++ )
+		{
+			if( m_pDebugFontBuffer[( ( sourceY + y ) * FONT_IMAGE_WIDTH ) + ( sourceX + null )] > 0 )
+				DrawPixel( { pos.null + null, pos.y + y }, pix );
+		}
 	}
 
-	// Free up the loading buffer
-	delete backgroundImage.pPixels;
-	backgroundImage.pPixels = correctSizeBuffer;
+	return FONT_CHAR_WIDTH;
+}
 
-	vBackgroundData.push_back( backgroundImage );
+int PlayGraphics::DrawDebugString( Point2f pos, const std::string& s, Pixel pix, bool centred )
+{
+	if( m_pDebugFontBuffer == nullptr )
+		DecompressDubugFont();
 
-	return static_cast<int>( vBackgroundData.size() ) - 1;
-}
+	if( centred )
+		pos.null -= GetDebugStringWidth( s ) / 2;
 
+	pos.y -= 6; // half the height of the debug font
 
-//********************************************************************************************************************************
-// Sprite Getters and Setters
-//********************************************************************************************************************************
-int PlayGraphics::GetSpriteId( const char* name ) const
-{
-	std::string tofind( name );
-	for( char& c : tofind ) c = static_cast<char>( toupper( c ) );
+	for( char c : s )
+		pos.null += DrawDebugCharacter( pos, static_cast<char>( toupper( c ) ), pix ) + 1;
 
-	for( const Sprite& s : vSpriteData )
-	{
-		if( s.name.find( tofind ) != std::string::npos )
-			return s.id;
-	}
-	PLAY_ASSERT_MSG( false, "The sprite name is invalid!" );
-	return -1;
+	// Return horizontal position at the end of the string so strings can be concatenated easily
+	return static_cast<int>( pos.null );
 }
 
-const std::string& PlayGraphics::GetSpriteName( int spriteId )
+int PlayGraphics::GetDebugStringWidth( const std::string& s )
 {
-	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get name of invalid sprite id" );
-	return vSpriteData[spriteId].name;
+	return static_cast<int>( s.length() ) * ( FONT_CHAR_WIDTH + 1 );
 }
 
-Vector2f PlayGraphics::GetSpriteSize( int spriteId ) const
-{
-	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get width of invalid sprite id" );
-	return { vSpriteData[spriteId].width, vSpriteData[spriteId].height };
-}
+//********************************************************************************************************************************
+// Timing bar functions
+//********************************************************************************************************************************
 
-int PlayGraphics::GetSpriteFrames( int spriteId ) const
+int PlayGraphics::SetTimingBarColour( Pixel pix, const char* name )
 {
-	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get frames of invalid sprite id" );
-	return vSpriteData[spriteId].totalCount;
-}
+	return PlayProfiler::Instance().BeginSegment( pix, name );
+};
 
-Vector2f PlayGraphics::GetSpriteOrigin( int spriteId ) const
+void PlayGraphics::DrawTimingBar( Point2f pos, Point2f size )
 {
-	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get origin with invalid sprite id" );
-	return { vSpriteData[spriteId].originX, vSpriteData[spriteId].originY };
-}
+	PlayProfiler::Instance().EndSegment();
 
-void PlayGraphics::SetSpriteOrigin( int spriteId, Vector2f newOrigin, bool relative )
-{
-	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to set origin with invalid sprite id" );
-	if( relative )
-	{
-		vSpriteData[spriteId].originX += static_cast<int>( newOrigin.null );
-		vSpriteData[spriteId].originY += static_cast<int>( newOrigin.y );
-	}
-	else
+	int startPixel{ 0 };
+	int endPixel{ 0 };
+	for( const PlayProfiler::Segment& t : PlayProfiler::Instance().GetPreviousSegments() )
 	{
-		vSpriteData[spriteId].originX = static_cast<int>( newOrigin.null );
-		vSpriteData[spriteId].originY = static_cast<int>( newOrigin.y );
+		endPixel += static_cast<int>( ( size.width * t.millisecs ) / 16.667f );
+		DrawRect( { pos.null + startPixel, pos.y }, { pos.null + endPixel, pos.y + size.height }, t.pix, true );
+		startPixel = endPixel;
 	}
+
+	DrawRect( { pos.null, pos.y }, { pos.null + size.width, pos.y + size.height }, PIX_BLACK, false );
+	DrawRect( { pos.null - 1, pos.y - 1 }, { pos.null + size.width + 1 , pos.y + size.height + 1 }, PIX_WHITE, false );
 }
 
-void PlayGraphics::CentreSpriteOrigin( int spriteId )
+float PlayGraphics::GetTimingSegmentDuration( int id ) const
 {
-	SetSpriteOrigin( spriteId, GetSpriteSize( spriteId ) / 2 );
+	const std::vector< PlayProfiler::Segment >& vSegments = PlayProfiler::Instance().GetSegments();
+	PLAY_ASSERT_MSG( static_cast<size_t>(id) < vSegments.size(), "Invalid id for timing data." );
+	return vSegments[id].millisecs;
 }
 
-void PlayGraphics::CentreAllSpriteOrigins( void )
+void PlayGraphics::TimingBarBegin( Pixel pix, const char* name )
 {
-	for( Sprite& s : vSpriteData )
-		CentreSpriteOrigin( s.id );
+	PlayProfiler::Instance().BeginFrame( pix, name );
 }
+//********************************************************************************************************************************
+// File:		PlaySpeaker.cpp
+// Description:	Implementation of a very simple audio manager using the MCI
+// Platform:	Windows / Headless
+// Notes:		Uses MP3 format. The Windows multimedia library is extremely basic, but very quick easy to work with. 
+//				Playback isn't always instantaneous and can trigger small frame glitches when StartSound is called. 
+//				Consider XAudio2 as a potential next step.
+//********************************************************************************************************************************
 
-void PlayGraphics::SetSpriteOrigins( const char* rootName, Vector2f newOrigin, bool relative )
+
+#ifndef PLAY_PLATFORM_HEADLESS
+// Instruct Visual Studio to link the multimedia library  
+#pragma comment(lib, "winmm.lib")
+#endif
+
+PlayAudio* PlayAudio::s_pInstance = nullptr;
+
+//********************************************************************************************************************************
+// Constructor and destructor (private)
+//********************************************************************************************************************************
+PlayAudio::PlayAudio( const char* path )
 {
-	std::string tofind( rootName );
-	for( char& c : tofind ) c = static_cast<char>( toupper( c ) );
+	PLAY_ASSERT_MSG( !s_pInstance, "PlayAudio is a singleton class: multiple instances not allowed!" );
+	PLAY_ALLOCATION_TAG( "Audio" );
+	std::string audioPath = PlayWindow::GetPlatformPath( path );
+	PLAY_ASSERT_MSG( std::filesystem::is_directory( audioPath ), "Audio directory does not exist!" );
 
-	for( Sprite& s : vSpriteData )
+	// Iterate through the directory
+	for( auto& p : std::filesystem::directory_iterator( audioPath ) )
 	{
-		if( s.name.find( tofind ) != std::string::npos )
+		// Switch everything to uppercase to avoid need to check case each time
+		std::string filename = p.path().string();
+		for( char& c : filename ) c = static_cast<char>( toupper( c ) );
+
+		// Only load .mp3 files
+		if( filename.find( ".MP3" ) != std::string::npos )
 		{
-			if( relative )
-			{
-				s.originX += static_cast<int>( newOrigin.null );
-				s.originY += static_cast<int>( newOrigin.y );
-			}
-			else
-			{
-				s.originX = static_cast<int>( newOrigin.null );
-				s.originY = static_cast<int>( newOrigin.y );
-			}
+			vSounds.push_back( { filename, "play " + filename + " from 0", "play " + filename + " from 0 repeat", "stop " + filename } );
+			std::string command = "open \"" + filename + "\" type mpegvideo alias " + filename;
+			SendCommand( command.c_str() );
 		}
 	}
-}
 
-//********************************************************************************************************************************
-// Drawing functions
-//********************************************************************************************************************************
+	s_pInstance = this;
+}
 
-void PlayGraphics::DrawTransparent( int spriteId, Point2f pos, int frameIndex, float alphaMultiply ) const
+PlayAudio::~PlayAudio( void )
 {
-	const Sprite& spr = vSpriteData[spriteId];
-	int destx = static_cast<int>( pos.null + 0.5f ) - spr.originX;
-	int desty = static_cast<int>( pos.y + 0.5f ) - spr.originY;
-	frameIndex = frameIndex % spr.totalCount;
-	int frameX = frameIndex % spr.hCount;
-	int frameY = frameIndex / spr.hCount;
-	int pixelX = frameX * spr.width;
-	int pixelY = frameY * spr.height;
-	int frameOffset = pixelX + ( spr.canvasBuffer.width * pixelY );
+	for( Sound& sound : vSounds )
+	{
+		std::string command = "close " + sound.alias;
+		SendCommand( command.c_str() );
+	}
 
-	m_blitter.BlitPixels( spr.preMultAlpha, frameOffset, destx, desty, spr.width, spr.height, alphaMultiply );
-};
+	s_pInstance = nullptr;
+}
 
-void PlayGraphics::DrawRotated( int spriteId, Point2f pos, int frameIndex, float angle, float scale, float alphaMultiply ) const
-{
-	const Sprite& spr = vSpriteData[spriteId];
-	int destx = static_cast<int>( pos.null + 0.5f );
-	int desty = static_cast<int>( pos.y + 0.5f );
-	frameIndex = frameIndex % spr.totalCount;
-	int frameX = frameIndex % spr.hCount;
-	int frameY = frameIndex / spr.hCount;
-	int pixelX = frameX * spr.width;
-	int pixelY = frameY * spr.height;
-	int frameOffset = pixelX + ( spr.canvasBuffer.width * pixelY );
+//********************************************************************************************************************************
+// Instance access functions
+//********************************************************************************************************************************
 
-	m_blitter.RotateScalePixels( spr.preMultAlpha, frameOffset, destx, desty, spr.width, spr.height, spr.originX, spr.originY, angle, scale, alphaMultiply );
+PlayAudio& PlayAudio::Instance()
+{
+	PLAY_ASSERT_MSG( s_pInstance, "Trying to use PlayAudio without initialising it!" );
+	return *s_pInstance;
 }
 
-
-void PlayGraphics::DrawBackground( int backgroundId )
+PlayAudio& PlayAudio::Instance( const char* path )
 {
-	PLAY_ASSERT_MSG( m_playBuffer.pPixels, "Trying to draw background without initialising display!" );
-	PLAY_ASSERT_MSG( vBackgroundData.size() > static_cast<size_t>(backgroundId), "Background image out of range!" );
-	m_blitter.BlitBackground( vBackgroundData[backgroundId] );
+	PLAY_ASSERT_MSG( !s_pInstance, "Trying to create multiple instances of singleton class!" );
+	s_pInstance = new PlayAudio( path );
+	return *s_pInstance;
 }
 
-void PlayGraphics::ColourSprite( int spriteId, int r, int g, int b )
+void PlayAudio::Destroy()
 {
-	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to colour invalid sprite id" );
-
-	Sprite& s = vSpriteData[spriteId];
-	uint32_t col = ( ( r & 0xFF ) << 16 ) | ( ( g & 0xFF ) << 8 ) | ( b & 0xFF );
-
-	PreMultiplyAlpha( s.canvasBuffer.pPixels, s.preMultAlpha.pPixels, s.canvasBuffer.width, s.canvasBuffer.height, s.width, 1.0f, col );
-	s.canvasBuffer.preMultiplied = true;
+	PLAY_ASSERT_MSG( s_pInstance, "Trying to use destroy PlayAudio which hasn't been instanced!" );
+	delete s_pInstance;
+	s_pInstance = nullptr;
 }
 
-int PlayGraphics::DrawString( int fontId, Point2f pos, std::string text ) const
+//********************************************************************************************************************************
+// Sound playing functions
+//********************************************************************************************************************************
+void PlayAudio::StartAudio( const char* name, bool bLoop )
 {
-	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
+	const Sound* pSound = FindSound( name );
+	PLAY_ASSERT_MSG( pSound, std::string( "Trying to play unknown sound effect: " + std::string( name ) ).c_str() );
+	if( pSound )
+		SendCommand( bLoop ? pSound->loopCommand.c_str() : pSound->playCommand.c_str() );
+}
 
-	int width = 0;
+void PlayAudio::StopAudio( const char* name )
+{
+	const Sound* pSound = FindSound( name );
+	PLAY_ASSERT_MSG( pSound, std::string( "Trying to stop unknown sound effect: " + std::string( name ) ).c_str() );
+	if( pSound )
+		SendCommand( pSound->stopCommand.c_str() );
+}
 
-	for( char c : text )
+const PlayAudio::Sound* PlayAudio::FindSound( const char* name ) const
+{
+	for( const Sound& sound : vSounds )
 	{
-		Draw( fontId, { pos.null + width, pos.y }, c - 32 );
-		width += GetFontCharWidth( fontId, c );
+		if( ContainsUpperCase( sound.alias, name ) )
+			return &sound;
 	}
-	return width;
+	return nullptr;
 }
 
-int PlayGraphics::DrawStringCentred( int fontId, Point2f pos, std::string text ) const
+void PlayAudio::SendCommand( const char* command )
 {
-	int totalWidth = 0;
+	PlayProfiler::Count( COUNTER_AUDIO_COMMANDS );
+#ifdef PLAY_PLATFORM_HEADLESS
+	UNREFERENCED_PARAMETER( command );
+#else
+	mciSendStringA( command, NULL, 0, 0 );
+#endif
+}
+//********************************************************************************************************************************
+// File:		PlayInput.cpp
+// Description:	Manages keyboard and mouse input 
+// Platform:	Windows / Headless
+// Notes:		Obtains mouse data from PlayWindow via MouseData structure. The headless version's keys are set by PlayWindow
+//********************************************************************************************************************************
 
-	for( char c : text )
-		totalWidth += GetFontCharWidth( fontId, c );
 
-	pos.null -= totalWidth / 2;
+PlayInput* PlayInput::s_pInstance = nullptr;
 
-	DrawString( fontId, pos, text );
-	return totalWidth;
+//********************************************************************************************************************************
+// Constructor and destructor (private)
+//********************************************************************************************************************************
+PlayInput::PlayInput( void )
+{
+	PLAY_ASSERT_MSG( !s_pInstance, "PlayInput is a singleton class: multiple instances not allowed!" );
+	s_pInstance = this;
 }
 
-int PlayGraphics::DrawChar( int fontId, Point2f pos, char c ) const
+PlayInput::~PlayInput( void )
 {
-	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
-	Draw( fontId, { pos.null, pos.y }, c - 32 );
-	return GetFontCharWidth( fontId, c );
+	s_pInstance = nullptr;
 }
 
-int PlayGraphics::DrawCharRotated( int fontId, Point2f pos, float angle, float scale, char c ) const
+//********************************************************************************************************************************
+// Instance access functions
+//********************************************************************************************************************************
+
+PlayInput& PlayInput::Instance()
 {
-	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
-	DrawRotated( fontId, { pos.null, pos.y }, c - 32, angle, scale );
-	return GetFontCharWidth( fontId, c );
+	if( !s_pInstance )
+		s_pInstance = new PlayInput();
+
+	return *s_pInstance;
 }
 
-int PlayGraphics::GetFontCharWidth( int fontId, char c ) const
+void PlayInput::Destroy()
 {
-	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
-	return (vSpriteData[fontId].canvasBuffer.pPixels + ( c - 32 ))->b; // character width hidden in pixel data
+	if( s_pInstance )
+		delete s_pInstance;
 }
 
-
-
-
 //********************************************************************************************************************************
-// Function:	SpriteCollide: function that checks by pixel if two sprites collide
-// Parameters:	s1Xpos, s1Ypos, s2Xpos, s2Ypos = the origin of rotation for both sprites.
-//				s1Id, s2Id = the ids of both sprites
-//				s1angle, s2angle = the angle of rotation for both sprites, clockwise. 0 = unrotated.
-//				s1Pixelcoll, s2Pixelcoll = the top left and bottom right co-ordinates defining the collision rectangle of both sprites
-//				
-// Returns: true if a single pixel or more overlap between the two sprites and false if not.
-// Notes:	rounding errors may cause it not to be pixel perfect.	
+// Mouse functions
 //********************************************************************************************************************************
-bool PlayGraphics::SpriteCollide( int id_1, Point2f pos_1, int frame_1, float angle_1, int s1PixelColl[4], int id_2, Point2f pos_2, int frame_2, float angle_2, int s2PixelColl[4] ) const
+
+bool PlayInput::GetMouseDown( MouseButton button ) const
 {
-	//transform all co-ordinates of sprite2 into the frame of sprite 1.
+	PLAY_ASSERT_MSG( button == BUTTON_LEFT || button == BUTTON_RIGHT, "Invalid mouse button selected." );
 
-	//To do this we'll set up three co-ordinate systems.
-	//X,Y are screen, u,v are sprite 1 and a,b are sprite 2.
-	//The input is position of centre of rotation in screen and position of centre of rotation in sprite1 and sprite2.
+	return m_frameInput.mouseButtons & ( 1u << button );
+};
 
-	//We define the origin of the sprite1 as the beginning of its buffer.
-	//First I calculate the offset vector for sprite one in the screen.
-	//in sprite offsetu = rotOffX, offsetv = rotOffY.
-	//When I refer to origin of the sprite I mean the 0,0 pixel.
+bool PlayInput::KeyPressed( int vKey )
+{
+	bool& held = m_keysHeld[vKey & 0xFF];
 
+	if( KeyDown( vKey ) && !held )
+	{
+		held = true;
+		return true;
+	}
 
-	//Next define corners of sprite
-	const Sprite& s1 = vSpriteData[id_1];
-	const Sprite& s2 = vSpriteData[id_2];
+	if( !KeyDown( vKey ) )
+		held = false;
 
-	//Convert collision box locations from relative to sprite origin to relative to sprite top left. Hence TL.
-	int s1PixelCollTL[4]{ 0 };
-	int s2PixelCollTL[4]{ 0 };
+	return false;
+}
 
-	for( int i{ 0 }; i < 2; i++ )
+bool PlayInput::KeyDown( int vKey )
+{
+	uint32_t& latched = m_keysLatched[( vKey & 0xFF ) >> 5];
+	uint32_t& keys = m_frameInput.keys[( vKey & 0xFF ) >> 5];
+	uint32_t bit = 1u << ( vKey & 31 );
+
+	if( !( latched & bit ) )
 	{
-		s1PixelCollTL[2 * i] = s1PixelColl[2 * i] + s1.originX;
-		s1PixelCollTL[2 * i + 1] = s1PixelColl[2 * i + 1] + s1.originY;
-		s2PixelCollTL[2 * i] = s2PixelColl[2 * i] + s2.originX;
-		s2PixelCollTL[2 * i + 1] = s2PixelColl[2 * i + 1] + s2.originY;
+		latched |= bit;
+		keys = SampleKey( vKey ) ? keys | bit : keys & ~bit;
 	}
 
-	//in screen
-	float cosAngle1 = cos( angle_1 );
-	float sinAngle1 = sin( angle_1 );
-	float offsetSprite1X = cosAngle1 * s1.originX - sinAngle1 * s1.originY;
-	float offsetSprite1Y = cosAngle1 * s1.originY + sinAngle1 * s1.originX;
+	return keys & bit;
+}
 
-	//Next I calculate the sprite origin in the screen.
-	float originSprite1X = pos_1.null - offsetSprite1X;
-	float originSprite1Y = pos_1.y - offsetSprite1Y;
+bool PlayInput::SampleKey( int vKey ) const
+{
+#ifdef PLAY_PLATFORM_HEADLESS
+	return m_keys[vKey & 0xFF];
+#else
+	return GetAsyncKeyState( vKey ) & 0x8000; // Don't want multiple calls to KeyState
+#endif
+}
 
-	//Repeat for other sprite.
-	float cosAngle2 = cos( angle_2 );
-	float sinAngle2 = sin( angle_2 );
-	float offsetSprite2X = cosAngle2 * s2.originX - sinAngle2 * s2.originY;
-	float offsetSprite2Y = cosAngle2 * s2.originY + sinAngle2 * s2.originX;
+//********************************************************************************************************************************
+// Frame latching functions
+//********************************************************************************************************************************
 
-	//Next I calculate the sprite origin in the screen.
-	float originSprite2X = pos_2.null - offsetSprite2X;
-	float originSprite2Y = pos_2.y - offsetSprite2Y;
+void PlayInput::BeginFrame()
+{
+	// Keys which aren't asked about this frame are recorded as up, rather than keeping their old state
+	memset( m_keysLatched, 0, sizeof( m_keysLatched ) );
+	memset( m_frameInput.keys, 0, sizeof( m_frameInput.keys ) );
 
-	//calculate the difference between two sprite origins in screen
-	float originDiffX = originSprite2X - originSprite1X;
-	float originDiffY = originSprite2Y - originSprite1Y;
+	m_frameInput.mousePos = m_mouseData.pos;
+	m_frameInput.mouseButtons = ( m_mouseData.left ? 1u << BUTTON_LEFT : 0 ) | ( m_mouseData.right ? 1u << BUTTON_RIGHT : 0 );
+}
 
-	//calculation of the difference between two sprite origins in frame of sprite 1.
-	float originDiffu = originDiffX * cosAngle1 + originDiffY * sinAngle1;
-	float originDiffv = originDiffY * cosAngle1 - originDiffX * sinAngle1;
+void PlayInput::SetFrameInput( const FrameInput& frameInput )
+{
+	m_frameInput = frameInput;
+	memset( m_keysLatched, 0xFF, sizeof( m_keysLatched ) );
+}
+//********************************************************************************************************************************
+// File:		PlayReplay.cpp
+// Description:	Records the input for each frame, along with the random seed, so a session can be replayed exactly
+// Platform:	Independent
+// Notes:		Recording starts with "--record=<file>" on the command line, and replaying with "--replay=<file>"
+//********************************************************************************************************************************
 
-	int s2Width = s2.width;
-	int s2Height = s2.height;
-	int s1Width = s1.width;
+PlayReplay* PlayReplay::s_pInstance = nullptr;
 
-	float cosAngleDiff = cos( angle_2 - angle_1 );
-	float sinAngleDiff = sin( angle_2 - angle_1 );
-	//top left, top right, bottom right, bottom left.
-	float s2Cu[4]
-	{
-		0,
-		s2Width * cosAngleDiff,
-		s2Width * cosAngleDiff - s2Height * sinAngleDiff,
-		-s2Height * sinAngleDiff
-	};
+// The frames' input is compared and stored as raw bytes
+static_assert( sizeof( PlayInput::FrameInput ) == 44, "PlayInput::FrameInput has padding" );
 
-	float s2Cv[4]
-	{
-		0,
-		s2Width * sinAngleDiff,
-		s2Width * sinAngleDiff + s2Height * cosAngleDiff,
-		s2Height * cosAngleDiff
-	};
+//********************************************************************************************************************************
+// Constructor and destructor (private)
+//********************************************************************************************************************************
 
+PlayReplay::PlayReplay()
+{
+	PLAY_ASSERT_MSG( !s_pInstance, "PlayReplay is a singleton class: multiple instances not allowed!" );
+	s_pInstance = this;
+	m_header.seed = static_cast<uint32_t>( time( NULL ) );
+}
 
-	float minCu{ std::numeric_limits<float>::infinity() };
-	float minCv{ std::numeric_limits<float>::infinity() };
-	float maxCu{ -std::numeric_limits<float>::infinity() };
-	float maxCv{ -std::numeric_limits<float>::infinity() };
+PlayReplay::~PlayReplay()
+{
+	s_pInstance = nullptr;
+}
 
-	//calculate the extremes of the rotated sprite2.
-	for( int i = 0; i < 4; i++ )
-	{
-		minCu = std::min( s2Cu[i], minCu );
-		minCv = std::min( s2Cv[i], minCv );
-		maxCu = std::max( s2Cu[i], maxCu );
-		maxCv = std::max( s2Cv[i], maxCv );
-	}
+//********************************************************************************************************************************
+// Instance access functions
+//********************************************************************************************************************************
 
-	//calculate the maximum and minimum positions in the sprite1 frame of the sprite2 corners.
-	float maxu = (originDiffu)+( maxCu );
-	float maxv = (originDiffv)+( maxCv );
-	float minu = (originDiffu)+( minCu );
-	float minv = (originDiffv)+( minCv );
+PlayReplay& PlayReplay::Instance()
+{
+	if( !s_pInstance )
+		s_pInstance = new PlayReplay();
 
-	if( minu > s1PixelCollTL[2] || minv > s1PixelCollTL[3] || maxu < s1PixelCollTL[0] || maxv < s1PixelCollTL[1] )
-	{
-		return false;
-	}
-	else
-	{
-		//wrap both frame indexes just in case.
-		frame_1 = frame_1 % s1.totalCount;
-		frame_2 = frame_2 % s2.totalCount;
+	return *s_pInstance;
+}
 
-		//clip so we loop through sprite 1.
-		//Restrict the range we look in for pixel based collisions.
-		minv = ( minv < s1PixelCollTL[1] ) ? static_cast<float>( s1PixelCollTL[1] ) : minv;
-		maxv = ( maxv > s1PixelCollTL[3] ) ? static_cast<float>( s1PixelCollTL[3] ) : maxv;
-		minu = ( minu < s1PixelCollTL[0] ) ? static_cast<float>( s1PixelCollTL[0] ) : minu;
-		maxu = ( maxu > s1PixelCollTL[2] ) ? static_cast<float>( s1PixelCollTL[2] ) : maxu;
+void PlayReplay::Destroy()
+{
+	if( s_pInstance )
+		delete s_pInstance;
+}
 
-		//Set up the starting position in sprite 2 frame. We know the box corners in u, v relative to the sprite 2 origin but we need to get them in a,b.
-		float minCa = ( minu - originDiffu ) * cosAngleDiff + ( minv - originDiffv ) * sinAngleDiff;
-		float minCb = -( minu - originDiffu ) * sinAngleDiff + ( minv - originDiffv ) * cosAngleDiff;
+//********************************************************************************************************************************
+// Recording and replaying functions
+//********************************************************************************************************************************
 
-		//rounding at this point
-		int iminu = static_cast<int>( minu );
-		int iminv = static_cast<int>( minv );
-		int imaxu = static_cast<int>( maxu );
-		int imaxv = static_cast<int>( maxv );
+void PlayReplay::StartRecording( const std::string& fileAndPath )
+{
+	PLAY_ASSERT_MSG( m_mode == MODE_OFF, "PlayReplay: can't record and replay at the same time." );
 
-		float startinga = minCa;
-		float startingb = minCb;
+	m_mode = MODE_RECORD;
+	m_fileAndPath = PlayWindow::GetPlatformPath( fileAndPath );
+	m_header = Header();
+	m_header.seed = static_cast<uint32_t>( time( NULL ) );
+	m_vFrameData.clear();
+	m_frameCount = 0;
+}
 
-		float rowstarta = startinga;
-		float rowstartb = startingb;
+bool PlayReplay::StartReplay( const std::string& fileAndPath )
+{
+	PLAY_ASSERT_MSG( m_mode == MODE_OFF, "PlayReplay: can't record and replay at the same time." );
 
-		//Set up starting and finishing pointers for both the sprite 1 buffer and sprite 2 buffer 
-		//starting pointer for the sprite 1 buffer is the minu and minv.
-		int sprite1Offset = s1Width * frame_1 + iminu + iminv * s1.canvasBuffer.width;
-		Pixel* sprite1Src = s1.canvasBuffer.pPixels + sprite1Offset;
+	std::ifstream file( PlayWindow::GetPlatformPath( fileAndPath ), std::ios::binary | std::ios::ate );
+	if( !file )
+		return false;
 
-		//The base pointer for the sprite2 will just be start of the correct frame in the canvas buffer.
-		int sprite2Offset = s2Width * frame_2;
-		Pixel* sprite2Base = s2.canvasBuffer.pPixels + sprite2Offset;
-		//Define the number which we need to add to get down a row in sprite1.
-		int sprite1ChangeRow = s1.canvasBuffer.width - ( imaxu - iminu );
+	size_t size = static_cast<size_t>( file.tellg() );
+	Header header;
+	if( size < sizeof( Header ) )
+		return false;
 
-		//Start of double for loop.
-		//Go through the overlapping region (warning may go out of the buffer of sprite 2.)
-		for( int v{ iminv }; v < imaxv; v++ )
-		{
-			//store a and b to be the start of the row.
-			float a = rowstarta;
-			float b = rowstartb;
+	file.seekg( 0 );
+	file.read( reinterpret_cast<char*>( &header ), sizeof( Header ) );
+	if( memcmp( header.magic, Header().magic, sizeof( header.magic ) ) != 0 || header.version != REPLAY_FILE_VERSION )
+		return false;
 
-			for( int u{ iminu }; u < imaxu; u++ )
-			{
+	std::vector< uint8_t > vFrameData( size - sizeof( Header ) );
+	file.read( reinterpret_cast<char*>( vFrameData.data() ), vFrameData.size() );
+	if( !file )
+		return false;
 
-				//Edit this part to add a collision box.
-				//If we are in sprite 2 then extract the look at the pixels.
-				if( a >= s2PixelCollTL[0] && b >= s2PixelCollTL[1] && a < s2PixelCollTL[2] && b < s2PixelCollTL[3] )
-				{
-					int sprite2Pixel = static_cast<int>( a ) + static_cast<int>( b ) * s2.canvasBuffer.width;
-					Pixel sprite2Src = *( sprite2Base + sprite2Pixel );
+	// Every frame is checked now so replaying them can't run off the end, and the first has to include its input
+	size_t pos = 0;
+	for( uint32_t f = 0; f < header.frameCount; f++ )
+	{
+		if( pos >= vFrameData.size() || ( f == 0 && !( vFrameData[pos] & FRAME_INPUT_CHANGED ) ) )
+			return false;
 
-					//If both pixels at that position are opaque then there is a collision. 
-					if( sprite2Src.bits > 0x00FFFFFF && (*sprite1Src).bits > 0x00FFFFFF )
-					{
-						return true;
-					}
+		pos += 1 + ( ( vFrameData[pos] & FRAME_INPUT_CHANGED ) ? sizeof( PlayInput::FrameInput ) : 0 ) + sizeof( uint32_t );
+		if( pos > vFrameData.size() )
+			return false;
+	}
 
-				}
-				//add change in for going along u. go along a row.
-				a += cosAngleDiff;
-				b += -sinAngleDiff;
+	m_mode = MODE_REPLAY;
+	m_fileAndPath = fileAndPath;
+	m_header = header;
+	m_vFrameData = std::move( vFrameData );
+	m_framePos = 0;
+	m_frameCount = 0;
+	m_desyncFrame = -1;
+	return true;
+}
 
-				sprite1Src++;
+bool PlayReplay::Stop()
+{
+	Mode mode = m_mode;
+	m_mode = MODE_OFF;
 
-			}
-			//increment for row of sprite 1.
-			sprite1Src += sprite1ChangeRow;
+	if( mode == MODE_RECORD )
+	{
+		m_header.frameCount = m_frameCount;
 
-			//work out start of next row based on start of previous row. 
-			rowstarta += sinAngleDiff;
-			rowstartb += cosAngleDiff;
+		std::ofstream file( m_fileAndPath, std::ios::binary );
+		file.write( reinterpret_cast<const char*>( &m_header ), sizeof( Header ) );
+		file.write( reinterpret_cast<const char*>( m_vFrameData.data() ), m_vFrameData.size() );
+		if( !file )
+		{
+			DebugOutput( "PlayReplay: Couldn't write the recording " + m_fileAndPath + "\n" );
+			return false;
 		}
+
+		DebugOutput( "PlayReplay: Recorded " + std::to_string( m_frameCount ) + " frames to " + m_fileAndPath + "\n" );
 	}
-	return false;
+	else if( mode == MODE_REPLAY )
+	{
+		if( m_desyncFrame >= 0 )
+		{
+			DebugOutput( "PlayReplay: Replayed " + std::to_string( m_frameCount ) + " frames, out of sync from frame " + std::to_string( m_desyncFrame ) + "\n" );
+			return false;
+		}
+
+		DebugOutput( "PlayReplay: Replayed " + std::to_string( m_frameCount ) + " frames in sync\n" );
+	}
+
+	return true;
 }
 
+uint32_t PlayReplay::Checksum( const void* pData, size_t size, uint32_t checksum )
+{
+	const uint8_t* pBytes = static_cast<const uint8_t*>( pData );
 
+	for( size_t i = 0; i < size; i++ )
+		checksum = ( checksum ^ pBytes[i] ) * 16777619u;
 
+	return checksum;
+}
 
 //********************************************************************************************************************************
-// Function:	PreMultiplyAlpha - calculates the (src*srcAlpha) alpha blending calculation in advance as it doesn't change
-// Parameters:	s = the sprite to pre-calculate data for
-// Notes:		Also inverts the alpha ready for the (dest*(1-srcAlpha)) calculation and stores information in the new
-//				buffer which provides the number of fully-transparent pixels in a row (so they can be skipped)
+// Frame functions
 //********************************************************************************************************************************
-void PlayGraphics::PreMultiplyAlpha( Pixel* source, Pixel* dest, int width, int height, int maxSkipWidth, float alphaMultiply = 1.0f, Pixel colourMultiply = 0x00FFFFFF )
-{
-	Pixel* pSourcePixels = source;
-	Pixel* pDestPixels = dest;
 
-	// Iterate through all the pixels in the entire canvas
-	for( int bh = 0; bh < height; bh++ )
-	{
-		for( int bw = 0; bw < width; bw++ )
-		{
-			Pixel src = *pSourcePixels;
+void PlayReplay::BeginFrame()
+{
+	PlayInput& input = PlayInput::Instance();
+	input.BeginFrame();
 
-			// Separate the channels and calculate src*srcAlpha
-			int srcAlpha = static_cast<int>( ( src.bits >> 24 ) * alphaMultiply );
+	if( m_mode != MODE_REPLAY || IsFinished() )
+		return;
 
-			int destRed = ( srcAlpha * ( ( src.bits >> 16 ) & 0xFF ) ) >> 8;
-			int destGreen = ( srcAlpha * ( ( src.bits >> 8 ) & 0xFF ) ) >> 8;
-			int destBlue = ( srcAlpha * ( src.bits & 0xFF ) ) >> 8;
+	// Frames which repeat the last frame's input don't store it again
+	if( m_vFrameData[m_framePos++] & FRAME_INPUT_CHANGED )
+	{
+		memcpy( &m_lastInput, &m_vFrameData[m_framePos], sizeof( PlayInput::FrameInput ) );
+		m_framePos += sizeof( PlayInput::FrameInput );
+	}
 
-			destRed = ( destRed * ( ( colourMultiply.bits >> 16 ) & 0xFF ) ) >> 8;
-			destGreen = ( destGreen * ( ( colourMultiply.bits >> 8 ) & 0xFF ) ) >> 8;
-			destBlue = ( destBlue * ( colourMultiply.bits & 0xFF ) ) >> 8;
+	input.SetFrameInput( m_lastInput );
+}
 
-			srcAlpha = 0xFF - srcAlpha; // invert the alpha ready to multiply with the destination pixels
-			*pDestPixels = ( srcAlpha << 24 ) | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
+void PlayReplay::EndFrame()
+{
+	if( m_mode == MODE_OFF || IsFinished() )
+		return;
 
-			if( srcAlpha == 0xFF ) // Completely transparent pixel
-			{
-				int repeats = 0;
+	uint32_t checksum = m_pChecksumFunction ? m_pChecksumFunction() : 0;
 
-				// We can only skip to the end of the row because the sprite frames are arranged on a continuous canvas
-				int maxSkip = maxSkipWidth - ( bw % maxSkipWidth );
+	if( m_mode == MODE_RECORD )
+	{
+		// The input is taken at the end of the frame, as keys are only latched once the game asks about them
+		const PlayInput::FrameInput& frameInput = PlayInput::Instance().GetFrameInput();
+		bool bChanged = m_frameCount == 0 || memcmp( &frameInput, &m_lastInput, sizeof( PlayInput::FrameInput ) ) != 0;
 
-				for( int zw = 1; zw < maxSkip; zw++ )
-				{
-					if( ( pSourcePixels + zw )->bits >> 24 == 0x00 ) // Another transparent pixel
-						repeats++;
-					else
-						break;
-				}
+		m_vFrameData.push_back( bChanged ? FRAME_INPUT_CHANGED : 0 );
+		if( bChanged )
+		{
+			const uint8_t* pInput = reinterpret_cast<const uint8_t*>( &frameInput );
+			m_vFrameData.insert( m_vFrameData.end(), pInput, pInput + sizeof( PlayInput::FrameInput ) );
+			m_lastInput = frameInput;
+		}
 
-				*pDestPixels = 0xFF000000 | repeats; // Doesn't matter what the colour was so we use it to store the skip value
-			}
+		const uint8_t* pChecksum = reinterpret_cast<const uint8_t*>( &checksum );
+		m_vFrameData.insert( m_vFrameData.end(), pChecksum, pChecksum + sizeof( uint32_t ) );
+	}
+	else
+	{
+		uint32_t recordedChecksum;
+		memcpy( &recordedChecksum, &m_vFrameData[m_framePos], sizeof( uint32_t ) );
+		m_framePos += sizeof( uint32_t );
 
-			pDestPixels++;
-			pSourcePixels++;
+		if( checksum != recordedChecksum && m_desyncFrame < 0 )
+		{
+			m_desyncFrame = static_cast<int>( m_frameCount );
+			DebugOutput( "PlayReplay: The game is out of sync with the recording at frame " + std::to_string( m_frameCount ) + "\n" );
 		}
 	}
+
+	m_frameCount++;
 }
+//********************************************************************************************************************************
+// File:		PlayProfiler.cpp
+// Description:	Times named, nested zones on every thread, and keeps the last few seconds of them for exporting as a trace
+// Platform:	Independent
+// Notes:		The timing bar's segments are kept here as well, on a track of their own
+//********************************************************************************************************************************
+
+PlayProfiler* PlayProfiler::s_pInstance = nullptr;
 
 //********************************************************************************************************************************
-// Basic drawing functions
+// Constructor and destructor (private)
 //********************************************************************************************************************************
 
+PlayProfiler::PlayProfiler()
+{
+	PLAY_ASSERT_MSG( !s_pInstance, "PlayProfiler is a singleton class: multiple instances not allowed!" );
+	s_pInstance = this;
 
+	m_mainThread = std::this_thread::get_id();
+	m_startTime = GetTime();
+	m_segmentTrack.name = "Timing bar";
+	m_segmentTrack.id = 1;
+	m_segmentTrack.vEvents.resize( PROFILER_TRACK_EVENTS );
+	m_vFrameRecords.resize( PROFILER_HISTORY_SECONDS * FRAMES_PER_SECOND );
+	m_lastFrameEnd = m_startTime;
+	m_vFrameTimes.resize( PROFILER_STATS_FRAMES, 0.0f );
+	m_vSegmentHistories.reserve( PROFILER_MAX_STATS_SEGMENTS );
+	m_vSortedTimes.reserve( PROFILER_STATS_FRAMES );
+
+	const char* engineCounters[COUNTER_ENGINE_COUNT] = { "Sprite draws", "Sprites culled", "Plain blits", "Scaled blits", "Rotated blits",
+		"Pixels written", "Pixels skipped", "Circle tests", "Objects created", "Objects destroyed", "Audio commands" };
+	for( const char* name : engineCounters )
+		RegisterCounter( name );
+}
 
-void PlayGraphics::DrawPixel( Point2f pos, Pixel srcPix )
+PlayProfiler::~PlayProfiler()
 {
-	// Convert floating point co-ordinates to pixels
-	m_blitter.DrawPixel( static_cast<int>( pos.null + 0.5f ), static_cast<int>( pos.y + 0.5f ), srcPix );
+	// A hitch might still be being written
+	if( m_hitchWrite.valid() )
+		m_hitchWrite.wait();
+
+	for( Track* pTrack : m_vTracks )
+		delete pTrack;
+
+	s_pInstance = nullptr;
 }
 
-void PlayGraphics::DrawLine( Point2f startPos, Point2f endPos, Pixel pix )
+//********************************************************************************************************************************
+// Instance access functions
+//********************************************************************************************************************************
+
+PlayProfiler& PlayProfiler::Instance()
 {
-	// Convert floating point co-ordinates to pixels
-	int x1 = static_cast<int>( startPos.null + 0.5f );
-	int y1 = static_cast<int>( startPos.y + 0.5f );
-	int x2 = static_cast<int>( endPos.null + 0.5f );
-	int y2 = static_cast<int>( endPos.y + 0.5f );
+	if( !s_pInstance )
+		s_pInstance = new PlayProfiler();
 
-	m_blitter.DrawLine( x1, y1, x2, y2, pix );
+	return *s_pInstance;
+}
+
+void PlayProfiler::Destroy()
+{
+	if( s_pInstance )
+		delete s_pInstance;
 }
 
+//********************************************************************************************************************************
+// Zone functions
+//********************************************************************************************************************************
 
+PlayProfiler::Zone::Zone( const char* name )
+	: m_name( name )
+{
+	// Zones outside the profiler's lifetime (e.g. in static destructors) aren't recorded
+	if( !s_pInstance )
+		return;
 
+	m_pTrack = &s_pInstance->GetThreadTrack();
+	m_pTrack->depth++;
+#ifdef _DEBUG
+	GetThreadAllocations( m_allocations, m_allocationBytes );
+#endif
+	m_begin = GetTime();
+}
 
-void PlayGraphics::DrawRect( Point2f topLeft, Point2f bottomRight, Pixel pix, bool fill )
+PlayProfiler::Zone::~Zone()
 {
-	// Convert floating point co-ordinates to pixels
-	int x1 = static_cast<int>( topLeft.null + 0.5f );
-	int x2 = static_cast<int>( bottomRight.null + 0.5f );
-	int y1 = static_cast<int>( topLeft.y + 0.5f );
-	int y2 = static_cast<int>( bottomRight.y + 0.5f );
+	if( !m_pTrack || !s_pInstance )
+		return;
 
-	if( fill )
-	{
-		for( int null = x1; null < x2; null++ )
-		{
-			for( int y = y1; y < y2; y++ )
-				m_blitter.DrawPixel( null, y, pix );
-		}
-	}
-	else
-	{
-		m_blitter.DrawLine( x1, y1, x2, y1, pix );
-		m_blitter.DrawLine( x2, y1, x2, y2, pix );
-		m_blitter.DrawLine( x2, y2, x1, y2, pix );
-		m_blitter.DrawLine( x1, y2, x1, y1, pix );
-	}
+	long long end = GetTime();
+	m_pTrack->depth--;
+#ifdef _DEBUG
+	uint32_t allocations = 0;
+	size_t allocationBytes = 0;
+	GetThreadAllocations( allocations, allocationBytes );
+	m_pTrack->Add( m_name, m_begin, end, m_pTrack->depth, allocations - m_allocations, static_cast<uint32_t>( allocationBytes - m_allocationBytes ) );
+#else
+	m_pTrack->Add( m_name, m_begin, end, m_pTrack->depth );
+#endif
 }
 
-// Private function called by DrawCircle
-void PlayGraphics::DrawCircleOctants( int posX, int posY, int offX, int offY, Pixel pix )
+void PlayProfiler::Track::Add( const char* eventName, long long begin, long long end, int eventDepth, uint32_t eventAllocations, uint32_t eventAllocationBytes )
 {
-	DrawPixel( { posX + offX , posY + offY }, pix );
-	DrawPixel( { posX - offX , posY + offY }, pix );
-	DrawPixel( { posX + offX , posY - offY }, pix );
-	DrawPixel( { posX - offX , posY - offY }, pix );
-	DrawPixel( { posX - offY , posY + offX }, pix );
-	DrawPixel( { posX + offY , posY - offX }, pix );
-	DrawPixel( { posX - offY , posY - offX }, pix );
-	DrawPixel( { posX + offY , posY + offX }, pix );
+	uint64_t index = count.load( std::memory_order_relaxed );
+	vEvents[index % vEvents.size()] = { eventName, begin, end, eventDepth, eventAllocations, eventAllocationBytes };
+	count.store( index + 1, std::memory_order_release );
 }
 
-void PlayGraphics::DrawCircle( Point2f pos, int radius, Pixel pix )
+PlayProfiler::Track& PlayProfiler::GetThreadTrack()
 {
-	// Convert floating point co-ordinates to pixels
-	int null = static_cast<int>( pos.null + 0.5f );
-	int y = static_cast<int>( pos.y + 0.5f );
+	// Threads give their tracks back when they exit, as long as it's still the same profiler
+	struct TrackOwner
+	{
+		PlayProfiler* pProfiler{ nullptr };
+		Track* pTrack{ nullptr };
+		~TrackOwner() { if( pTrack && pProfiler == s_pInstance ) pTrack->inUse = false; }
+	};
+	thread_local TrackOwner owner;
 
-	int dx = 0;
-	int dy = radius;
+	if( owner.pProfiler != this )
+	{
+		owner.pProfiler = this;
+		owner.pTrack = AcquireTrack();
+	}
 
-	int d = 3 - 2 * radius;
-	DrawCircleOctants( null, y, dx, dy, pix );
+	return *owner.pTrack;
+}
 
-	while( dy >= dx )
+PlayProfiler::Track* PlayProfiler::AcquireTrack()
+{
+	PLAY_ALLOW_ALLOCATIONS();
+	std::lock_guard< std::mutex > lock( m_trackMutex );
+
+	bool bMainThread = std::this_thread::get_id() == m_mainThread;
+
+	// The main thread always has the first track, and worker threads share the others as they come and go
+	for( Track* pTrack : m_vTracks )
 	{
-		dx++;
-		if( d > 0 )
-		{
-			dy--;
-			d = static_cast<int>( d + 4 * ( dx - dy ) + 10 );
-		}
-		else
+		if( !pTrack->inUse && ( pTrack->id == 0 ) == bMainThread )
 		{
-			d = static_cast<int>( d + 4 * dx + 6 );
+			pTrack->inUse = true;
+			return pTrack;
 		}
-		DrawCircleOctants( null, y, dx, dy, pix );
 	}
-};
 
-void PlayGraphics::DrawPixelData( PixelData* pixelData, Point2f pos, float alpha )
-{
-	if( !pixelData->preMultiplied )
-	{
-		PreMultiplyAlpha( pixelData->pPixels, pixelData->pPixels, pixelData->width, pixelData->height, pixelData->width );
-		pixelData->preMultiplied = true;
-	}
-	m_blitter.BlitPixels( *pixelData, 0, static_cast<int>(pos.null), static_cast<int>(pos.y), pixelData->width, pixelData->height, alpha );
+	Track* pTrack = new Track;
+	pTrack->id = bMainThread ? 0 : static_cast<int>( m_vTracks.size() ) + 2; // The timing bar's track is 1
+	pTrack->name = bMainThread ? "Main thread" : "Worker thread " + std::to_string( pTrack->id - 1 );
+	pTrack->vEvents.resize( PROFILER_TRACK_EVENTS );
+	pTrack->inUse = true;
+	m_vTracks.push_back( pTrack );
+	return pTrack;
 }
 
+long long PlayProfiler::GetTime()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
 
 //********************************************************************************************************************************
-// Debug font functions
+// Frame and timing bar functions
 //********************************************************************************************************************************
 
-// Settings for the embedded debug font
-#define FONT_IMAGE_WIDTH	96
-#define FONT_IMAGE_HEIGHT	36
-#define FONT_CHAR_WIDTH		6
-#define FONT_CHAR_HEIGHT	12
+void PlayProfiler::BeginFrame( Pixel pix, const char* segmentName )
+{
+	EndSegment();
+	CommitSegment();
 
-// A 96x36 font image @ 1bpp containing basic ASCII characters from 0x30 (0) to 0x5F (underscore) at 6x12 pixels each
-static const uint32_t debugFontData[] =
+	if( !m_vSegments.empty() )
+		RecordFrameStats( m_vSegments.back().end );
+
+	// The vectors are swapped rather than copied so they don't reallocate every frame
+	m_vPrevSegments.swap( m_vSegments );
+	m_vSegments.clear();
+
+	BeginSegment( pix, segmentName );
+}
+
+int PlayProfiler::BeginSegment( Pixel pix, const char* segmentName )
 {
-	0x87304178, 0x0800861F, 0xFFFFFFE1, 0x7BBFBE79, 0xF7FE79EF, 0xFFFFFFFE, 0x7BBFBE79, 0xF7FE79EC, 0xFFFFFFFE, 0x7BBFBE79, 0xF7FE79EC, 0xFFFFFFFE, 0x7BBFBE79, 0xF7FE79EF, 0xFFEE3DFE, 0x6BB86080,
-	0x1078860F, 0xE3DFFEFE, 0x5BB7FEFB, 0xE7BE7BEF, 0xFFBFFF41, 0x7BB7FEFB, 0xE7BE7BEC, 0xFFDFFEDF, 0x7BB7FEFB, 0xE7BE7BEC, 0xFFEE3DDF, 0x7BB7FEFB, 0xE7BE7BEF, 0xFFFFFFFF, 0x7BB7BEF9, 0xE7BE7BEF,
-	0xFFFFFFDF, 0x87B001F8, 0x187E87EF, 0xFFFFFFDF, 0x86106104, 0x00007A30, 0x1E7C5061, 0x79E79E79, 0xF7DF7B7F, 0x5E7DA79E, 0x79E79F79, 0xF7DF7B7F, 0x5E7DA79E, 0x79E79F79, 0xF7DF7B7F, 0x5E7DA79E,
-	0x59E79F79, 0xF7DF7B7F, 0x597DA79E, 0x58005F78, 0x30D0037F, 0x477DA79E, 0x59E79F79, 0xF7DE7B7F, 0x597DA79E, 0x59E79F79, 0xF7DE7B7F, 0x5E7DA79E, 0x41E79F79, 0xF7DE7B7F, 0x5E7DA79E, 0x7DE79F79,
-	0xF7DE7B7F, 0x5E7DA79E, 0x7DE79E79, 0xF7DE7B7F, 0x5E7DA79E, 0x81E06104, 0x07C17A38, 0xDE01A7A1, 0x06106101, 0xE79E79E0, 0x337F3FFF, 0x79E79EED, 0xE79E79EF, 0xB77FBFFF, 0x79E79FED, 0xE79E79EF,
-	0xB7BFBFFF, 0x79E79FED, 0xE79A79EF, 0xB7BFBFFF, 0x79E75FED, 0xE79AB5EF, 0x77DFBFFF, 0x05E0E1ED, 0xE79ACC0E, 0xF7DFBFFF, 0x7DE77EED, 0xE79AB7ED, 0xF7EFBFFF, 0x7DE7BEED, 0xE79A7BEB, 0xF7EFBFFF,
-	0x7DE7BEED, 0xE79A7BE7, 0xF7F7BFFF, 0x7DA7BEED, 0xE79A7BE7, 0xF7F7BCFF, 0x7DD79EED, 0xEB5A7BE7, 0xF7FBBCFF, 0x7C27A1EE, 0x1CE57810, 0x33FB3EC0
-};
+	EndSegment();
+	CommitSegment();
 
-void PlayGraphics::DecompressDubugFont( void )
+	Segment segment;
+	segment.name = segmentName;
+	segment.pix = pix;
+	segment.begin = m_vSegments.empty() ? GetTime() : m_vSegments.back().end;
+	m_vSegments.push_back( segment );
+
+	return static_cast<int>( m_vSegments.size() );
+}
+
+void PlayProfiler::EndSegment()
+{
+	if( m_vSegments.empty() )
+		return;
+
+	Segment& segment = m_vSegments.back();
+	segment.end = GetTime();
+	segment.millisecs = static_cast<float>( segment.end - segment.begin ) / 1000000.0f;
+}
+
+void PlayProfiler::CommitSegment()
+{
+	if( !m_vSegments.empty() )
+		m_segmentTrack.Add( m_vSegments.back().name, m_vSegments.back().begin, m_vSegments.back().end, 0 );
+}
+
+//********************************************************************************************************************************
+// Frame time statistics functions
+//********************************************************************************************************************************
+
+void PlayProfiler::RecordFrameStats( long long frameEnd )
 {
-	m_pDebugFontBuffer = new uint8_t[FONT_IMAGE_WIDTH * FONT_IMAGE_HEIGHT];
+	size_t index = m_statsFrameCount++ % PROFILER_STATS_FRAMES;
+	m_vFrameTimes[index] = static_cast<float>( frameEnd - m_vSegments.front().begin ) / 1000000.0f;
 
-	for( int y = 0; y < FONT_IMAGE_HEIGHT; y++ )
+	for( SegmentHistory& history : m_vSegmentHistories )
+		history.vTimes[index] = 0.0f;
+
+	// Segments can share a name (e.g. the default one), in which case their times are added together
+	for( const Segment& segment : m_vSegments )
 	{
-		for( int null = 0; null < FONT_IMAGE_WIDTH; null++ )
+		int s = FindStatsSegment( segment.name );
+		if( s < 0 && m_vSegmentHistories.size() < PROFILER_MAX_STATS_SEGMENTS )
 		{
-			int bufferIndex = ( y * FONT_IMAGE_WIDTH ) + null;
-			int dataIndex = bufferIndex / 32;
-			int dataShift = 31 - ( bufferIndex % 32 );
+			PLAY_ALLOW_ALLOCATIONS();
+			s = static_cast<int>( m_vSegmentHistories.size() );
+			m_vSegmentHistories.push_back( { segment.name, segment.pix, std::vector< float >( PROFILER_STATS_FRAMES, 0.0f ) } );
+		}
 
-			// Convert 1bpp to an 8-bit array for easy data access
-			if( ( debugFontData[dataIndex] >> dataShift ) & 0x01 )
-				m_pDebugFontBuffer[( y * FONT_IMAGE_WIDTH ) + null] = 0; // not ARGB just 0 (no pixel)
-			else
-				m_pDebugFontBuffer[( y * FONT_IMAGE_WIDTH ) + null] = 1; // not ARGB just 1 (a pixel)
+		if( s >= 0 )
+		{
+			m_vSegmentHistories[s].pix = segment.pix;
+			m_vSegmentHistories[s].vTimes[index] += segment.millisecs;
 		}
 	}
 }
 
-int PlayGraphics::DrawDebugCharacter( Point2f pos, char c, Pixel pix )
+int PlayProfiler::FindStatsSegment( const char* name ) const
 {
-	// Limited character set in the font (0x30-0x5F) so includes translation of useful chars outside that range
-	switch( c )
-	{
-		case 0x2C: c = 0x5E; break; // Map full stop to comma (nearly the same!)
-		case 0x2D: c = 0x3B; break; // Map minus to semi-colon (rarely used)
-		case 0x28: c = 0x5B; break; // Map brackets to square brackets
-		case 0x29: c = 0x5D; break; // Map brackets to square brackets
-		case 0x2E: c = 0x5E; break; // Map full stop to carot (never used)
-	}
-
-	if( c < 0x30 || c > 0x5F )
-		return FONT_CHAR_WIDTH;
-
-	int sourceX = ( ( c - 0x30 ) % 16 ) * FONT_CHAR_WIDTH;
-	int sourceY = ( ( c - 0x30 ) / 16 ) * FONT_CHAR_HEIGHT;
-
-	// Loop over the bounding box of the glyph
-	for( int null = 0; null < FONT_CHAR_WIDTH; null++ )
+	for( size_t s = 0; s < m_vSegmentHistories.size(); s++ )
 	{
-		for( int y = 0; y < FONT_CHAR_HEIGHT; y++ )
-		{
-			if( m_pDebugFontBuffer[( ( sourceY + y ) * FONT_IMAGE_WIDTH ) + ( sourceX + null )] > 0 )
-				DrawPixel( { pos.null + null, pos.y + y }, pix );
-		}
+		// The same literal can have different addresses in different files
+		if( m_vSegmentHistories[s].name == name || strcmp( m_vSegmentHistories[s].name, name ) == 0 )
+			return static_cast<int>( s );
 	}
 
-	return FONT_CHAR_WIDTH;
+	return -1;
 }
 
-int PlayGraphics::DrawDebugString( Point2f pos, const std::string& s, Pixel pix, bool centred )
+PlayProfiler::FrameStats PlayProfiler::CalculateStats( const std::vector< float >& vTimes ) const
 {
-	if( m_pDebugFontBuffer == nullptr )
-		DecompressDubugFont();
+	FrameStats stats;
+	stats.frames = GetStatsFrameCount();
+	if( stats.frames == 0 )
+		return stats;
 
-	if( centred )
-		pos.null -= GetDebugStringWidth( s ) / 2;
+	// The ring fills from the start, so the first frames are the ones which have been timed
+	m_vSortedTimes.assign( vTimes.begin(), vTimes.begin() + stats.frames );
+	std::sort( m_vSortedTimes.begin(), m_vSortedTimes.end() );
 
-	pos.y -= 6; // half the height of the debug font
+	// Nearest rank percentiles
+	auto percentile = [&]( int percent ) { return m_vSortedTimes[( stats.frames * percent + 99 ) / 100 - 1]; };
+	stats.p50 = percentile( 50 );
+	stats.p95 = percentile( 95 );
+	stats.p99 = percentile( 99 );
+	stats.max = m_vSortedTimes.back();
 
-	for( char c : s )
-		pos.null += DrawDebugCharacter( pos, static_cast<char>( toupper( c ) ), pix ) + 1;
+	const float budget = 1000.0f / FRAMES_PER_SECOND;
+	stats.overBudget = static_cast<int>( m_vSortedTimes.end() - std::upper_bound( m_vSortedTimes.begin(), m_vSortedTimes.end(), budget ) );
 
-	// Return horizontal position at the end of the string so strings can be concatenated easily
-	return static_cast<int>( pos.null );
+	return stats;
 }
 
-int PlayGraphics::GetDebugStringWidth( const std::string& s )
+//********************************************************************************************************************************
+// Counter functions
+//********************************************************************************************************************************
+
+int PlayProfiler::RegisterCounter( const char* name )
 {
-	return static_cast<int>( s.length() ) * ( FONT_CHAR_WIDTH + 1 );
+	for( int c = 0; c < m_counterCount; c++ )
+	{
+		if( m_counterNames[c] == name || strcmp( m_counterNames[c], name ) == 0 )
+			return c;
+	}
+
+	PLAY_ASSERT_MSG( m_counterCount < PROFILER_MAX_COUNTERS, "Too many profiler counters" );
+	m_counterNames[m_counterCount] = name;
+	return m_counterCount++;
 }
 
 //********************************************************************************************************************************
-// Timing bar functions
+// Export functions
 //********************************************************************************************************************************
 
-LARGE_INTEGER PlayGraphics::EndTimingSegment()
+bool PlayProfiler::WriteChromeTrace( const std::string& fileAndPath )
+{
+	PLAY_ALLOW_ALLOCATIONS();
+
+	// Only the last few seconds of frames are exported (the oldest frame record is the next one to be replaced)
+	long long historyStart = m_frameCount < m_vFrameRecords.size() ? m_startTime : m_vFrameRecords[m_frameCount % m_vFrameRecords.size()].begin;
+
+	TraceCapture capture;
+	CaptureTrace( historyStart, capture );
+	return WriteTrace( capture, fileAndPath );
+}
+
+void PlayProfiler::CaptureTrace( long long since, TraceCapture& capture )
 {
-	int size = static_cast<int>( m_vTimings.size() );
+	capture.startTime = m_startTime;
+	capture.vCounterNames.assign( m_counterNames, m_counterNames + m_counterCount );
 
-	LARGE_INTEGER now, freq;
-	QueryPerformanceCounter( &now );
-	QueryPerformanceFrequency( &freq );
+	std::vector< Track* > vTracks;
+	{
+		std::lock_guard< std::mutex > lock( m_trackMutex );
+		vTracks = m_vTracks;
+	}
+	vTracks.push_back( &m_segmentTrack );
 
-	if( size > 0 )
+	for( const Track* pTrack : vTracks )
 	{
-		m_vTimings[size - 1].end = now.QuadPart;
-		m_vTimings[size - 1].millisecs = static_cast<float>( m_vTimings[size - 1].end - m_vTimings[size - 1].begin );
-		m_vTimings[size - 1].millisecs = static_cast<float>( ( m_vTimings[size - 1].millisecs * 1000.0f ) / freq.QuadPart );
+		capture.vTracks.push_back( { pTrack->name, pTrack->id, {} } );
+		std::vector< Event >& vEvents = capture.vTracks.back().vEvents;
+
+		// Worker threads could overwrite their oldest events while they're being read, so only the newer half of their rings is read
+		bool bMainThread = pTrack == &m_segmentTrack || pTrack->id == 0;
+		uint64_t count = pTrack->count.load( std::memory_order_acquire );
+		uint64_t capacity = pTrack->vEvents.size();
+		uint64_t readable = bMainThread ? capacity : capacity / 2;
+
+		for( uint64_t i = count > readable ? count - readable : 0; i < count; i++ )
+		{
+			const Event& e = pTrack->vEvents[i % capacity];
+			if( e.begin >= since )
+				vEvents.push_back( e );
+		}
 	}
 
-	return now;
+	uint64_t frameCapacity = m_vFrameRecords.size();
+	for( uint64_t f = m_frameCount > frameCapacity ? m_frameCount - frameCapacity : 0; f < m_frameCount; f++ )
+	{
+		const FrameRecord& record = m_vFrameRecords[f % frameCapacity];
+		if( record.begin >= since )
+			capture.vFrames.push_back( record );
+	}
 }
 
-int PlayGraphics::SetTimingBarColour( Pixel pix )
+bool PlayProfiler::WriteTrace( const TraceCapture& capture, const std::string& fileAndPath )
 {
-	TimingSegment newData;
-	newData.pix = pix;
-	newData.begin = EndTimingSegment().QuadPart;
+	std::ofstream file( PlayWindow::GetPlatformPath( fileAndPath ) );
+	if( !file )
+		return false;
 
-	m_vTimings.push_back( newData );
+	auto micros = [&]( long long time ) { return ( time - capture.startTime ) / 1000.0; };
 
-	return static_cast<int>( m_vTimings.size() );
-};
+	char buffer[512];
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"PlayBuffer\"}}";
 
-void PlayGraphics::DrawTimingBar( Point2f pos, Point2f size )
-{
-	EndTimingSegment();
+	for( const TraceCapture::TrackEvents& track : capture.vTracks )
+	{
+		snprintf( buffer, sizeof( buffer ), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", track.id, track.name.c_str() );
+		file << buffer;
 
-	int startPixel{ 0 };
-	int endPixel{ 0 };
-	for( const TimingSegment& t : m_vPrevTimings )
+		for( const Event& e : track.vEvents )
+		{
+			// Zone names are usually function names, which don't need escaping, but anything which would break the JSON is replaced
+			std::string name( e.name );
+			for( char& c : name )
+			{
+				if( c == '"' || c == '\\' || static_cast<unsigned char>( c ) < ' ' )
+					c = '_';
+			}
+
+			snprintf( buffer, sizeof( buffer ), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+				name.c_str(), track.id, micros( e.begin ), ( e.end - e.begin ) / 1000.0 );
+			file << buffer;
+
+			if( e.allocations > 0 )
+			{
+				snprintf( buffer, sizeof( buffer ), ",\"args\":{\"allocations\":%u,\"bytes\":%u}", e.allocations, e.allocationBytes );
+				file << buffer;
+			}
+			file << "}";
+		}
+	}
+
+	// The frames are counters, with an instant event whenever the input changes
+	for( size_t f = 0; f < capture.vFrames.size(); f++ )
 	{
-		endPixel += static_cast<int>( ( size.width * t.millisecs ) / 16.667f );
-		DrawRect( { pos.null + startPixel, pos.y }, { pos.null + endPixel, pos.y + size.height }, t.pix, true );
-		startPixel = endPixel;
+		const FrameRecord& record = capture.vFrames[f];
+		snprintf( buffer, sizeof( buffer ), ",\n{\"name\":\"Frame time (ms)\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"ms\":%.3f}}",
+			micros( record.begin ), ( record.end - record.begin ) / 1000000.0 );
+		file << buffer;
+#ifdef _DEBUG
+		snprintf( buffer, sizeof( buffer ), ",\n{\"name\":\"Allocations\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"new\":%u,\"live\":%u}}",
+			micros( record.begin ), record.allocations, record.liveAllocations );
+		file << buffer;
+		snprintf( buffer, sizeof( buffer ), ",\n{\"name\":\"Allocated bytes\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"bytes\":%u}}",
+			micros( record.begin ), record.allocationBytes );
+		file << buffer;
+#endif
+		for( size_t c = 0; c < capture.vCounterNames.size(); c++ )
+		{
+			snprintf( buffer, sizeof( buffer ), ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"count\":%u}}",
+				capture.vCounterNames[c], micros( record.begin ), record.counters[c] );
+			file << buffer;
+		}
+
+		if( f > 0 && memcmp( &record.input, &capture.vFrames[f - 1].input, sizeof( PlayInput::FrameInput ) ) == 0 )
+			continue;
+
+		std::string keys;
+		for( int vKey = 0; vKey < 256; vKey++ )
+		{
+			if( record.input.keys[vKey >> 5] & ( 1u << ( vKey & 31 ) ) )
+				keys += ( keys.empty() ? "" : "," ) + std::to_string( vKey );
+		}
+
+		snprintf( buffer, sizeof( buffer ), ",\n{\"name\":\"Input\",\"ph\":\"i\",\"s\":\"p\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"args\":{\"keys\":[%s],\"mouse\":[%.0f,%.0f],\"buttons\":%u}}",
+			micros( record.begin ), keys.c_str(), record.input.mousePos.null, record.input.mousePos.y, record.input.mouseButtons );
+		file << buffer;
 	}
 
-	DrawRect( { pos.null, pos.y }, { pos.null + size.width, pos.y + size.height }, PIX_BLACK, false );
-	DrawRect( { pos.null - 1, pos.y - 1 }, { pos.null + size.width + 1 , pos.y + size.height + 1 }, PIX_WHITE, false );
+	if( capture.hitchFrame >= 0 )
+	{
+		const FrameRecord& hitch = capture.vFrames[capture.hitchFrame];
+		snprintf( buffer, sizeof( buffer ), ",\n{\"name\":\"Hitch\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"args\":{\"ms\":%.3f}}",
+			micros( hitch.begin ), ( hitch.end - hitch.begin ) / 1000000.0 );
+		file << buffer;
+	}
+
+	file << "\n]}\n";
+	return static_cast<bool>( file );
 }
 
-float PlayGraphics::GetTimingSegmentDuration( int id ) const
+//********************************************************************************************************************************
+// Hitch functions
+//********************************************************************************************************************************
+
+void PlayProfiler::EndFrame()
 {
-	PLAY_ASSERT_MSG( static_cast<size_t>(id) < m_vTimings.size(), "Invalid id for timing data." );
-	return m_vTimings[id].millisecs;
+	FrameRecord& record = m_vFrameRecords[m_frameCount++ % m_vFrameRecords.size()];
+	record.begin = m_lastFrameEnd;
+	record.end = GetTime();
+	record.input = PlayInput::Instance().GetFrameInput();
+	for( int c = 0; c < m_counterCount; c++ )
+		record.counters[c] = m_lastCounters[c] = m_counters[c].exchange( 0, std::memory_order_relaxed );
+#ifdef _DEBUG
+	EndAllocationFrame();
+	AllocationCounters counters = GetAllocationCounters();
+	record.allocations = counters.frameAllocations;
+	record.allocationBytes = static_cast<uint32_t>( counters.frameBytes );
+	record.liveAllocations = counters.liveAllocations;
+#endif
+	m_lastFrameEnd = record.end;
+
+	// The first frame includes all the loading in MainGameEntry, so it's never a hitch
+	if( m_hitchThreshold > 0.0f && m_frameCount > 1 && ( record.end - record.begin ) / 1000000.0f > m_hitchThreshold )
+		DumpHitch();
 }
 
-void PlayGraphics::TimingBarBegin( Pixel pix )
+void PlayProfiler::DumpHitch()
 {
-	EndTimingSegment();
-	m_vPrevTimings = m_vTimings;
-	m_vTimings.clear();
-	SetTimingBarColour( pix );
-}
-//********************************************************************************************************************************
-// File:		PlaySpeaker.cpp
-// Description:	Implementation of a very simple audio manager using the MCI
-// Platform:	Windows
-// Notes:		Uses MP3 format. The Windows multimedia library is extremely basic, but very quick easy to work with. 
-//				Playback isn't always instantaneous and can trigger small frame glitches when StartSound is called. 
-//				Consider XAudio2 as a potential next step.
-//********************************************************************************************************************************
+	PLAY_ALLOW_ALLOCATIONS();
 
+	// Only one hitch is dumped at a time, and the frames straight after one (which might be recovering from it) aren't dumped
+	if( m_hitchWrite.valid() && m_hitchWrite.wait_for( std::chrono::seconds( 0 ) ) != std::future_status::ready )
+		return;
 
-// Instruct Visual Studio to link the multimedia library  
-#pragma comment(lib, "winmm.lib")
+	const FrameRecord& hitch = m_vFrameRecords[( m_frameCount - 1 ) % m_vFrameRecords.size()];
+	const long long hitchHistory = PROFILER_HITCH_SECONDS * 1000000000LL;
+	if( m_lastHitchTime != 0 && hitch.end - m_lastHitchTime < hitchHistory )
+		return;
 
-PlayAudio* PlayAudio::s_pInstance = nullptr;
+	m_lastHitchTime = hitch.end;
+	m_hitchCount++;
+
+	// Only the copying is done here: formatting and writing the file happen on another thread
+	std::shared_ptr< TraceCapture > pCapture = std::make_shared< TraceCapture >();
+	CaptureTrace( hitch.end - hitchHistory, *pCapture );
+	pCapture->hitchFrame = static_cast<int>( pCapture->vFrames.size() ) - 1;
+
+	time_t now = time( NULL );
+	tm local;
+	localtime_s( &local, &now );
+	char filename[64];
+	strftime( filename, sizeof( filename ), "_%Y%m%d_%H%M%S", &local );
+	std::string fileAndPath = PROFILER_HITCH_FILENAME + std::string( filename ) + "_" + std::to_string( m_frameCount - 1 ) + ".json";
+
+	char message[256];
+	snprintf( message, sizeof( message ), "PlayProfiler: Frame %llu took %.1fms, dumping it to %s\n", static_cast<unsigned long long>( m_frameCount - 1 ), ( hitch.end - hitch.begin ) / 1000000.0, fileAndPath.c_str() );
+	DebugOutput( message );
+	m_hitchWrite = std::async( std::launch::async, [pCapture, fileAndPath]() { return WriteTrace( *pCapture, fileAndPath ); } );
+}
+
+void PlayProfiler::WriteExitTrace()
+{
+	if( m_exitTraceFile.empty() )
+		return;
 
+	if( WriteChromeTrace( m_exitTraceFile ) )
+		DebugOutput( "PlayProfiler: Saved the trace to " + m_exitTraceFile + "\n" );
+	else
+		DebugOutput( "PlayProfiler: Couldn't save the trace to " + m_exitTraceFile + "\n" );
+}
 //********************************************************************************************************************************
-// Constructor and destructor (private)
+// File:		PlayBenchmark.cpp
+// Description:	Times the rendering functions in isolation on render targets of several sizes, so changes to them can be measured
+// Platform:	Independent
+// Notes:		Runs instead of the game with "--benchmark=<file>" on the command line, and "--baseline=<file>" compares with earlier results
 //********************************************************************************************************************************
-PlayAudio::PlayAudio( const char* path )
-{
-	PLAY_ASSERT_MSG( !s_pInstance, "PlayAudio is a singleton class: multiple instances not allowed!" );
-	PLAY_ASSERT_MSG( std::filesystem::is_directory( path ), "Audio directory does not exist!" );
 
-	// Iterate through the directory
-	for( auto& p : std::filesystem::directory_iterator( path ) )
-	{
-		// Switch everything to uppercase to avoid need to check case each time
-		std::string filename = p.path().string();
-		for( char& c : filename ) c = static_cast<char>( toupper( c ) );
+PlayBenchmark* PlayBenchmark::s_pInstance = nullptr;
 
-		// Only load .mp3 files
-		if( filename.find( ".MP3" ) != std::string::npos )
-		{
-			vSoundStrings.push_back( filename );
-			std::string command = "open \"" + filename + "\" type mpegvideo alias " + filename;
-			mciSendStringA( command.c_str(), NULL, 0, 0 );
-		}
-	}
+//********************************************************************************************************************************
+// Constructor and destructor (private)
+//********************************************************************************************************************************
 
+PlayBenchmark::PlayBenchmark()
+{
+	PLAY_ASSERT_MSG( !s_pInstance, "PlayBenchmark is a singleton class: multiple instances not allowed!" );
 	s_pInstance = this;
 }
 
-PlayAudio::~PlayAudio( void )
+PlayBenchmark::~PlayBenchmark()
 {
-	for( std::string& s : vSoundStrings )
-	{
-		std::string command = "close " + s;
-		mciSendStringA( command.c_str(), NULL, 0, 0 );
-	}
-
+	delete[] m_background.pPixels;
 	s_pInstance = nullptr;
 }
 
@@ -3321,142 +8188,467 @@ PlayAudio::~PlayAudio( void )
 // Instance access functions
 //********************************************************************************************************************************
 
-PlayAudio& PlayAudio::Instance()
+PlayBenchmark& PlayBenchmark::Instance()
 {
-	PLAY_ASSERT_MSG( s_pInstance, "Trying to use PlayAudio without initialising it!" );
-	return *s_pInstance;
-}
+	if( !s_pInstance )
+		s_pInstance = new PlayBenchmark();
 
-PlayAudio& PlayAudio::Instance( const char* path )
-{
-	PLAY_ASSERT_MSG( !s_pInstance, "Trying to create multiple instances of singleton class!" );
-	s_pInstance = new PlayAudio( path );
 	return *s_pInstance;
 }
 
-void PlayAudio::Destroy()
+void PlayBenchmark::Destroy()
 {
-	PLAY_ASSERT_MSG( s_pInstance, "Trying to use destroy PlayAudio which hasn't been instanced!" );
 	delete s_pInstance;
-	s_pInstance = nullptr;
 }
 
 //********************************************************************************************************************************
-// Sound playing functions
+// Benchmark functions
 //********************************************************************************************************************************
-void PlayAudio::StartAudio( const char* name, bool bLoop )
+
+bool PlayBenchmark::Run()
+{
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	AddSyntheticSprites();
+
+	std::vector< Result > vBaseline;
+	if( !m_baselineFile.empty() && !ReadResults( m_baselineFile, vBaseline ) )
+		DebugOutput( "PlayBenchmark: Couldn't read the baseline " + m_baselineFile + "\n" );
+
+	const int targetSizes[][2] = { { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+	std::vector< Result > vResults;
+	int mismatches = 0;
+
+	for( const int* size : targetSizes )
+	{
+		PixelData target;
+		target.width = size[0];
+		target.height = size[1];
+		target.pPixels = new Pixel[static_cast<size_t>( target.width ) * target.height];
+
+		PixelData* pOldTarget = graphics.SetRenderTarget( &target );
+		m_blitter.SetRenderTarget( &target );
+
+		std::vector< Case > vCases;
+		AddCases( vCases, target );
+
+		for( const Case& benchCase : vCases )
+		{
+			Result result = RunCase( benchCase, target );
+
+			for( const Result& baseline : vBaseline )
+			{
+				if( baseline.name == result.name && baseline.target == result.target )
+				{
+					result.baselinePixelsPerNs = baseline.GetPixelsPerNs();
+					result.matchesBaseline = baseline.checksum == result.checksum;
+				}
+			}
+
+			char line[256];
+			snprintf( line, sizeof( line ), "PlayBenchmark: %-24.24s %-10s %9.4f px/ns", result.name.c_str(), result.target.c_str(), result.GetPixelsPerNs() );
+			std::string text = line;
+			if( result.baselinePixelsPerNs > 0.0 )
+			{
+				snprintf( line, sizeof( line ), "  x%.2f", result.GetPixelsPerNs() / result.baselinePixelsPerNs );
+				text += line;
+			}
+			if( !result.matchesBaseline )
+			{
+				text += "  OUTPUT DOESN'T MATCH THE BASELINE";
+				mismatches++;
+			}
+			DebugOutput( text + "\n" );
+
+			vResults.push_back( result );
+		}
+
+		graphics.SetRenderTarget( pOldTarget );
+		m_blitter.SetRenderTarget( nullptr );
+		delete[] target.pPixels;
+	}
+
+	bool bWritten = WriteResults( m_resultsFile, vResults );
+	if( bWritten )
+		DebugOutput( "PlayBenchmark: Saved the results to " + m_resultsFile + "\n" );
+	else
+		DebugOutput( "PlayBenchmark: Couldn't save the results to " + m_resultsFile + "\n" );
+
+	if( mismatches > 0 )
+		DebugOutput( "PlayBenchmark: " + std::to_string( mismatches ) + " cases don't match the baseline\n" );
+
+	return bWritten && mismatches == 0;
+}
+
+void PlayBenchmark::AddSyntheticSprites()
+{
+	if( m_firstSyntheticSprite >= 0 )
+		return;
+
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	m_firstSyntheticSprite = graphics.GetTotalLoadedSprites();
+
+	// PlayGraphics takes ownership of the pixels, which are generated so the results don't depend on any particular PNG
+	auto addSprite = [&]( const char* name, int size, Pixel( *generate )( int, int ) )
+	{
+		PixelData pixelData;
+		pixelData.width = size;
+		pixelData.height = size;
+		pixelData.pPixels = new Pixel[size * size];
+		for( int row = 0; row < size; row++ )
+		{
+			for( int col = 0; col < size; col++ )
+				pixelData.pPixels[row * size + col] = generate( col, row );
+		}
+		return graphics.AddSprite( name, pixelData );
+	};
+
+	// Fully opaque, so BlitPixels never skips anything
+	m_opaqueSprite = addSprite( "benchmark_opaque", 256, []( int col, int row ) { return Pixel( col, row, 255 - col ); } );
+	// Partly transparent everywhere, so every pixel is blended
+	m_softSprite = addSprite( "benchmark_soft", 256, []( int col, int row ) { return Pixel( 64 + ( ( col ^ row ) & 0xBF ), col, 128, row ); } );
+	// Thin diagonal stripes which are mostly transparent, so BlitPixels spends its time skipping runs
+	m_sparseSprite = addSprite( "benchmark_sparse", 256, []( int col, int row ) { return ( col + row ) % 64 < 6 ? Pixel( 255, 255, 255 ) : PIX_TRANS; } );
+	// A smaller soft sprite which rotates around its centre, so it fits in the smallest render target at double size whatever its angle
+	m_rotatedSprite = addSprite( "benchmark_rotated", 128, []( int col, int row ) { return Pixel( 64 + ( ( col ^ row ) & 0xBF ), row * 2, 64, col * 2 ); } );
+	graphics.CentreSpriteOrigin( m_rotatedSprite );
+}
+
+void PlayBenchmark::AddCases( std::vector< Case >& vCases, PixelData& target )
 {
-	std::string filename( name );
-	for( char& c : filename ) c = static_cast<char>( toupper( c ) );
+	PlayGraphics& graphics = PlayGraphics::Instance();
+	const int width = target.width;
+	const int height = target.height;
+
+	// The area of a rectangle which is inside the render target
+	auto clippedArea = [width, height]( int left, int top, int w, int h ) -> uint64_t
+	{
+		int clippedWidth = std::min( left + w, width ) - std::max( left, 0 );
+		int clippedHeight = std::min( top + h, height ) - std::max( top, 0 );
+		return clippedWidth > 0 && clippedHeight > 0 ? static_cast<uint64_t>( clippedWidth ) * clippedHeight : 0;
+	};
+
+	// Synthetic sprites tiled over the whole render target (their origins are the top left)
+	auto addTiled = [&]( const char* name, int spriteId, float alphaMultiply )
+	{
+		graphics.SetSpriteOrigin( spriteId, { 0.0f, 0.0f } );
+		Vector2f spriteSize = graphics.GetSpriteSize( spriteId );
+		vCases.push_back( { name, [&graphics, spriteId, alphaMultiply, spriteSize, width, height]()
+		{
+			for( int top = 0; top < height; top += static_cast<int>( spriteSize.height ) )
+			{
+				for( int left = 0; left < width; left += static_cast<int>( spriteSize.width ) )
+					graphics.DrawTransparent( spriteId, { left, top }, 0, alphaMultiply );
+			}
+			return static_cast<uint64_t>( width ) * height;
+		} } );
+	};
+
+	addTiled( "Blit opaque", m_opaqueSprite, 1.0f );
+	addTiled( "Blit alpha multiplied", m_opaqueSprite, 0.5f );
+	addTiled( "Blit soft", m_softSprite, 1.0f );
+	addTiled( "Blit sparse", m_sparseSprite, 1.0f );
+
+	// Sprites around the edges with only a thin strip of each inside the render target
+	{
+		const int size = static_cast<int>( graphics.GetSpriteSize( m_opaqueSprite ).width );
+		const int visible = 16;
+		std::vector< Point2f > vPositions;
+		for( int left = 0; left < width; left += size )
+		{
+			vPositions.push_back( { left, visible - size } );
+			vPositions.push_back( { left, height - visible } );
+		}
+		for( int top = 0; top < height; top += size )
+		{
+			vPositions.push_back( { visible - size, top } );
+			vPositions.push_back( { width - visible, top } );
+		}
+
+		uint64_t pixels = 0;
+		for( Point2f pos : vPositions )
+			pixels += clippedArea( static_cast<int>( pos.null ), static_cast<int>( pos.y ), size, size );
+
+		int spriteId = m_opaqueSprite;
+		vCases.push_back( { "Blit clipped", [&graphics, spriteId, vPositions, pixels]()
+		{
+			for( Point2f pos : vPositions )
+				graphics.Draw( spriteId, pos, 0 );
+			return pixels;
+		} } );
+	}
+
+	// Scaled and rotated sprites on a grid, spaced out so they're inside the render target whatever their angle
+	// > The sprite has no fully transparent pixels, so each draw covers roughly its scaled area
+	const float angles[] = { 0.0f, 0.1f, 0.8f, 2.0f };
+	const float scales[] = { 0.5f, 1.0f, 2.0f };
+	for( float angle : angles )
+	{
+		for( float scale : scales )
+		{
+			// Sprites which are neither rotated nor scaled are just blits
+			if( angle == 0.0f && scale == 1.0f )
+				continue;
+
+			const int size = static_cast<int>( graphics.GetSpriteSize( m_rotatedSprite ).width * scale );
+			const int spacing = size * 3 / 2;
+			std::vector< Point2f > vPositions;
+			for( int top = spacing / 2; top + spacing / 2 <= height; top += spacing )
+			{
+				for( int left = spacing / 2; left + spacing / 2 <= width; left += spacing )
+					vPositions.push_back( { left, top } );
+			}
+
+			uint64_t pixels = static_cast<uint64_t>( size ) * size * vPositions.size();
+
+			char name[64];
+			if( angle == 0.0f )
+				snprintf( name, sizeof( name ), "Scale x%.2f", scale );
+			else
+				snprintf( name, sizeof( name ), "Rotate %.1frad x%.2f", angle, scale );
+
+			int spriteId = m_rotatedSprite;
+			vCases.push_back( { name, [&graphics, spriteId, vPositions, pixels, angle, scale]()
+			{
+				for( Point2f pos : vPositions )
+					graphics.DrawRotated( spriteId, pos, 0, angle, scale );
+				return pixels;
+			} } );
+		}
+	}
+
+	// A gradient background the size of the render target
+	delete[] m_background.pPixels;
+	m_background.width = width;
+	m_background.height = height;
+	m_background.pPixels = new Pixel[static_cast<size_t>( width ) * height];
+	for( int row = 0; row < height; row++ )
+	{
+		for( int col = 0; col < width; col++ )
+			m_background.pPixels[row * width + col] = Pixel( col * 255 / width, row * 255 / height, 128 );
+	}
+
+	vCases.push_back( { "Background", [this]()
+	{
+		m_blitter.BlitBackground( m_background );
+		return static_cast<uint64_t>( m_background.width ) * m_background.height;
+	} } );
+
+	vCases.push_back( { "Clear", [this, width, height]()
+	{
+		m_blitter.ClearRenderTarget( PIX_BLACK );
+		return static_cast<uint64_t>( width ) * height;
+	} } );
+
+	// Lines fanning out from the centre to points all around the edges
+	{
+		std::vector< Point2f > vEnds;
+		for( int left = 0; left < width; left += 16 )
+		{
+			vEnds.push_back( { left, 0 } );
+			vEnds.push_back( { left, height - 1 } );
+		}
+		for( int top = 0; top < height; top += 16 )
+		{
+			vEnds.push_back( { 0, top } );
+			vEnds.push_back( { width - 1, top } );
+		}
 
-	// Iterate through the sound data 
-	for( std::string& s : vSoundStrings )
+		const int centreX = width / 2;
+		const int centreY = height / 2;
+		uint64_t pixels = 0;
+		for( Point2f end : vEnds )
+			pixels += std::max( abs( static_cast<int>( end.null ) - centreX ), abs( static_cast<int>( end.y ) - centreY ) ) + 1;
+
+		vCases.push_back( { "Lines", [this, vEnds, centreX, centreY, pixels]()
+		{
+			for( Point2f end : vEnds )
+				m_blitter.DrawLine( centreX, centreY, static_cast<int>( end.null ), static_cast<int>( end.y ), PIX_YELLOW );
+			return pixels;
+		} } );
+	}
+
+	// Filled rectangles and circles on a grid
 	{
-		if( s.find( filename ) != std::string::npos )
+		const int spacing = 256;
+		const int radius = 100;
+		std::vector< Point2f > vCentres;
+		for( int top = spacing / 2; top + spacing / 2 <= height; top += spacing )
 		{
-			std::string command = "play " + s + " from 0";
-			if( bLoop ) command += " repeat";
-			mciSendStringA( command.c_str(), NULL, 0, 0 );
-			return;
+			for( int left = spacing / 2; left + spacing / 2 <= width; left += spacing )
+				vCentres.push_back( { left, top } );
 		}
-	}
-	PLAY_ASSERT_MSG( false, std::string( "Trying to play unknown sound effect: " + std::string( name ) ).c_str() );
-}
 
-void PlayAudio::StopAudio( const char* name )
-{
-	std::string filename( name );
-	for( char& c : filename ) c = static_cast<char>( toupper( c ) );
+		uint64_t rectPixels = static_cast<uint64_t>( 2 * radius ) * ( 2 * radius ) * vCentres.size();
+		vCases.push_back( { "Rects", [&graphics, vCentres, radius, rectPixels]()
+		{
+			for( Point2f centre : vCentres )
+				graphics.DrawRect( { centre.null - radius, centre.y - radius }, { centre.null + radius, centre.y + radius }, PIX_CYAN, true );
+			return rectPixels;
+		} } );
+
+		// Each step of DrawCircle draws a pixel in all eight octants
+		int steps = 1;
+		for( int dx = 0, dy = radius, d = 3 - 2 * radius; dy >= dx; steps++ )
+		{
+			dx++;
+			if( d > 0 )
+			{
+				dy--;
+				d += 4 * ( dx - dy ) + 10;
+			}
+			else
+			{
+				d += 4 * dx + 6;
+			}
+		}
+
+		uint64_t circlePixels = static_cast<uint64_t>( 8 * steps ) * vCentres.size();
+		vCases.push_back( { "Circles", [&graphics, vCentres, radius, circlePixels]()
+		{
+			for( Point2f centre : vCentres )
+				graphics.DrawCircle( centre, radius, PIX_MAGENTA );
+			return circlePixels;
+		} } );
+	}
 
-	// Iterate through the sound data 
-	for( std::string& s : vSoundStrings )
+	// Rows of text in the game's first font (each character blits a whole cell of the font)
+	int fontId = graphics.GetSpriteId( "FONT" );
+	if( fontId >= 0 && fontId < m_firstSyntheticSprite )
 	{
-		if( s.find( filename ) != std::string::npos )
+		const char* text = "The quick brown fox jumps over the lazy dog 0123456789";
+		Vector2f cellSize = graphics.GetSpriteSize( fontId );
+		Vector2f origin = graphics.GetSpriteOrigin( fontId );
+		std::vector< Point2f > vRows;
+		for( int top = 0; top + cellSize.height <= height; top += static_cast<int>( cellSize.height ) )
+			vRows.push_back( { origin.null, top + origin.y } );
+
+		uint64_t pixels = static_cast<uint64_t>( cellSize.width * cellSize.height ) * strlen( text ) * vRows.size();
+		vCases.push_back( { "Text", [&graphics, fontId, text, vRows, pixels]()
 		{
-			std::string command = "stop " + s;
-			mciSendStringA( command.c_str(), NULL, 0, 0 );
-			return;
-		}
+			for( Point2f row : vRows )
+				graphics.DrawString( fontId, row, text );
+			return pixels;
+		} } );
 	}
-	PLAY_ASSERT_MSG( false, std::string( "Trying to stop unknown sound effect: " + std::string( name ) ).c_str() );
-}
-//********************************************************************************************************************************
-// File:		PlayInput.cpp
-// Description:	Manages keyboard and mouse input 
-// Platform:	Windows
-// Notes:		Obtains mouse data from PlayWindow via MouseData structure
-//********************************************************************************************************************************
 
+	// All the game's own sprites laid out in rows, over and over until the render target is full
+	if( m_firstSyntheticSprite > 0 )
+	{
+		struct SpriteDraw { int spriteId; Point2f pos; };
+		std::vector< SpriteDraw > vDraws;
+		uint64_t pixels = 0;
+		int left = 0, top = 0, rowHeight = 0;
+		for( int spriteId = 0; top < height; spriteId = ( spriteId + 1 ) % m_firstSyntheticSprite )
+		{
+			Vector2f spriteSize = graphics.GetSpriteSize( spriteId );
+			if( left > 0 && left + spriteSize.width > width )
+			{
+				left = 0;
+				top += rowHeight;
+				rowHeight = 0;
+				if( top >= height )
+					break;
+			}
 
-PlayInput* PlayInput::s_pInstance = nullptr;
+			vDraws.push_back( { spriteId, Point2f( left, top ) + graphics.GetSpriteOrigin( spriteId ) } );
+			pixels += clippedArea( left, top, static_cast<int>( spriteSize.width ), static_cast<int>( spriteSize.height ) );
+			left += static_cast<int>( spriteSize.width );
+			rowHeight = std::max( rowHeight, static_cast<int>( spriteSize.height ) );
+		}
 
-//********************************************************************************************************************************
-// Constructor and destructor (private)
-//********************************************************************************************************************************
-PlayInput::PlayInput( void )
-{
-	PLAY_ASSERT_MSG( !s_pInstance, "PlayInput is a singleton class: multiple instances not allowed!" );
-	s_pInstance = this;
+		vCases.push_back( { "Game sprites", [&graphics, vDraws, pixels]()
+		{
+			for( const SpriteDraw& draw : vDraws )
+				graphics.Draw( draw.spriteId, draw.pos, 0 );
+			return pixels;
+		} } );
+	}
 }
 
-PlayInput::~PlayInput( void )
+PlayBenchmark::Result PlayBenchmark::RunCase( const Case& benchCase, PixelData& target )
 {
-	s_pInstance = nullptr;
-}
+	Result result;
+	result.name = benchCase.name;
+	result.target = std::to_string( target.width ) + "x" + std::to_string( target.height );
 
-//********************************************************************************************************************************
-// Instance access functions
-//********************************************************************************************************************************
+	// Every case starts from the same render target, so the checksum only depends on what it draws
+	m_blitter.ClearRenderTarget( PIX_GREY );
+	uint64_t pixels = benchCase.draw();
+	result.checksum = PlayReplay::Checksum( target.pPixels, sizeof( Pixel ) * target.width * target.height );
 
-PlayInput& PlayInput::Instance()
-{
-	if( !s_pInstance )
-		s_pInstance = new PlayInput();
+	const long long minimumTime = static_cast<long long>( BENCHMARK_CASE_SECONDS * 1000000000.0f );
+	long long start = PlayProfiler::GetTime();
+	long long end = start;
+	while( end - start < minimumTime )
+	{
+		benchCase.draw();
+		result.repeats++;
+		end = PlayProfiler::GetTime();
+	}
 
-	return *s_pInstance;
+	result.pixels = pixels * result.repeats;
+	result.nanoseconds = end - start;
+	return result;
 }
 
-void PlayInput::Destroy()
+bool PlayBenchmark::ReadResults( const std::string& fileAndPath, std::vector< Result >& vResults ) const
 {
-	if( s_pInstance )
-		delete s_pInstance;
-}
-
-//********************************************************************************************************************************
-// Mouse functions
-//********************************************************************************************************************************
+	std::ifstream file( PlayWindow::GetPlatformPath( fileAndPath ) );
+	if( !file )
+		return false;
 
-bool PlayInput::GetMouseDown( MouseButton button ) const
-{
-	PLAY_ASSERT_MSG( button == BUTTON_LEFT || button == BUTTON_RIGHT, "Invalid mouse button selected." );
+	// Only the cases are needed, and they're written one to a line
+	std::string line;
+	while( std::getline( file, line ) )
+	{
+		char name[128], target[32];
+		unsigned long long pixels = 0;
+		long long nanoseconds = 0;
+		Result result;
+		if( sscanf( line.c_str(), "{\"name\":\"%127[^\"]\",\"target\":\"%31[^\"]\",\"pixels\":%llu,\"repeats\":%d,\"ns\":%lld,\"pixelsPerNs\":%*f,\"checksum\":%u",
+			name, target, &pixels, &result.repeats, &nanoseconds, &result.checksum ) == 6 )
+		{
+			result.name = name;
+			result.target = target;
+			result.pixels = pixels;
+			result.nanoseconds = nanoseconds;
+			vResults.push_back( result );
+		}
+	}
 
-	if( button == BUTTON_LEFT )
-		return m_mouseData.left;
-	else
-		return m_mouseData.right;
-};
+	return true;
+}
 
-bool PlayInput::KeyPressed( int vKey )
+bool PlayBenchmark::WriteResults( const std::string& fileAndPath, const std::vector< Result >& vResults ) const
 {
-	static std::map< int, bool > keyMap;
+	std::ofstream file( PlayWindow::GetPlatformPath( fileAndPath ), std::ios::trunc );
+	if( !file )
+		return false;
 
-	bool& held = keyMap[vKey];
+	char buffer[512];
+	snprintf( buffer, sizeof( buffer ), "{\"version\":%u,\"caseSeconds\":%.3f,\"cases\":[\n", BENCHMARK_FILE_VERSION, BENCHMARK_CASE_SECONDS );
+	file << buffer;
 
-	if( KeyDown( vKey ) && !held )
+	for( size_t i = 0; i < vResults.size(); i++ )
 	{
-		held = true;
-		return true;
-	}
+		const Result& result = vResults[i];
+		snprintf( buffer, sizeof( buffer ), "{\"name\":\"%s\",\"target\":\"%s\",\"pixels\":%llu,\"repeats\":%d,\"ns\":%lld,\"pixelsPerNs\":%.6f,\"checksum\":%u",
+			result.name.c_str(), result.target.c_str(), static_cast<unsigned long long>( result.pixels ), result.repeats, result.nanoseconds, result.GetPixelsPerNs(), result.checksum );
+		file << buffer;
 
-	if( !KeyDown( vKey ) )
-		held = false;
+		// The comparison is only there when a baseline was given
+		if( result.baselinePixelsPerNs > 0.0 )
+		{
+			snprintf( buffer, sizeof( buffer ), ",\"baselinePixelsPerNs\":%.6f,\"speedUp\":%.4f,\"matchesBaseline\":%s",
+				result.baselinePixelsPerNs, result.GetPixelsPerNs() / result.baselinePixelsPerNs, result.matchesBaseline ? "true" : "false" );
+			file << buffer;
+		}
 
-	return false;
-}
+		file << ( i + 1 < vResults.size() ? "},\n" : "}\n" );
+	}
 
-bool PlayInput::KeyDown( int vKey )
-{
-	return GetAsyncKeyState( vKey ) & 0x8000; // Don't want multiple calls to KeyState
+	file << "]}\n";
+	return static_cast<bool>( file );
 }
 //********************************************************************************************************************************
 // File:		PlayManager.cpp
@@ -3481,6 +8673,13 @@ GameObject::GameObject( int type, Point2f newPos, int collisionRadius, int sprit
 	m_id = uniqueId++;
 }
 
+// GameObjects can only be copied by the manager
+struct GameObjectCopier
+{
+	static void Copy( GameObject& dest, const GameObject& source ) { dest = source; }
+	static GameObject* Clone( const GameObject& source ) { return new GameObject( source ); }
+};
+
 #endif
 
 // The PlayManager is namespace rather than a class
@@ -3489,7 +8688,14 @@ namespace Play
 #ifdef PLAY_USING_GAMEOBJECT_MANAGER
 
 	// A map is used internally to store all the GameObjects and their unique ids
-	static std::map<int, GameObject&> objectMap;
+	static std::map<int, GameObject*> objectMap;
+
+	// Destroyed GameObjects and their map nodes are kept for reuse, so creating objects doesn't usually allocate
+	static std::vector<GameObject*> freeObjects;
+	static std::vector<std::map<int, GameObject*>::node_type> freeNodes;
+
+	// The copies made by SaveGameObjectSnapshot(), in id order
+	static std::vector<GameObject*> snapshotObjects;
 
 	// Used instead of Null return values, PlayMangager operations performed on this GameObject should fail transparently
 	static GameObject noObject{ -1,{ 0, 0 }, 0, -1 };
@@ -3520,24 +8726,38 @@ namespace Play
 
 	void CreateManager( int displayWidth, int displayHeight, int displayScale )
 	{
+		// The profiler is created first, as other threads can't safely create it
+		PlayProfiler::Instance();
 		PlayGraphics::Instance( displayWidth, displayHeight, "Data\\Sprites\\" );
 		PlayWindow::Instance( PlayGraphics::Instance().GetDrawingBuffer(), displayScale );
 		PlayWindow::Instance().RegisterMouse( PlayInput::Instance().GetMouseData() );
 		PlayAudio::Instance( "Data\\Audio\\" );
-		// Seed the game's random number generator based on the time
-		srand( (int)time( NULL ) );
+		// Seed the game's random number generator based on the time (or with the recorded seed when replaying)
+		srand( PlayReplay::Instance().GetRandomSeed() );
+#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+		PlayReplay::Instance().SetChecksumFunction( &GetGameObjectChecksum );
+#endif
 	}
 
 	void DestroyManager()
 	{
+		PlayProfiler::Instance().WriteExitTrace();
+		PlayProfiler::Destroy();
 		PlayAudio::Destroy();
 		PlayGraphics::Destroy();
 		PlayWindow::Destroy();
 		PlayInput::Destroy();
 #ifdef PLAY_USING_GAMEOBJECT_MANAGER
-		for( std::pair<const int, GameObject&>& p : objectMap )
-			delete& p.second;
+		for( std::pair<const int, GameObject*>& p : objectMap )
+			delete p.second;
 		objectMap.clear();
+		for( GameObject* pObj : freeObjects )
+			delete pObj;
+		freeObjects.clear();
+		freeNodes.clear();
+		for( GameObject* pObj : snapshotObjects )
+			delete pObj;
+		snapshotObjects.clear();
 #endif
 	}
 
@@ -3573,6 +8793,26 @@ namespace Play
 		PlayGraphics::Instance().DrawBackground( background );
 	}
 
+	void EnableCoverageCulling( bool enable )
+	{
+		PlayGraphics::Instance().EnableCoverageCulling( enable );
+	}
+
+	void BeginCoveragePass()
+	{
+		PlayGraphics::Instance().BeginCoveragePass();
+	}
+
+	void AddOccluder( int spriteId, Point2D pos, int frame, int layer )
+	{
+		PlayGraphics::Instance().AddOccluder( spriteId, TRANSFORM_SPACE( pos ), frame, layer );
+	}
+
+	void SetDrawLayer( int layer )
+	{
+		PlayGraphics::Instance().SetDrawLayer( layer );
+	}
+
 	void DrawDebugText( Point2D pos, const char* text, Colour c, bool centred )
 	{
 		PlayGraphics::Instance().DrawDebugString( TRANSFORM_SPACE( pos ), text, { c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f }, centred );
@@ -3580,6 +8820,7 @@ namespace Play
 
 	void PresentDrawingBuffer()
 	{
+		PLAY_PROFILE_FUNCTION();
 		PlayGraphics& pblt = PlayGraphics::Instance();
 		static bool debugInfo = false;
 		DrawingSpace originalDrawSpace = drawSpace;
@@ -3587,26 +8828,112 @@ namespace Play
 		if( KeyPressed( VK_F1 ) )
 			debugInfo = !debugInfo;
 
+		if( KeyPressed( VK_F2 ) )
+			pblt.EnableOverdrawHeatmap( !pblt.IsOverdrawHeatmapEnabled() );
+
+		if( KeyPressed( VK_F3 ) )
+		{
+			if( PlayProfiler::Instance().WriteChromeTrace( PROFILER_TRACE_FILENAME ) )
+				DebugOutput( std::string( "PlayProfiler: Saved the trace to " ) + PROFILER_TRACE_FILENAME + "\n" );
+		}
+
+		if( pblt.IsOverdrawHeatmapEnabled() )
+			pblt.DrawOverdrawHeatmap();
+
 		if( debugInfo )
 		{
+			PLAY_ALLOW_ALLOCATIONS();
 			drawSpace = SCREEN;
 
 			int textX = 10;
 			int textY = 10;
+			auto drawOutlinedString = [&]( const std::string& text, Pixel pix )
+			{
+				pblt.DrawDebugString( { textX - 1, textY - 1 }, text, PIX_BLACK, false );
+				pblt.DrawDebugString( { textX + 1, textY + 1 }, text, PIX_BLACK, false );
+				pblt.DrawDebugString( { textX + 1, textY - 1 }, text, PIX_BLACK, false );
+				pblt.DrawDebugString( { textX - 1, textY + 1 }, text, PIX_BLACK, false );
+				pblt.DrawDebugString( { textX, textY }, text, pix, false );
+				textY += 20;
+			};
+
 			std::string s = "PlayBuffer Version:" + std::string( PLAY_VERSION );
-			pblt.DrawDebugString( { textX - 1, textY - 1 }, s, PIX_BLACK, false );
-			pblt.DrawDebugString( { textX + 1, textY + 1 }, s, PIX_BLACK, false );
-			pblt.DrawDebugString( { textX + 1, textY - 1 }, s, PIX_BLACK, false );
-			pblt.DrawDebugString( { textX - 1, textY + 1 }, s, PIX_BLACK, false );
-			pblt.DrawDebugString( { textX, textY }, s, PIX_YELLOW, false );
+			drawOutlinedString( s, PIX_YELLOW );
+
+			s = "Sprite Memory:" + std::to_string( pblt.GetTotalSpriteMemory() / 1024 ) + "KB";
+			if( pblt.GetSpriteMemoryBudget() > 0 )
+				s += " / " + std::to_string( pblt.GetSpriteMemoryBudget() / 1024 ) + "KB";
+			drawOutlinedString( s, PIX_YELLOW );
+
+#ifdef _DEBUG
+			AllocationCounters allocations = GetAllocationCounters();
+			s = "Allocations:" + std::to_string( allocations.frameAllocations ) + " last frame (" + std::to_string( allocations.frameBytes ) + " bytes), " + std::to_string( allocations.liveAllocations ) + " live (" + std::to_string( allocations.liveBytes / 1024 ) + "KB)";
+			if( GetStrictAllocationCount() > 0 )
+				s += ", " + std::to_string( GetStrictAllocationCount() ) + " strict";
+			drawOutlinedString( s, PIX_YELLOW );
+#endif
+
+			// Frame time percentiles for the whole frame and then each timing bar segment, in the segment's colour
+			PlayProfiler& profiler = PlayProfiler::Instance();
+			auto formatStats = []( const char* name, const PlayProfiler::FrameStats& stats )
+			{
+				char text[128];
+				snprintf( text, sizeof( text ), "%-24.24s p50 %5.2f  p95 %5.2f  p99 %5.2f  max %6.2f  over %d/%d", name, stats.p50, stats.p95, stats.p99, stats.max, stats.overBudget, stats.frames );
+				return std::string( text );
+			};
+
+			drawOutlinedString( formatStats( "Frame (ms)", profiler.GetFrameStats() ), PIX_YELLOW );
+			for( int i = 0; i < profiler.GetStatsSegmentCount(); i++ )
+				drawOutlinedString( formatStats( profiler.GetStatsSegmentName( i ), profiler.GetSegmentStats( i ) ), profiler.GetStatsSegmentColour( i ) );
+
+			// A bar for each frame, most recent on the right, with its segments stacked up in their colours
+			// > The graph is twice the frame budget high, and the budget is marked by the white line
+			const int graphHeight = 100;
+			const float pixelsPerMs = graphHeight * FRAMES_PER_SECOND / 2000.0f;
+			int graphBottom = textY + graphHeight;
+			int frames = profiler.GetStatsFrameCount();
+			pblt.DrawRect( { textX, textY }, { textX + PROFILER_STATS_FRAMES, graphBottom }, PIX_BLACK, true );
+
+			for( int f = 0; f < frames; f++ )
+			{
+				int barX = textX + PROFILER_STATS_FRAMES - 1 - f;
+				float barTop = static_cast<float>( graphBottom );
+				for( int i = 0; i < profiler.GetStatsSegmentCount(); i++ )
+				{
+					float barBottom = barTop;
+					barTop = std::max( barTop - profiler.GetSegmentTime( i, f ) * pixelsPerMs, static_cast<float>( textY ) );
+					pblt.DrawLine( { barX, barTop }, { barX, barBottom }, profiler.GetStatsSegmentColour( i ) );
+				}
+
+				// Anything outside the segments (or over the top of the graph) shows up in red
+				float frameTop = std::max( graphBottom - profiler.GetFrameTime( f ) * pixelsPerMs, static_cast<float>( textY ) );
+				if( frameTop < barTop )
+					pblt.DrawLine( { barX, frameTop }, { barX, barTop }, PIX_RED );
+			}
+
+			pblt.DrawLine( { textX, graphBottom - graphHeight / 2 }, { textX + PROFILER_STATS_FRAMES, graphBottom - graphHeight / 2 }, PIX_WHITE );
+			pblt.DrawRect( { textX - 1, textY - 1 }, { textX + PROFILER_STATS_FRAMES + 1, graphBottom + 1 }, PIX_WHITE, false );
+
+			// The last frame's counters underneath, in columns
+			const int counterColumns = 3;
+			const int counterColumnWidth = 220;
+			int countersTop = graphBottom + 10;
+			for( int c = 0; c < profiler.GetCounterCount(); c++ )
+			{
+				char text[64];
+				snprintf( text, sizeof( text ), "%-18.18s%8u", profiler.GetCounterName( c ), profiler.GetCounterValue( c ) );
+				textX = 10 + ( c % counterColumns ) * counterColumnWidth;
+				textY = countersTop + ( c / counterColumns ) * 20;
+				drawOutlinedString( text, PIX_WHITE );
+			}
 
 			drawSpace = WORLD;
 
 #ifdef PLAY_USING_GAMEOBJECT_MANAGER
 			
-			for( std::pair<const int, GameObject&>& i : objectMap )
+			for( std::pair<const int, GameObject*>& i : objectMap )
 			{
-				GameObject& obj = i.second;
+				GameObject& obj = *i.second;
 				int id = obj.spriteId;
 				Vector2D size = pblt.GetSpriteSize( obj.spriteId );
 				Vector2D origin = pblt.GetSpriteOrigin( id );
@@ -3634,6 +8961,8 @@ namespace Play
 		}
 
 		PlayWindow::Instance().Present();
+		pblt.ResetOverdrawCount();
+		pblt.TrimSpriteMemory();
 
 		drawSpace = originalDrawSpace;
 	}
@@ -3736,6 +9065,57 @@ namespace Play
 		PlayGraphics::Instance().ColourSprite( spriteId, static_cast<int>( c.red * 2.55f ), static_cast<int>( c.green * 2.55f), static_cast<int>( c.blue * 2.55f ) );
 	}
 
+	void SetSpriteMemoryBudget( size_t bytes )
+	{
+		PlayGraphics::Instance().SetSpriteMemoryBudget( bytes );
+	}
+
+	void PreloadSprites( const std::vector<int>& spriteIds )
+	{
+		PlayGraphics::Instance().PreloadSprites( spriteIds );
+	}
+
+	std::vector<int> GetEvictedSprites()
+	{
+		return PlayGraphics::Instance().GetEvictedSprites();
+	}
+
+	std::vector<PlayGraphics::DecodedSprite> DecodeSprites( const std::vector<int>& spriteIds )
+	{
+		return PlayGraphics::Instance().DecodeSprites( spriteIds );
+	}
+
+	void AttachSprites( std::vector<PlayGraphics::DecodedSprite>& vDecoded )
+	{
+		PlayGraphics::Instance().AttachSprites( vDecoded );
+	}
+
+	void DiscardSprites( std::vector<PlayGraphics::DecodedSprite>& vDecoded )
+	{
+		PlayGraphics::DiscardSprites( vDecoded );
+	}
+
+	size_t GetSpriteMemory( int spriteId )
+	{
+		return PlayGraphics::Instance().GetSpriteMemory( spriteId );
+	}
+
+	size_t GetSpriteCategoryMemory( const char* category )
+	{
+		return PlayGraphics::Instance().GetSpriteCategoryMemory( category );
+	}
+
+	void EnableCompactSprites( bool enable )
+	{
+		PlayGraphics::Instance().EnableCompactSprites( enable );
+	}
+
+	void MakeSpriteMutable( const char* spriteName )
+	{
+		PlayGraphics& pblt = PlayGraphics::Instance();
+		pblt.MakeSpriteMutable( pblt.GetSpriteId( spriteName ) );
+	}
+
 	void CentreSpriteOrigin( const char* spriteName )
 	{
 		PlayGraphics& pblt = PlayGraphics::Instance();
@@ -3822,6 +9202,31 @@ namespace Play
 		PlayGraphics::Instance().DrawRotated( spriteID, TRANSFORM_SPACE( pos ), frameIndex, angle, scale, opacity );
 	}
 
+	int CreateScaledSprite( int spriteId, float scale )
+	{
+		return PlayGraphics::Instance().AddScaledSprite( spriteId, scale );
+	}
+
+	void UpdateScaledSprite( int scaledId, int spriteId, float scale )
+	{
+		PlayGraphics::Instance().UpdateScaledSprite( scaledId, spriteId, scale );
+	}
+
+	void ClearComposite( PixelData& composite, Point2D topLeft, Point2D bottomRight )
+	{
+		PlayGraphics::Instance().ClearComposite( composite, topLeft, bottomRight );
+	}
+
+	void ComposeSprite( PixelData& composite, int spriteID, Point2D pos, int frameIndex, Point2D clipTopLeft, Point2D clipBottomRight )
+	{
+		PlayGraphics::Instance().Compose( composite, spriteID, pos, frameIndex, clipTopLeft, clipBottomRight );
+	}
+
+	void DrawComposite( const PixelData& composite, Point2D pos )
+	{
+		PlayGraphics::Instance().DrawComposite( composite, TRANSFORM_SPACE( pos ) );
+	}
+
 	void DrawLine( Point2f start, Point2f end, Colour c )
 	{
 		return PlayGraphics::Instance().DrawLine( TRANSFORM_SPACE( start ), TRANSFORM_SPACE( end ), { c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f }  );
@@ -3926,14 +9331,14 @@ namespace Play
 		}
 	};
 
-	void DrawFontText( const char* fontId, std::string text, Point2D pos, Align justify )
+	void DrawFontText( const char* fontId, const char* text, Point2D pos, Align justify )
 	{
 		int font = PlayGraphics::Instance().GetSpriteId( fontId );
 
 		int totalWidth{ 0 };
 
-		for( char c : text )
-			totalWidth += PlayGraphics::Instance().GetFontCharWidth( font, c );
+		for( const char* c = text; *c; c++ )
+			totalWidth += PlayGraphics::Instance().GetFontCharWidth( font, *c );
 
 		switch( justify )
 		{
@@ -3951,14 +9356,19 @@ namespace Play
 		PlayGraphics::Instance().DrawString( font, TRANSFORM_SPACE( pos ), text );
 	}
 
-	void BeginTimingBar( Colour c )
+	void DrawFontText( const char* fontId, const std::string& text, Point2D pos, Align justify )
 	{
-		PlayGraphics::Instance().TimingBarBegin( Pixel( c.red*2.55f, c.green*2.55f, c.blue*2.55f ) );
+		DrawFontText( fontId, text.c_str(), pos, justify );
 	}
 
-	int ColourTimingBar( Colour c )
+	void BeginTimingBar( Colour c, const char* name )
 	{
-		return PlayGraphics::Instance().SetTimingBarColour( Pixel( c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f ) );
+		PlayGraphics::Instance().TimingBarBegin( Pixel( c.red*2.55f, c.green*2.55f, c.blue*2.55f ), name );
+	}
+
+	int ColourTimingBar( Colour c, const char* name )
+	{
+		return PlayGraphics::Instance().SetTimingBarColour( Pixel( c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f ), name );
 	}
 
 	void DrawTimingBar( Point2f pos, Point2f size )
@@ -3966,6 +9376,26 @@ namespace Play
 		PlayGraphics::Instance().DrawTimingBar( pos, size );
 	}
 
+	PlayProfiler::FrameStats GetFrameTimeStats( const char* segmentName )
+	{
+		PlayProfiler& profiler = PlayProfiler::Instance();
+		if( !segmentName )
+			return profiler.GetFrameStats();
+
+		int segment = profiler.FindStatsSegment( segmentName );
+		return segment < 0 ? PlayProfiler::FrameStats() : profiler.GetSegmentStats( segment );
+	}
+
+	void SetHitchThreshold( float millisecs )
+	{
+		PlayProfiler::Instance().SetHitchThreshold( millisecs );
+	}
+
+	float GetHitchThreshold()
+	{
+		return PlayProfiler::Instance().GetHitchThreshold();
+	}
+
 
 	//**************************************************************************************************
 	// GameObject functions
@@ -3975,30 +9405,92 @@ namespace Play
 
 	int CreateGameObject( int type, Point2f newPos, int collisionRadius, const char* spriteName )
 	{
-		int spriteId = PlayGraphics::Instance().GetSpriteId( spriteName );
-		// Deletion is handled in DestroyGameObject()
-		GameObject* pObj = new GameObject( type, newPos, collisionRadius, spriteId );
-		int id = pObj->GetId();
-		objectMap.insert( std::map<int, GameObject&>::value_type( id, *pObj ) );
-		return id;
+		return CreateGameObject( type, newPos, collisionRadius, PlayGraphics::Instance().GetSpriteId( spriteName ) );
+	}
+
+	// Adds a copy of the GameObject to the map just before the hint, reusing a destroyed GameObject and map node if there are any
+	static std::map<int, GameObject*>::iterator InsertGameObject( const GameObject& source, std::map<int, GameObject*>::iterator hint )
+	{
+		GameObject* pObj;
+		if( freeObjects.empty() )
+		{
+			// Deletion is handled in DestroyManager()
+			pObj = GameObjectCopier::Clone( source );
+		}
+		else
+		{
+			pObj = freeObjects.back();
+			freeObjects.pop_back();
+			GameObjectCopier::Copy( *pObj, source );
+		}
+
+		if( freeNodes.empty() )
+			return objectMap.emplace_hint( hint, pObj->GetId(), pObj );
+
+		std::map<int, GameObject*>::node_type node = std::move( freeNodes.back() );
+		freeNodes.pop_back();
+		node.key() = pObj->GetId();
+		node.mapped() = pObj;
+		return objectMap.insert( hint, std::move( node ) );
+	}
+
+	// Removes a GameObject from the map, keeping it and its map node for reuse
+	// > Returns the iterator following the removed object
+	static std::map<int, GameObject*>::iterator EraseGameObject( std::map<int, GameObject*>::iterator i )
+	{
+		std::map<int, GameObject*>::iterator next = std::next( i );
+		freeObjects.push_back( i->second );
+		freeNodes.push_back( objectMap.extract( i ) );
+		return next;
+	}
+
+	int CreateGameObject( int type, Point2f newPos, int collisionRadius, int spriteId )
+	{
+		PLAY_ALLOCATION_TAG( "Game objects" );
+		GameObject newObj( type, newPos, collisionRadius, spriteId );
+		// Ids always increase so the new object belongs at the end of the map
+		InsertGameObject( newObj, objectMap.end() );
+		PlayProfiler::Count( COUNTER_OBJECTS_CREATED );
+		return newObj.GetId();
+	}
+
+	int CreateGameObjects( int type, int count, const Point2f* pPositions, const int* pSpriteIds, int collisionRadius )
+	{
+		PLAY_ALLOCATION_TAG( "Game objects" );
+		PLAY_ASSERT_MSG( count > 0, "Trying to create no GameObjects" );
+
+		// The ids are handed out consecutively, so each object goes straight on the end of the map without searching it
+		int firstId = -1;
+
+		for( int i = 0; i < count; i++ )
+		{
+			GameObject newObj( type, pPositions[i], collisionRadius, pSpriteIds[i] );
+			InsertGameObject( newObj, objectMap.end() );
+
+			if( i == 0 )
+				firstId = newObj.GetId();
+		}
+
+		PlayProfiler::Count( COUNTER_OBJECTS_CREATED, count );
+		return firstId;
 	}
 
 	GameObject& GetGameObject( int ID )
 	{
-		std::map<int, GameObject&>::iterator i = objectMap.find( ID );
+		std::map<int, GameObject*>::iterator i = objectMap.find( ID );
 
 		if( i == objectMap.end() )
 			return noObject;
 
-		return i->second;
+		return *i->second;
 	}
 
 	GameObject& GetGameObjectByType( int type )
 	{
-		for( std::pair<const int, GameObject&>& i : objectMap )
+		for( std::pair<const int, GameObject*>& i : objectMap )
 		{
-			if( i.second.type == type )
-				return i.second;
+			if( i.second->type == type )
+				return *i.second;
 		}
 
 		return noObject;
@@ -4007,19 +9499,25 @@ namespace Play
 	std::vector<int> CollectGameObjectIDsByType( int type )
 	{
 		std::vector<int> vec;
-		for( std::pair<const int, GameObject&>& i : objectMap )
+		CollectGameObjectIDsByType( type, vec );
+		return vec; // Returning a copy of the vector
+	}
+
+	void CollectGameObjectIDsByType( int type, std::vector<int>& vIds )
+	{
+		vIds.clear();
+		for( std::pair<const int, GameObject*>& i : objectMap )
 		{
-			if( i.second.type == type )
-				vec.push_back( i.first );
+			if( i.second->type == type )
+				vIds.push_back( i.first );
 		}
-		return vec; // Returning a copy of the vector
 	}
 
 	std::vector<int> CollectAllGameObjectIDs()
 	{
 		std::vector<int> vec;
 
-		for( std::pair<const int, GameObject&>& i : objectMap )
+		for( std::pair<const int, GameObject*>& i : objectMap )
 			vec.push_back( i.first );
 
 		return vec; // Returning a copy of the vector
@@ -4068,15 +9566,16 @@ namespace Play
 
 	void DestroyGameObject( int ID )
 	{
-		if( objectMap.find( ID ) == objectMap.end() )
+		std::map<int, GameObject*>::iterator i = objectMap.find( ID );
+
+		if( i == objectMap.end() )
 		{
 			PLAY_ASSERT_MSG( false, "Unable to find object with given ID" );
 		}
 		else
 		{
-			GameObject* go = &objectMap.find( ID )->second;
-			delete go;
-			objectMap.erase( ID );
+			EraseGameObject( i );
+			PlayProfiler::Count( COUNTER_OBJECTS_DESTROYED );
 		}
 	}
 
@@ -4087,15 +9586,87 @@ namespace Play
 			DestroyGameObject( typeVec[i] );
 	}
 
+	void SaveGameObjectSnapshot()
+	{
+		for( GameObject* pObj : snapshotObjects )
+			delete pObj;
+		snapshotObjects.clear();
+		snapshotObjects.reserve( objectMap.size() );
+
+		// Deletion is handled here or in DestroyManager()
+		for( std::pair<const int, GameObject*>& i : objectMap )
+			snapshotObjects.push_back( GameObjectCopier::Clone( *i.second ) );
+	}
+
+	void RestoreGameObjectSnapshot()
+	{
+		// Objects which aren't in the snapshot are destroyed first, so there are always enough to reuse for the missing ones
+		size_t s = 0;
+		for( std::map<int, GameObject*>::iterator i = objectMap.begin(); i != objectMap.end(); )
+		{
+			while( s < snapshotObjects.size() && snapshotObjects[s]->GetId() < i->first )
+				s++;
+
+			if( s < snapshotObjects.size() && snapshotObjects[s]->GetId() == i->first )
+				++i;
+			else
+				i = EraseGameObject( i );
+		}
+
+		// Both lists are in id order so they can be walked together, copying over the remaining objects in place
+		std::map<int, GameObject*>::iterator i = objectMap.begin();
+		for( GameObject* pSaved : snapshotObjects )
+		{
+			if( i != objectMap.end() && i->first == pSaved->GetId() )
+			{
+				GameObjectCopier::Copy( *i->second, *pSaved );
+				++i;
+			}
+			else
+			{
+				InsertGameObject( *pSaved, i );
+			}
+		}
+	}
+
+	uint32_t GetGameObjectChecksum()
+	{
+		uint32_t checksum = PlayReplay::Checksum( nullptr, 0 );
+
+		// Only the default members are included, as the game can add members which don't affect its state
+		for( std::pair<const int, GameObject*>& i : objectMap )
+		{
+			const GameObject& obj = *i.second;
+			checksum = PlayReplay::Checksum( &i.first, sizeof( int ), checksum );
+			checksum = PlayReplay::Checksum( &obj.type, sizeof( int ), checksum );
+			checksum = PlayReplay::Checksum( &obj.spriteId, sizeof( int ), checksum );
+			checksum = PlayReplay::Checksum( &obj.pos, sizeof( Point2D ), checksum );
+			checksum = PlayReplay::Checksum( &obj.velocity, sizeof( Vector2D ), checksum );
+			checksum = PlayReplay::Checksum( &obj.acceleration, sizeof( Vector2D ), checksum );
+			checksum = PlayReplay::Checksum( &obj.rotation, sizeof( float ), checksum );
+			checksum = PlayReplay::Checksum( &obj.rotSpeed, sizeof( float ), checksum );
+			checksum = PlayReplay::Checksum( &obj.frame, sizeof( int ), checksum );
+			checksum = PlayReplay::Checksum( &obj.framePos, sizeof( float ), checksum );
+			checksum = PlayReplay::Checksum( &obj.animSpeed, sizeof( float ), checksum );
+			checksum = PlayReplay::Checksum( &obj.radius, sizeof( int ), checksum );
+			checksum = PlayReplay::Checksum( &obj.scale, sizeof( float ), checksum );
+		}
+
+		return checksum;
+	}
+
 	bool IsColliding( GameObject& object1, GameObject& object2 )
 	{
 		//Don't collide with noObject
 		if( object1.type == -1 || object2.type == -1 )
 			return false;
 
-		int xDiff = int( object1.pos.null ) - int( object2.pos.null );
-		int yDiff = int( object1.pos.y ) - int( object2.pos.y );
-		int radii = object2.radius + object1.radius;
+		PlayProfiler::Count( COUNTER_CIRCLE_TESTS );
+
+		// The squares are worked out in 64 bits, as they overflow an int for objects more than about 46000 pixels apart
+		long long xDiff = int( object1.pos.null ) - int( object2.pos.null );
+		long long yDiff = int( object1.pos.y ) - int( object2.pos.y );
+		long long radii = object2.radius + object1.radius;
 
 		// Game progammers don't do square root!
 		return( ( xDiff * xDiff ) + ( yDiff * yDiff ) < radii * radii );
@@ -4223,6 +9794,11 @@ namespace Play
 		return PlayInput::Instance().KeyDown( vKey );
 	}
 
+	bool IsRecordingOrReplaying()
+	{
+		return PlayReplay::Instance().IsRecording() || PlayReplay::Instance().IsReplaying();
+	}
+
 	int RandomRoll( int sides )
 	{
 		return ( rand() % sides ) + 1;